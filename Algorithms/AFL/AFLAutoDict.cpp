@@ -0,0 +1,192 @@
+#include "Algorithms/AFL/AFLAutoDict.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string_view>
+
+#include "Algorithms/AFL/AFLUtil.hpp"
+
+namespace {
+
+/* The order of all the entries: by use count, descending. Ties are broken
+   by length and then by content, so that the order is always the same. */
+
+bool RankBefore(const AFLDictData &e1, const AFLDictData &e2) {
+    if (e1.hit_cnt != e2.hit_cnt) return e1.hit_cnt > e2.hit_cnt;
+    if (e1.data.size() != e2.data.size()) return e1.data.size() < e2.data.size();
+    return std::lexicographical_compare(e1.data.begin(), e1.data.end(),
+                                        e2.data.begin(), e2.data.end());
+}
+
+/* The order of the first USE_AUTO_EXTRAS entries: by length. */
+
+bool FrontBefore(const AFLDictData &e1, const AFLDictData &e2) {
+    if (e1.data.size() != e2.data.size()) return e1.data.size() < e2.data.size();
+    if (e1.hit_cnt != e2.hit_cnt) return e1.hit_cnt > e2.hit_cnt;
+    return std::lexicographical_compare(e1.data.begin(), e1.data.end(),
+                                        e2.data.begin(), e2.data.end());
+}
+
+} // anonymous namespace
+
+AFLAutoDict::AFLAutoDict() {
+    entries.reserve(AFLOption::MAX_AUTO_EXTRAS);
+    ids.reserve(AFLOption::MAX_AUTO_EXTRAS);
+    pos_of.reserve(AFLOption::MAX_AUTO_EXTRAS);
+    key_of.reserve(AFLOption::MAX_AUTO_EXTRAS);
+    index.reserve(AFLOption::MAX_AUTO_EXTRAS);
+}
+
+bool AFLAutoDict::FoldedToken::operator==(const FoldedToken &other) const {
+    return len == other.len && std::memcmp(bytes.data(), other.bytes.data(), len) == 0;
+}
+
+std::size_t AFLAutoDict::FoldedTokenHash::operator()(const FoldedToken &token) const {
+    return std::hash<std::string_view>()(
+               std::string_view((const char*)token.bytes.data(), token.len));
+}
+
+AFLAutoDict::FoldedToken AFLAutoDict::Fold(const u8 *token, u32 len) {
+    FoldedToken folded;
+    folded.len = len;
+    for (u32 i=0; i < len; i++) folded.bytes[i] = std::tolower(token[i]);
+    return folded;
+}
+
+bool AFLAutoDict::Contains(const u8 *token, u32 len) const {
+    if (len > AFLOption::MAX_AUTO_EXTRA) return false;
+    return index.count(Fold(token, len)) != 0;
+}
+
+void AFLAutoDict::Add(const u8 *token, u32 len, fuzzuf::utils::random::prng &rng) {
+    auto key = Fold(token, len);
+    version++;
+
+    auto itr = index.find(key);
+    if (itr != index.end()) {
+        u32 pos = pos_of[itr->second];
+        entries[pos].hit_cnt++;
+        Settle(pos);
+        return;
+    }
+
+    /* At this point, looks like we're dealing with a new entry. So, let's
+       append it if we have room. Otherwise, let's randomly evict some other
+       entry from the bottom half of the list. */
+
+    if (entries.size() < AFLOption::MAX_AUTO_EXTRAS) {
+        u32 id = entries.size();
+        entries.emplace_back(AFLDictData{AFLDictData::word_t(token, token + len), 0});
+        ids.emplace_back(id);
+        pos_of.emplace_back(id);
+        key_of.emplace_back(key);
+        index.emplace(key, id);
+
+        Settle(id);
+    } else {
+        using afl::util::UR;
+
+        u32 pos = AFLOption::MAX_AUTO_EXTRAS / 2;
+        pos += UR((AFLOption::MAX_AUTO_EXTRAS + 1) / 2, rng);
+
+        u32 id = ids[pos];
+        index.erase(key_of[id]);
+        key_of[id] = key;
+        index.emplace(key, id);
+
+        entries[pos].data.assign(token, token + len);
+        entries[pos].hit_cnt = 0;
+
+        Settle(pos);
+    }
+}
+
+void AFLAutoDict::Restore(const std::vector<AFLDictData> &saved) {
+    entries.clear();
+    ids.clear();
+    pos_of.clear();
+    key_of.clear();
+    index.clear();
+    version++;
+
+    for (const auto &entry : saved) {
+        if (entries.size() == AFLOption::MAX_AUTO_EXTRAS) break;
+        if (entry.data.empty() || entry.data.size() > AFLOption::MAX_AUTO_EXTRA) continue;
+
+        auto key = Fold(entry.data.data(), entry.data.size());
+        u32 id = entries.size();
+        if (!index.emplace(key, id).second) continue;
+
+        entries.emplace_back(entry);
+        ids.emplace_back(id);
+        pos_of.emplace_back(id);
+        key_of.emplace_back(key);
+    }
+}
+
+u32 AFLAutoDict::GetNumFront() const {
+    return std::min<u32>(AFLOption::USE_AUTO_EXTRAS, entries.size());
+}
+
+void AFLAutoDict::Swap(u32 i, u32 j) {
+    std::swap(entries[i], entries[j]);
+    std::swap(ids[i], ids[j]);
+    pos_of[ids[i]] = i;
+    pos_of[ids[j]] = j;
+}
+
+void AFLAutoDict::Move(u32 from, u32 to) {
+    if (from < to) {
+        std::rotate(entries.begin() + from, entries.begin() + from + 1, entries.begin() + to + 1);
+        std::rotate(ids.begin() + from, ids.begin() + from + 1, ids.begin() + to + 1);
+        for (u32 i=from; i <= to; i++) pos_of[ids[i]] = i;
+    } else if (to < from) {
+        std::rotate(entries.begin() + to, entries.begin() + from, entries.begin() + from + 1);
+        std::rotate(ids.begin() + to, ids.begin() + from, ids.begin() + from + 1);
+        for (u32 i=to; i <= from; i++) pos_of[ids[i]] = i;
+    }
+}
+
+void AFLAutoDict::Settle(u32 pos) {
+    u32 num_front = GetNumFront();
+    u32 last = entries.size() - 1;
+
+    auto settle_in_front = [this, num_front](u32 pos) {
+        while (pos > 0 && FrontBefore(entries[pos], entries[pos-1])) {
+            Swap(pos, pos-1);
+            pos--;
+        }
+        while (pos + 1 < num_front && FrontBefore(entries[pos+1], entries[pos])) {
+            Swap(pos, pos+1);
+            pos++;
+        }
+    };
+
+    // An entry in the front only moves up in the ranking, so it stays in the front.
+    if (pos < num_front) {
+        settle_in_front(pos);
+        return;
+    }
+
+    // Take the entry out of the rest, which is sorted by the ranking
+    Move(pos, last);
+
+    u32 worst = 0;
+    for (u32 i=1; i < num_front; i++) {
+        if (RankBefore(entries[worst], entries[i])) worst = i;
+    }
+
+    if (RankBefore(entries[last], entries[worst])) {
+        // The entry gets into the front and pushes out the worst one there,
+        // which still ranks higher than the rest.
+        Swap(worst, last);
+        settle_in_front(worst);
+        Move(last, num_front);
+    } else {
+        auto itr = std::lower_bound(
+                       entries.begin() + num_front, entries.begin() + last, entries[last],
+                       RankBefore);
+        Move(last, itr - entries.begin());
+    }
+}
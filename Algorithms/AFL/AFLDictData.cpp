@@ -1,4 +1,5 @@
 #include <Utils/AFLDictParser.hpp>
+#include <Utils/MappedDictionary.hpp>
 #include <Algorithms/AFL/AFLDictData.hpp>
 
 namespace fuzzuf::algorithm::afl::dictionary {
@@ -6,6 +7,7 @@ namespace fuzzuf::algorithm::afl::dictionary {
 /**
  * @fn
  * filenameで指定されたAFL辞書をdestにロードする
+ * filenameがtools/dict2mpで変換済みの辞書の場合はパースせずにロードする
  * destに最初から要素がある場合、ロードした内容は既にある要素の後ろにinsertされる
  * @brief filenameで指定されたAFL辞書をdestにロードする
  * @param filename ファイル名
@@ -18,7 +20,12 @@ void load(
   bool strict,
   const std::function< void( std::string&& ) > &eout
 ) {
-  utils::dictionary::load_afl_dictionary( filename_, dest, strict, eout );
+  if( auto mapped = utils::dictionary::mapped_dictionary::try_open( filename_ ) ) {
+    dest.reserve( dest.size() + mapped->size() );
+    utils::dictionary::load_mapped_dictionary( *mapped, dest, eout );
+  }
+  else
+    utils::dictionary::load_afl_dictionary( filename_, dest, strict, eout );
 }
 
 }
@@ -0,0 +1,342 @@
+#include "Algorithms/AFL/AFLExecutorPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <sched.h>
+#include <string>
+#include <thread>
+
+#include "Options.hpp"
+#include "Utils/Common.hpp"
+#include "Feedback/InplaceMemoryFeedback.hpp"
+#include "Feedback/ExitStatusFeedback.hpp"
+#include "Algorithms/AFL/AFLMacro.hpp"
+#include "Algorithms/AFL/AFLState.hpp"
+#include "Algorithms/AFL/AFLUtil.hpp"
+#include "Algorithms/AFL/AFLFuzzer.hpp"
+
+// Same as AFLState::RunExecutorWithClassifyCounts, on the given executor
+static InplaceMemoryFeedback RunWithClassifyCounts(
+    NativeLinuxExecutor &executor,
+    const u8 *buf,
+    u32 len,
+    u32 tmout,
+    ExitStatusFeedback &exit_status
+) {
+    executor.Run(buf, len, tmout);
+
+    auto inp_feed = executor.GetAFLFeedback();
+    exit_status = executor.GetExitStatusFeedback();
+    if constexpr (sizeof(size_t) == 8) {
+        inp_feed.ModifyMemoryWithFunc(
+            [](u8* trace_bits, u32 map_size) {
+                AFLFuzzer::ClassifyCounts<u64>((u64*)trace_bits, map_size);
+            }
+        );
+    } else {
+        inp_feed.ModifyMemoryWithFunc(
+            [](u8* trace_bits, u32 map_size) {
+                AFLFuzzer::ClassifyCounts<u32>((u32*)trace_bits, map_size);
+            }
+        );
+    }
+    return inp_feed;
+}
+
+AFLExecutorPool::AFLExecutorPool(
+    const AFLSetting &setting,
+    NativeLinuxExecutor &main_executor,
+    u32 num_workers
+) {
+    executors.emplace_back(&main_executor);
+
+    // When the main executor binds this thread to a core, the additional fork servers
+    // would inherit it. So we let each of them pick another free core, and bring back
+    // the original affinity at the end.
+    int cpuid_to_bind = NativeLinuxExecutor::CPUID_DO_NOT_BIND;
+#ifdef __linux__
+    cpu_set_t orig_affinity;
+    CPU_ZERO(&orig_affinity);
+    sched_getaffinity(0, sizeof(orig_affinity), &orig_affinity);
+
+    if (main_executor.binded_cpuid) {
+        u32 num_free = Util::GetFreeCpu(main_executor.cpu_core_count).size();
+        if (num_free + 1 < num_workers) {
+            WARNF("Only %u free CPU cores, using %u executors for deterministic stages.",
+                num_free, num_free + 1);
+            num_workers = num_free + 1;
+        }
+        cpuid_to_bind = NativeLinuxExecutor::CPUID_BIND_WHICHEVER;
+    }
+#endif
+
+    for (u32 i=1; i < num_workers; i++) {
+        auto outfile = std::string(AFLOption::DEFAULT_OUTFILE) + "." + std::to_string(i);
+        own_executors.emplace_back(
+            new NativeLinuxExecutor(
+                setting.argv,
+                setting.exec_timelimit_ms,
+                setting.exec_memlimit,
+                setting.forksrv,
+                setting.out_dir / outfile,
+                true,                 // need_afl_cov
+                false,                // need_bb_cov
+                cpuid_to_bind
+            )
+        );
+        executors.emplace_back(own_executors.back().get());
+    }
+
+#ifdef __linux__
+    sched_setaffinity(0, sizeof(orig_affinity), &orig_affinity);
+#endif
+
+    // Each executor overwrites these on construction
+    NativeLinuxExecutor::active_instance = &main_executor;
+    main_executor.SetupEnvironmentVariablesForTarget();
+}
+
+AFLExecutorPool::~AFLExecutorPool() {}
+
+u64 AFLExecutorPool::Run(
+    const AFLState &state,
+    const u8 *seed,
+    u32 len,
+    const std::vector<Patch> &patches,
+    const std::vector<u8> &data,
+    std::vector<Result> &results
+) {
+    results.assign(patches.size(), Result{});
+
+    std::atomic<std::size_t> next_patch(0);
+    std::atomic<u64> num_execs(0);
+    std::vector<std::exception_ptr> errors(executors.size());
+
+    auto work = [&](std::size_t worker_id) {
+        try {
+            auto &executor = *executors[worker_id];
+
+            std::vector<u8> buf(seed, seed + len);
+
+            // Every worker has its own copy of virgin_bits so that a trace found
+            // by an earlier mutant of the same worker isn't reported again.
+            // This never misses anything: bits are cleared only by mutants
+            // which are re-executed before the later ones.
+            std::vector<u8> virgin(state.virgin_bits);
+
+            while (!state.stop_soon) {
+                std::size_t begin = next_patch.fetch_add(AFLOption::DET_SHARD_CHUNK);
+                if (begin >= patches.size()) break;
+                std::size_t end = std::min<std::size_t>(
+                                      begin + AFLOption::DET_SHARD_CHUNK, patches.size());
+
+                for (std::size_t i=begin; i < end; i++) {
+                    const auto &patch = patches[i];
+                    std::memcpy(&buf[patch.pos], &data[patch.data_off], patch.len);
+
+                    ExitStatusFeedback exit_status;
+                    auto inp_feed = RunWithClassifyCounts(executor, buf.data(), len, 0, exit_status);
+
+                    auto &result = results[i];
+                    result.cksum = inp_feed.CalcCksum32();
+                    result.exit_reason = exit_status.exit_reason;
+
+                    if (result.exit_reason != PUTExitReasonType::FAULT_NONE) {
+                        // crashes and timeouts are rare and need the full treatment
+                        result.interesting = true;
+                    } else if (result.exit_reason == state.crash_mode) {
+                        u8 hnb = 0;
+                        inp_feed.ShowMemoryToFunc(
+                            [&hnb, &virgin](const u8* trace_bits, u32 map_size) {
+                                hnb = afl::util::HasNewBits(
+                                          trace_bits, virgin.data(), map_size);
+                            }
+                        );
+                        result.interesting = hnb != 0;
+                    }
+
+                    std::memcpy(&buf[patch.pos], seed + patch.pos, patch.len);
+                    num_execs++;
+                }
+            }
+        } catch (...) {
+            errors[worker_id] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i=1; i < executors.size(); i++) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (auto &thread : threads) thread.join();
+
+    for (auto &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    return num_execs;
+}
+
+std::vector<u8> AFLExecutorPool::Calibration::GetTrace(u32 cksum) const {
+    std::vector<u8> trace(first_trace);
+    if (cksum != cksums[0]) {
+        for (const auto &[pos, val] : trace_diffs.at(cksum)) trace[pos] = val;
+    }
+    return trace;
+}
+
+u64 AFLExecutorPool::Calibrate(
+    const AFLState &state,
+    const std::vector<std::pair<const u8*, u32>> &inputs,
+    u32 tmout,
+    std::vector<Calibration> &results
+) {
+    results.assign(inputs.size(), Calibration{});
+
+    std::atomic<std::size_t> next_input(0);
+    std::atomic<u64> num_execs(0);
+    std::vector<std::exception_ptr> errors(executors.size());
+
+    auto work = [&](std::size_t worker_id) {
+        try {
+            auto &executor = *executors[worker_id];
+
+            while (!state.stop_soon) {
+                std::size_t idx = next_input++;
+                if (idx >= inputs.size()) break;
+
+                const u8 *buf = inputs[idx].first;
+                u32 len = inputs[idx].second;
+                auto &result = results[idx];
+
+                u32 num_runs = state.fast_cal ? 3 : AFLOption::CAL_CYCLES;
+                u64 start_us = Util::GetCurTimeUs();
+                for (u32 i=0; i < num_runs && !state.stop_soon; i++) {
+                    ExitStatusFeedback exit_status;
+                    auto inp_feed = RunWithClassifyCounts(executor, buf, len, tmout, exit_status);
+                    num_execs++;
+
+                    u32 cksum = inp_feed.CalcCksum32();
+                    result.exit_reason = exit_status.exit_reason;
+                    result.cksums.emplace_back(cksum);
+                    result.elapsed_us.emplace_back(Util::GetCurTimeUs() - start_us);
+
+                    if (i == 0) {
+                        inp_feed.ShowMemoryToFunc(
+                            [&result](const u8* trace_bits, u32 map_size) {
+                                result.first_trace.assign(trace_bits, trace_bits + map_size);
+                            }
+                        );
+                    } else if (cksum != result.cksums[0] && !result.trace_diffs.count(cksum)) {
+                        inp_feed.ShowMemoryToFunc(
+                            [&result, cksum](const u8* trace_bits, u32 map_size) {
+                                auto &diff = result.trace_diffs[cksum];
+                                for (u32 j=0; j < map_size; j++) {
+                                    if (trace_bits[j] != result.first_trace[j]) {
+                                        diff.emplace_back(j, trace_bits[j]);
+                                    }
+                                }
+                            }
+                        );
+                    }
+
+                    // These end the calibration whatever the other runs would give
+                    if (exit_status.exit_reason != state.crash_mode) break;
+                    if (!state.setting.dumb_mode && i == 0 && !inp_feed.CountNonZeroBytes()) break;
+
+                    // The serial calibration extends only when new variable bytes show up,
+                    // which can't happen unless the trace differs from the first one
+                    if (cksum != result.cksums[0]) num_runs = AFLOption::CAL_CYCLES_LONG;
+                }
+            }
+        } catch (...) {
+            errors[worker_id] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i=1; i < executors.size(); i++) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (auto &thread : threads) thread.join();
+
+    for (auto &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    return num_execs;
+}
+
+u64 AFLExecutorPool::RunInputs(
+    const AFLState &state,
+    const std::vector<std::pair<const u8*, u32>> &inputs,
+    std::vector<Result> &results,
+    u32 keep_cksum,
+    std::vector<u8> &kept_trace
+) {
+    results.assign(inputs.size(), Result{});
+
+    std::atomic<std::size_t> next_input(0);
+    std::atomic<u64> num_execs(0);
+    std::mutex trace_mutex;
+    std::vector<std::exception_ptr> errors(executors.size());
+
+    auto work = [&](std::size_t worker_id) {
+        try {
+            auto &executor = *executors[worker_id];
+
+            while (!state.stop_soon) {
+                std::size_t idx = next_input++;
+                if (idx >= inputs.size()) break;
+
+                ExitStatusFeedback exit_status;
+                auto inp_feed = RunWithClassifyCounts(
+                                    executor, inputs[idx].first, inputs[idx].second, 0, exit_status);
+                num_execs++;
+
+                auto &result = results[idx];
+                result.cksum = inp_feed.CalcCksum32();
+                result.exit_reason = exit_status.exit_reason;
+
+                if (result.cksum == keep_cksum) {
+                    std::lock_guard<std::mutex> lock(trace_mutex);
+                    if (kept_trace.empty()) {
+                        inp_feed.ShowMemoryToFunc(
+                            [&kept_trace](const u8* trace_bits, u32 map_size) {
+                                kept_trace.assign(trace_bits, trace_bits + map_size);
+                            }
+                        );
+                    }
+                }
+            }
+        } catch (...) {
+            errors[worker_id] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i=1; i < executors.size(); i++) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (auto &thread : threads) thread.join();
+
+    for (auto &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    return num_execs;
+}
+
+// Do not call non aync-signal-safe functions inside
+// because this function can be called during signal handling
+void AFLExecutorPool::ReceiveStopSignal(void) {
+    for (auto &executor : own_executors) {
+        executor->ReceiveStopSignal();
+    }
+}
@@ -1,12 +1,17 @@
 #include "Algorithms/AFL/AFLFuzzer.hpp"
 
+#include <algorithm>
 #include <cstddef>
+#include <thread>
+#include <unordered_set>
 #include <unistd.h>
 #include <sys/ioctl.h>
 
 #include "Options.hpp"
 #include "Utils/Common.hpp"
 #include "Utils/Workspace.hpp"
+#include "Utils/ListDirectory.hpp"
+#include "Utils/ParallelFor.hpp"
 #include "Feedback/ExitStatusFeedback.hpp"
 
 #include "HierarFlow/HierarFlowRoutine.hpp"
@@ -16,7 +21,9 @@
 #include "Algorithms/AFL/CountClasses.hpp"
 #include "Algorithms/AFL/AFLMacro.hpp"
 #include "Algorithms/AFL/AFLSetting.hpp"
+#include "Algorithms/AFL/AFLCmpLog.hpp"
 #include "Algorithms/AFL/AFLState.hpp"
+#include "Algorithms/AFL/AFLExecutorPool.hpp"
 #include "Algorithms/AFL/AFLMutationHierarFlowRoutines.hpp"
 #include "Algorithms/AFL/AFLUpdateHierarFlowRoutines.hpp"
 #include "Algorithms/AFL/AFLOtherHierarFlowRoutines.hpp"
@@ -111,27 +118,196 @@ static void CheckIfTty(AFLState &state) {
     }
 }
 
-static void ShufflePtrs(void** ptrs, u32 cnt, int rand_fd) {
+static void SetupDetExecutorPool(
+    AFLState &state,
+    const AFLSetting &setting,
+    NativeLinuxExecutor &executor,
+    std::unique_ptr<AFLExecutorPool> &pool
+) {
+    char *det_shards = getenv("AFL_DET_SHARDS");
+    if (!det_shards) return;
+
+    u32 num_workers = atoi(det_shards);
+    if (num_workers < 2) return;
+
+    if (!setting.forksrv) {
+        WARNF("AFL_DET_SHARDS requires the fork server, ignoring it.");
+        return;
+    }
+
+    pool.reset(new AFLExecutorPool(setting, executor, num_workers));
+    if (pool->GetNumWorkers() < 2) {
+        pool.reset();
+        return;
+    }
+
+    state.det_executor_pool = pool.get();
+    OKF("Running the dry run and deterministic stages on %u executors.",
+        pool->GetNumWorkers());
+}
+
+static void SetupPackedCorpus(AFLState &state) {
+    if (!getenv("AFL_PACKED_CORPUS")) return;
+
+    auto queue_dir = state.setting.out_dir / "queue";
+    state.corpus_store = std::make_shared<PackedCorpusStore>(queue_dir);
+    state.input_set.EnablePackedStore(state.corpus_store);
+
+    OKF("Storing the queue in '%s/corpus.seg'.", queue_dir.c_str());
+}
+
+/* Read the queue of an earlier run that used AFL_PACKED_CORPUS. The entries
+   are copied under their original names, which PivotInputs() then keeps.
+   Copies of an earlier entry are kept as well: PivotInputs() only keeps a
+   name whose ID matches the position in the queue. */
+
+static void ReadPackedTestcases(AFLState &state) {
+    auto& in_dir = state.setting.in_dir;
+    ACTF("Reading the packed corpus in '%s'...", in_dir.c_str());
+
+    if (fs::equivalent(in_dir, state.setting.out_dir / "queue"))
+        FATAL("The input directory '%s' is the queue being written", in_dir.c_str());
+
+    PackedCorpusStore in_store(in_dir, true);
+    std::vector<u8> buf;
+
+    for (u32 idx = 0; idx < in_store.size(); idx++) {
+        const auto& name = in_store.GetName(idx);
+        u32 len = in_store.GetLen(idx);
+
+        if (!len) continue;
+
+        if (len > AFLOption::MAX_FILE) {
+            FATAL("Test case '%s' is too big (%s, limit is %s)",
+                name.c_str(),
+                afl::util::DescribeMemorySize(len).c_str(),
+                afl::util::DescribeMemorySize(AFLOption::MAX_FILE).c_str()
+            );
+        }
+
+        buf.resize(len);
+        in_store.Read(idx, buf.data());
+
+        std::string fn = Util::StrPrintf("%s/queue/%s", state.setting.out_dir.c_str(), name.c_str());
+        std::string pfn = Util::StrPrintf("%s/.state/det_progress/%s", in_dir.c_str(), name.c_str());
+
+        bool passed_det = in_store.GetFlags(idx) & PackedCorpusStore::PASSED_DET;
+
+        auto testcase = afl::util::AddToQueue(state, fn, buf.data(), len, passed_det);
+
+        if (state.corpus_store) {
+            auto new_idx = state.corpus_store->Find(name);
+            if (new_idx) state.corpus_store->SetParent(*new_idx, in_store.GetParent(idx));
+        }
+
+        if (!passed_det) testcase->det_progress = afl::util::ReadDetProgress(pfn);
+    }
+}
+
+template<class T>
+static void ShuffleVector(std::vector<T> &vec, fuzzuf::utils::random::prng &rng) {
     using afl::util::UR;
+    u32 cnt = vec.size();
     for (u32 i=0; i < cnt-2; i++) {
-        u32 j = i + UR(cnt - i, rand_fd);
-        std::swap(ptrs[i], ptrs[j]);
+        u32 j = i + UR(cnt - i, rng);
+        std::swap(vec[i], vec[j]);
     }
 }
 
+/* What the scan of the input directory found out about one file. */
+
+struct SeedFileInfo {
+    int error = 0;                /* errno of a failed lstat or access     */
+    u32 mode = 0;                 /* File type and mode                    */
+    u64 size = 0;                 /* File size                             */
+    bool passed_det = false;      /* Deterministic stages done?            */
+    bool hashed = false;          /* Is hash valid?                        */
+    Util::Hash128Value hash;      /* Hash of the contents                  */
+
+    std::unique_ptr<AFLDetProgress> det_progress;
+};
+
+/* Called on several threads at once, so it only fills in info. Files which
+   can't be read are left unhashed; the dry run will complain about them. */
+
+static void ScanSeedFile(
+    int dir_fd,
+    const std::string &in_dir,
+    const std::string &name,
+    SeedFileInfo &info
+) {
+    struct statx stx;
+    if ( statx(dir_fd, name.c_str(), AT_SYMLINK_NOFOLLOW, STATX_TYPE | STATX_SIZE, &stx) != 0
+      || faccessat(dir_fd, name.c_str(), R_OK, 0) != 0) {
+        info.error = errno;
+        return;
+    }
+
+    info.mode = stx.stx_mode;
+    info.size = stx.stx_size;
+
+    if (!S_ISREG(info.mode) || !info.size || info.size > AFLOption::MAX_FILE) return;
+
+    /* Check for metadata that indicates that deterministic fuzzing
+       is complete for this entry. We don't want to repeat deterministic
+       fuzzing when resuming aborted scans, because it would be pointless
+       and probably very time-consuming. Likewise, if deterministic fuzzing
+       was interrupted, pick up where it stopped. */
+
+    std::string dfn = in_dir + "/.state/deterministic_done/" + name;
+    std::string pfn = in_dir + "/.state/det_progress/" + name;
+
+    info.passed_det = access(dfn.c_str(), F_OK) == 0;
+    if (!info.passed_det) info.det_progress = afl::util::ReadDetProgress(pfn);
+
+    int fd = openat(dir_fd, name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    thread_local std::vector<u8> buf;
+    buf.resize(info.size);
+
+    u64 done = 0;
+    while (done < info.size) {
+        ssize_t n = pread(fd, buf.data() + done, info.size - done, done);
+        if (n <= 0) break;
+        done += n;
+    }
+    close(fd);
+
+    if (done != info.size) return;
+
+    info.hash = Util::Hash128(buf.data(), buf.size(), AFLOption::HASH_CONST);
+    info.hashed = true;
+}
+
 static void ReadTestcases(AFLState &state) {
     //FIXME: support resume
-    struct dirent **nl;
-
     auto& in_dir = state.setting.in_dir;
+
+    /* If this is the queue of an earlier run, it may have left a checkpoint
+       that saves us from calibrating everything again. */
+
+    state.resume_checkpoint = afl::util::ReadCheckpoint((in_dir / ".state/checkpoint").string());
+
+    if (PackedCorpusStore::Exists(in_dir)) {
+        ReadPackedTestcases(state);
+
+        if (!state.queued_paths) FATAL("No usable test cases in '%s'", in_dir.c_str());
+
+        state.last_path_time = 0;
+        state.queued_at_start = state.queued_paths;
+        return;
+    }
+
     ACTF("Scanning '%s'...", in_dir.c_str());
 
-    /* We use scandir() + alphasort() rather than readdir() because otherwise,
-       the ordering  of test cases would vary somewhat randomly and would be
-       difficult to control. */
+    /* The directory is read with getdents64() in large batches and sorted
+       with strcoll() just like scandir() + alphasort() would do, because
+       otherwise the ordering of test cases would vary somewhat randomly and
+       would be difficult to control. */
 
-    int nl_cnt = Util::ScanDirAlpha(in_dir.string(), &nl);
-    if (nl_cnt < 0) {
+    std::vector<std::string> names;
+    if (!fuzzuf::utils::list_directory(in_dir.string(), names)) {
         SAYF("\n" cLRD "[-] " cRST
             "The input directory does not seem to be valid - try again. The fuzzer needs\n"
             "    one or more test case to start with - ideally, a small file under 1 kB\n"
@@ -141,49 +317,88 @@ static void ReadTestcases(AFLState &state) {
         PFATAL("Unable to open '%s'", in_dir.c_str());
     }
 
-    if (state.shuffle_queue && nl_cnt > 1) {
+    std::sort(names.begin(), names.end(),
+        [](const std::string &lhs, const std::string &rhs) {
+            return std::strcoll(lhs.c_str(), rhs.c_str()) < 0;
+        }
+    );
+
+    if (state.shuffle_queue && names.size() > 1) {
         ACTF("Shuffling queue...");
-        ShufflePtrs((void**)nl, nl_cnt, state.rand_fd);
+        ShuffleVector(names, state.rng);
     }
 
-    for (int i=0; i < nl_cnt; i++) {
-        struct stat st;
+    /* stat, check and hash the files on all cores. The results are then
+       taken in the order above, so queue IDs don't depend on the threads. */
 
-        std::string fn = Util::StrPrintf("%s/%s", in_dir.c_str(), nl[i]->d_name);
-        std::string dfn = Util::StrPrintf("%s/.state/deterministic_done/%s", in_dir.c_str(), nl[i]->d_name);
+    int dir_fd = open(in_dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) PFATAL("Unable to open '%s'", in_dir.c_str());
 
-        bool passed_det = false;
-        free(nl[i]); /* not tracked */
+    std::vector<SeedFileInfo> infos(names.size());
+    fuzzuf::utils::parallel_for(
+        names.size(), std::thread::hardware_concurrency(), AFLOption::SEED_SCAN_CHUNK,
+        [&](std::size_t i) {
+            ScanSeedFile(dir_fd, in_dir.string(), names[i], infos[i]);
+        }
+    );
+    close(dir_fd);
+
+    /* The queue of an earlier run may contain copies of an entry (trimming
+       can make two entries equal). Dropping one would shift the IDs of all
+       the following entries, and PivotInputs() would then rename them and
+       not resume, so copies are only dropped from a plain seed directory. */
+
+    const std::string case_prefix = state.setting.simple_files ? "id_" : "id:";
+    bool is_queue = std::any_of(names.begin(), names.end(),
+        [&case_prefix](const std::string &name) {
+            return name.compare(0, case_prefix.size(), case_prefix) == 0;
+        }
+    );
 
-        if (lstat(fn.c_str(), &st) != 0 || access(fn.c_str(), R_OK) != 0) {
+    u32 duplicates = 0;
+
+    for (u32 i=0; i < names.size(); i++) {
+        auto &info = infos[i];
+
+        std::string fn = Util::StrPrintf("%s/%s", in_dir.c_str(), names[i].c_str());
+
+        if (info.error) {
+            errno = info.error;
             PFATAL("Unable to access '%s'", fn.c_str());
         }
 
         /* This also takes care of . and .. */
 
-        if (!S_ISREG(st.st_mode) || !st.st_size || fn.find("/README.txt") != std::string::npos) {
+        if (!S_ISREG(info.mode) || !info.size || fn.find("/README.txt") != std::string::npos) {
             continue;
         }
 
-        if (st.st_size > AFLOption::MAX_FILE) {
+        if (info.size > AFLOption::MAX_FILE) {
             FATAL("Test case '%s' is too big (%s, limit is %s)",
                 fn.c_str(),
-                afl::util::DescribeMemorySize(st.st_size).c_str(),
+                afl::util::DescribeMemorySize(info.size).c_str(),
                 afl::util::DescribeMemorySize(AFLOption::MAX_FILE).c_str()
             );
         }
 
-        /* Check for metadata that indicates that deterministic fuzzing
-           is complete for this entry. We don't want to repeat deterministic
-           fuzzing when resuming aborted scans, because it would be pointless
-           and probably very time-consuming. */
+        /* A copy of an earlier test case would only cost another calibration
+           and a share of every cycle. */
+
+        if (!is_queue && info.hashed && afl::util::IsKnownContent(state, info.hash)) {
+            duplicates++;
+            continue;
+        }
 
-        if (access(dfn.c_str(), F_OK) == 0) passed_det = true;
+        auto testcase = afl::util::AddToQueue(state, fn, nullptr, (u32)info.size, info.passed_det);
+        testcase->det_progress = std::move(info.det_progress);
 
-        afl::util::AddToQueue(state, fn, nullptr, (u32)st.st_size, passed_det);
+        if (info.hashed) afl::util::MarkAsKnownContent(state, *testcase, info.hash);
     }
 
-    free(nl); /* not tracked */
+    if (duplicates) {
+        WARNF("Skipped %u duplicate test case%s.", duplicates, duplicates > 1 ? "s" : "");
+        state.queued_duplicates += duplicates;
+    }
 
     if (!state.queued_paths) {
         SAYF("\n" cLRD "[-] " cRST
@@ -203,6 +418,9 @@ static void ReadTestcases(AFLState &state) {
 static void PivotInputs(AFLState &state) {
     ACTF("Creating hard links for all input files...");
 
+    std::vector<std::string> new_names;
+    new_names.reserve(state.case_queue.size());
+
     u32 id = 0;
     for (const auto& testcase : state.case_queue) {
         auto& input = *testcase->input;
@@ -228,11 +446,11 @@ static void PivotInputs(AFLState &state) {
               && sscanf(rsl.c_str()+pos+1, "%06u", &src_id) == 1) {
 
                 if (src_id < state.case_queue.size()) {
-                    testcase->depth = state.case_queue[src_id]->depth + 1;
+                    testcase->Depth() = state.case_queue[src_id]->Depth() + 1;
                 }
 
-                if (state.max_depth < testcase->depth) {
-                    state.max_depth = testcase->depth;
+                if (state.max_depth < testcase->Depth()) {
+                    state.max_depth = testcase->Depth();
                 }
             }
         } else {
@@ -255,17 +473,34 @@ static void PivotInputs(AFLState &state) {
             }
         }
 
-        /* Pivot to the new queue entry. */
+        new_names.emplace_back(std::move(nfn));
+        id++;
+    }
+
+    /* Pivot to the new queue entries. Entries read from a packed corpus are
+       already there. The links are made on all cores unless they go into the
+       packed store, which is not thread-safe. */
+
+    u32 num_threads = state.corpus_store ? 1 : std::thread::hardware_concurrency();
+    fuzzuf::utils::parallel_for(
+        state.case_queue.size(), num_threads, AFLOption::SEED_SCAN_CHUNK,
+        [&state, &new_names](std::size_t i) {
+            auto& input = *state.case_queue[i]->input;
+            const auto& nfn = new_names[i];
 
-        if (!input.LinkAndRefer(nfn)) {
-            input.CopyAndRefer(nfn);
+            if (input.GetPath() != nfn && !input.LinkAndRefer(nfn)) {
+                input.CopyAndRefer(nfn);
+            }
         }
+    );
 
-        /* Make sure that the passed_det value carries over, too. */
+    /* Make sure that the passed_det value carries over, too. */
 
+    for (const auto& testcase : state.case_queue) {
         if (testcase->passed_det) afl::util::MarkAsDetDone(state, *testcase);
-
-        id++;
+        else if (testcase->det_progress) {
+            afl::util::SaveDetProgress(state, *testcase, *testcase->det_progress);
+        }
     }
 
 #if 0
@@ -273,61 +508,133 @@ static void PivotInputs(AFLState &state) {
 #endif
 }
 
-static void CheckMapCoverage(const InplaceMemoryFeedback &inp_feed) {
-    if (inp_feed.CountNonZeroBytes() < 100) return ;
+static void CheckMapCoverage(const u8 *trace_bits, u32 map_size) {
+    if (Util::CountBytes(trace_bits, map_size) < 100) return ;
 
-    inp_feed.ShowMemoryToFunc(
-        [](const u8 *trace_bits, u32 map_size) {
-            u32 start = 1 << (AFLOption::MAP_SIZE_POW2 - 1);
-            for (u32 i = start; i < map_size; i++) {
-                if (trace_bits[i]) return;
-            }
+    u32 start = 1 << (AFLOption::MAP_SIZE_POW2 - 1);
+    for (u32 i = start; i < map_size; i++) {
+        if (trace_bits[i]) return;
+    }
 
-            WARNF("Recompile binary with newer version of afl to improve coverage!");
-        }
-    );
+    WARNF("Recompile binary with newer version of afl to improve coverage!");
+}
+
+/* Run the calibration of the next DRY_RUN_BATCH test cases from
+   case_queue[begin] on all the executors of the pool. Returns where the
+   batch ends; calibrations[i] is for case_queue[begin + i], and is left
+   empty for the cases to skip. */
+
+static u32 CalibrateInParallel(
+    AFLState &state,
+    AFLExecutorPool &pool,
+    const std::vector<bool> &skip,
+    u32 begin,
+    std::vector<AFLExecutorPool::Calibration> &calibrations
+) {
+    std::vector<u32> ids;
+    u32 end = begin;
+    while (end < state.case_queue.size() && ids.size() < AFLOption::DRY_RUN_BATCH) {
+        if (!skip[end]) ids.emplace_back(end);
+        end++;
+    }
+
+    std::vector<std::pair<const u8*, u32>> inputs;
+    for (u32 id : ids) {
+        auto& input = *state.case_queue[id]->input;
+        input.Load();
+        inputs.emplace_back(input.GetBuf(), input.GetLen());
+    }
+
+    std::vector<AFLExecutorPool::Calibration> results;
+    state.total_execs += pool.Calibrate(
+                             state, inputs, afl::util::CalibrationTimeout(state, true), results);
+
+    for (u32 id : ids) state.case_queue[id]->input->Unload();
+
+    calibrations.assign(end - begin, AFLExecutorPool::Calibration{});
+    for (u32 i=0; i < ids.size(); i++) {
+        calibrations[ids[i] - begin] = std::move(results[i]);
+    }
+
+    return end;
 }
 
 static void PerformDryRun(AFLState &state) {
     u32 cal_failures = 0;
     char *skip_crashes = getenv("AFL_SKIP_CRASHES");
 
-    for (const auto& testcase : state.case_queue) {
+    std::vector<bool> restored(state.case_queue.size(), false);
+    if (state.resume_checkpoint) {
+        ACTF("Restoring the calibration from the checkpoint...");
+        restored = state.RestoreCheckpoint(*state.resume_checkpoint);
+        state.resume_checkpoint.reset();
+    }
+
+    /* With the executor pool, the test cases are run on all the executors a
+       batch at a time, and the results are then taken in queue order as if
+       they had been calibrated one by one. */
+
+    auto *pool = state.det_executor_pool;
+    std::vector<AFLExecutorPool::Calibration> calibrations;
+    u32 batch_begin = 0;
+    u32 batch_end = 0;
+
+    for (u32 idx = 0; idx < state.case_queue.size(); idx++) {
+        if (restored[idx]) continue;
+
+        const auto& testcase = state.case_queue[idx];
         auto& input = *testcase->input;
 
         std::string fn = input.GetPath().filename().string();
 
-        ACTF("Attempting dry run with '%s'...", fn.c_str());
+        if (pool && idx >= batch_end) {
+            batch_begin = idx;
+            batch_end = CalibrateInParallel(state, *pool, restored, idx, calibrations);
+        }
 
-        input.Load();
+        ACTF("Attempting dry run with '%s'...", fn.c_str());
 
         // There should be no active instance of InplaceMemoryFeedback at this point.
         // So we can just create a temporary instance to get a result.
         InplaceMemoryFeedback inp_feed;
-        ExitStatusFeedback exit_status;
-        PUTExitReasonType res = afl::util::CalibrateCaseWithFeedDestroyed(
-                                    *testcase,
-                                    input.GetBuf(),
-                                    input.GetLen(),
-                                    state,
-                                    inp_feed,
-                                    exit_status,
-                                    0,
-                                    true);
-
-        input.Unload();
+        const AFLExecutorPool::Calibration *calibration = nullptr;
+        PUTExitReasonType res;
+        if (pool) {
+            calibration = &calibrations[idx - batch_begin];
+            res = afl::util::ReplayCalibration(*testcase, state, *calibration, 0);
+        } else {
+            input.Load();
+
+            ExitStatusFeedback exit_status;
+            res = afl::util::CalibrateCaseWithFeedDestroyed(
+                      *testcase,
+                      input.GetBuf(),
+                      input.GetLen(),
+                      state,
+                      inp_feed,
+                      exit_status,
+                      0,
+                      true);
+
+            input.Unload();
+        }
 
         if (state.stop_soon) return;
 
         if (res == state.crash_mode || res == PUTExitReasonType::FAULT_NOBITS) {
             SAYF(cGRA "    len = %u, map size = %u, exec speed = %llu us\n" cRST,
-                 input.GetLen(), testcase->bitmap_size, testcase->exec_us);
+                 input.GetLen(), testcase->BitmapSize(), testcase->ExecUs());
         }
 
         switch (res) {
         case PUTExitReasonType::FAULT_NONE:
             if (testcase == state.case_queue.front()) {
-                CheckMapCoverage(inp_feed);
+                if (calibration) {
+                    auto trace = calibration->GetTrace(calibration->cksums.back());
+                    CheckMapCoverage(trace.data(), trace.size());
+                } else {
+                    inp_feed.ShowMemoryToFunc(CheckMapCoverage);
+                }
             }
 
             if (state.crash_mode != PUTExitReasonType::FAULT_NONE) {
@@ -479,6 +786,8 @@ static void PerformDryRun(AFLState &state) {
             WARNF(cLRD "High percentage of rejected test cases, check settings!");
     }
 
+    state.dry_run_done = true;
+
     OKF("All test cases processed.");
 }
 
@@ -514,10 +823,23 @@ AFLFuzzer::AFLFuzzer(
             setting.out_dir / AFLOption::DEFAULT_OUTFILE,
             true,                 // need_afl_cov
             false,                // need_bb_cov
-            setting.cpuid_to_bind
+            setting.cpuid_to_bind,
+            {
+                // the runtime writes operands only after we clear the header,
+                // so this map doesn't have to be reset on every execution
+                FeedbackMapSpec{
+                    AFLOption::CMPLOG_MAP_NAME,
+                    afl::cmplog::MAP_SIZE,
+                    "",
+                    FeedbackMapSpec::ResetPolicy::KEEP
+                }
+            }
         )
     );
 
+    // the fresh map is zero-filled, which the runtime takes as "logging enabled"
+    afl::cmplog::DisableLog(executor->feedback_maps.GetMap(AFLOption::CMPLOG_MAP_NAME));
+
     state.reset(new AFLState( setting, *executor ));
 
     state->start_time = Util::GetCurTimeMs();
@@ -527,6 +849,8 @@ AFLFuzzer::AFLFuzzer(
     SaveCmdline(*state, setting.argv);
     FixUpBanner(*state, setting.argv[0]);
     CheckIfTty(*state);
+    SetupDetExecutorPool(*state, setting, *executor, det_executor_pool);
+    SetupPackedCorpus(*state);
 
     ReadTestcases(*state);
     PivotInputs(*state);
@@ -562,6 +886,7 @@ void AFLFuzzer::BuildFuzzFlow() {
     auto byte_flip_other = CreateNode<ByteFlipOther>(*state);
     auto arith = CreateNode<Arith>(*state);
     auto interest = CreateNode<Interest>(*state);
+    auto input_to_state = CreateNode<InputToState>(*state);
     auto user_dict_overwrite = CreateNode<UserDictOverwrite>(*state);
     auto user_dict_insert = CreateNode<UserDictInsert>(*state);
     auto auto_dict_overwrite = CreateNode<AutoDictOverwrite>(*state);
@@ -589,6 +914,7 @@ void AFLFuzzer::BuildFuzzFlow() {
           || byte_flip_other << execute.HardLink() << normal_update.HardLink()
           || arith << execute.HardLink() << normal_update.HardLink()
           || interest << execute.HardLink() << normal_update.HardLink()
+          || input_to_state << execute.HardLink() << normal_update.HardLink()
           || user_dict_overwrite << execute.HardLink() << normal_update.HardLink()
           || auto_dict_overwrite << execute.HardLink() << normal_update.HardLink()
          )
@@ -611,6 +937,7 @@ void AFLFuzzer::BuildFuzzFlow() {
             byte_flip_other << execute << normal_update,
             arith << execute << normal_update,
             interest << execute << normal_update,
+            input_to_state << execute << normal_update,
             user_dict_overwrite << execute << normal_update,
             auto_dict_overwrite << execute << normal_update
         ],
@@ -633,9 +960,8 @@ static void CullQueue(AFLState &state) {
     state.queued_favored = 0;
     state.pending_favored = 0;
 
-    for (const auto& testcase : state.case_queue) {
-        testcase->favored = false;
-    }
+    auto &meta = state.queue_meta;
+    std::fill(meta.favored.begin(), meta.favored.end(), false);
 
     for (u32 i=0; i < AFLOption::MAP_SIZE; i++) {
         if (state.top_rated[i] && !has_top_rated[i]) {
@@ -643,15 +969,18 @@ static void CullQueue(AFLState &state) {
 
             has_top_rated |= *(top_testcase.trace_mini);
 
-            top_testcase.favored = true;
+            top_testcase.Favored() = true;
             state.queued_favored++;
 
-            if (!top_testcase.was_fuzzed) state.pending_favored++;
+            if (!top_testcase.WasFuzzed()) state.pending_favored++;
         }
     }
 
-    for (const auto& testcase : state.case_queue) {
-        afl::util::MarkAsRedundant(state, *testcase, !testcase->favored);
+    /* Only the entries whose redundancy changed have to be looked at. */
+
+    for (u32 i=0; i < meta.size(); i++) {
+        if (meta.fs_redundant[i] != meta.favored[i]) continue;
+        afl::util::MarkAsRedundant(state, *state.case_queue[i], !meta.favored[i]);
     }
 }
 
@@ -666,4 +995,5 @@ void AFLFuzzer::OneLoop(void) {
 void AFLFuzzer::ReceiveStopSignal(void) {
     state->ReceiveStopSignal(); 
     executor->ReceiveStopSignal();
+    if (det_executor_pool) det_executor_pool->ReceiveStopSignal();
 }
@@ -1,7 +1,13 @@
 #include "Algorithms/AFL/AFLMutationHierarFlowRoutines.hpp"
 
+#include <array>
+#include <set>
+#include <tuple>
+
 #include "Utils/Common.hpp"
 #include "ExecInput/ExecInput.hpp"
+#include "Feedback/InplaceMemoryFeedback.hpp"
+#include "Feedback/ExitStatusFeedback.hpp"
 
 #include "HierarFlow/HierarFlowRoutine.hpp"
 #include "HierarFlow/HierarFlowNode.hpp"
@@ -9,13 +15,128 @@
 
 #include "Algorithms/AFL/AFLMutator.hpp"
 #include "Algorithms/AFL/AFLUtil.hpp"
+#include "Algorithms/AFL/AFLCmpLog.hpp"
+#include "Algorithms/AFL/AFLUpdateHierarFlowRoutines.hpp"
 
 namespace afl {
 namespace pipeline {
 namespace mutation {
 
+DetStageBase::DetStageBase(AFLState &state) : state(state) {}
+
+bool DetStageBase::TryMutant(AFLMutator &mutator, u32 pos, u32 len) {
+    if (!state.det_executor_pool) {
+        return CallSuccessors(mutator.GetBuf(), mutator.GetLen());
+    }
+
+    // Until this batch is executed, resuming has to start from here
+    if (patches.empty()) {
+        state.det_progress.stage = cur_stage;
+        state.det_progress.pos = cur_pos;
+    }
+
+    const u8 *buf = mutator.GetBuf();
+    patches.emplace_back(AFLExecutorPool::Patch{pos, len, (u32)patch_data.size()});
+    patch_data.insert(patch_data.end(), buf + pos, buf + pos + len);
+    cursors.emplace_back(StageCursor{
+        state.stage_cur, state.stage_cur_byte, state.stage_cur_val, state.stage_val_type
+    });
+
+    if (patches.size() < AFLOption::DET_SHARD_BATCH) return false;
+    return FlushMutants(mutator);
+}
+
+bool DetStageBase::FlushMutants(AFLMutator &mutator) {
+    if (patches.empty()) return false;
+
+    const auto &source = mutator.GetSource();
+    const u8 *seed = source.GetBuf();
+    u32 len = source.GetLen();
+
+    state.total_execs += state.det_executor_pool->Run(
+                             state, seed, len, patches, patch_data, results);
+
+    // The stage goes on from where it recorded the last mutant
+    StageCursor stage_pos{
+        state.stage_cur, state.stage_cur_byte, state.stage_cur_val, state.stage_val_type
+    };
+    bool should_construct_auto_dict = state.ShouldConstructAutoDict();
+
+    // ReplayMutant takes care of the dictionary for every mutant including re-executed ones
+    state.SetShouldConstructAutoDict(false);
+
+    bool aborted = state.stop_soon;
+    replay_buf.assign(seed, seed + len);
+
+    for (u32 i=0; i < patches.size() && !aborted; i++) {
+        const auto &patch = patches[i];
+        std::memcpy(&replay_buf[patch.pos], &patch_data[patch.data_off], patch.len);
+
+        state.stage_cur = cursors[i].stage_cur;
+        state.stage_cur_byte = cursors[i].stage_cur_byte;
+        state.stage_cur_val = cursors[i].stage_cur_val;
+        state.stage_val_type = cursors[i].stage_val_type;
+
+        if (results[i].interesting) {
+            // Execute it again so that the successors see the real feedback
+            aborted = CallSuccessors(replay_buf.data(), len);
+        } else {
+            // This is what NormalUpdate would do for an ordinary execution
+            state.subseq_tmouts = 0;
+        }
+
+        if (!aborted) ReplayMutant(replay_buf.data(), len, results[i].cksum);
+
+        std::memcpy(&replay_buf[patch.pos], seed + patch.pos, patch.len);
+    }
+
+    state.stage_cur = stage_pos.stage_cur;
+    state.stage_cur_byte = stage_pos.stage_cur_byte;
+    state.stage_cur_val = stage_pos.stage_cur_val;
+    state.stage_val_type = stage_pos.stage_val_type;
+    state.SetShouldConstructAutoDict(should_construct_auto_dict);
+
+    patches.clear();
+    patch_data.clear();
+    cursors.clear();
+
+    state.ShowStats();
+
+    return aborted;
+}
+
+bool DetStageBase::IsStageDone(u32 stage) const {
+    using afl::util::DetStageRank;
+
+    return state.det_resume 
+        && DetStageRank(stage) < DetStageRank(state.det_resume->stage);
+}
+
+u32 DetStageBase::GetResumePos(u32 stage) const {
+    if (state.det_resume && state.det_resume->stage == stage) {
+        return state.det_resume->pos;
+    }
+    return 0;
+}
+
+void DetStageBase::EnterPosition(u32 stage, u32 pos) {
+    cur_stage = stage;
+    cur_pos = pos;
+
+    // Otherwise, the position of the oldest mutant not executed yet is kept
+    if (patches.empty()) {
+        state.det_progress.stage = stage;
+        state.det_progress.pos = pos;
+    }
+
+    if (Util::GetCurTimeMs() - state.last_det_checkpoint_ms 
+            > AFLOption::DET_CHECKPOINT_SEC * 1000) {
+        afl::util::CheckpointDetProgress(state, *state.case_queue[state.current_entry]);
+    }
+}
+
 BitFlip1WithAutoDictBuild::BitFlip1WithAutoDictBuild(AFLState &state)
-        : state(state) {}
+        : DetStageBase(state) {}
     
 AFLMutCalleeRef
     BitFlip1WithAutoDictBuild::operator()(AFLMutator& mutator) 
@@ -25,6 +146,8 @@ AFLMutCalleeRef
      * SIMPLE BITFLIP (+dictionary construction) *
      *********************************************/
 
+    if (IsStageDone(AFLOption::STAGE_FLIP1)) return GoToDefaultNext();
+
     state.prev_cksum = state.queue_cur_exec_cksum;
     
     u64 orig_hit_cnt = state.queued_paths + state.unique_crashes;
@@ -34,11 +157,15 @@ AFLMutCalleeRef
     state.stage_max = mutator.GetLen() << 3;
 
     state.a_len = 0;
-    state.a_collect.clear();
     state.SetShouldConstructAutoDict(false);
 
-    for (state.stage_cur=0; state.stage_cur < state.stage_max; state.stage_cur++) {
+    state.stage_cur = GetResumePos(AFLOption::STAGE_FLIP1) << 3;
+    for (; state.stage_cur < state.stage_max; state.stage_cur++) {
         state.stage_cur_byte = state.stage_cur >> 3;
+
+        if ((state.stage_cur & 7) == 0) {
+            EnterPosition(AFLOption::STAGE_FLIP1, state.stage_cur >> 3);
+        }
         
         // If the following conditions are met, consider appending Auto Extra values in the successor
         // For the details, check afl::pipeline::update::ConstructAutoDict
@@ -48,13 +175,18 @@ AFLMutCalleeRef
         }
 
         mutator.FlipBit(state.stage_cur, 1);
-        if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) {
+        if (TryMutant(mutator, state.stage_cur >> 3, 1)) {
             SetResponseValue(true);
             return GoToParent();
         }
         mutator.FlipBit(state.stage_cur, 1);
     }
 
+    if (FlushMutants(mutator)) {
+        SetResponseValue(true);
+        return GoToParent();
+    }
+
     u64 new_hit_cnt = state.queued_paths + state.unique_crashes;
     state.stage_finds[AFLOption::STAGE_FLIP1]  += new_hit_cnt - orig_hit_cnt;
     state.stage_cycles[AFLOption::STAGE_FLIP1] += state.stage_max;
@@ -62,7 +194,14 @@ AFLMutCalleeRef
     return GoToDefaultNext();
 }
 
-BitFlipOther::BitFlipOther(AFLState &state) : state(state) {}
+void BitFlip1WithAutoDictBuild::ReplayMutant(const u8* buf, u32 /* len */, u32 cksum) {
+    // the same condition as the one set in the loop above
+    if (!state.setting.dumb_mode && (state.stage_cur & 7) == 7) {
+        afl::pipeline::update::CollectAutoDict(state, buf, cksum);
+    }
+}
+
+BitFlipOther::BitFlipOther(AFLState &state) : DetStageBase(state) {}
 
 AFLMutCalleeRef BitFlipOther::operator()(AFLMutator& mutator) {
     /*********************************************
@@ -75,22 +214,37 @@ AFLMutCalleeRef BitFlipOther::operator()(AFLMutator& mutator) {
     };
     
     for (u32 bit_width=2, idx=0; bit_width <= 4; bit_width *= 2, idx++) {
+        if (IsStageDone(stage_idxs[idx])) continue;
+
         u64 orig_hit_cnt = state.queued_paths + state.unique_crashes;
 
         state.stage_short = "flip" + std::to_string(bit_width);
         state.stage_name = "bitflip " + std::to_string(bit_width) + "/1";
         state.stage_max = (mutator.GetLen() << 3) + 1 - bit_width;
 
-        for (state.stage_cur=0; state.stage_cur < state.stage_max; state.stage_cur++) {
+        state.stage_cur = GetResumePos(stage_idxs[idx]) << 3;
+        for (; state.stage_cur < state.stage_max; state.stage_cur++) {
             state.stage_cur_byte = state.stage_cur >> 3;
+
+            if ((state.stage_cur & 7) == 0) {
+                EnterPosition(stage_idxs[idx], state.stage_cur >> 3);
+            }
             
+            u32 first_byte = state.stage_cur >> 3;
+            u32 last_byte = (state.stage_cur + bit_width - 1) >> 3;
+
             mutator.FlipBit(state.stage_cur, bit_width);
-            if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) {
+            if (TryMutant(mutator, first_byte, last_byte - first_byte + 1)) {
                 SetResponseValue(true);
                 return GoToParent();
             }
             mutator.FlipBit(state.stage_cur, bit_width);
         }
+
+        if (FlushMutants(mutator)) {
+            SetResponseValue(true);
+            return GoToParent();
+        }
             
         u64 new_hit_cnt = state.queued_paths + state.unique_crashes;
         state.stage_finds[stage_idxs[idx]] += new_hit_cnt - orig_hit_cnt;
@@ -101,7 +255,7 @@ AFLMutCalleeRef BitFlipOther::operator()(AFLMutator& mutator) {
 }
 
 ByteFlip1WithEffMapBuild::ByteFlip1WithEffMapBuild(AFLState &state)
-    : state(state) {}
+    : DetStageBase(state) {}
 
 AFLMutCalleeRef
         ByteFlip1WithEffMapBuild::operator()(AFLMutator& mutator) {
@@ -109,13 +263,27 @@ AFLMutCalleeRef
 
     using afl::util::EFF_APOS;
     using afl::util::EFF_ALEN;
-    
-    state.eff_map.assign(EFF_ALEN(mutator.GetLen()), 0);
-    state.eff_map[0] = 1;
-    state.eff_cnt = 1;
-    if (EFF_APOS(mutator.GetLen() - 1) != 0) {
-        state.eff_map[EFF_APOS(mutator.GetLen() - 1)] = 1;
-        state.eff_cnt++;
+
+    // Reuse the effector map an earlier run has built (or started to build),
+    // so that the later stages skip the bytes known to have no effect right away
+    if (IsStageDone(AFLOption::STAGE_FLIP8)) {
+        state.eff_map = state.det_resume->eff_map;
+        state.eff_cnt = state.det_resume->eff_cnt;
+        return GoToDefaultNext();
+    }
+
+    u32 resume_pos = GetResumePos(AFLOption::STAGE_FLIP8);
+    if (resume_pos) {
+        state.eff_map = state.det_resume->eff_map;
+        state.eff_cnt = state.det_resume->eff_cnt;
+    } else {
+        state.eff_map.assign(EFF_ALEN(mutator.GetLen()), 0);
+        state.eff_map[0] = 1;
+        state.eff_cnt = 1;
+        if (EFF_APOS(mutator.GetLen() - 1) != 0) {
+            state.eff_map[EFF_APOS(mutator.GetLen() - 1)] = 1;
+            state.eff_cnt++;
+        }
     }
 
     u64 orig_hit_cnt = state.queued_paths + state.unique_crashes;
@@ -123,14 +291,16 @@ AFLMutCalleeRef
 
     state.stage_short = "flip8";
     state.stage_name = "bitflip 8/8";
-    state.stage_cur = 0;
+    state.stage_cur = resume_pos;
     state.stage_max = num_mutable_pos;
 
-    for (u32 i=0; i < num_mutable_pos; i++) {
+    for (u32 i=resume_pos; i < num_mutable_pos; i++) {
+        EnterPosition(AFLOption::STAGE_FLIP8, i);
+
         state.stage_cur_byte = i;
 
         mutator.FlipByte(state.stage_cur, 1);
-        if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) {
+        if (TryMutant(mutator, i, 1)) {
             SetResponseValue(true);
             return GoToParent();
         }
@@ -139,6 +309,11 @@ AFLMutCalleeRef
         state.stage_cur++;
     }
 
+    if (FlushMutants(mutator)) {
+        SetResponseValue(true);
+        return GoToParent();
+    }
+
     if (state.eff_cnt != EFF_ALEN(mutator.GetLen()) && 
         state.eff_cnt * 100 / EFF_ALEN(mutator.GetLen()) > AFLOption::EFF_MAX_PERC) {
         
@@ -157,7 +332,11 @@ AFLMutCalleeRef
     return GoToDefaultNext();
 }
 
-ByteFlipOther::ByteFlipOther(AFLState &state) : state(state) {}
+void ByteFlip1WithEffMapBuild::ReplayMutant(const u8* /* buf */, u32 len, u32 cksum) {
+    afl::pipeline::update::MarkEffMap(state, len, cksum);
+}
+
+ByteFlipOther::ByteFlipOther(AFLState &state) : DetStageBase(state) {}
 
 AFLMutCalleeRef ByteFlipOther::operator()(AFLMutator& mutator) {
     /* Walking byte. */
@@ -173,6 +352,8 @@ AFLMutCalleeRef ByteFlipOther::operator()(AFLMutator& mutator) {
         // if the input is too short, then it's impossible
         if (mutator.GetLen() < byte_width) return GoToDefaultNext();
 
+        if (IsStageDone(stage_idxs[idx])) continue;
+
         u64 orig_hit_cnt = state.queued_paths + state.unique_crashes;
         u32 num_mutable_pos = mutator.GetLen() + 1 - byte_width;
 
@@ -181,7 +362,9 @@ AFLMutCalleeRef ByteFlipOther::operator()(AFLMutator& mutator) {
         state.stage_cur = 0;
         state.stage_max = num_mutable_pos;
 
-        for (u32 i=0; i < num_mutable_pos; i++) {
+        for (u32 i=GetResumePos(stage_idxs[idx]); i < num_mutable_pos; i++) {
+            EnterPosition(stage_idxs[idx], i);
+
             // Why this is suffice to check \forall j(i <= j < i+byte_width) !eff_map[EFF_APOS(i)]?:
             // now since byte_width <= 8, |{EFF_APOS(j) | \forall j}| <= 2 holds
 
@@ -195,7 +378,7 @@ AFLMutCalleeRef ByteFlipOther::operator()(AFLMutator& mutator) {
             state.stage_cur_byte = i;
 
             mutator.FlipByte(i, byte_width);
-            if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) {
+            if (TryMutant(mutator, i, byte_width)) {
                 SetResponseValue(true);
                 return GoToParent();
             }
@@ -203,6 +386,11 @@ AFLMutCalleeRef ByteFlipOther::operator()(AFLMutator& mutator) {
 
             state.stage_cur++;
         }
+
+        if (FlushMutants(mutator)) {
+            SetResponseValue(true);
+            return GoToParent();
+        }
         
         u64 new_hit_cnt = state.queued_paths + state.unique_crashes;
         state.stage_finds[stage_idxs[idx]]  += new_hit_cnt - orig_hit_cnt;
@@ -212,7 +400,7 @@ AFLMutCalleeRef ByteFlipOther::operator()(AFLMutator& mutator) {
     return GoToDefaultNext();
 }
 
-Arith::Arith(AFLState &state) : state(state) {}
+Arith::Arith(AFLState &state) : DetStageBase(state) {}
 
 AFLMutCalleeRef Arith::operator()(AFLMutator& mutator) {
     /**********************
@@ -240,7 +428,7 @@ AFLMutCalleeRef Arith::operator()(AFLMutator& mutator) {
     return GoToDefaultNext();
 }
 
-Interest::Interest(AFLState &state) : state(state) {}
+Interest::Interest(AFLState &state) : DetStageBase(state) {}
 
 AFLMutCalleeRef Interest::operator()(AFLMutator& mutator) {
     /**********************
@@ -266,6 +454,157 @@ AFLMutCalleeRef Interest::operator()(AFLMutator& mutator) {
     return GoToDefaultNext();
 }
 
+InputToState::InputToState(AFLState &state) : DetStageBase(state) {}
+
+/* Write the lowest "size" bytes of val into buf in the given byte order. */
+
+static void EncodeOperand(u8 *buf, u64 val, u32 size, bool be) {
+    for (u32 i=0; i < size; i++) {
+        u32 shift = be ? (size - 1 - i) * 8 : i * 8;
+        buf[i] = (val >> shift) & 0xff;
+    }
+}
+
+AFLMutCalleeRef InputToState::operator()(AFLMutator& mutator) {
+    if (IsStageDone(AFLOption::STAGE_ITS)) return GoToDefaultNext();
+
+    // The candidates are not sorted by position, so the stage restarts from scratch
+    EnterPosition(AFLOption::STAGE_ITS, 0);
+
+    auto &feedback_maps = state.executor.feedback_maps;
+    if (state.no_cmplog || !feedback_maps.Has(AFLOption::CMPLOG_MAP_NAME)) {
+        return GoToDefaultNext();
+    }
+
+    using afl::cmplog::CmpLogHeader;
+    using afl::cmplog::CmpLogEntry;
+
+    /* Run the seed once with comparison logging enabled, and copy the operands
+       out right away. After that, mark the log as full again so that the
+       following executions don't spend time on logging. */
+
+    u8 *cmplog_map = feedback_maps.GetMap(AFLOption::CMPLOG_MAP_NAME);
+    CmpLogHeader header{0, 0};
+    std::memcpy(cmplog_map, &header, sizeof(header));
+    MEM_BARRIER();
+
+    ExitStatusFeedback exit_status;
+    auto inp_feed = state.RunExecutorWithClassifyCounts(
+                        mutator.GetBuf(), mutator.GetLen(), exit_status);
+    InplaceMemoryFeedback::DiscardActive(std::move(inp_feed));
+
+    std::memcpy(&header, cmplog_map, sizeof(header));
+    u32 num_entries = std::min(header.num_entries, AFLOption::CMPLOG_MAX_ENTRIES);
+
+    std::vector<CmpLogEntry> entries(num_entries);
+    std::memcpy(entries.data(), cmplog_map + sizeof(CmpLogHeader), 
+                sizeof(CmpLogEntry) * num_entries);
+
+    afl::cmplog::DisableLog(cmplog_map);
+
+    if (num_entries == 0) {
+        /* If enough seeds in a row log nothing, the PUT is probably not
+           instrumented for comparison logging. Don't waste an execution per
+           seed on it from now on. A seed that crashes or times out may log
+           nothing even if the PUT is instrumented, so it isn't counted. */
+        if (!has_seen_cmplog && exit_status.exit_reason == PUTExitReasonType::FAULT_NONE
+         && ++empty_cmplog_runs >= AFLOption::CMPLOG_EMPTY_MAX) {
+            state.no_cmplog = true;
+        }
+        return GoToDefaultNext();
+    }
+    has_seen_cmplog = true;
+
+    /* Find every place in the input where one of the operands appears 
+       verbatim, and plan to replace it with the other operand. 1-byte 
+       comparisons are left to the bitflip and interest stages. An operand
+       that is common in the input would flood the stage with candidates,
+       so only the first CMPLOG_MAX_CANDIDATES of each entry are tried. */
+
+    struct Candidate {
+        u32 pos;
+        u32 size;
+        std::array<u8, 8> repl;
+    };
+
+    std::vector<Candidate> candidates;
+    std::set<std::tuple<u32, u32, u64>> planned;
+
+    const u8 *buf = mutator.GetBuf();
+    u32 len = mutator.GetLen();
+
+    for (const auto &entry : entries) {
+        u32 entry_candidates = 0;
+        u32 size = entry.size;
+        if (size != 2 && size != 4 && size != 8) continue;
+        if (size > len) continue;
+
+        for (int dir=0; dir < 2; dir++) {
+            u64 pattern = entry.operands[dir];
+            u64 repl    = entry.operands[1 - dir];
+            if (size < 8) {
+                u64 mask = (1ULL << (size * 8)) - 1;
+                pattern &= mask;
+                repl    &= mask;
+            }
+            if (pattern == repl) continue;
+
+            for (bool be : {false, true}) {
+                std::array<u8, 8> pattern_bytes;
+                std::array<u8, 8> repl_bytes{};
+                EncodeOperand(pattern_bytes.data(), pattern, size, be);
+                EncodeOperand(repl_bytes.data(), repl, size, be);
+
+                /* Runs of identical bytes (e.g. zero) match almost everywhere. */
+
+                if (std::all_of(pattern_bytes.begin(), pattern_bytes.begin() + size,
+                                [&](u8 c) { return c == pattern_bytes[0]; })) continue;
+
+                u64 repl_key;
+                std::memcpy(&repl_key, repl_bytes.data(), sizeof(repl_key));
+
+                for (u32 i=0; i + size <= len; i++) {
+                    if (entry_candidates >= AFLOption::CMPLOG_MAX_CANDIDATES) break;
+                    if (std::memcmp(buf + i, pattern_bytes.data(), size)) continue;
+                    if (!planned.emplace(i, size, repl_key).second) continue;
+
+                    candidates.emplace_back(Candidate{i, size, repl_bytes});
+                    entry_candidates++;
+                }
+            }
+        }
+    }
+
+    state.stage_name = "input-to-state";
+    state.stage_short = "its";
+    state.stage_cur = 0;
+    state.stage_max = candidates.size();
+    state.stage_val_type = AFLOption::STAGE_VAL_NONE;
+
+    u64 orig_hit_cnt = state.queued_paths + state.unique_crashes;
+
+    for (auto &candidate : candidates) {
+        state.stage_cur_byte = candidate.pos;
+
+        mutator.Replace(candidate.pos, candidate.repl.data(), candidate.size);
+
+        if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) {
+            SetResponseValue(true);
+            return GoToParent();
+        }
+
+        state.stage_cur++;
+
+        mutator.Replace(candidate.pos, mutator.GetSource().GetBuf() + candidate.pos, candidate.size);
+    }
+
+    u64 new_hit_cnt = state.queued_paths + state.unique_crashes;
+    state.stage_finds[AFLOption::STAGE_ITS]  += new_hit_cnt - orig_hit_cnt;
+    state.stage_cycles[AFLOption::STAGE_ITS] += state.stage_max;
+
+    return GoToDefaultNext();
+}
+
 UserDictInsert::UserDictInsert(AFLState &state) : state(state) {}
 
 AFLMutCalleeRef UserDictInsert::operator()(AFLMutator& mutator) {
@@ -357,29 +696,39 @@ bool HavocBase::DoHavoc(
     /* We essentially just do several thousand runs (depending on perf_score)
        where we take the input file and make random stacked tweaks. */
 
-    for (state.stage_cur = 0; state.stage_cur < state.stage_max; state.stage_cur++) {
+    /* Mutants are generated HAVOC_BATCH at a time into the mutator's arena,
+       leaving out_buf untouched, and then executed one by one. */
+
+    std::vector<u32> stackings;
+    state.stage_cur = 0;
+    while (state.stage_cur < state.stage_max) {
         using afl::util::UR;
-        u32 use_stacking = 1 << (1 + UR(AFLOption::HAVOC_STACK_POW2, state.rand_fd));
 
-        state.stage_cur_val = use_stacking;
-        mutator.Havoc(use_stacking, state.extras, state.a_extras);
-        if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) return true;
+        u32 batch = std::min<u32>(AFLOption::HAVOC_BATCH, state.stage_max - state.stage_cur);
+        stackings.resize(batch);
+        for (auto &use_stacking : stackings) {
+            use_stacking = 1 << (1 + UR(AFLOption::HAVOC_STACK_POW2, state.rng));
+        }
 
-        /* out_buf might have been mangled a bit, so let's restore it to its
-           original size and shape. */
+        mutator.HavocBatch(stackings, state.extras, state.a_extras.GetEntries());
 
-        mutator.RestoreHavoc();
+        for (u32 i=0; i < batch; i++, state.stage_cur++) {
+            state.stage_cur_val = stackings[i];
 
-        /* If we're finding new stuff, let's run for a bit longer, limits
-           permitting. */
+            auto [buf, len] = mutator.GetHavocMutant(i);
+            if (CallSuccessors(buf, len)) return true;
 
-        if (state.queued_paths != havoc_queued) {
-            if (perf_score <= AFLOption::HAVOC_MAX_MULT * 100) {
-                state.stage_max *= 2;
-                perf_score *= 2;
-            }
+            /* If we're finding new stuff, let's run for a bit longer, limits
+               permitting. */
 
-            havoc_queued = state.queued_paths;
+            if (state.queued_paths != havoc_queued) {
+                if (perf_score <= AFLOption::HAVOC_MAX_MULT * 100) {
+                    state.stage_max *= 2;
+                    perf_score *= 2;
+                }
+
+                havoc_queued = state.queued_paths;
+            }
         }
     }
 
@@ -424,7 +773,7 @@ AFLMutCalleeRef Splicing::operator()(AFLMutator& mutator) {
         u32 tid;
         do { 
             using afl::util::UR;
-            tid = UR(state.queued_paths, state.rand_fd);
+            tid = UR(state.queued_paths, state.rng);
         } while (tid == state.current_entry);
 
         /* Make sure that the target has a reasonable length. */
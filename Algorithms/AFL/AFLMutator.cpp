@@ -10,8 +10,8 @@
 
 /* TODO: Implement generator class */
 
-AFLMutator::AFLMutator( const ExecInput &input, const AFLState& state ) 
-    : Mutator(input), state(state) {}
+AFLMutator::AFLMutator( const ExecInput &input, AFLState& state ) 
+    : Mutator(input, state.rng, state.mutation_arena), state(state) {}
 
 AFLMutator::~AFLMutator() {}
 
@@ -29,7 +29,7 @@ u32 AFLMutator::ChooseBlockLen(u32 limit) {
 
     // just an alias of afl::util::UR
     auto UR = [this](u32 limit) {
-        return afl::util::UR(limit, state.rand_fd);
+        return afl::util::UR(limit, rng);
     };
 
     switch (UR(rlim)) {
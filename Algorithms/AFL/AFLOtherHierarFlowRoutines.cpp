@@ -5,6 +5,7 @@
 #include "HierarFlow/HierarFlowIntermediates.hpp"
 
 #include "Algorithms/AFL/AFLMacro.hpp"
+#include "Algorithms/AFL/AFLExecutorPool.hpp"
 #include "Logger/Logger.hpp"
 
 namespace afl {
@@ -75,25 +76,25 @@ AFLMidCalleeRef ConsiderSkipMut::operator()(
 ) {
     // just an alias of afl::util::UR
     auto UR = [this](u32 limit) {
-        return afl::util::UR(limit, state.rand_fd);
+        return afl::util::UR(limit, state.rng);
     };
 
     if (state.setting.ignore_finds) {
-        if (testcase->depth > 1) {
+        if (testcase->Depth() > 1) {
             SetResponseValue(true);
             return GoToParent();
         }
     } else {
         if (state.pending_favored) {
-            if ( (testcase->was_fuzzed || !testcase->favored) 
+            if ( (testcase->WasFuzzed() || !testcase->Favored()) 
               && UR(100) < AFLOption::SKIP_TO_NEW_PROB) {
                 SetResponseValue(true);
                 return GoToParent();
             }
         } else if (!state.setting.dumb_mode && 
-                   !testcase->favored && 
+                   !testcase->Favored() && 
                    state.queued_paths > 10) {
-            if (state.queue_cycle > 1 && !testcase->was_fuzzed) {
+            if (state.queue_cycle > 1 && !testcase->WasFuzzed()) {
                 if (UR(100) < AFLOption::SKIP_NFAV_NEW_PROB) {
                     SetResponseValue(true);
                     return GoToParent();
@@ -136,7 +137,7 @@ AFLMidCalleeRef RetryCalibrate::operator()(
     // auto mutator = Mutator( input );
 
     state.subseq_tmouts = 0;
-    state.cur_depth = testcase->depth;
+    state.cur_depth = testcase->Depth();
 
     /*******************************************
      * CALIBRATION (only if failed earlier on) * 
@@ -186,6 +187,188 @@ TrimCase::TrimCase(
 ) : state(state), 
     abandon_entry(abandon_entry) {}
 
+/* The trimmer for when there is an executor pool. It walks the input with
+   the same block sizes as the serial one below, but takes TRIM_SHARD_BLOCKS
+   blocks at a time. Each of them is first removed on its own, all on the
+   pool at once. The blocks that made no difference to the trace are then
+   removed together: the first n of them for n = all, half, a quarter and so
+   on, again at once. The largest reduction that keeps the trace is kept, as
+   the serial trimmer would have kept each of its removals. */
+
+static PUTExitReasonType DoTrimCaseInParallel(AFLState &state, AFLTestcase &testcase) {
+    auto &pool = *state.det_executor_pool;
+    auto &input = *testcase.input;
+
+    state.bytes_trim_in += input.GetLen();
+
+    u32 len_p2 = Util::NextP2(input.GetLen());
+
+    u32 remove_len = std::max(
+                        len_p2 / AFLOption::TRIM_START_STEPS, 
+                        AFLOption::TRIM_MIN_BYTES
+                     );
+
+    u32 end_len = std::max(
+                      len_p2 / AFLOption::TRIM_END_STEPS, 
+                      AFLOption::TRIM_MIN_BYTES
+                  );
+
+    std::vector<u8> clean_trace;
+    bool needs_write = false;
+    PUTExitReasonType fault = PUTExitReasonType::FAULT_NONE;
+
+    std::vector<std::unique_ptr<u8[]>> bufs;
+    std::vector<std::pair<const u8*, u32>> inputs;
+    std::vector<AFLExecutorPool::Result> results;
+
+    /* Add the input with the blocks at positions[0, n) removed. */
+
+    auto add_candidate = [&](const std::vector<u32> &positions, u32 n) {
+        const u8 *buf = input.GetBuf();
+        u32 len = input.GetLen();
+
+        u32 removed = 0;
+        for (u32 i=0; i < n; i++) removed += std::min(remove_len, len - positions[i]);
+
+        u32 test_len = len - removed;
+        std::unique_ptr<u8[]> test_buf(new u8[test_len]);
+
+        u32 src = 0;
+        u32 dst = 0;
+        for (u32 i=0; i < n; i++) {
+            std::memcpy(test_buf.get() + dst, buf + src, positions[i] - src);
+            dst += positions[i] - src;
+            src = positions[i] + std::min(remove_len, len - positions[i]);
+        }
+        std::memcpy(test_buf.get() + dst, buf + src, len - src);
+
+        inputs.emplace_back(test_buf.get(), test_len);
+        bufs.emplace_back(std::move(test_buf));
+    };
+
+    /* Run the candidates; false if trimming has to be abandoned. */
+
+    auto run_candidates = [&]() {
+        u64 execs = pool.RunInputs(state, inputs, results, testcase.exec_cksum, clean_trace);
+        state.total_execs += execs;
+        state.trim_execs += execs;
+        state.stage_cur += execs;
+
+        for (const auto &result : results) {
+            if (result.exit_reason == PUTExitReasonType::FAULT_ERROR) {
+                fault = PUTExitReasonType::FAULT_ERROR;
+            }
+        }
+
+        return !state.stop_soon && fault != PUTExitReasonType::FAULT_ERROR;
+    };
+
+    while (remove_len >= end_len) {
+        u32 remove_pos = remove_len;
+
+        state.stage_name = Util::StrPrintf(
+                              "trim %s/%s", 
+                              afl::util::DescribeInteger(remove_len).c_str(),
+                              afl::util::DescribeInteger(remove_len).c_str()
+                           );
+
+        state.stage_cur = 0;
+        state.stage_max = input.GetLen() / remove_len;
+
+        while (remove_pos < input.GetLen()) {
+            std::vector<u32> positions;
+            for (u32 pos = remove_pos; 
+                 pos < input.GetLen() && positions.size() < AFLOption::TRIM_SHARD_BLOCKS; 
+                 pos += remove_len) {
+                positions.emplace_back(pos);
+            }
+
+            bufs.clear();
+            inputs.clear();
+            for (u32 i=0; i < positions.size(); i++) {
+                std::vector<u32> single{positions[i]};
+                add_candidate(single, 1);
+            }
+
+            if (!run_candidates()) {
+                state.bytes_trim_out += input.GetLen();
+                return fault;
+            }
+
+            std::vector<u32> removable;
+            for (u32 i=0; i < positions.size(); i++) {
+                if (results[i].cksum == testcase.exec_cksum) removable.emplace_back(positions[i]);
+            }
+
+            if (removable.empty()) {
+                remove_pos = positions.back() + remove_len;
+                state.ShowStats();
+                continue;
+            }
+
+            /* Removing the first one alone is already known to work. */
+
+            std::vector<u32> counts;
+            for (u32 n = removable.size(); n > 1; n >>= 1) counts.emplace_back(n);
+
+            bufs.clear();
+            inputs.clear();
+            for (u32 n : counts) add_candidate(removable, n);
+
+            if (!counts.empty() && !run_candidates()) {
+                state.bytes_trim_out += input.GetLen();
+                return fault;
+            }
+
+            u32 best = 1;
+            for (u32 i=0; i < counts.size(); i++) {
+                if (results[i].cksum == testcase.exec_cksum) {
+                    best = counts[i];
+                    break;
+                }
+            }
+
+            bufs.clear();
+            inputs.clear();
+            add_candidate(removable, best);
+            input.OverwriteKeepingLoaded(std::move(bufs.back()), inputs.back().second);
+            afl::util::MarkAsKnownContent(
+                state,
+                testcase,
+                afl::util::HashContent(input.GetBuf(), input.GetLen())
+            );
+            needs_write = true;
+
+            len_p2 = Util::NextP2(input.GetLen());
+            end_len = std::max(
+                          len_p2 / AFLOption::TRIM_END_STEPS,
+                          AFLOption::TRIM_MIN_BYTES
+                      );
+
+            /* Carry on right after the last removed block, like the serial
+               trimmer does. */
+
+            remove_pos = removable[best - 1] - (best - 1) * remove_len;
+
+            state.ShowStats();
+        }
+
+        remove_len >>= 1;
+    }
+
+    if (needs_write) {
+        afl::util::UpdateBitmapScoreWithRawTrace(
+            testcase, 
+            state, 
+            clean_trace.data(), 
+            AFLOption::MAP_SIZE
+        );
+    }
+
+    state.bytes_trim_out += input.GetLen();
+    return fault;
+}
+
 /* Trim all new test cases to save cycles when doing deterministic checks. The
    trimmer uses power-of-two increments somewhere between 1/16 and 1/1024 of
    file size, to keep the stage short and sweet. */
@@ -198,6 +381,8 @@ static PUTExitReasonType DoTrimCase(AFLState &state, AFLTestcase &testcase) {
 
     if (input.GetLen() < 5) return PUTExitReasonType::FAULT_NONE;
 
+    if (state.det_executor_pool) return DoTrimCaseInParallel(state, testcase);
+
     state.bytes_trim_in += input.GetLen();
     
     /* Select initial chunk len, starting with large steps. */
@@ -276,6 +461,15 @@ static PUTExitReasonType DoTrimCase(AFLState &state, AFLTestcase &testcase) {
             if (cksum == testcase.exec_cksum) {
                 input.OverwriteKeepingLoaded(std::move(test_buf), test_len);
 
+                /* The new contents are on disk now, even if trimming is 
+                   abandoned later on. */
+
+                afl::util::MarkAsKnownContent(
+                    state,
+                    testcase,
+                    afl::util::HashContent(input.GetBuf(), input.GetLen())
+                );
+
                 len_p2 = Util::NextP2(input.GetLen());
                 end_len = std::max(
                               len_p2 / AFLOption::TRIM_END_STEPS,
@@ -361,7 +555,7 @@ static u32 DoCalcScore(AFLState &state, AFLTestcase &testcase) {
     avg_exec_us--;
 
     using afl::util::UR;
-    switch(UR(7, -1)) {
+    switch(UR(7, state.rng)) {
     case 0:
         perf_score = 10;
         break;
@@ -385,42 +579,42 @@ static u32 DoCalcScore(AFLState &state, AFLTestcase &testcase) {
         break;
     };
 #else
-    if (testcase.exec_us * 0.1 > avg_exec_us) perf_score = 10;
-    else if (testcase.exec_us * 0.25 > avg_exec_us) perf_score = 25;
-    else if (testcase.exec_us * 0.5 > avg_exec_us) perf_score = 50;
-    else if (testcase.exec_us * 0.75 > avg_exec_us) perf_score = 75;
-    else if (testcase.exec_us * 4 < avg_exec_us) perf_score = 300;
-    else if (testcase.exec_us * 3 < avg_exec_us) perf_score = 200;
-    else if (testcase.exec_us * 2 < avg_exec_us) perf_score = 150;
+    if (testcase.ExecUs() * 0.1 > avg_exec_us) perf_score = 10;
+    else if (testcase.ExecUs() * 0.25 > avg_exec_us) perf_score = 25;
+    else if (testcase.ExecUs() * 0.5 > avg_exec_us) perf_score = 50;
+    else if (testcase.ExecUs() * 0.75 > avg_exec_us) perf_score = 75;
+    else if (testcase.ExecUs() * 4 < avg_exec_us) perf_score = 300;
+    else if (testcase.ExecUs() * 3 < avg_exec_us) perf_score = 200;
+    else if (testcase.ExecUs() * 2 < avg_exec_us) perf_score = 150;
 #endif
 
     /* Adjust score based on bitmap size. The working theory is that better
        coverage translates to better targets. Multiplier from 0.25x to 3x. */
 
-    if (testcase.bitmap_size * 0.3 > avg_bitmap_size) perf_score *= 3;
-    else if (testcase.bitmap_size * 0.5 > avg_bitmap_size) perf_score *= 2;
-    else if (testcase.bitmap_size * 0.75 > avg_bitmap_size) perf_score *= 1.5;
-    else if (testcase.bitmap_size * 3 < avg_bitmap_size) perf_score *= 0.25;
-    else if (testcase.bitmap_size * 2 < avg_bitmap_size) perf_score *= 0.5;
-    else if (testcase.bitmap_size * 1.5 < avg_bitmap_size) perf_score *= 0.75;
+    if (testcase.BitmapSize() * 0.3 > avg_bitmap_size) perf_score *= 3;
+    else if (testcase.BitmapSize() * 0.5 > avg_bitmap_size) perf_score *= 2;
+    else if (testcase.BitmapSize() * 0.75 > avg_bitmap_size) perf_score *= 1.5;
+    else if (testcase.BitmapSize() * 3 < avg_bitmap_size) perf_score *= 0.25;
+    else if (testcase.BitmapSize() * 2 < avg_bitmap_size) perf_score *= 0.5;
+    else if (testcase.BitmapSize() * 1.5 < avg_bitmap_size) perf_score *= 0.75;
 
     /* Adjust score based on handicap. Handicap is proportional to how late
        in the game we learned about this path. Latecomers are allowed to run
        for a bit longer until they catch up with the rest. */
 
-    if (testcase.handicap >= 4) {
+    if (testcase.Handicap() >= 4) {
       perf_score *= 4;
-      testcase.handicap -= 4;
-    } else if (testcase.handicap) {
+      testcase.Handicap() -= 4;
+    } else if (testcase.Handicap()) {
       perf_score *= 2;
-      testcase.handicap--;
+      testcase.Handicap()--;
     }
 
     /* Final adjustment based on input depth, under the assumption that fuzzing
        deeper test cases is more likely to reveal stuff that can't be
        discovered with traditional fuzzers. */
 
-    switch (testcase.depth) {
+    switch (testcase.Depth()) {
     case 0 ... 3: 
         break;
     case 4 ... 7: 
@@ -475,7 +669,7 @@ AFLMidCalleeRef ApplyDetMuts::operator()(
        this entry ourselves (was_fuzzed), or if it has gone through deterministic
        testing in earlier, resumed runs (passed_det). */
 
-    if (state.skip_deterministic || testcase->was_fuzzed || testcase->passed_det) {
+    if (state.skip_deterministic || testcase->WasFuzzed() || testcase->passed_det) {
         state.doing_det = false;
         return GoToDefaultNext();
     }
@@ -498,11 +692,48 @@ AFLMidCalleeRef ApplyDetMuts::operator()(
     // this will be required in dictionary construction and eff_map construction
     state.queue_cur_exec_cksum = testcase->exec_cksum;
 
+    /* If an earlier, aborted run has left the progress of this entry, continue
+       from there. The checkpoint is ignored if the entry or its trace has changed
+       since then (e.g. the target was rebuilt). */
+
+    state.det_resume = std::move(testcase->det_progress);
+    if (state.det_resume) {
+        using afl::util::DetStageRank;
+        using afl::util::EFF_ALEN;
+
+        const auto &resume = *state.det_resume;
+        u32 len = mutator.GetLen();
+
+        bool has_eff_map = resume.eff_map.size() == EFF_ALEN(len);
+        bool needs_eff_map = DetStageRank(resume.stage) >= DetStageRank(AFLOption::STAGE_FLIP8);
+
+        if ( resume.len != len 
+          || resume.exec_cksum != testcase->exec_cksum
+          || resume.pos > len
+          || DetStageRank(resume.stage) > DetStageRank(AFLOption::STAGE_EXTRAS_AO)
+          || (needs_eff_map && !has_eff_map)) {
+            state.det_resume.reset();
+        }
+    }
+
+    state.det_progress = AFLDetProgress();
+    if (state.det_resume) {
+        state.det_progress.stage = state.det_resume->stage;
+        state.det_progress.pos = state.det_resume->pos;
+    }
+    state.last_det_checkpoint_ms = Util::GetCurTimeMs();
+
     // call deterministic mutations
     // if they return true, then we should go to abandon_entry
     auto should_abandon_entry = CallSuccessors(mutator);
 
+    state.det_resume.reset();
+
     if (should_abandon_entry) {
+        /* Remember how far we got, so that the next run doesn't start over. */
+
+        if (state.stop_soon) afl::util::CheckpointDetProgress(state, *testcase);
+
         SetResponseValue(true);
         return abandon_entry;
     }
@@ -546,10 +777,10 @@ AFLMidCalleeRef AbandonEntry::operator()(
     /* Update pending_not_fuzzed count if we made it through the calibration
        cycle and have not seen this entry before. */
 
-    if (!state.stop_soon && !testcase->cal_failed && !testcase->was_fuzzed) {
-        testcase->was_fuzzed = true;
+    if (!state.stop_soon && !testcase->cal_failed && !testcase->WasFuzzed()) {
+        testcase->WasFuzzed() = true;
         state.pending_not_fuzzed--;
-        if (testcase->favored) state.pending_favored--;
+        if (testcase->Favored()) state.pending_favored--;
     }
 
     testcase->input->Unload();
@@ -567,7 +798,11 @@ NullableRef<HierarFlowCallee<bool(const u8*, u32)>> ExecutePUT::operator()(
     ExitStatusFeedback exit_status;
 
     auto inp_feed = state.RunExecutorWithClassifyCounts(input, len, exit_status);
-    CallSuccessors(input, len, inp_feed, exit_status);
+
+    // Tell the mutation stage that it's time to bail out (e.g. stop_soon is set)
+    if (CallSuccessors(input, len, inp_feed, exit_status)) {
+        SetResponseValue(true);
+    }
     return GoToDefaultNext();
 }
 
@@ -1,7 +1,9 @@
 #include "Algorithms/AFL/AFLState.hpp"
 
 #include <unistd.h>
+#include <unordered_map>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 
 #include "Utils/Common.hpp"
 #include "Algorithms/AFL/AFLMacro.hpp"
@@ -16,9 +18,13 @@ AFLState::AFLState(const AFLSetting &setting, NativeLinuxExecutor &executor)
     : setting( setting ), 
       executor( executor ),
       input_set(),
-      rand_fd( Util::OpenFile("/dev/urandom", O_RDONLY | O_CLOEXEC) ),
+      file_writer( std::make_shared<fuzzuf::utils::async_file_writer>(AFLOption::ASYNC_WRITE_BUFFER_SIZE) ),
+      rng( fuzzuf::utils::random::prng::create() ),
       should_construct_auto_dict(false)
 {
+    input_set.EnableDiskCache(AFLOption::CORPUS_CACHE_SIZE);
+    input_set.EnableAsyncWriter(file_writer);
+
     if (in_bitmap.empty()) virgin_bits.assign(AFLOption::MAP_SIZE, 255);
     else {
         ReadBitmap(in_bitmap);
@@ -36,11 +42,13 @@ AFLState::AFLState(const AFLSetting &setting, NativeLinuxExecutor &executor)
 }
 
 AFLState::~AFLState() {
-    if (rand_fd != -1) {
-        Util::CloseFile(rand_fd);
-        rand_fd = -1;
+    try {
+        file_writer->flush();
+        if (corpus_store) corpus_store->Sync();
+        SaveCheckpoint();
+    } catch (const FileError &e) {
+        WARNF("%s", e.what());
     }
-
     fclose(plot_file);
 }
 
@@ -175,7 +183,10 @@ void AFLState::WriteStatsFile(double bitmap_cvg, double stability, double eps) {
                "afl_version       : " AFL_VERSION "\n"
                "target_mode       : %s%s%s%s%s%s%s\n"
                "command_line      : %s\n"
-               "slowest_exec_ms   : %llu\n",
+               "slowest_exec_ms   : %llu\n"
+               "corpus_cache_hit  : %llu\n"
+               "corpus_cache_miss : %llu\n"
+               "dup_rejected      : %u\n",
                start_time / 1000, Util::GetCurTimeMs() / 1000, getpid(),
                queue_cycle ? (queue_cycle - 1) : 0, total_execs, eps,
                queued_paths, queued_favored, queued_discovered, queued_imported,
@@ -191,7 +202,10 @@ void AFLState::WriteStatsFile(double bitmap_cvg, double stability, double eps) {
                (qemu_mode || setting.dumb_mode || no_forkserver || 
                crash_mode != PUTExitReasonType::FAULT_NONE ||
                 persistent_mode || deferred_mode) ? "" : "default",
-               orig_cmdline.c_str(), slowest_exec_ms);
+               orig_cmdline.c_str(), slowest_exec_ms,
+               input_set.GetDiskCache()->GetHits(),
+               input_set.GetDiskCache()->GetMisses(),
+               queued_duplicates);
                /* ignore errors */
 
     /* Get rss value from the children
@@ -219,7 +233,9 @@ void AFLState::SaveAuto(void) {
     if (!auto_changed) return;
     auto_changed = false;
 
-    u32 lim = std::min<u32>(AFLOption::USE_AUTO_EXTRAS, a_extras.size());
+    const auto &entries = a_extras.GetEntries();
+
+    u32 lim = std::min<u32>(AFLOption::USE_AUTO_EXTRAS, entries.size());
     for (u32 i=0; i<lim; i++) {
         auto fn =   setting.out_dir 
                   / "queue/.state/auto_extras" 
@@ -228,7 +244,7 @@ void AFLState::SaveAuto(void) {
         int fd = Util::OpenFile(fn.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
         if (fd < 0) PFATAL("Unable to create '%s'", fn.c_str());
 
-        Util::WriteFile(fd, &a_extras[i].data[0], a_extras[i].data.size());
+        Util::WriteFile(fd, &entries[i].data[0], entries[i].data.size());
         Util::CloseFile(fd);
     }
 }
@@ -259,6 +275,263 @@ void AFLState::ReadBitmap(fs::path fname) {
     virgin_bits.resize(AFLOption::MAP_SIZE);
     Util::ReadFile(fd, virgin_bits.data(), AFLOption::MAP_SIZE);
     Util::CloseFile(fd);
+
+    // these are maintained incrementally by HasNewBits() from now on
+    virgin_touched_bytes = Util::CountNon255Bytes(&virgin_bits[0], virgin_bits.size());
+    virgin_cleared_bits = (AFLOption::MAP_SIZE << 3) - Util::CountBits(&virgin_bits[0], virgin_bits.size());
+}
+
+/* Size and mtime of the target, so that a checkpoint taken with another
+   build of it isn't trusted. */
+
+static void GetTargetStamp(const std::string &path, u64 &size, u64 &mtime) {
+    struct stat st;
+    if (stat(path.c_str(), &st)) {
+        size = mtime = 0;
+        return;
+    }
+
+    size = st.st_size;
+    mtime = (u64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+/* Save what the dry run would otherwise have to recompute when resuming
+   from this queue. The entries it refers to must already be on disk, so
+   file_writer has to be flushed before calling this. */
+
+void AFLState::SaveCheckpoint(void) {
+    if (!dry_run_done) return;
+
+    AFLCheckpoint checkpoint;
+    GetTargetStamp(setting.argv[0], checkpoint.target_size, checkpoint.target_mtime);
+    checkpoint.crash_mode = static_cast<u32>(crash_mode);
+
+    std::vector<u32> to_entry(case_queue.size(), AFLCheckpoint::NO_ENTRY);
+    for (const auto &testcase : case_queue) {
+
+        /* cal_failed is set while an entry is being calibrated, and an entry
+           which hasn't been calibrated yet has no checksum. */
+
+        if (testcase->cal_failed || !testcase->exec_cksum) continue;
+
+        /* Without a hash, the entry couldn't be told apart from a replaced
+           one when resuming. */
+
+        if (!testcase->content_hash) continue;
+
+        AFLCheckpoint::Entry entry;
+        entry.name = testcase->input->GetPath().filename().string();
+        entry.hash = *testcase->content_hash;
+        entry.exec_cksum = testcase->exec_cksum;
+        entry.bitmap_size = testcase->BitmapSize();
+        entry.exec_us = testcase->ExecUs();
+        entry.handicap = testcase->Handicap();
+        entry.depth = testcase->Depth();
+        entry.trim_done = testcase->trim_done;
+        entry.was_fuzzed = testcase->WasFuzzed();
+        entry.has_new_cov = testcase->has_new_cov;
+        entry.var_behavior = testcase->var_behavior;
+
+        if (testcase->trace_mini) {
+            const auto &trace_mini = *testcase->trace_mini;
+            entry.trace_mini.assign(AFLOption::MAP_SIZE >> 3, 0);
+            for (u32 i=0; i < AFLOption::MAP_SIZE; i++) {
+                if (trace_mini[i]) entry.trace_mini[i >> 3] |= 1 << (i & 7);
+            }
+        }
+
+        to_entry[testcase->queue_id] = checkpoint.entries.size();
+        checkpoint.entries.emplace_back(std::move(entry));
+    }
+
+    checkpoint.top_rated.assign(AFLOption::MAP_SIZE, AFLCheckpoint::NO_ENTRY);
+    for (u32 i=0; i < AFLOption::MAP_SIZE; i++) {
+        if (top_rated[i]) checkpoint.top_rated[i] = to_entry[top_rated[i].value().get().queue_id];
+    }
+
+    checkpoint.virgin_bits = virgin_bits;
+    checkpoint.virgin_tmout = virgin_tmout;
+    checkpoint.virgin_crash = virgin_crash;
+    checkpoint.var_bytes = var_bytes;
+    checkpoint.stage_finds = stage_finds;
+    checkpoint.stage_cycles = stage_cycles;
+    checkpoint.a_extras = a_extras.GetEntries();
+    checkpoint.rng = rng.get_state();
+
+    auto &counters = checkpoint.counters;
+    counters.queue_cycle = queue_cycle;
+    counters.current_entry = current_entry;
+    counters.cycles_wo_finds = cycles_wo_finds;
+    counters.total_execs = total_execs;
+    counters.total_crashes = total_crashes;
+    counters.unique_crashes = unique_crashes;
+    counters.total_tmouts = total_tmouts;
+    counters.unique_tmouts = unique_tmouts;
+    counters.unique_hangs = unique_hangs;
+    counters.last_crash_execs = last_crash_execs;
+    counters.slowest_exec_ms = slowest_exec_ms;
+    counters.trim_execs = trim_execs;
+    counters.bytes_trim_in = bytes_trim_in;
+    counters.bytes_trim_out = bytes_trim_out;
+    counters.blocks_eff_total = blocks_eff_total;
+    counters.blocks_eff_select = blocks_eff_select;
+    counters.total_cal_us = total_cal_us;
+    counters.total_cal_cycles = total_cal_cycles;
+    counters.total_bitmap_size = total_bitmap_size;
+    counters.total_bitmap_entries = total_bitmap_entries;
+
+    auto fn = setting.out_dir / "queue/.state/checkpoint";
+    afl::util::WriteCheckpoint(fn.string(), checkpoint);
+}
+
+/* Take over the calibration of the entries in case_queue which are in the
+   checkpoint under the same name and contents, and then the global state.
+   Returns which entries, by queue_id, don't have to be calibrated again. */
+
+std::vector<bool> AFLState::RestoreCheckpoint(const AFLCheckpoint &checkpoint) {
+    std::vector<bool> restored(case_queue.size(), false);
+
+    u64 target_size, target_mtime;
+    GetTargetStamp(setting.argv[0], target_size, target_mtime);
+    if ( checkpoint.target_size != target_size
+      || checkpoint.target_mtime != target_mtime
+      || checkpoint.crash_mode != static_cast<u32>(crash_mode)) {
+        WARNF("The target has changed since the checkpoint, calibrating all the entries.");
+        return restored;
+    }
+
+    std::unordered_map<std::string, u32> by_name;
+    for (u32 i=0; i < checkpoint.entries.size(); i++) {
+        by_name.emplace(checkpoint.entries[i].name, i);
+    }
+
+    std::vector<AFLTestcase*> from_entry(checkpoint.entries.size(), nullptr);
+    u32 num_restored = 0;
+
+    for (const auto &testcase : case_queue) {
+        auto itr = by_name.find(testcase->input->GetPath().filename().string());
+        if (itr == by_name.end()) continue;
+
+        const auto &entry = checkpoint.entries[itr->second];
+
+        /* The entries have been hashed while the input directory was read,
+           which tells if one has been replaced since. */
+
+        if (!testcase->content_hash || *testcase->content_hash != entry.hash) continue;
+
+        testcase->exec_cksum = entry.exec_cksum;
+        testcase->BitmapSize() = entry.bitmap_size;
+        testcase->ExecUs() = entry.exec_us;
+        testcase->Handicap() = entry.handicap;
+        testcase->Depth() = entry.depth;
+        testcase->trim_done = entry.trim_done;
+
+        if (entry.was_fuzzed) {
+            testcase->WasFuzzed() = true;
+            pending_not_fuzzed--;
+        }
+
+        if (entry.has_new_cov) {
+            testcase->has_new_cov = true;
+            queued_with_cov++;
+        }
+
+        if (entry.var_behavior) {
+            afl::util::MarkAsVariable(*this, *testcase);
+            queued_variable++;
+        }
+
+        if (max_depth < entry.depth) max_depth = entry.depth;
+
+        if (!entry.trace_mini.empty()) {
+            testcase->trace_mini.reset(new std::bitset<AFLOption::MAP_SIZE>());
+            for (u32 i=0; i < AFLOption::MAP_SIZE; i++) {
+                if (entry.trace_mini[i >> 3] & (1 << (i & 7))) testcase->trace_mini->set(i);
+            }
+        }
+
+        from_entry[itr->second] = testcase.get();
+        restored[testcase->queue_id] = true;
+        num_restored++;
+    }
+
+    /* Nothing in common; this checkpoint must be about some other queue. */
+
+    if (!num_restored) return restored;
+
+    /* The entries that have to be calibrated again will compete with these
+       winners in UpdateBitmapScore(). */
+
+    for (u32 i=0; i < AFLOption::MAP_SIZE; i++) {
+        u32 winner = checkpoint.top_rated[i];
+        if (winner == AFLCheckpoint::NO_ENTRY || !from_entry[winner]) continue;
+
+        auto &testcase = *from_entry[winner];
+        if (!testcase.trace_mini) continue;
+
+        top_rated[i] = std::ref(testcase);
+        testcase.tc_ref++;
+    }
+
+    for (auto *testcase : from_entry) {
+        if (testcase && !testcase->tc_ref) testcase->trace_mini.reset();
+    }
+
+    /* Merge rather than overwrite, in case -B gave a bitmap too. */
+
+    for (u32 i=0; i < AFLOption::MAP_SIZE; i++) {
+        virgin_bits[i] &= checkpoint.virgin_bits[i];
+        virgin_tmout[i] &= checkpoint.virgin_tmout[i];
+        virgin_crash[i] &= checkpoint.virgin_crash[i];
+        var_bytes[i] |= checkpoint.var_bytes[i];
+    }
+
+    virgin_touched_bytes = Util::CountNon255Bytes(&virgin_bits[0], virgin_bits.size());
+    virgin_cleared_bits = (AFLOption::MAP_SIZE << 3) - Util::CountBits(&virgin_bits[0], virgin_bits.size());
+    var_byte_count = Util::CountBytes(&var_bytes[0], var_bytes.size());
+
+    for (u32 i=0; i < std::min(stage_finds.size(), checkpoint.stage_finds.size()); i++) {
+        stage_finds[i] = checkpoint.stage_finds[i];
+        stage_cycles[i] = checkpoint.stage_cycles[i];
+    }
+
+    a_extras.Restore(checkpoint.a_extras);
+    auto_changed = !a_extras.empty();
+
+    rng.set_state(checkpoint.rng);
+
+    const auto &counters = checkpoint.counters;
+    queue_cycle = counters.queue_cycle;
+    cycles_wo_finds = counters.cycles_wo_finds;
+    total_execs = counters.total_execs;
+    total_crashes = counters.total_crashes;
+    unique_crashes = counters.unique_crashes;
+    total_tmouts = counters.total_tmouts;
+    unique_tmouts = counters.unique_tmouts;
+    unique_hangs = counters.unique_hangs;
+    last_crash_execs = counters.last_crash_execs;
+    slowest_exec_ms = counters.slowest_exec_ms;
+    trim_execs = counters.trim_execs;
+    bytes_trim_in = counters.bytes_trim_in;
+    bytes_trim_out = counters.bytes_trim_out;
+    blocks_eff_total = counters.blocks_eff_total;
+    blocks_eff_select = counters.blocks_eff_select;
+    total_cal_us = counters.total_cal_us;
+    total_cal_cycles = counters.total_cal_cycles;
+    total_bitmap_size = counters.total_bitmap_size;
+    total_bitmap_entries = counters.total_bitmap_entries;
+
+    /* SelectSeed moves to the next entry before fuzzing it, so stop right
+       before the one that was being fuzzed. For the first entry, this wraps
+       around to 0 without starting a new cycle. */
+
+    current_entry = u32(counters.current_entry) - 1;
+
+    score_changed = true;
+
+    OKF("Restored %u of %u entries from the checkpoint.", num_restored, queued_paths);
+
+    return restored;
 }
 
 void AFLState::MaybeUpdatePlotFile(double bitmap_cvg, double eps) {
@@ -340,7 +613,7 @@ void AFLState::ShowStats(void) {
     if (!stats_update_freq) stats_update_freq = 1;
 
     /* Do some bitmap stats. */
-    u32 t_bytes = Util::CountNon255Bytes(&virgin_bits[0], virgin_bits.size());
+    u32 t_bytes = virgin_touched_bytes;
     double t_byte_ratio = ((double)t_bytes * 100) / AFLOption::MAP_SIZE;
 
     double stab_ratio;
@@ -356,6 +629,11 @@ void AFLState::ShowStats(void) {
         WriteStatsFile(t_byte_ratio, stab_ratio, avg_exec);
         SaveAuto();
         WriteBitmap();
+
+        /* Make sure the queue and crashes found so far are on disk, too. */
+        file_writer->flush();
+        if (corpus_store) corpus_store->Sync();
+        SaveCheckpoint();
     }
 
     /* Every now and then, write plot data. */
@@ -374,7 +652,7 @@ void AFLState::ShowStats(void) {
     if (not_on_tty) return;
 
     /* Compute some mildly useful bitmap stats. */
-    u32 t_bits = (AFLOption::MAP_SIZE << 3) - Util::CountBits(&virgin_bits[0], virgin_bits.size()); 
+    u32 t_bits = virgin_cleared_bits;
 
     /* Now, for the visuals... */
     bool term_too_small = false;
@@ -501,13 +779,13 @@ void AFLState::ShowStats(void) {
     auto& queue_cur = *case_queue[current_entry];
 
     tmp = DescribeInteger(current_entry);
-    if (!queue_cur.favored) tmp += '*';
+    if (!queue_cur.Favored()) tmp += '*';
     tmp += Util::StrPrintf(" (%0.02f%%)", ((double)current_entry * 100) / queued_paths);
 
     SAYF(bV bSTOP "  now processing : " cRST "%-17s " bSTG bV bSTOP, tmp.c_str());
 
     tmp = Util::StrPrintf("%0.02f%% / %0.02f%%", 
-                          ((double)queue_cur.bitmap_size) * 100 / AFLOption::MAP_SIZE, t_byte_ratio);
+                          ((double)queue_cur.BitmapSize()) * 100 / AFLOption::MAP_SIZE, t_byte_ratio);
 
     SAYF("    map density : %s%-21s " bSTG bV "\n", t_byte_ratio > 70 ? cLRD : 
          ((t_bytes < 200 && !setting.dumb_mode) ? cPIN : cRST), tmp.c_str());
@@ -1,7 +1,21 @@
 #include "Algorithms/AFL/AFLTestcase.hpp"
 #include "ExecInput/OnDiskExecInput.hpp"
 
-AFLTestcase::AFLTestcase(std::shared_ptr<OnDiskExecInput> input)
-    : input( input ) {}
+u32 AFLQueueMeta::Add() {
+    u32 id = size();
+    exec_us.emplace_back(0);
+    bitmap_size.emplace_back(0);
+    handicap.emplace_back(0);
+    depth.emplace_back(0);
+    favored.emplace_back(false);
+    was_fuzzed.emplace_back(false);
+    fs_redundant.emplace_back(false);
+    return id;
+}
+
+AFLTestcase::AFLTestcase(std::shared_ptr<OnDiskExecInput> input, AFLQueueMeta &meta)
+    : input( input ),
+      meta( &meta ),
+      queue_id( meta.Add() ) {}
 
 AFLTestcase::~AFLTestcase() {}
@@ -1,5 +1,6 @@
 #include "Algorithms/AFL/AFLUpdateHierarFlowRoutines.hpp"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <functional>
@@ -51,10 +52,7 @@ static std::string DescribeOp(AFLState &state, u8 hnb) {
     return ret;
 }
 
-static bool CheckEqualNocase(const std::vector<u8> &m1, const std::vector<u8> &m2) {
-    // NOTE: this function implicitly assumes m1.size() == m2.size()
-    u32 len = m1.size(); 
-
+static bool CheckEqualNocase(const u8 *m1, const u8 *m2, u32 len) {
     for (u32 i=0; i<len; i++) {
         if (std::tolower(m1[i]) != std::tolower(m2[i])) return false;
     }
@@ -62,24 +60,24 @@ static bool CheckEqualNocase(const std::vector<u8> &m1, const std::vector<u8> &m
     return true;
 }
 
-static void MaybeAddAuto(AFLState &state, const std::vector<u8> &mem) {
+static void MaybeAddAuto(AFLState &state, const u8 *mem, u32 len) {
     /* Allow users to specify that they don't want auto dictionaries. */
 
     if (AFLOption::MAX_AUTO_EXTRAS == 0 || AFLOption::USE_AUTO_EXTRAS == 0) return;
 
     /* Skip runs of identical bytes. */
 
-    if (mem == std::vector<u8>(mem.size(), mem[0])) return;
+    if (std::all_of(mem, mem + len, [mem](u8 c) { return c == mem[0]; })) return;
 
     /* Reject builtin interesting values. */
 
-    if (mem.size() == 2) {
-        u16 converted = *(u16*)mem.data();
+    if (len == 2) {
+        u16 converted = *(const u16*)mem;
         for (auto val : Mutator::interesting_16) {
             if (converted == (u16)val || converted == SWAP16(val)) return;
         }
-    } else if (mem.size() == 4) {
-        u32 converted = *(u32*)mem.data();
+    } else if (len == 4) {
+        u32 converted = *(const u32*)mem;
         for (auto val : Mutator::interesting_32) {
             if (converted == (u32)val || converted == SWAP32(val)) return;
         }
@@ -89,73 +87,19 @@ static void MaybeAddAuto(AFLState &state, const std::vector<u8> &mem) {
        match. We optimize by exploiting the fact that extras[] are sorted
        by size. */
 
-    auto itr = state.extras.begin();
-    for (; itr != state.extras.end(); itr++)  {
-        if (itr->data.size() >= mem.size()) break;
-    }
+    auto itr = std::lower_bound(state.extras.begin(), state.extras.end(), len,
+                   [](const AFLDictData &extra, u32 len) { return extra.data.size() < len; });
 
-    for (; itr != state.extras.end() && itr->data.size() == mem.size(); itr++) {
-        if (CheckEqualNocase(itr->data, mem)) return;
+    for (; itr != state.extras.end() && itr->data.size() == len; itr++) {
+        if (CheckEqualNocase(itr->data.data(), mem, len)) return;
     }
 
-    /* Last but not least, check a_extras[] for matches. There are no
-       guarantees of a particular sort order. */
+    /* Last but not least, check a_extras[] for matches, and append or
+       update the entry. a_extras keeps itself sorted. */
 
     state.auto_changed = 1;
 
-    bool will_append = true;
-    for (auto &extra : state.a_extras) {
-        if (extra.data.size() == mem.size() && CheckEqualNocase(extra.data, mem)) {
-            extra.hit_cnt++;
-            will_append = false;
-            break;
-        }
-    }
-
-    if (will_append) {
-        /* At this point, looks like we're dealing with a new entry. So, let's
-           append it if we have room. Otherwise, let's randomly evict some other
-           entry from the bottom half of the list. */
-    
-        if (state.a_extras.size() < AFLOption::MAX_AUTO_EXTRAS) {
-            state.a_extras.emplace_back(AFLDictData{mem, 0});
-        } else {
-            using afl::util::UR;
-
-            int idx = AFLOption::MAX_AUTO_EXTRAS / 2;
-            idx += UR((AFLOption::MAX_AUTO_EXTRAS + 1) / 2, state.rand_fd);
-    
-            state.a_extras[idx].data = mem;
-            state.a_extras[idx].hit_cnt = 0;
-        }
-    }
-
-    std::sort(state.a_extras.begin(), state.a_extras.end(), 
-        [](const AFLDictData& e1, const AFLDictData& e2) {
-#ifdef BEHAVE_DETERMINISTIC
-            if (e1.hit_cnt != e2.hit_cnt) return e1.hit_cnt > e2.hit_cnt;
-            if (e1.data.size() != e2.data.size()) return e1.data.size() < e2.data.size();
-            return std::lexicographical_compare(e1.data.begin(), e1.data.end(),
-                                                e2.data.begin(), e2.data.end());
-#else
-            return e1.hit_cnt > e2.hit_cnt;
-#endif
-        }
-    );
-
-    size_t lim = std::min<size_t>(AFLOption::USE_AUTO_EXTRAS, state.a_extras.size());
-    std::sort(state.a_extras.begin(), state.a_extras.begin() + lim, 
-        [](const AFLDictData& e1, const AFLDictData& e2) {
-#ifdef BEHAVE_DETERMINISTIC
-            if (e1.data.size() != e2.data.size()) return e1.data.size() < e2.data.size();
-            if (e1.hit_cnt != e2.hit_cnt) return e1.hit_cnt > e2.hit_cnt;
-            return std::lexicographical_compare(e1.data.begin(), e1.data.end(),
-                                                e2.data.begin(), e2.data.end());
-#else
-            return e1.data.size() < e2.data.size();
-#endif
-        }
-    );
+    state.a_extras.Add(mem, len, state.rng);
 }
 
 static bool SaveIfInteresting(
@@ -187,6 +131,18 @@ static bool SaveIfInteresting(
             return false;
         }
 
+        /* A target with variable behavior can report new bits for an input
+           that is already in the queue. Another copy would only cost a
+           calibration and a share of every cycle. */
+
+        if (afl::util::IsKnownContent(state, afl::util::HashContent(buf, len))) {
+            state.queued_duplicates++;
+            if (state.crash_mode == PUTExitReasonType::FAULT_CRASH) {
+                state.total_crashes++;
+            }
+            return false;
+        }
+
         if (!state.setting.simple_files) {
             fn = Util::StrPrintf("%s/queue/id:%06u,%s", 
                                     state.setting.out_dir.c_str(), 
@@ -389,9 +345,7 @@ keep_as_crash:
     /* If we're here, we apparently want to save the crash or hang
        test case, too. */
 
-    int fd = Util::OpenFile(fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-    Util::WriteFile(fd, buf, len);
-    Util::CloseFile(fd);
+    state.file_writer->write_exclusive(fn, buf, len);
 
     return keeping;
 }
@@ -445,19 +399,9 @@ AFLUpdCalleeRef NormalUpdate::operator()(
     return GoToDefaultNext();
 }
 
-ConstructAutoDict::ConstructAutoDict(AFLState &state) : state(state) {}
-
-// Deal with dictionary construction in bitflip 1/1 stage
-AFLUpdCalleeRef ConstructAutoDict::operator()(
-    const u8 *buf, 
-    u32 /* unused */, 
-    InplaceMemoryFeedback& inp_feed,
-    ExitStatusFeedback & /* unused */ 
-) {
-    if (!state.ShouldConstructAutoDict()) return GoToDefaultNext();
-
-    u32 cksum = inp_feed.CalcCksum32();
-
+/* Collect auto-dictionary tokens from the checksums of bitflip 1/1, given
+   the checksum of the execution of buf. */
+void CollectAutoDict(AFLState &state, const u8 *buf, u32 cksum) {
     if (state.stage_cur == state.stage_max - 1 && cksum == state.prev_cksum) {
 
         /* If at end of file and we are still collecting a string, grab the
@@ -466,11 +410,10 @@ AFLUpdCalleeRef ConstructAutoDict::operator()(
         if (state.a_len < AFLOption::MAX_AUTO_EXTRA) {
             // At this point, the content of buf is different from the original AFL,
             // because the original one does this procedure AFTER restoring buf.
-            state.a_collect.emplace_back(buf[state.stage_cur >> 3] ^ 1);
+            state.a_collect[state.a_len] = buf[state.stage_cur >> 3] ^ 1;
         }
 
-        // NOTE: why do we have a_len? Isn't a_collect.size() enough?
-        // In the original AFL, a_len can be MAX_AUTO_EXTRA+1:
+        // NOTE: In the original AFL, a_len can be MAX_AUTO_EXTRA+1:
         // when AFL tries to append a character while a_len == MAX_AUTO_EXTRA,
         // it fails to do that, only to increment a_len.
         // This is considered as the problem of the original AFL,
@@ -478,7 +421,7 @@ AFLUpdCalleeRef ConstructAutoDict::operator()(
         state.a_len++;
         
         if (AFLOption::MIN_AUTO_EXTRA <= state.a_len && state.a_len <= AFLOption::MAX_AUTO_EXTRA) {
-            MaybeAddAuto(state, state.a_collect);
+            MaybeAddAuto(state, state.a_collect.data(), state.a_len);
         }
     } else if (cksum != state.prev_cksum) {
 
@@ -486,10 +429,9 @@ AFLUpdCalleeRef ConstructAutoDict::operator()(
            worthwhile queued up, and collect that if the answer is yes. */
 
         if (AFLOption::MIN_AUTO_EXTRA <= state.a_len && state.a_len <= AFLOption::MAX_AUTO_EXTRA) {
-            MaybeAddAuto(state, state.a_collect);
+            MaybeAddAuto(state, state.a_collect.data(), state.a_len);
         }
         
-        state.a_collect.clear();
         state.a_len = 0;
         state.prev_cksum = cksum;
     }
@@ -499,11 +441,40 @@ AFLUpdCalleeRef ConstructAutoDict::operator()(
 
     if (cksum != state.queue_cur_exec_cksum) {
         if (state.a_len < AFLOption::MAX_AUTO_EXTRA) {
-            state.a_collect.emplace_back(buf[state.stage_cur >> 3] ^ 1);
+            state.a_collect[state.a_len] = buf[state.stage_cur >> 3] ^ 1;
         }
         state.a_len++;
     }
+}
+
+/* We also use bitflip 8/8 to pull off a simple trick: we identify
+   bytes that seem to have no effect on the current execution path
+   even when fully flipped - and we skip them during more expensive
+   deterministic stages, such as arithmetics or known ints. */
+void MarkEffMap(AFLState &state, u32 len, u32 cksum) {
+    using afl::util::EFF_APOS;
+
+    if (state.eff_map[EFF_APOS(state.stage_cur)]) return;
+
+    if ( state.setting.dumb_mode || len < AFLOption::EFF_MIN_LEN
+      || cksum != state.queue_cur_exec_cksum) {
+        state.eff_map[EFF_APOS(state.stage_cur)] = 1;
+        state.eff_cnt++;
+    }
+}
+
+ConstructAutoDict::ConstructAutoDict(AFLState &state) : state(state) {}
+
+// Deal with dictionary construction in bitflip 1/1 stage
+AFLUpdCalleeRef ConstructAutoDict::operator()(
+    const u8 *buf, 
+    u32 /* unused */, 
+    InplaceMemoryFeedback& inp_feed,
+    ExitStatusFeedback & /* unused */ 
+) {
+    if (!state.ShouldConstructAutoDict()) return GoToDefaultNext();
 
+    CollectAutoDict(state, buf, inp_feed.CalcCksum32());
     return GoToDefaultNext();
 }
 
@@ -516,30 +487,12 @@ AFLUpdCalleeRef ConstructEffMap::operator()(
     InplaceMemoryFeedback& inp_feed,
     ExitStatusFeedback & /* unused */ 
 ) {
-    /* We also use this stage to pull off a simple trick: we identify
-       bytes that seem to have no effect on the current execution path
-       even when fully flipped - and we skip them during more expensive
-       deterministic stages, such as arithmetics or known ints. */
-
     using afl::util::EFF_APOS;
 
-    if (!state.eff_map[EFF_APOS(state.stage_cur)]) {
-        bool set_eff_map_bit = false;
-        if (state.setting.dumb_mode || len < AFLOption::EFF_MIN_LEN) {
-            set_eff_map_bit = true;
-        } else {
-            u32 cksum = inp_feed.CalcCksum32();
-            if (cksum != state.queue_cur_exec_cksum) {
-                set_eff_map_bit = true;
-            }
-        }
-
-        if (set_eff_map_bit) {
-            state.eff_map[EFF_APOS(state.stage_cur)] = 1;
-            state.eff_cnt++;
-        }
-    }
+    // the checksum is needed only if the bit is not set yet
+    if (state.eff_map[EFF_APOS(state.stage_cur)]) return GoToDefaultNext();
 
+    MarkEffMap(state, len, inp_feed.CalcCksum32());
     return GoToDefaultNext();
 }
 
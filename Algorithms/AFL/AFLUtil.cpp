@@ -1,5 +1,8 @@
 #include "Algorithms/AFL/AFLUtil.hpp"
 
+#include <climits>
+#include <sys/stat.h>
+
 #include "Utils/Common.hpp"
 #include "Feedback/PUTExitReasonType.hpp"
 #include "Algorithms/AFL/AFLMacro.hpp"
@@ -13,25 +16,12 @@
 namespace afl {
 namespace util {
 
-u32 UR(u32 limit, int rand_fd) {
-    static u32 rand_cnt;
-
-#ifdef BEHAVE_DETERMINISTIC
-    rand_fd++; // Just to muzzle Wunused-variable
-    static u32 cnt;
-    if (unlikely(!rand_cnt--)) {
-        srandom(cnt++);
-    }
-#else
-    if (rand_fd != -1 && unlikely(!rand_cnt--)) {
-        u32 seed[2];
-        Util::ReadFile(rand_fd, &seed, sizeof(seed));
-        srandom(seed[0]);
-        rand_cnt = (AFLOption::RESEED_RNG / 2) + (seed[1] % AFLOption::RESEED_RNG);
-    }
-#endif
+/* Generate a random number (from 0 to limit - 1). Unlike the original,
+   this doesn't have bias, and doesn't touch the global state of libc:
+   each fuzzer passes its own generator. */
 
-    return random() % limit;
+u32 UR(u32 limit, fuzzuf::utils::random::prng &rng) {
+    return rng.below(limit);
 }
 
 /* Describe all the integers with five characters or less */
@@ -155,6 +145,14 @@ std::string DescribeTimeDelta(u64 cur_ms, u64 event_ms) {
                             DescribeInteger(t_d).c_str(), t_h, t_m, t_s);
 }
 
+/* With AFL_PACKED_CORPUS, the markers are flags of the entry in the corpus
+   store instead of files under queue/.state/. */
+
+static std::optional<u32> FindInCorpusStore(const AFLState& state, const AFLTestcase &testcase) {
+    if (!state.corpus_store) return std::nullopt;
+    return state.corpus_store->Find(testcase.input->GetPath().filename().string());
+}
+
 void MarkAsDetDone(const AFLState& state, AFLTestcase &testcase) {
     const auto& input = *testcase.input;
 
@@ -162,15 +160,28 @@ void MarkAsDetDone(const AFLState& state, AFLTestcase &testcase) {
     fn = Util::StrPrintf("%s/queue/.state/deterministic_done/%s", 
         state.setting.out_dir.c_str(), fn.c_str());
 
-    int fd = Util::OpenFile(fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
-    Util::CloseFile(fd);
+    if (auto idx = FindInCorpusStore(state, testcase)) {
+        state.corpus_store->SetFlag(*idx, PackedCorpusStore::PASSED_DET, true);
+    } else {
+        state.file_writer->create(fn);
+    }
 
     testcase.passed_det = true;
+
+    /* The progress of deterministic stages is no longer needed. */
+
+    RemoveDetProgress(state, testcase);
 }
 
 void MarkAsVariable(const AFLState& state, AFLTestcase &testcase) {
     const auto& input = *testcase.input;
 
+    if (auto idx = FindInCorpusStore(state, testcase)) {
+        state.corpus_store->SetFlag(*idx, PackedCorpusStore::VAR_BEHAVIOR, true);
+        testcase.var_behavior = true;
+        return;
+    }
+
     std::string fn = input.GetPath().filename().string();
     std::string ldest = Util::StrPrintf("../../%s", fn.c_str());
     fn = Util::StrPrintf("%s/queue/.state/variable_behavior/%s", 
@@ -187,30 +198,490 @@ void MarkAsVariable(const AFLState& state, AFLTestcase &testcase) {
 void MarkAsRedundant(const AFLState& state, AFLTestcase &testcase, bool val) {
     const auto& input = *testcase.input;
 
-    if (val == testcase.fs_redundant) return;
+    if (val == testcase.FsRedundant()) return;
+
+    testcase.FsRedundant() = val;
 
-    testcase.fs_redundant = val;
+    if (auto idx = FindInCorpusStore(state, testcase)) {
+        state.corpus_store->SetFlag(*idx, PackedCorpusStore::FS_REDUNDANT, val);
+        return;
+    }
 
     std::string fn = input.GetPath().filename().string();
     fn = Util::StrPrintf("%s/queue/.state/redundant_edges/%s", 
         state.setting.out_dir.c_str(), fn.c_str());
     
-    if (val) {
-        int fd = Util::OpenFile(fn, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    /* The marker is created or removed in the background, and failures are
+       reported by the next flush. */
+
+    if (val) state.file_writer->create(fn);
+    else state.file_writer->remove(fn);
+}
+
+/* The order in which deterministic stages are executed. Checkpoints refer
+   to the stages with STAGE_* values, which are not in this order. */
+
+u32 DetStageRank(u32 stage) {
+    static const u32 det_stage_order[] = {
+        AFLOption::STAGE_FLIP1,
+        AFLOption::STAGE_FLIP2,
+        AFLOption::STAGE_FLIP4,
+        AFLOption::STAGE_FLIP8,
+        AFLOption::STAGE_FLIP16,
+        AFLOption::STAGE_FLIP32,
+        AFLOption::STAGE_ARITH8,
+        AFLOption::STAGE_ARITH16,
+        AFLOption::STAGE_ARITH32,
+        AFLOption::STAGE_INTEREST8,
+        AFLOption::STAGE_INTEREST16,
+        AFLOption::STAGE_INTEREST32,
+        AFLOption::STAGE_ITS,
+        AFLOption::STAGE_EXTRAS_UO,
+        AFLOption::STAGE_EXTRAS_UI,
+        AFLOption::STAGE_EXTRAS_AO
+    };
+
+    u32 num_stages = sizeof(det_stage_order) / sizeof(det_stage_order[0]);
+    for (u32 i=0; i < num_stages; i++) {
+        if (det_stage_order[i] == stage) return i;
+    }
+    return num_stages;
+}
+
+/* On-disk layout of deterministic stage checkpoints. The effector map
+   follows the header. */
+
+namespace {
+
+const u32 DET_PROGRESS_MAGIC = 0x50444641; /* "AFDP" */
+
+struct DetProgressHeader {
+    u32 magic;
+    u32 stage;
+    u32 pos;
+    u32 len;
+    u32 exec_cksum;
+    u32 eff_cnt;
+    u32 eff_len;
+};
+
+} // anonymous namespace
+
+/* Write the checkpoint to a temporary file first, so that a crash in the 
+   middle never leaves a broken one behind. */
+
+void WriteDetProgress(const std::string &path, const AFLDetProgress &progress) {
+    DetProgressHeader header{
+        DET_PROGRESS_MAGIC,
+        progress.stage,
+        progress.pos,
+        progress.len,
+        progress.exec_cksum,
+        progress.eff_cnt,
+        (u32)progress.eff_map.size()
+    };
+
+    std::string tmp = path + ".tmp";
+    int fd = Util::OpenFile(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    Util::WriteFile(fd, &header, sizeof(header));
+    if (!progress.eff_map.empty()) {
+        Util::WriteFile(fd, progress.eff_map.data(), progress.eff_map.size());
+    }
+    Util::CloseFile(fd);
+
+    if (rename(tmp.c_str(), path.c_str())) PFATAL("Unable to rename '%s'", tmp.c_str());
+}
+
+/* Returns nullptr if there is no checkpoint, or if it doesn't look sane. */
+
+std::unique_ptr<AFLDetProgress> ReadDetProgress(const std::string &path) {
+    if (access(path.c_str(), F_OK) != 0) return nullptr;
+
+    DetProgressHeader header;
+    auto progress = std::make_unique<AFLDetProgress>();
+
+    int fd = Util::OpenFile(path, O_RDONLY);
+    try {
+        Util::ReadFile(fd, &header, sizeof(header));
+
+        if ( header.magic != DET_PROGRESS_MAGIC
+          || header.eff_len > EFF_ALEN(AFLOption::MAX_FILE)) {
+            Util::CloseFile(fd);
+            return nullptr;
+        }
+
+        progress->eff_map.resize(header.eff_len);
+        if (header.eff_len) Util::ReadFile(fd, progress->eff_map.data(), header.eff_len);
+    } catch (const FileError &) {
         Util::CloseFile(fd);
+        return nullptr;
+    }
+    Util::CloseFile(fd);
+
+    progress->stage = header.stage;
+    progress->pos = header.pos;
+    progress->len = header.len;
+    progress->exec_cksum = header.exec_cksum;
+    progress->eff_cnt = header.eff_cnt;
+
+    return progress;
+}
+
+void SaveDetProgress(
+    const AFLState& state, 
+    const AFLTestcase &testcase,
+    const AFLDetProgress &progress
+) {
+    std::string fn = testcase.input->GetPath().filename().string();
+    fn = Util::StrPrintf("%s/queue/.state/det_progress/%s", 
+        state.setting.out_dir.c_str(), fn.c_str());
+
+    WriteDetProgress(fn, progress);
+}
+
+void RemoveDetProgress(const AFLState& state, const AFLTestcase &testcase) {
+    std::string fn = testcase.input->GetPath().filename().string();
+    fn = Util::StrPrintf("%s/queue/.state/det_progress/%s", 
+        state.setting.out_dir.c_str(), fn.c_str());
+
+    unlink(fn.c_str()); /* Ignore errors */
+}
+
+/* Save state.det_progress for the entry being fuzzed. The effector map is
+   included once bitflip 8/8 has started to build it; before that, eff_map
+   still belongs to the previous entry. */
+
+void CheckpointDetProgress(AFLState& state, const AFLTestcase &testcase) {
+    auto &progress = state.det_progress;
+
+    progress.len = testcase.input->GetLen();
+    progress.exec_cksum = testcase.exec_cksum;
+
+    if (DetStageRank(progress.stage) >= DetStageRank(AFLOption::STAGE_FLIP8)) {
+        progress.eff_cnt = state.eff_cnt;
+        progress.eff_map = state.eff_map;
     } else {
-        if (unlink(fn.c_str())) PFATAL("Unable to remove '%s'", fn.c_str());
+        progress.eff_cnt = 0;
+        progress.eff_map.clear();
     }
+
+    /* The checkpoint is only useful if the queue entries and markers it
+       depends on are already on disk. */
+
+    state.file_writer->flush();
+    if (state.corpus_store) state.corpus_store->Sync();
+    SaveDetProgress(state, testcase, progress);
+    state.last_det_checkpoint_ms = Util::GetCurTimeMs();
+}
+
+/* On-disk layout of queue checkpoints: the header, the counters, the PRNG
+   state, the bitmaps, the stage stats, the auto extras, the entries (each
+   with its name and packed trace) and top_rated, in this order. Everything
+   is stored as is, as it is only read back on the same machine. */
+
+namespace {
+
+const u32 CHECKPOINT_MAGIC = 0x50434641; /* "AFCP" */
+const u32 CHECKPOINT_VERSION = 2;
+
+struct CheckpointHeader {
+    u32 magic;
+    u32 version;
+    u32 map_size;
+    u32 crash_mode;
+    u64 target_size;
+    u64 target_mtime;
+    u32 num_entries;
+    u32 num_extras;
+    u32 num_stages;
+    u32 padding;
+};
+
+struct CheckpointEntryHeader {
+    u64 hash_low;
+    u64 hash_high;
+    u64 exec_us;
+    u64 handicap;
+    u64 depth;
+    u32 exec_cksum;
+    u32 bitmap_size;
+    u32 flags;
+    u32 name_len;
+    u32 trace_mini_len;
+    u32 padding;
+};
+
+enum CheckpointEntryFlag : u32 {
+    CP_TRIM_DONE    = 1u << 0,
+    CP_WAS_FUZZED   = 1u << 1,
+    CP_HAS_NEW_COV  = 1u << 2,
+    CP_VAR_BEHAVIOR = 1u << 3
+};
+
+class CheckpointReader {
+public:
+    CheckpointReader(const std::vector<u8> &buf) 
+        : cur(buf.data()), end(buf.data() + buf.size()) {}
+
+    void Read(void *dst, std::size_t len) {
+        if (std::size_t(end - cur) < len) throw FileError("Truncated checkpoint");
+        std::memcpy(dst, cur, len);
+        cur += len;
+    }
+
+    template<class T>
+    void Read(T &dst) { Read(&dst, sizeof(T)); }
+
+    bool AtEnd() const { return cur == end; }
+
+private:
+    const u8 *cur;
+    const u8 *end;
+};
+
+template<class T>
+void AppendBytes(std::vector<u8> &buf, const T *src, std::size_t num) {
+    auto p = reinterpret_cast<const u8*>(src);
+    buf.insert(buf.end(), p, p + num * sizeof(T));
+}
+
+template<class T>
+void AppendValue(std::vector<u8> &buf, const T &src) { AppendBytes(buf, &src, 1); }
+
+} // anonymous namespace
+
+/* The checkpoint is built in memory and then written at once, through a
+   temporary file like det_progress. */
+
+void WriteCheckpoint(const std::string &path, const AFLCheckpoint &checkpoint) {
+    CheckpointHeader header{
+        CHECKPOINT_MAGIC,
+        CHECKPOINT_VERSION,
+        AFLOption::MAP_SIZE,
+        checkpoint.crash_mode,
+        checkpoint.target_size,
+        checkpoint.target_mtime,
+        (u32)checkpoint.entries.size(),
+        (u32)checkpoint.a_extras.size(),
+        (u32)checkpoint.stage_finds.size(),
+        0
+    };
+
+    std::vector<u8> buf;
+    AppendValue(buf, header);
+    AppendValue(buf, checkpoint.counters);
+    AppendValue(buf, checkpoint.rng);
+
+    for (const auto *map : { &checkpoint.virgin_bits, &checkpoint.virgin_tmout,
+                             &checkpoint.virgin_crash, &checkpoint.var_bytes }) {
+        if (map->size() != AFLOption::MAP_SIZE) 
+            throw FileError("Bitmap of a wrong size in the checkpoint");
+        AppendBytes(buf, map->data(), map->size());
+    }
+
+    if (checkpoint.stage_cycles.size() != checkpoint.stage_finds.size())
+        throw FileError("Stage stats of different sizes in the checkpoint");
+    AppendBytes(buf, checkpoint.stage_finds.data(), checkpoint.stage_finds.size());
+    AppendBytes(buf, checkpoint.stage_cycles.data(), checkpoint.stage_cycles.size());
+
+    for (const auto &extra : checkpoint.a_extras) {
+        AppendValue(buf, (u32)extra.data.size());
+        AppendValue(buf, extra.hit_cnt);
+        AppendBytes(buf, extra.data.data(), extra.data.size());
+    }
+
+    for (const auto &entry : checkpoint.entries) {
+        CheckpointEntryHeader entry_header{
+            entry.hash.low,
+            entry.hash.high,
+            entry.exec_us,
+            entry.handicap,
+            entry.depth,
+            entry.exec_cksum,
+            entry.bitmap_size,
+              (entry.trim_done ? CP_TRIM_DONE : 0u)
+            | (entry.was_fuzzed ? CP_WAS_FUZZED : 0u)
+            | (entry.has_new_cov ? CP_HAS_NEW_COV : 0u)
+            | (entry.var_behavior ? CP_VAR_BEHAVIOR : 0u),
+            (u32)entry.name.size(),
+            (u32)entry.trace_mini.size(),
+            0
+        };
+        AppendValue(buf, entry_header);
+        AppendBytes(buf, entry.name.data(), entry.name.size());
+        AppendBytes(buf, entry.trace_mini.data(), entry.trace_mini.size());
+    }
+
+    if (checkpoint.top_rated.size() != AFLOption::MAP_SIZE)
+        throw FileError("top_rated of a wrong size in the checkpoint");
+    AppendBytes(buf, checkpoint.top_rated.data(), checkpoint.top_rated.size());
+
+    std::string tmp = path + ".tmp";
+    int fd = Util::OpenFile(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    Util::WriteFile(fd, buf.data(), buf.size());
+    Util::CloseFile(fd);
+
+    if (rename(tmp.c_str(), path.c_str())) PFATAL("Unable to rename '%s'", tmp.c_str());
 }
 
+/* Returns nullptr if there is no checkpoint, or if it doesn't look sane. */
+
+std::unique_ptr<AFLCheckpoint> ReadCheckpoint(const std::string &path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return nullptr;
+
+    auto checkpoint = std::make_unique<AFLCheckpoint>();
+
+    try {
+        std::vector<u8> buf(st.st_size);
+        int fd = Util::OpenFile(path, O_RDONLY);
+        try {
+            Util::ReadFile(fd, buf.data(), buf.size());
+        } catch (const FileError &) {
+            Util::CloseFile(fd);
+            throw;
+        }
+        Util::CloseFile(fd);
+
+        CheckpointReader reader(buf);
+
+        CheckpointHeader header;
+        reader.Read(header);
+        if ( header.magic != CHECKPOINT_MAGIC
+          || header.version != CHECKPOINT_VERSION
+          || header.map_size != AFLOption::MAP_SIZE
+          || header.num_extras > AFLOption::MAX_AUTO_EXTRAS) {
+            return nullptr;
+        }
+
+        checkpoint->crash_mode = header.crash_mode;
+        checkpoint->target_size = header.target_size;
+        checkpoint->target_mtime = header.target_mtime;
+
+        reader.Read(checkpoint->counters);
+        reader.Read(checkpoint->rng);
+
+        for (auto *map : { &checkpoint->virgin_bits, &checkpoint->virgin_tmout,
+                           &checkpoint->virgin_crash, &checkpoint->var_bytes }) {
+            map->resize(AFLOption::MAP_SIZE);
+            reader.Read(map->data(), map->size());
+        }
+
+        for (auto *stats : { &checkpoint->stage_finds, &checkpoint->stage_cycles }) {
+            /* Don't allocate more than what the file can hold */
+            std::vector<u64> tmp;
+            for (u32 i=0; i < header.num_stages; i++) {
+                u64 val;
+                reader.Read(val);
+                tmp.emplace_back(val);
+            }
+            *stats = std::move(tmp);
+        }
+
+        checkpoint->a_extras.resize(header.num_extras);
+        for (auto &extra : checkpoint->a_extras) {
+            u32 len;
+            reader.Read(len);
+            reader.Read(extra.hit_cnt);
+            if (len > AFLOption::MAX_AUTO_EXTRA) return nullptr;
+            extra.data.resize(len);
+            reader.Read(extra.data.data(), len);
+        }
+
+        for (u32 i=0; i < header.num_entries; i++) {
+            CheckpointEntryHeader entry_header;
+            reader.Read(entry_header);
+            if ( entry_header.trace_mini_len != 0
+              && entry_header.trace_mini_len != AFLOption::MAP_SIZE / 8) {
+                return nullptr;
+            }
+
+            AFLCheckpoint::Entry entry;
+            entry.hash.low = entry_header.hash_low;
+            entry.hash.high = entry_header.hash_high;
+            entry.exec_us = entry_header.exec_us;
+            entry.handicap = entry_header.handicap;
+            entry.depth = entry_header.depth;
+            entry.exec_cksum = entry_header.exec_cksum;
+            entry.bitmap_size = entry_header.bitmap_size;
+            entry.trim_done = entry_header.flags & CP_TRIM_DONE;
+            entry.was_fuzzed = entry_header.flags & CP_WAS_FUZZED;
+            entry.has_new_cov = entry_header.flags & CP_HAS_NEW_COV;
+            entry.var_behavior = entry_header.flags & CP_VAR_BEHAVIOR;
+
+            if (entry_header.name_len > PATH_MAX) return nullptr;
+            entry.name.resize(entry_header.name_len);
+            reader.Read(entry.name.data(), entry_header.name_len);
+
+            entry.trace_mini.resize(entry_header.trace_mini_len);
+            reader.Read(entry.trace_mini.data(), entry_header.trace_mini_len);
+
+            checkpoint->entries.emplace_back(std::move(entry));
+        }
+
+        checkpoint->top_rated.resize(AFLOption::MAP_SIZE);
+        reader.Read(checkpoint->top_rated.data(), AFLOption::MAP_SIZE * sizeof(u32));
+        for (u32 winner : checkpoint->top_rated) {
+            if (winner != AFLCheckpoint::NO_ENTRY && winner >= header.num_entries) return nullptr;
+        }
+
+        if (!reader.AtEnd()) return nullptr;
+    } catch (const FileError &) {
+        return nullptr;
+    }
+
+    return checkpoint;
+}
+
+/* There is deliberately no cheaper test in front of this, such as skipping
+   traces whose checksum has been merged before: hashing the whole map costs
+   more than the scan in DoHasNewBits() (about 15 us against 8 us for
+   64 KiB), and a checksum collision would silently drop new coverage. */
+
 u8 HasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size, AFLState &state) {
     if constexpr (sizeof(size_t) == 8) {
-        return DoHasNewBits<u64>(trace_bits, virgin_map, map_size, state);
+        return DoHasNewBits<u64>(trace_bits, virgin_map, map_size, &state);
     } else {
-        return DoHasNewBits<u32>(trace_bits, virgin_map, map_size, state);
+        return DoHasNewBits<u32>(trace_bits, virgin_map, map_size, &state);
     }
 }
 
+u8 HasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size) {
+    if constexpr (sizeof(size_t) == 8) {
+        return DoHasNewBits<u64>(trace_bits, virgin_map, map_size, nullptr);
+    } else {
+        return DoHasNewBits<u32>(trace_bits, virgin_map, map_size, nullptr);
+    }
+}
+
+/* Every queue entry is indexed by a hash of its contents, so that a copy of
+   an existing entry can be turned away before it costs a calibration and a
+   share of every later cycle. With a 128-bit hash, two different inputs
+   colliding is not a practical concern. */
+
+Util::Hash128Value HashContent(const u8 *buf, u32 len) {
+    return Util::Hash128(buf, len, AFLOption::HASH_CONST);
+}
+
+bool IsKnownContent(const AFLState &state, const Util::Hash128Value &hash) {
+    return state.content_hashes.count(hash) != 0;
+}
+
+/* Register the contents of testcase, replacing what it was registered with
+   before (trimming changes the contents of an entry). */
+
+void MarkAsKnownContent(AFLState &state, AFLTestcase &testcase, const Util::Hash128Value &hash) {
+    if (testcase.content_hash) {
+        auto itr = state.content_hashes.find(*testcase.content_hash);
+        if (itr != state.content_hashes.end() && --itr->second == 0) {
+            state.content_hashes.erase(itr);
+        }
+    }
+
+    state.content_hashes[hash]++;
+    testcase.content_hash = hash;
+}
+
 static void MinimizeBits(
     std::bitset<AFLOption::MAP_SIZE> &trace_mini, const u8 *trace_bits
 ) {
@@ -227,7 +698,7 @@ void UpdateBitmapScoreWithRawTrace(
 ) {
 #ifdef BEHAVE_DETERMINISTIC // Just for ease of grep
 #else
-    u64 fav_factor = testcase.exec_us * testcase.input->GetLen();
+    u64 fav_factor = testcase.ExecUs() * testcase.input->GetLen();
 #endif
 
     for (u32 i=0; i<map_size; i++) {
@@ -236,9 +707,9 @@ void UpdateBitmapScoreWithRawTrace(
                 auto &top_testcase = state.top_rated[i].value().get();
 #ifdef BEHAVE_DETERMINISTIC
                 // FIXME: this probability may be too much. Need for opinions.
-                if (UR(2, -1)) continue; 
+                if (UR(2, state.rng)) continue; 
 #else
-                u64 factor = top_testcase.exec_us * top_testcase.input->GetLen();
+                u64 factor = top_testcase.ExecUs() * top_testcase.input->GetLen();
                 if (fav_factor > factor) continue;
 #endif
              
@@ -279,6 +750,17 @@ void UpdateBitmapScore(
     );
 }
 
+/* Be a bit more generous about timeouts when resuming sessions, or when
+   trying to calibrate already-added finds. */
+
+u32 CalibrationTimeout(const AFLState &state, bool from_queue) {
+    if (!from_queue || state.resuming_fuzz) {
+        return std::max(state.setting.exec_timelimit_ms + AFLOption::CAL_TMOUT_ADD,
+                        state.setting.exec_timelimit_ms * AFLOption::CAL_TMOUT_PERC / 100);
+    }
+    return state.setting.exec_timelimit_ms;
+}
+
 PUTExitReasonType CalibrateCaseWithFeedDestroyed(
     AFLTestcase &testcase,
     const u8 *buf,
@@ -297,13 +779,7 @@ PUTExitReasonType CalibrateCaseWithFeedDestroyed(
     s32 old_sm = state.stage_max;
     std::string old_sn = std::move(state.stage_name);
 
-    u32 use_tmout;
-    if (!from_queue || state.resuming_fuzz) {
-        use_tmout = std::max(state.setting.exec_timelimit_ms + AFLOption::CAL_TMOUT_ADD,
-                             state.setting.exec_timelimit_ms * AFLOption::CAL_TMOUT_PERC / 100);
-    } else {
-        use_tmout = state.setting.exec_timelimit_ms;
-    }
+    u32 use_tmout = CalibrationTimeout(state, from_queue);
 
     testcase.cal_failed++;
 
@@ -364,6 +840,7 @@ PUTExitReasonType CalibrateCaseWithFeedDestroyed(
                         for (u32 i=0; i < map_size; i++) {
                             if (!state.var_bytes[i] && first_trace[i] != trace_bits[i]) {
                                 state.var_bytes[i] = 1;
+                                state.var_byte_count++;
                                 state.stage_max = AFLOption::CAL_CYCLES_LONG;
                             }
                         }
@@ -387,12 +864,12 @@ PUTExitReasonType CalibrateCaseWithFeedDestroyed(
     state.total_cal_us += stop_us - start_us;
     state.total_cal_cycles += state.stage_max;
 
-    testcase.exec_us = (stop_us - start_us) / state.stage_max;
-    testcase.bitmap_size = inp_feed.CountNonZeroBytes();
-    testcase.handicap = handicap;
+    testcase.ExecUs() = (stop_us - start_us) / state.stage_max;
+    testcase.BitmapSize() = inp_feed.CountNonZeroBytes();
+    testcase.Handicap() = handicap;
     testcase.cal_failed = 0;
 
-    state.total_bitmap_size += testcase.bitmap_size;
+    state.total_bitmap_size += testcase.BitmapSize();
     state.total_bitmap_entries++;
 
     UpdateBitmapScore(testcase, state, inp_feed);
@@ -418,7 +895,6 @@ abort_calibration:
     /* Mark variable paths. */
 
     if (var_detected) {
-        state.var_byte_count = Util::CountBytes(&state.var_bytes[0], state.var_bytes.size());
         if (!testcase.var_behavior) {
             MarkAsVariable(state, testcase);
             state.queued_variable++;
@@ -434,8 +910,140 @@ abort_calibration:
     return exit_status.exit_reason;
 }
 
+/* Do to state what CalibrateCaseWithFeedDestroyed() does on the first
+   calibration of testcase, from the runs an AFLExecutorPool worker made.
+   Test cases must be replayed in queue order, so that virgin_bits,
+   var_bytes and top_rated end up the same as with serial calibration.
+   The worker may have run the case more often than needed; the extra runs
+   are not looked at, but they are counted in total_execs by the caller. */
+
+PUTExitReasonType ReplayCalibration(
+    AFLTestcase &testcase,
+    AFLState &state,
+    const AFLExecutorPool::Calibration &calibration,
+    u32 handicap
+) {
+    PUTExitReasonType exit_reason = state.crash_mode;
+
+    const auto &cksums = calibration.cksums;
+
+    /* Each trace is rebuilt in place from the first one and the bytes in
+       which it differs. */
+
+    using TraceDiff = std::vector<std::pair<u32, u8>>;
+    const u8 *first_trace = calibration.first_trace.data();
+    std::vector<u8> trace(calibration.first_trace);
+    const TraceDiff *applied = nullptr;
+    const u8 *trace_bits = trace.data();
+
+    testcase.cal_failed++;
+
+    u32 stage_max = state.fast_cal ? 3 : AFLOption::CAL_CYCLES;
+
+    u8 hnb = 0;
+    u8 new_bits = 0;
+    bool var_detected = false;
+    bool aborted = false;
+    for (u32 stage_cur=0; stage_cur < stage_max; stage_cur++) {
+
+        /* The worker only stops short when stop_soon is set. */
+
+        if (stage_cur >= cksums.size()) {
+            aborted = true;
+            break;
+        }
+
+        bool last_run = stage_cur + 1 == cksums.size();
+        if (last_run && calibration.exit_reason != state.crash_mode) {
+            exit_reason = calibration.exit_reason;
+            aborted = true;
+            break;
+        }
+
+        u32 cksum = cksums[stage_cur];
+
+        const TraceDiff *diff = nullptr;
+        if (cksum != cksums[0]) diff = &calibration.trace_diffs.at(cksum);
+
+        if (diff != applied) {
+            if (applied) {
+                for (const auto &[pos, val] : *applied) trace[pos] = first_trace[pos];
+            }
+            if (diff) {
+                for (const auto &[pos, val] : *diff) trace[pos] = val;
+            }
+            applied = diff;
+        }
+
+        if (!state.setting.dumb_mode && !stage_cur 
+         && !Util::CountBytes(trace_bits, AFLOption::MAP_SIZE)) {
+            exit_reason = PUTExitReasonType::FAULT_NOINST;
+            aborted = true;
+            break;
+        }
+
+        if (testcase.exec_cksum != cksum) {
+            hnb = HasNewBits(trace_bits, &state.virgin_bits[0], AFLOption::MAP_SIZE, state);
+
+            if (hnb > new_bits) new_bits = hnb;
+
+            if (testcase.exec_cksum) {
+                for (u32 i=0; i < AFLOption::MAP_SIZE; i++) {
+                    if (!state.var_bytes[i] && first_trace[i] != trace_bits[i]) {
+                        state.var_bytes[i] = 1;
+                        state.var_byte_count++;
+                        stage_max = AFLOption::CAL_CYCLES_LONG;
+                    }
+                }
+
+                var_detected = true;
+            } else {
+                testcase.exec_cksum = cksum;
+            }
+        }
+    }
+
+    if (!aborted) {
+        u64 elapsed_us = calibration.elapsed_us[stage_max - 1];
+
+        state.total_cal_us += elapsed_us;
+        state.total_cal_cycles += stage_max;
+
+        testcase.ExecUs() = elapsed_us / stage_max;
+        testcase.BitmapSize() = Util::CountBytes(trace_bits, AFLOption::MAP_SIZE);
+        testcase.Handicap() = handicap;
+        testcase.cal_failed = 0;
+
+        state.total_bitmap_size += testcase.BitmapSize();
+        state.total_bitmap_entries++;
+
+        UpdateBitmapScoreWithRawTrace(testcase, state, trace_bits, AFLOption::MAP_SIZE);
+
+        if ( !state.setting.dumb_mode 
+          && exit_reason == PUTExitReasonType::FAULT_NONE 
+          && new_bits == 0) {
+            exit_reason = PUTExitReasonType::FAULT_NOBITS;
+        }
+    }
+
+    if (new_bits == 2 && !testcase.has_new_cov) {
+        testcase.has_new_cov = true;
+        state.queued_with_cov++;
+    }
+
+    if (var_detected) {
+        if (!testcase.var_behavior) {
+            MarkAsVariable(state, testcase);
+            state.queued_variable++;
+        }
+    }
+
+    return exit_reason;
+}
+
 // Difference with AFL's add_to_queue: 
 // if buf is not nullptr, then this function saves "buf" in a file specified by "fn"
+// and registers it in state.content_hashes
 
 std::shared_ptr<AFLTestcase> AddToQueue(
     AFLState &state,
@@ -447,14 +1055,26 @@ std::shared_ptr<AFLTestcase> AddToQueue(
     auto input = state.input_set.CreateOnDisk(fn);
     if (buf) {
         input->OverwriteThenUnload(buf, len);
+
+        /* Keep the lineage in the corpus store, so that it doesn't have to be
+           parsed back from the file name. */
+
+        if (state.corpus_store) {
+            auto idx = state.corpus_store->Find(input->GetPath().filename().string());
+            if (idx) state.corpus_store->SetParent(*idx, state.current_entry);
+        }
     }
 
-    std::shared_ptr<AFLTestcase> testcase( new AFLTestcase(std::move(input)) );
+    std::shared_ptr<AFLTestcase> testcase( new AFLTestcase(std::move(input), state.queue_meta) );
+
+    /* Entries read from the input directory are hashed by ReadTestcases(). */
+
+    if (buf) MarkAsKnownContent(state, *testcase, HashContent(buf, len));
 
-    testcase->depth = state.cur_depth + 1;
+    testcase->Depth() = state.cur_depth + 1;
     testcase->passed_det = passed_det;
 
-    if (testcase->depth > state.max_depth) state.max_depth = testcase->depth;
+    if (testcase->Depth() > state.max_depth) state.max_depth = testcase->Depth();
 
     state.case_queue.emplace_back(testcase);
 
@@ -466,6 +1086,9 @@ std::shared_ptr<AFLTestcase> AddToQueue(
     if (state.queued_paths % 100 == 0) {
         printf("%u reached. time: %llu\n", state.queued_paths, state.last_path_time - state.start_time);
         if (state.queued_paths == 900) {
+            state.file_writer->flush();
+            if (state.corpus_store) state.corpus_store->Sync();
+            state.SaveCheckpoint();
             exit(0);
         }
     }
@@ -0,0 +1,160 @@
+#include "Algorithms/libFuzzer/Corpus.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fuzzuf::algorithm::libfuzzer {
+
+Corpus::Corpus(const fs::path &queue_dir)
+    : queue_dir(queue_dir),
+      smallest_element_per_feature(FEATURE_SET_SIZE, 0),
+      input_sizes_per_feature(FEATURE_SET_SIZE, 0) {}
+
+std::size_t Corpus::NumActiveUnits() const {
+    return std::count_if(
+        inputs.begin(), inputs.end(),
+        [](const auto &ii) { return !ii->data.empty(); }
+    );
+}
+
+std::size_t Corpus::MaxInputSize() const {
+    std::size_t max_size = 0;
+    for (const auto &ii : inputs) {
+        max_size = std::max(max_size, ii->data.size());
+    }
+    return max_size;
+}
+
+std::size_t Corpus::SizeInBytes() const {
+    std::size_t total = 0;
+    for (const auto &ii : inputs) {
+        total += ii->data.size();
+    }
+    return total;
+}
+
+std::string Corpus::ComputeName(const u8 *data, std::size_t size) {
+    u32 h1 = Util::Hash32(data, size, AFLOption::HASH_CONST);
+    u32 h2 = Util::Hash32(data, size, ~AFLOption::HASH_CONST);
+    return Util::StrPrintf("%08x%08x", h1, h2);
+}
+
+bool Corpus::HasUnit(const u8 *data, std::size_t size) const {
+    return names.count(ComputeName(data, size)) != 0;
+}
+
+bool Corpus::AddFeature(u32 feature, u32 new_size, bool shrink) {
+    assert(new_size);
+    feature %= FEATURE_SET_SIZE;
+
+    u32 old_size = input_sizes_per_feature[feature];
+    if (old_size != 0 && !(shrink && old_size > new_size)) return false;
+
+    if (old_size > 0) {
+        u32 old_idx = smallest_element_per_feature[feature];
+        auto &ii = *inputs[old_idx];
+        assert(ii.num_features > 0);
+        ii.num_features--;
+        if (ii.num_features == 0) DeleteInput(old_idx);
+    } else {
+        num_added_features++;
+    }
+    num_updated_features++;
+
+    smallest_element_per_feature[feature] = inputs.size();
+    input_sizes_per_feature[feature] = new_size;
+    return true;
+}
+
+InputInfo &Corpus::AddToCorpus(
+    const u8 *data,
+    std::size_t size,
+    std::size_t num_features,
+    std::vector<u32> &&feature_set
+) {
+    assert(size);
+
+    inputs.emplace_back(new InputInfo());
+    auto &ii = *inputs.back();
+    ii.data.assign(data, data + size);
+    ii.name = ComputeName(data, size);
+    ii.num_features = num_features;
+    ii.unique_feature_set = std::move(feature_set);
+
+    names.insert(ii.name);
+    WriteUnitFile(ii);
+
+    distribution_needs_update = true;
+    return ii;
+}
+
+void Corpus::Replace(InputInfo &ii, const u8 *data, std::size_t size) {
+    assert(ii.data.size() > size);
+
+    names.erase(names.find(ii.name));
+    DeleteUnitFile(ii);
+
+    ii.data.assign(data, data + size);
+    ii.name = ComputeName(data, size);
+    ii.reduced = true;
+
+    names.insert(ii.name);
+    WriteUnitFile(ii);
+
+    distribution_needs_update = true;
+}
+
+InputInfo &Corpus::ChooseUnitToMutate(fuzzuf::utils::random::prng &rng) {
+    UpdateCorpusDistribution();
+
+    u64 total = cumulative_weights.empty() ? 0 : cumulative_weights.back();
+    if (total == 0) {
+        // every input was deleted. this should not happen because
+        // the last added input is always the smallest one for some feature
+        return *inputs[rng.below(inputs.size())];
+    }
+
+    u64 r = ((u64(rng()) << 32) | rng()) % total;
+    auto it = std::upper_bound(cumulative_weights.begin(), cumulative_weights.end(), r);
+    return *inputs[it - cumulative_weights.begin()];
+}
+
+void Corpus::DeleteInput(std::size_t idx) {
+    auto &ii = *inputs[idx];
+    names.erase(names.find(ii.name));
+    DeleteUnitFile(ii);
+    std::vector<u8>().swap(ii.data);
+    distribution_needs_update = true;
+}
+
+void Corpus::WriteUnitFile(const InputInfo &ii) {
+    if (queue_dir.empty()) return;
+
+    int fd = Util::OpenFile((queue_dir / ii.name).string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    Util::WriteFile(fd, ii.data.data(), ii.data.size());
+    Util::CloseFile(fd);
+}
+
+void Corpus::DeleteUnitFile(const InputInfo &ii) {
+    if (queue_dir.empty()) return;
+
+    // another input with the same content may still refer to the file
+    if (names.count(ii.name)) return;
+    unlink((queue_dir / ii.name).c_str());
+}
+
+void Corpus::UpdateCorpusDistribution() {
+    if (!distribution_needs_update) return;
+    distribution_needs_update = false;
+
+    cumulative_weights.resize(inputs.size());
+    u64 sum = 0;
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+        if (inputs[i]->num_features && !inputs[i]->data.empty()) sum += i + 1;
+        cumulative_weights[i] = sum;
+    }
+}
+
+} // namespace fuzzuf::algorithm::libfuzzer
@@ -1,4 +1,6 @@
+#include <optional>
 #include <Utils/AFLDictParser.hpp>
+#include <Utils/MappedDictionary.hpp>
 #include <Algorithms/libFuzzer/Dictionary.hpp>
 
 namespace fuzzuf::algorithm::libfuzzer::dictionary {
@@ -6,6 +8,7 @@ namespace fuzzuf::algorithm::libfuzzer::dictionary {
 /**
  * @fn
  * filenameで指定されたAFL辞書をdestにロードする
+ * filenameがtools/dict2mpで変換済みの辞書の場合はパースせずにロードする
  * destに最初から要素がある場合、ロードした内容は既にある要素の後ろにinsertされる
  * @brief filenameで指定されたAFL辞書をdestにロードする
  * @param filename ファイル名
@@ -18,12 +21,16 @@ namespace fuzzuf::algorithm::libfuzzer::dictionary {
     bool strict,
     const std::function< void( std::string&& ) > &eout
   ) {
-    utils::dictionary::load_afl_dictionary( filename_, dest, strict, eout );
+    if( auto mapped = utils::dictionary::mapped_dictionary::try_open( filename_ ) )
+      utils::dictionary::load_mapped_dictionary( *mapped, dest, eout );
+    else
+      utils::dictionary::load_afl_dictionary( filename_, dest, strict, eout );
   }
 
 /**
  * @fn
  * filenameで指定されたAFL辞書をdestにロードする
+ * filenameがtools/dict2mpで変換済みの辞書の場合はパースせずにロードする
  * destに最初から要素がある場合、ロードした内容は既にある要素の後ろにinsertされる
  * @brief filenameで指定されたAFL辞書をdestにロードする
  * @param filename ファイル名
@@ -36,8 +43,38 @@ namespace fuzzuf::algorithm::libfuzzer::dictionary {
     bool strict,
     const std::function< void( std::string&& ) > &eout
   ) {
-    utils::dictionary::load_afl_dictionary( filename_, dest, strict, eout );
+    if( auto mapped = utils::dictionary::mapped_dictionary::try_open( filename_ ) )
+      utils::dictionary::load_mapped_dictionary( *mapped, dest, eout );
+    else
+      utils::dictionary::load_afl_dictionary( filename_, dest, strict, eout );
   }
 
-}
+/**
+ * @fn
+ * filenameで指定された変換済みの辞書をmmapし、その要素をdestにロードする
+ * 要素のバイト列はコピーされず、mmapした領域を指す
+ * destに最初から要素がある場合、ロードした内容は既にある要素の後ろにinsertされる
+ * @brief filenameで指定された変換済みの辞書をdestにロードする
+ * @param filename ファイル名
+ * @param dest ロードした内容の出力先
+ * @param eout ファイルのロードに失敗した場合にエラーメッセージが文字列で渡ってくるコールバック
+ */
+  void load(
+    const std::string &filename_,
+    mapped_dictionary_t &dest,
+    bool,
+    const std::function< void( std::string&& ) > &eout
+  ) {
+    std::optional< utils::dictionary::mapped_dictionary > mapped;
+    try {
+      mapped.emplace( filename_ );
+    }
+    catch( const exceptions::invalid_file& ) {
+      eout( filename_ + " is not a precompiled dictionary." );
+      throw;
+    }
+    dest.reserve( dest.size() + mapped->size() );
+    utils::dictionary::load_mapped_dictionary( *mapped, dest, eout );
+  }
 
+}
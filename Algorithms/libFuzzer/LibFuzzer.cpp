@@ -0,0 +1,330 @@
+#include "Algorithms/libFuzzer/LibFuzzer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Options.hpp"
+#include "Utils/Common.hpp"
+#include "Feedback/ExitStatusFeedback.hpp"
+#include "Algorithms/AFL/AFLFuzzer.hpp"
+#include "Algorithms/AFL/AFLMacro.hpp"
+#include "Algorithms/libFuzzer/Dictionary.hpp"
+
+namespace fuzzuf::algorithm::libfuzzer {
+
+LibFuzzer::LibFuzzer(
+    const std::vector<std::string> &argv,
+    const std::string &in_dir,
+    const std::string &out_dir,
+    u32 exec_timelimit_ms,
+    u32 exec_memlimit,
+    bool forksrv,
+    const std::vector<std::string> &dict_paths,
+    u32 max_len
+) :
+    setting( argv,
+             in_dir,
+             out_dir,
+             exec_timelimit_ms,
+             exec_memlimit,
+             forksrv,
+             dict_paths,
+             max_len,
+             NativeLinuxExecutor::CPUID_BIND_WHICHEVER ),
+    rng( fuzzuf::utils::random::prng::create() ),
+    md( rng ),
+    corpus( setting.out_dir / "queue" ),
+    max_mutation_len( 0 ),
+    covered_edges( AFLOption::MAP_SIZE, 0 ),
+    start_time( Util::GetCurTimeMs() )
+{
+    // Executor needs the directory specified by "out_dir" to be already set up
+    Util::CreateDir(setting.out_dir.string());
+    Util::CreateDir((setting.out_dir / "queue").string());
+    Util::CreateDir((setting.out_dir / "crashes").string());
+    Util::CreateDir((setting.out_dir / "hangs").string());
+
+    executor.reset(
+        new NativeLinuxExecutor(
+            setting.argv,
+            setting.exec_timelimit_ms,
+            setting.exec_memlimit,
+            setting.forksrv,
+            setting.out_dir / AFLOption::DEFAULT_OUTFILE,
+            true,                 // need_afl_cov
+            false,                // need_bb_cov
+            setting.cpuid_to_bind
+        )
+    );
+
+    LoadDictionaries();
+    ReadAndExecuteSeedCorpus();
+}
+
+LibFuzzer::~LibFuzzer() {}
+
+void LibFuzzer::OneLoop(void) {
+    if (stop_soon) return;
+    MutateAndTestOne();
+}
+
+// do not call non aync-signal-safe functions inside because this function can be called during signal handling
+void LibFuzzer::ReceiveStopSignal(void) {
+    stop_soon = 1;
+    executor->ReceiveStopSignal();
+}
+
+void LibFuzzer::LoadDictionaries() {
+    auto &dict = md.GetManualDictionary();
+    for (const auto &path : setting.dict_paths) {
+        dictionary::load(path, dict, true,
+            [](std::string &&msg) { WARNF("%s", msg.c_str()); });
+    }
+    if (!dict.empty()) {
+        OKF("Loaded %zu dictionary entries.", dict.size());
+    }
+}
+
+void LibFuzzer::ReadAndExecuteSeedCorpus() {
+    std::vector<std::vector<u8>> seeds;
+
+    struct dirent **nl;
+    int nl_cnt = Util::ScanDirAlpha(setting.in_dir.string(), &nl);
+    if (nl_cnt < 0) {
+        PFATAL("Unable to open '%s'", setting.in_dir.c_str());
+    }
+
+    for (int i=0; i < nl_cnt; i++) {
+        struct stat st;
+        std::string fn = Util::StrPrintf("%s/%s", setting.in_dir.c_str(), nl[i]->d_name);
+        free(nl[i]); /* not tracked */
+
+        if (lstat(fn.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || !st.st_size) continue;
+
+        u32 len = std::min<u64>(st.st_size, AFLOption::MAX_FILE);
+        std::vector<u8> buf(len);
+        int fd = Util::OpenFile(fn, O_RDONLY);
+        Util::ReadFile(fd, buf.data(), len);
+        Util::CloseFile(fd);
+        seeds.emplace_back(std::move(buf));
+    }
+    free(nl); /* not tracked */
+
+    std::size_t max_seed_size = 0;
+    std::size_t total_seed_size = 0;
+    for (const auto &seed : seeds) {
+        max_seed_size = std::max(max_seed_size, seed.size());
+        total_seed_size += seed.size();
+    }
+
+    if (setting.max_len) {
+        max_mutation_len = std::min(setting.max_len, AFLOption::MAX_FILE);
+    } else {
+        max_mutation_len = std::max<u32>(LibFuzzerOption::DEFAULT_MAX_LEN, max_seed_size);
+        SAYF("INFO: -max_len is not provided; using %u\n", max_mutation_len);
+    }
+    current_unit.resize(max_mutation_len);
+
+    if (seeds.empty()) {
+        SAYF("INFO: A corpus is not provided, starting from an empty corpus\n");
+        const u8 newline = '\n';
+        RunOne(&newline, 1, nullptr, false, nullptr);
+    } else {
+        SAYF("INFO: seed corpus: files: %zu min: %zub max: %zub total: %zub\n",
+             seeds.size(),
+             std::min_element(seeds.begin(), seeds.end(),
+                 [](const auto &l, const auto &r) { return l.size() < r.size(); })->size(),
+             max_seed_size, total_seed_size);
+
+        // shuffle, then prefer small inputs as libFuzzer does by default
+        std::shuffle(seeds.begin(), seeds.end(), rng);
+        std::stable_sort(seeds.begin(), seeds.end(),
+            [](const auto &l, const auto &r) { return l.size() < r.size(); });
+
+        for (auto &seed : seeds) {
+            if (seed.size() > max_mutation_len) seed.resize(max_mutation_len);
+            RunOne(seed.data(), seed.size(), nullptr, false, nullptr);
+            if (stop_soon) return;
+        }
+    }
+
+    PrintStats("INITED");
+
+    if (corpus.empty()) {
+        FATAL("No interesting inputs were found. Is the code instrumented for coverage?");
+    }
+}
+
+void LibFuzzer::MutateAndTestOne() {
+    md.StartMutationSequence();
+
+    auto &ii = corpus.ChooseUnitToMutate(rng);
+    u32 size = std::min<std::size_t>(ii.data.size(), max_mutation_len);
+    std::memcpy(current_unit.data(), ii.data.data(), size);
+
+    for (u32 i = 0; i < setting.mutate_depth; i++) {
+        if (stop_soon) break;
+
+        const auto &other = corpus.ChooseUnitToMutate(rng);
+        md.SetCrossOverWith(other.data.data(), other.data.size());
+
+        size = md.Mutate(current_unit.data(), size, max_mutation_len);
+        ii.num_executed_mutations++;
+
+        bool found_unique_features = false;
+        auto res = RunOne(current_unit.data(), size, &ii, false, &found_unique_features);
+        if (res != RunResult::NONE) {
+            ii.num_successful_mutations++;
+            md.RecordSuccessfulMutationSequence();
+            PrintStatusForNewUnit(size, res == RunResult::REDUCE ? "REDUCE" : "NEW   ");
+            // we will mutate this input more in the next rounds
+            break;
+        }
+    }
+}
+
+template<class Func>
+void LibFuzzer::CollectFeatures(const InplaceMemoryFeedback &inp_feed, Func &&func) {
+    inp_feed.ShowMemoryToFunc(
+        [this, &func](const u8 *trace_bits, u32 map_size) {
+            for (u32 i = 0; i < map_size; i += sizeof(u64)) {
+                u64 word;
+                std::memcpy(&word, trace_bits + i, sizeof(word));
+                if (likely(!word)) continue;
+
+                for (u32 j = i; j < i + sizeof(u64); j++) {
+                    u8 count_class = trace_bits[j];
+                    if (!count_class) continue;
+
+                    if (!covered_edges[j]) {
+                        covered_edges[j] = 1;
+                        num_covered_edges++;
+                    }
+
+                    // the counts are already classified into powers of 2
+                    func(j * 8 + __builtin_ctz(count_class));
+                }
+            }
+        }
+    );
+}
+
+LibFuzzer::RunResult LibFuzzer::RunOne(
+    const u8 *data,
+    u32 size,
+    InputInfo *ii,
+    bool force_add_to_corpus,
+    bool *found_unique_features
+) {
+    if (!size) return RunResult::NONE;
+
+    executor->Run(data, size);
+    total_number_of_runs++;
+
+    auto inp_feed = executor->GetAFLFeedback();
+    auto exit_status = executor->GetExitStatusFeedback();
+    inp_feed.ModifyMemoryWithFunc(
+        [](u8 *trace_bits, u32 map_size) {
+            AFLFuzzer::ClassifyCounts<u64>((u64 *)trace_bits, map_size);
+        }
+    );
+
+    if (exit_status.exit_reason == PUTExitReasonType::FAULT_CRASH
+     || exit_status.exit_reason == PUTExitReasonType::FAULT_TMOUT) {
+        // unlike libFuzzer, we keep fuzzing and save only the ones with
+        // a trace different from the ones saved before
+        u64 key = (u64(exit_status.exit_reason) << 32) | inp_feed.CalcCksum32();
+        if (seen_artifacts.insert(key).second) {
+            if (exit_status.exit_reason == PUTExitReasonType::FAULT_CRASH) {
+                SAYF("==%d== ERROR: libFuzzer: deadly signal\n", getpid());
+                SaveArtifact("crashes", "crash-", data, size);
+            } else {
+                SAYF("==%d== ERROR: libFuzzer: timeout after %u ms\n", getpid(),
+                     setting.exec_timelimit_ms);
+                SaveArtifact("hangs", "timeout-", data, size);
+            }
+        }
+        return RunResult::NONE;
+    }
+
+    unique_feature_set_tmp.clear();
+    std::size_t found_unique_features_of_ii = 0;
+    std::size_t num_updates_before = corpus.NumFeatureUpdates();
+    CollectFeatures(inp_feed,
+        [&](u32 feature) {
+            if (corpus.AddFeature(feature, size, setting.shrink)) {
+                unique_feature_set_tmp.emplace_back(feature);
+            }
+            if (setting.reduce_inputs && ii
+             && std::binary_search(ii->unique_feature_set.begin(),
+                                   ii->unique_feature_set.end(), feature)) {
+                found_unique_features_of_ii++;
+            }
+        }
+    );
+    if (found_unique_features) *found_unique_features = found_unique_features_of_ii;
+
+    if (!(total_number_of_runs & (total_number_of_runs - 1))
+     && Util::GetCurTimeMs() - start_time >= 2000) {
+        PrintStats("pulse ");
+    }
+
+    std::size_t num_new_features = corpus.NumFeatureUpdates() - num_updates_before;
+    if (num_new_features || force_add_to_corpus) {
+        corpus.AddToCorpus(data, size, num_new_features, std::move(unique_feature_set_tmp));
+        unique_feature_set_tmp = std::vector<u32>();
+        return RunResult::NEW;
+    }
+
+    if (ii && found_unique_features_of_ii
+     && found_unique_features_of_ii == ii->unique_feature_set.size()
+     && ii->data.size() > size) {
+        corpus.Replace(*ii, data, size);
+        return RunResult::REDUCE;
+    }
+
+    return RunResult::NONE;
+}
+
+void LibFuzzer::SaveArtifact(const char *dir, const char *prefix, const u8 *data, u32 size) {
+    auto path = setting.out_dir / dir / (prefix + Corpus::ComputeName(data, size));
+    int fd = Util::OpenFile(path.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    Util::WriteFile(fd, data, size);
+    Util::CloseFile(fd);
+    SAYF("artifact_prefix='%s/'; Test unit written to %s\n",
+         (setting.out_dir / dir).c_str(), path.c_str());
+}
+
+void LibFuzzer::PrintStats(const char *where, const char *end) {
+    u64 elapsed_sec = (Util::GetCurTimeMs() - start_time) / 1000;
+    u64 exec_per_sec = elapsed_sec ? total_number_of_runs / elapsed_sec : 0;
+
+    SAYF("#%llu\t%s", total_number_of_runs, where);
+    if (num_covered_edges) SAYF(" cov: %zu", num_covered_edges);
+    if (corpus.NumFeatures()) SAYF(" ft: %zu", corpus.NumFeatures());
+    if (!corpus.empty()) {
+        SAYF(" corp: %zu", corpus.NumActiveUnits());
+        std::size_t n = corpus.SizeInBytes();
+        if (n < (1 << 14)) SAYF("/%zub", n);
+        else if (n < (1 << 24)) SAYF("/%zuKb", n >> 10);
+        else SAYF("/%zuMb", n >> 20);
+    }
+    SAYF(" exec/s: %llu", exec_per_sec);
+
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage)) SAYF(" rss: %ldMb", usage.ru_maxrss >> 10);
+    SAYF("%s", end);
+}
+
+void LibFuzzer::PrintStatusForNewUnit(u32 size, const char *text) {
+    PrintStats(text, "");
+    SAYF(" L: %u/%zu MS: %zu %s\n",
+         size, corpus.MaxInputSize(),
+         md.GetMutationSequenceLength(), md.DescribeMutationSequence().c_str());
+}
+
+} // namespace fuzzuf::algorithm::libfuzzer
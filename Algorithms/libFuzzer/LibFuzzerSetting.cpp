@@ -0,0 +1,30 @@
+#include <vector>
+#include <string>
+#include "Algorithms/libFuzzer/LibFuzzerSetting.hpp"
+
+namespace fuzzuf::algorithm::libfuzzer {
+
+LibFuzzerSetting::LibFuzzerSetting(
+    const std::vector<std::string> &argv,
+    const std::string &in_dir,
+    const std::string &out_dir,
+    u32 exec_timelimit_ms,
+    u64 exec_memlimit,
+    bool forksrv,
+    const std::vector<std::string> &dict_paths,
+    u32 max_len,
+    int cpuid_to_bind
+) :
+    argv( argv ),
+    in_dir( in_dir ),
+    out_dir( out_dir ),
+    exec_timelimit_ms( exec_timelimit_ms ),
+    exec_memlimit( exec_memlimit ),
+    forksrv( forksrv ),
+    dict_paths( dict_paths ),
+    max_len( max_len ),
+    cpuid_to_bind( cpuid_to_bind ) {}
+
+LibFuzzerSetting::~LibFuzzerSetting() {}
+
+} // namespace fuzzuf::algorithm::libfuzzer
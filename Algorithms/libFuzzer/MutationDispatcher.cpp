@@ -0,0 +1,401 @@
+#include "Algorithms/libFuzzer/MutationDispatcher.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "Options.hpp"
+
+namespace fuzzuf::algorithm::libfuzzer {
+
+namespace {
+
+template<typename T>
+T Bswap(T v) {
+    if constexpr (sizeof(T) == 1) return v;
+    else if constexpr (sizeof(T) == 2) return __builtin_bswap16(v);
+    else if constexpr (sizeof(T) == 4) return __builtin_bswap32(v);
+    else return __builtin_bswap64(v);
+}
+
+u64 Rand64(fuzzuf::utils::random::prng &rng, u64 limit) {
+    u64 v = (u64(rng()) << 32) | rng();
+    return v % limit;
+}
+
+template<typename T>
+std::size_t ChangeBinaryIntegerImpl(
+    fuzzuf::utils::random::prng &rng,
+    u8 *data,
+    std::size_t size
+) {
+    if (size < sizeof(T)) return 0;
+
+    std::size_t off = rng.below(size - sizeof(T) + 1);
+    T val;
+    if (off < 64 && !rng.below(4)) {
+        val = T(size);
+        if (rng() & 1) val = Bswap(val);
+    } else {
+        std::memcpy(&val, data + off, sizeof(val));
+        T add = T(rng.below(21));
+        add -= 10;
+        if (rng() & 1) {
+            // add assuming the other endianness
+            val = Bswap(T(Bswap(val) + add));
+        } else {
+            val = val + add;
+        }
+        if (add == 0 || (rng() & 1)) val = -val;
+    }
+    std::memcpy(data + off, &val, sizeof(val));
+    return size;
+}
+
+} // namespace
+
+const char *MutationDispatcher::GetMutatorName(MutatorType type) {
+    switch (type) {
+    case ERASE_BYTES:           return "EraseBytes";
+    case INSERT_BYTE:           return "InsertByte";
+    case INSERT_REPEATED_BYTES: return "InsertRepeatedBytes";
+    case CHANGE_BYTE:           return "ChangeByte";
+    case CHANGE_BIT:            return "ChangeBit";
+    case SHUFFLE_BYTES:         return "ShuffleBytes";
+    case CHANGE_ASCII_INTEGER:  return "ChangeASCIIInt";
+    case CHANGE_BINARY_INTEGER: return "ChangeBinInt";
+    case COPY_PART:             return "CopyPart";
+    case CROSS_OVER:            return "CrossOver";
+    case MANUAL_DICT:           return "ManualDict";
+    case PERSISTENT_AUTO_DICT:  return "PersAutoDict";
+    default:                    return "Unknown";
+    }
+}
+
+MutationDispatcher::MutationDispatcher(fuzzuf::utils::random::prng &rng)
+    : rng(rng) {}
+
+void MutationDispatcher::SetCrossOverWith(const u8 *data, std::size_t size) {
+    cross_over_with = data;
+    cross_over_with_size = size;
+}
+
+void MutationDispatcher::StartMutationSequence() {
+    current_sequence.clear();
+    current_dict_sequence.clear();
+}
+
+void MutationDispatcher::RecordSuccessfulMutationSequence() {
+    for (const auto &ref : current_dict_sequence) {
+        auto &entry = ref.persistent ? persistent_auto_dict[ref.idx] : manual_dict[ref.idx];
+        entry.increment_success_count();
+
+        if (ref.persistent) continue;
+
+        const auto &word = entry.get();
+        bool contained = std::any_of(
+            persistent_auto_dict.begin(), persistent_auto_dict.end(),
+            [&word](const auto &e) { return e.get() == word; }
+        );
+        if (!contained && persistent_auto_dict.size() < LibFuzzerOption::MAX_AUTO_DICT) {
+            persistent_auto_dict.push_back(entry);
+        }
+    }
+}
+
+std::string MutationDispatcher::DescribeMutationSequence() const {
+    std::string desc;
+    for (auto type : current_sequence) {
+        desc += GetMutatorName(type);
+        desc += '-';
+    }
+    return desc;
+}
+
+std::size_t MutationDispatcher::Mutate(u8 *data, std::size_t size, std::size_t max_size) {
+    // Some mutations may fail (e.g. can't insert more bytes if size == max_size),
+    // in which case try another one.
+    for (u32 iter = 0; iter < LibFuzzerOption::MUTATE_TRIES; iter++) {
+        auto type = MutatorType(Rand(NUM_MUTATORS));
+        std::size_t new_size = ApplyMutator(type, data, size, max_size);
+        if (new_size && new_size <= max_size) {
+            current_sequence.emplace_back(type);
+            return new_size;
+        }
+    }
+
+    // fallback, should not happen frequently
+    *data = ' ';
+    return 1;
+}
+
+std::size_t MutationDispatcher::ApplyMutator(
+    MutatorType type,
+    u8 *data,
+    std::size_t size,
+    std::size_t max_size
+) {
+    switch (type) {
+    case ERASE_BYTES:           return EraseBytes(data, size, max_size);
+    case INSERT_BYTE:           return InsertByte(data, size, max_size);
+    case INSERT_REPEATED_BYTES: return InsertRepeatedBytes(data, size, max_size);
+    case CHANGE_BYTE:           return ChangeByte(data, size, max_size);
+    case CHANGE_BIT:            return ChangeBit(data, size, max_size);
+    case SHUFFLE_BYTES:         return ShuffleBytes(data, size, max_size);
+    case CHANGE_ASCII_INTEGER:  return ChangeASCIIInteger(data, size, max_size);
+    case CHANGE_BINARY_INTEGER: return ChangeBinaryInteger(data, size, max_size);
+    case COPY_PART:             return CopyPart(data, size, max_size);
+    case CROSS_OVER:            return CrossOver(data, size, max_size);
+    case MANUAL_DICT:           return AddWordFromDictionary(false, data, size, max_size);
+    case PERSISTENT_AUTO_DICT:  return AddWordFromDictionary(true, data, size, max_size);
+    default:                    return 0;
+    }
+}
+
+u8 MutationDispatcher::RandCh() {
+    if (RandBool()) return u8(Rand(256));
+    static const char special[] = "!*'();:@&=+$,/?%#[]012Az-`~.\xff\x00";
+    return u8(special[Rand(sizeof(special) - 1)]);
+}
+
+std::size_t MutationDispatcher::EraseBytes(u8 *data, std::size_t size, std::size_t) {
+    if (size <= 1) return 0;
+    std::size_t n = Rand(size / 2) + 1;
+    std::size_t idx = Rand(size - n + 1);
+    std::memmove(data + idx, data + idx + n, size - idx - n);
+    return size - n;
+}
+
+std::size_t MutationDispatcher::InsertByte(u8 *data, std::size_t size, std::size_t max_size) {
+    if (size >= max_size) return 0;
+    std::size_t idx = Rand(size + 1);
+    std::memmove(data + idx + 1, data + idx, size - idx);
+    data[idx] = RandCh();
+    return size + 1;
+}
+
+std::size_t MutationDispatcher::InsertRepeatedBytes(u8 *data, std::size_t size, std::size_t max_size) {
+    const std::size_t min_bytes_to_insert = 3;
+    if (size + min_bytes_to_insert >= max_size) return 0;
+
+    std::size_t max_bytes_to_insert = std::min<std::size_t>(max_size - size, 128);
+    std::size_t n = Rand(max_bytes_to_insert - min_bytes_to_insert + 1) + min_bytes_to_insert;
+    std::size_t idx = Rand(size + 1);
+    std::memmove(data + idx + n, data + idx, size - idx);
+
+    // give preference to 0x00 and 0xff
+    u8 byte = RandBool() ? u8(Rand(256)) : (RandBool() ? 0 : 255);
+    std::memset(data + idx, byte, n);
+    return size + n;
+}
+
+std::size_t MutationDispatcher::ChangeByte(u8 *data, std::size_t size, std::size_t max_size) {
+    if (size > max_size || size == 0) return 0;
+    data[Rand(size)] = RandCh();
+    return size;
+}
+
+std::size_t MutationDispatcher::ChangeBit(u8 *data, std::size_t size, std::size_t max_size) {
+    if (size > max_size || size == 0) return 0;
+    data[Rand(size)] ^= 1 << Rand(8);
+    return size;
+}
+
+std::size_t MutationDispatcher::ShuffleBytes(u8 *data, std::size_t size, std::size_t max_size) {
+    if (size > max_size || size == 0) return 0;
+    std::size_t shuffle_amount = Rand(std::min<std::size_t>(size, 8)) + 1;
+    std::size_t shuffle_start = Rand(size - shuffle_amount + 1);
+    std::shuffle(data + shuffle_start, data + shuffle_start + shuffle_amount, rng);
+    return size;
+}
+
+std::size_t MutationDispatcher::ChangeASCIIInteger(u8 *data, std::size_t size, std::size_t max_size) {
+    if (size > max_size || size == 0) return 0;
+
+    std::size_t b = Rand(size);
+    while (b < size && !std::isdigit(data[b])) b++;
+    if (b == size) return 0;
+    std::size_t e = b;
+    while (e < size && std::isdigit(data[e])) e++;
+
+    // the digits are not null-terminated, so we parse them by ourselves
+    u64 val = data[b] - '0';
+    for (std::size_t i = b + 1; i < e; i++) {
+        val = val * 10 + data[i] - '0';
+    }
+
+    switch (Rand(5)) {
+    case 0: val++; break;
+    case 1: val--; break;
+    case 2: val /= 2; break;
+    case 3: val *= 2; break;
+    case 4: {
+        u64 square = val * val;
+        val = square ? Rand64(rng, square) : 0;
+        break;
+    }
+    }
+
+    // just replace the digits, without changing the size
+    for (std::size_t i = b; i < e; i++) {
+        std::size_t idx = e + b - i - 1;
+        data[idx] = (val % 10) + '0';
+        val /= 10;
+    }
+    return size;
+}
+
+std::size_t MutationDispatcher::ChangeBinaryInteger(u8 *data, std::size_t size, std::size_t max_size) {
+    if (size > max_size) return 0;
+    switch (Rand(4)) {
+    case 0:  return ChangeBinaryIntegerImpl<u8>(rng, data, size);
+    case 1:  return ChangeBinaryIntegerImpl<u16>(rng, data, size);
+    case 2:  return ChangeBinaryIntegerImpl<u32>(rng, data, size);
+    default: return ChangeBinaryIntegerImpl<u64>(rng, data, size);
+    }
+}
+
+std::size_t MutationDispatcher::CopyPartOf(
+    const u8 *from,
+    std::size_t from_size,
+    u8 *to,
+    std::size_t to_size
+) {
+    if (from_size == 0 || to_size == 0) return 0;
+
+    std::size_t to_beg = Rand(to_size);
+    std::size_t copy_size = Rand(to_size - to_beg) + 1;
+    copy_size = std::min(copy_size, from_size);
+    std::size_t from_beg = Rand(from_size - copy_size + 1);
+    std::memmove(to + to_beg, from + from_beg, copy_size);
+    return to_size;
+}
+
+std::size_t MutationDispatcher::InsertPartOf(
+    const u8 *from,
+    std::size_t from_size,
+    u8 *to,
+    std::size_t to_size,
+    std::size_t max_to_size
+) {
+    if (to_size >= max_to_size || from_size == 0) return 0;
+
+    std::size_t available_space = max_to_size - to_size;
+    std::size_t max_copy_size = std::min(available_space, from_size);
+    std::size_t copy_size = Rand(max_copy_size) + 1;
+    std::size_t from_beg = Rand(from_size - copy_size + 1);
+    std::size_t to_insert_pos = Rand(to_size + 1);
+    std::size_t tail_size = to_size - to_insert_pos;
+
+    if (to == from) {
+        tmp.assign(from + from_beg, from + from_beg + copy_size);
+        std::memmove(to + to_insert_pos + copy_size, to + to_insert_pos, tail_size);
+        std::memmove(to + to_insert_pos, tmp.data(), copy_size);
+    } else {
+        std::memmove(to + to_insert_pos + copy_size, to + to_insert_pos, tail_size);
+        std::memmove(to + to_insert_pos, from + from_beg, copy_size);
+    }
+    return to_size + copy_size;
+}
+
+std::size_t MutationDispatcher::CopyPart(u8 *data, std::size_t size, std::size_t max_size) {
+    if (size > max_size || size == 0) return 0;
+    if (size == max_size || RandBool()) {
+        return CopyPartOf(data, size, data, size);
+    } else {
+        return InsertPartOf(data, size, data, size, max_size);
+    }
+}
+
+std::size_t MutationDispatcher::CrossOver(u8 *data, std::size_t size, std::size_t max_size) {
+    if (size > max_size || !cross_over_with || cross_over_with_size == 0) return 0;
+
+    std::size_t new_size = 0;
+    switch (Rand(3)) {
+    case 0: {
+        // take parts of the two inputs alternately
+        tmp.resize(max_size);
+        std::size_t out_pos = 0;
+        std::size_t max_out_size = Rand(max_size) + 1;
+        std::size_t pos[2] = {0, 0};
+        const u8 *in_data[2] = {data, cross_over_with};
+        std::size_t in_size[2] = {size, cross_over_with_size};
+        int cur = 0;
+        while (out_pos < max_out_size && (pos[0] < in_size[0] || pos[1] < in_size[1])) {
+            if (pos[cur] < in_size[cur]) {
+                std::size_t max_extra_size = std::min(max_out_size - out_pos, in_size[cur] - pos[cur]);
+                std::size_t extra_size = Rand(max_extra_size) + 1;
+                std::memcpy(tmp.data() + out_pos, in_data[cur] + pos[cur], extra_size);
+                out_pos += extra_size;
+                pos[cur] += extra_size;
+            }
+            cur ^= 1;
+        }
+        std::memcpy(data, tmp.data(), out_pos);
+        new_size = out_pos;
+        break;
+    }
+    case 1:
+        new_size = InsertPartOf(cross_over_with, cross_over_with_size, data, size, max_size);
+        if (!new_size) new_size = CopyPartOf(cross_over_with, cross_over_with_size, data, size);
+        break;
+    case 2:
+        new_size = CopyPartOf(cross_over_with, cross_over_with_size, data, size);
+        break;
+    }
+    return new_size;
+}
+
+std::size_t MutationDispatcher::ChooseDictEntry(const Dictionary &dict) {
+    std::size_t a = Rand(dict.size());
+    if (dict.size() == 1) return a;
+    std::size_t b = Rand(dict.size());
+
+    // compare (success + 1) / (use + 2), i.e. the estimated success rate
+    // with a uniform prior, without division
+    auto score = [&dict](std::size_t l, std::size_t r) {
+        return u64(dict[l].get_success_count() + 1) * (dict[r].get_use_count() + 2);
+    };
+    return score(b, a) > score(a, b) ? b : a;
+}
+
+std::size_t MutationDispatcher::AddWordFromDictionary(
+    bool persistent,
+    u8 *data,
+    std::size_t size,
+    std::size_t max_size
+) {
+    if (size > max_size) return 0;
+
+    auto &dict = persistent ? persistent_auto_dict : manual_dict;
+    if (dict.empty()) return 0;
+
+    std::size_t idx = ChooseDictEntry(dict);
+    auto &entry = dict[idx];
+    const auto &word = entry.get();
+    if (word.empty()) return 0;
+
+    bool use_position_hint = entry.has_position_hint()
+                          && entry.get_position_hint() + word.size() < size
+                          && RandBool();
+    if (RandBool()) {
+        // insert the word
+        if (size + word.size() > max_size) return 0;
+        std::size_t pos = use_position_hint ? entry.get_position_hint() : Rand(size + 1);
+        std::memmove(data + pos + word.size(), data + pos, size - pos);
+        std::memcpy(data + pos, word.data(), word.size());
+        size += word.size();
+    } else {
+        // overwrite some bytes with the word
+        if (word.size() > size) return 0;
+        std::size_t pos = use_position_hint ? entry.get_position_hint()
+                                            : Rand(size - word.size() + 1);
+        std::memcpy(data + pos, word.data(), word.size());
+    }
+
+    entry.increment_use_count();
+    current_dict_sequence.emplace_back(DictEntryRef{persistent, idx});
+    return size;
+}
+
+} // namespace fuzzuf::algorithm::libfuzzer
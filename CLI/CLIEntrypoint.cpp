@@ -12,6 +12,7 @@
 void usage(const char *argv_0) {
     std::cerr << "Example usage:" << std::endl;
     std::cerr << "\t" << argv_0 << " afl --in_dir=test/put_binaries/libjpeg/seeds -- test/put_binaries/libjpeg/libjpeg_turbo_fuzzer @@" << std::endl;
+    std::cerr << "\t" << argv_0 << " libfuzzer --in_dir=test/put_binaries/libjpeg/seeds -- --dict=jpeg.dict test/put_binaries/libjpeg/libjpeg_turbo_fuzzer @@" << std::endl;
     exit(1);
 }
 
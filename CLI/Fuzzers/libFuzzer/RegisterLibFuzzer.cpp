@@ -0,0 +1,9 @@
+#include "Algorithms/libFuzzer/LibFuzzer.hpp"
+#include "CLI/FuzzerBuilderRegister.hpp"
+#include "CLI/Fuzzers/libFuzzer/BuildLibFuzzerFromArgs.hpp"
+
+// RegisterAFLFuzzer.cppと同様に、object fileとしてリンクされるとmain関数より先に登録される
+static FuzzerBuilderRegister global_libfuzzer_register(
+    "libfuzzer",
+    BuildLibFuzzerFromArgs<Fuzzer, fuzzuf::algorithm::libfuzzer::LibFuzzer>
+);
@@ -2,16 +2,14 @@
 
 #include "Utils/Common.hpp"
 
-u64 ExecInput::id_counter = 0;
-
 ExecInput::ExecInput()
-    : id(id_counter++), 
+    : id(INVALID_INPUT_ID), 
       len(0) {}
 
 ExecInput::~ExecInput() {}
 
 ExecInput::ExecInput(const u8* orig_buf, u32 len) 
-    : id(id_counter++),
+    : id(INVALID_INPUT_ID),
       buf(new u8[len]),
       len(len)
 {
@@ -19,7 +17,7 @@ ExecInput::ExecInput(const u8* orig_buf, u32 len)
 }
 
 ExecInput::ExecInput(std::unique_ptr<u8[]>&& orig_buf, u32 len) 
-    : id(id_counter++),
+    : id(INVALID_INPUT_ID),
       buf(orig_buf.release()),
       len(len) {}
 
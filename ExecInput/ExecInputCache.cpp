@@ -0,0 +1,52 @@
+#include "ExecInput/ExecInputCache.hpp"
+
+ExecInputCache::ExecInputCache(u64 capacity) : capacity(capacity) {}
+
+bool ExecInputCache::Get(u64 id, std::shared_ptr<u8[]> &buf, u32 &len) {
+    auto itr = index.find(id);
+    if (itr == index.end()) {
+        misses++;
+        return false;
+    }
+
+    hits++;
+    entries.splice(entries.begin(), entries, itr->second);
+    buf = itr->second->buf;
+    len = itr->second->len;
+    return true;
+}
+
+void ExecInputCache::Put(u64 id, std::shared_ptr<u8[]> buf, u32 len) {
+    Erase(id);
+    if (len > capacity) return;
+
+    entries.push_front(Entry{id, std::move(buf), len});
+    index[id] = entries.begin();
+    size += len;
+
+    EvictIfOver();
+}
+
+void ExecInputCache::Erase(u64 id) {
+    auto itr = index.find(id);
+    if (itr == index.end()) return;
+
+    size -= itr->second->len;
+    entries.erase(itr->second);
+    index.erase(itr);
+}
+
+void ExecInputCache::Clear() {
+    entries.clear();
+    index.clear();
+    size = 0;
+}
+
+void ExecInputCache::EvictIfOver() {
+    while (size > capacity) {
+        auto &victim = entries.back();
+        size -= victim.len;
+        index.erase(victim.id);
+        entries.pop_back();
+    }
+}
@@ -1,36 +1,97 @@
 #include "ExecInput/ExecInputSet.hpp"
 
+#include "Logger/Logger.hpp"
+
 ExecInputSet::ExecInputSet() {}
 
 ExecInputSet::~ExecInputSet() {}
 
 size_t ExecInputSet::size(void) {
-    return elems.size();
+    return live_slots.size();
+}
+
+u64 ExecInputSet::Insert(std::shared_ptr<ExecInput> input) {
+    u32 slot_idx;
+    if (!free_slots.empty()) {
+        slot_idx = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        if (slots.size() >= MAX_SLOTS) ERROR("Too many ExecInputs");
+        slot_idx = slots.size();
+        slots.emplace_back();
+    }
+
+    const u64 generation = Util::GlobalCounter() & ((u64(1) << GENERATION_BITS) - 1);
+
+    auto &slot = slots[slot_idx];
+    slot.id = (u64(slot_idx) << GENERATION_BITS) | generation;
+    slot.live_pos = live_slots.size();
+    slot.input = std::move(input);
+    live_slots.emplace_back(slot_idx);
+    return slot.id;
+}
+
+ExecInputSet::Slot *ExecInputSet::FindSlot(u64 id) {
+    u64 slot_idx = id >> GENERATION_BITS;
+    if (slot_idx >= slots.size()) return nullptr;
+
+    auto &slot = slots[slot_idx];
+    if (slot.id != id) return nullptr;
+    return &slot;
 }
 
 NullableRef<ExecInput> ExecInputSet::get_ref(u64 id) {
-    auto itr = elems.find(id);
-    if (itr == elems.end()) return std::nullopt;
-    return *itr->second;
+    auto slot = FindSlot(id);
+    if (!slot) return std::nullopt;
+    return *slot->input;
 }
 
 std::shared_ptr<ExecInput> ExecInputSet::get_shared(u64 id) {
-    auto itr = elems.find(id);
-    if (itr == elems.end()) return nullptr;
-    return itr->second;
+    auto slot = FindSlot(id);
+    if (!slot) return nullptr;
+    return slot->input;
 }
 
 void ExecInputSet::erase(u64 id) {
-    auto itr = elems.find(id);
-    if (itr == elems.end()) return;
+    auto slot = FindSlot(id);
+    if (!slot) return;
+
+    // live_slotsの末尾をこの要素の位置に移す
+    u32 last = live_slots.back();
+    live_slots[slot->live_pos] = last;
+    slots[last].live_pos = slot->live_pos;
+    live_slots.pop_back();
 
-    elems.erase(itr);
+    slot->id = ExecInput::INVALID_INPUT_ID;
+    slot->input.reset();
+    free_slots.emplace_back(id >> GENERATION_BITS);
+
+    if (disk_cache) disk_cache->Erase(id);
 }
 
 std::vector<u64> ExecInputSet::get_ids(void) {
     std::vector<u64> ids;
-    for (auto& itr : elems) {
-        ids.emplace_back(itr.first);
+    ids.reserve(live_slots.size());
+    for (auto slot_idx : live_slots) {
+        ids.emplace_back(slots[slot_idx].id);
     }
     return ids;
 }
+
+void ExecInputSet::EnableDiskCache(u64 capacity) {
+    disk_cache = std::make_shared<ExecInputCache>(capacity);
+}
+
+const ExecInputCache *ExecInputSet::GetDiskCache(void) const {
+    return disk_cache.get();
+}
+
+void ExecInputSet::EnableAsyncWriter(
+    std::shared_ptr<fuzzuf::utils::async_file_writer> new_writer
+) {
+    writer = std::move(new_writer);
+}
+
+void ExecInputSet::EnablePackedStore(std::shared_ptr<PackedCorpusStore> store) {
+    packed_store = std::move(store);
+}
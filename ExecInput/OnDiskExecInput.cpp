@@ -15,33 +15,89 @@ OnDiskExecInput::OnDiskExecInput(const fs::path& path, bool hardlinked)
 OnDiskExecInput::OnDiskExecInput(OnDiskExecInput&& orig)
     : ExecInput(std::move(orig)),
       path(std::move(orig.path)),
-      hardlinked(orig.hardlinked) {}
+      hardlinked(orig.hardlinked),
+      cache(std::move(orig.cache)),
+      writer(std::move(orig.writer)),
+      store(std::move(orig.store)) {}
 
 OnDiskExecInput& OnDiskExecInput::operator=(OnDiskExecInput&& orig) {
     ExecInput::operator=(std::move(orig));
     path = std::move(orig.path);
     hardlinked = orig.hardlinked;
+    cache = std::move(orig.cache);
+    writer = std::move(orig.writer);
+    store = std::move(orig.store);
     return *this;
 }
 
 void OnDiskExecInput::ReallocBufIfLack(u32 new_len) {
-    if (!buf || new_len > len) {
+    // bufはキャッシュや書き込み待ちの操作と共有されている事があり、その場合は書き換えられない
+    if (!buf || new_len > len || buf.use_count() > 1) {
         buf.reset(new u8[new_len], []( u8 *p ){ if( p ) delete [] p; });
     }
     len = new_len;
 }
 
+bool OnDiskExecInput::InStore(const fs::path& target) const {
+    return store && target.parent_path() == store->GetDir();
+}
+
+void OnDiskExecInput::PutIntoStore(const fs::path& dest_path) {
+    bool loaded = bool(buf);
+    LoadIfNotLoaded();
+    store->Put(dest_path.filename().string(), buf.get(), len);
+    if (!loaded) Unload();
+}
+
 void OnDiskExecInput::LoadIfNotLoaded(void) {
     if (buf) return;
     Load();
 }
 
+// 書き込みが終わっていない内容があればbufにコピーしてtrueを返す
+static bool LoadPending(
+    const fuzzuf::utils::async_file_writer *writer,
+    const fs::path& path,
+    std::shared_ptr<u8[]>& buf,
+    u32& len
+) {
+    if (!writer) return false;
+
+    fuzzuf::utils::async_file_writer::buffer_t pending;
+    std::size_t pending_len;
+    if (!writer->get_pending(path.string(), pending, pending_len)) return false;
+
+    buf.reset(new u8[pending_len]);
+    std::memcpy(buf.get(), pending.get(), pending_len);
+    len = pending_len;
+    return true;
+}
+
 void OnDiskExecInput::Load(void) {
+    if (cache && cache->Get(id, buf, len)) return;
+    if (LoadPending(writer.get(), path, buf, len)) {
+        if (cache) cache->Put(id, buf, len);
+        return;
+    }
+
+    if (InStore(path)) {
+        auto idx = store->Find(path.filename().string());
+        if (!idx) throw FileError("No such corpus entry: " + path.string());
+
+        ReallocBufIfLack(store->GetLen(*idx));
+        store->Read(*idx, buf.get());
+
+        if (cache) cache->Put(id, buf, len);
+        return;
+    }
+
     ReallocBufIfLack(fs::file_size(path));
 
     int fd = Util::OpenFile(path.string(), O_RDONLY);
     Util::ReadFile(fd, buf.get(), len);
     Util::CloseFile(fd);
+
+    if (cache) cache->Put(id, buf, len);
 }
 
 void OnDiskExecInput::Unload(void) {
@@ -49,6 +105,24 @@ void OnDiskExecInput::Unload(void) {
 }
 
 void OnDiskExecInput::Save(void) {
+    if (InStore(path)) {
+        store->Put(path.filename().string(), buf.get(), len);
+        hardlinked = false;
+        if (cache) cache->Put(id, buf, len);
+        return;
+    }
+
+    if (writer) {
+        // 削除と書き込みは要求した順に行われる
+        if (hardlinked) {
+            writer->remove(path.string());
+            hardlinked = false;
+        }
+        writer->write(path.string(), buf.get(), len);
+        if (cache) cache->Put(id, buf, len);
+        return;
+    }
+
     if (hardlinked) {
         Util::DeleteFileOrDirectory(path.string());
         hardlinked = false;
@@ -57,6 +131,8 @@ void OnDiskExecInput::Save(void) {
     int fd = Util::OpenFile(path.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
     Util::WriteFile(fd, buf.get(), len);
     Util::CloseFile(fd);
+
+    if (cache) cache->Put(id, buf, len);
 }
 
 void OnDiskExecInput::OverwriteKeepingLoaded(const u8* new_buf, u32 new_len) {
@@ -76,20 +152,59 @@ void OnDiskExecInput::OverwriteKeepingLoaded(
 
 void OnDiskExecInput::OverwriteThenUnload(const u8* new_buf, u32 new_len) {
     buf.reset();
+    // Like Unload(), keep the length of what is on disk
+    len = new_len;
+
+    if (InStore(path)) {
+        store->Put(path.filename().string(), new_buf, new_len);
+        if (cache) cache->Erase(id);
+        return;
+    }
+
+    if (writer) {
+        writer->write(path.string(), new_buf, new_len);
+        if (cache) cache->Erase(id);
+        return;
+    }
 
     int fd = Util::OpenFile(path.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
     Util::WriteFile(fd, new_buf, new_len);
     Util::CloseFile(fd);
+
+    if (cache) cache->Erase(id);
 }
 
 void OnDiskExecInput::OverwriteThenUnload(
     std::unique_ptr<u8[]>&& new_buf, u32 new_len
 ) {
     auto will_delete = std::move(new_buf);
+
+    if (writer && !InStore(path)) {
+        // We own the new content, so the writer and the cache can share it without copying
+        buf.reset();
+        len = new_len;
+        std::shared_ptr<u8[]> shared(will_delete.release());
+        writer->write(path.string(), shared, new_len);
+        if (cache) cache->Put(id, std::move(shared), new_len);
+        return;
+    }
+
     OverwriteThenUnload(will_delete.get(), new_len);
+
+    // We own the new content, so the cache can take it without copying
+    if (cache) cache->Put(id, std::shared_ptr<u8[]>(will_delete.release()), new_len);
 }
 
 void OnDiskExecInput::LoadByMmap(void) {
+    if (cache && cache->Get(id, buf, len)) return;
+    if (LoadPending(writer.get(), path, buf, len)) return;
+
+    // storeの要素はファイルとしてmmapできない
+    if (InStore(path)) {
+        Load();
+        return;
+    }
+
     int fd = Util::OpenFile( path.string(), O_RDONLY );
     auto file_len = fs::file_size(path);
 
@@ -108,14 +223,50 @@ void OnDiskExecInput::LoadByMmap(void) {
 }
 
 bool OnDiskExecInput::Link(const fs::path& dest_path) {
+    if (InStore(dest_path)) {
+        PutIntoStore(dest_path);
+        return true;
+    }
+    // storeの要素にはハードリンクを張れないので、呼び出し元にコピーさせる
+    if (InStore(path)) return false;
+
+    // リンクやコピーの元になるファイルは書き込みが終わっていなければならない
+    if (writer) writer->flush();
     return link(path.c_str(), dest_path.c_str()) == 0;
 }
 
 void OnDiskExecInput::Copy(const fs::path& dest_path) {
+    if (InStore(dest_path)) {
+        PutIntoStore(dest_path);
+        return;
+    }
+
+    if (InStore(path)) {
+        bool loaded = bool(buf);
+        LoadIfNotLoaded();
+        int fd = Util::OpenFile(dest_path.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        Util::WriteFile(fd, buf.get(), len);
+        Util::CloseFile(fd);
+        if (!loaded) Unload();
+        return;
+    }
+
+    if (writer) writer->flush();
     Util::CopyFile(path.string(), dest_path.string());
 }
 
 bool OnDiskExecInput::LinkAndRefer(const fs::path& new_path) {
+    // storeの中での移動は、内容を複製せずに名前を変える
+    if (InStore(path) && InStore(new_path)) {
+        auto idx = store->Find(path.filename().string());
+        if (!idx) throw FileError("No such corpus entry: " + path.string());
+
+        store->Rename(*idx, new_path.filename().string());
+        path = new_path;
+        hardlinked = false;
+        return true;
+    }
+
     if (!Link(new_path)) return false;
     path = new_path;
     hardlinked = true;
@@ -123,7 +274,15 @@ bool OnDiskExecInput::LinkAndRefer(const fs::path& new_path) {
 }
 
 void OnDiskExecInput::CopyAndRefer(const fs::path& new_path) {
+    if (InStore(new_path)) {
+        PutIntoStore(new_path);
+        path = new_path;
+        hardlinked = false;
+        return;
+    }
+
     // don't want to overwrite the content if new_path is a hardlink
+    if (writer) writer->flush();
     Util::DeleteFileOrDirectory(new_path.string());
     Copy(new_path);
     path = new_path;
@@ -0,0 +1,333 @@
+#include "ExecInput/PackedCorpusStore.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "Utils/Common.hpp"
+#include "Utils/Filesystem.hpp"
+
+namespace {
+
+constexpr char INDEX_MAGIC[8] = { 'F', 'Z', 'P', 'A', 'C', 'K', '0', '1' };
+constexpr u32 INDEX_VERSION = 1;
+constexpr u64 INITIAL_CAPACITY = 1024;
+
+fs::path SegmentPath(const fs::path &dir) { return dir / "corpus.seg"; }
+fs::path IndexPath(const fs::path &dir) { return dir / "corpus.idx"; }
+
+void PWriteAll(int fd, const void *buf, std::size_t len, u64 offset, const fs::path &path) {
+    auto p = static_cast<const u8*>(buf);
+    while (len) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw FileError("Unable to write '" + path.string() + "': " + std::strerror(errno));
+        p += n;
+        len -= n;
+        offset += n;
+    }
+}
+
+void PReadAll(int fd, void *buf, std::size_t len, u64 offset, const fs::path &path) {
+    auto p = static_cast<u8*>(buf);
+    while (len) {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) throw FileError("Unable to read '" + path.string() + "': " + std::strerror(errno));
+        if (n == 0) throw FileError("Short read from '" + path.string() + "'");
+        p += n;
+        len -= n;
+        offset += n;
+    }
+}
+
+} // namespace
+
+struct PackedCorpusStore::Header {
+    char magic[8];
+    u32 version;
+    u32 record_size;
+    u64 num_records;
+    // corpus.segのうち、レコードから参照され得る部分の長さ
+    u64 segment_size;
+};
+
+struct PackedCorpusStore::Record {
+    u64 data_offset;
+    u64 name_offset;
+    u32 len;
+    u32 name_len;
+    u32 flags;
+    u32 parent;
+};
+
+PackedCorpusStore::PackedCorpusStore(const fs::path &dir, bool read_only)
+    : dir(dir), read_only(read_only) {
+    static_assert(sizeof(Header) == 32 && sizeof(Record) == 32,
+                  "corpus.idx layout must not depend on the compiler");
+
+    const auto seg_path = SegmentPath(dir);
+    const auto idx_path = IndexPath(dir);
+
+    if (read_only) {
+        seg_fd = Util::OpenFile(seg_path.string(), O_RDONLY | O_CLOEXEC);
+        idx_fd = Util::OpenFile(idx_path.string(), O_RDONLY | O_CLOEXEC);
+    } else {
+        seg_fd = Util::OpenFile(seg_path.string(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        idx_fd = Util::OpenFile(idx_path.string(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    }
+
+    const u64 idx_file_size = fs::file_size(idx_path);
+    if (idx_file_size == 0 && !read_only) {
+        // 新しく作った
+        ReserveRecords(INITIAL_CAPACITY);
+        auto &header = GetHeader();
+        std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        header.version = INDEX_VERSION;
+        header.record_size = sizeof(Record);
+        header.num_records = 0;
+        header.segment_size = 0;
+        return;
+    }
+
+    if (idx_file_size < sizeof(Header))
+        throw FileError("Truncated corpus index: " + idx_path.string());
+
+    MapIndex((idx_file_size - sizeof(Header)) / sizeof(Record));
+
+    const auto &header = GetHeader();
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0
+     || header.version != INDEX_VERSION
+     || header.record_size != sizeof(Record)
+     || header.num_records > capacity) {
+        UnmapIndex();
+        throw FileError("Invalid corpus index: " + idx_path.string());
+    }
+
+    const u64 seg_file_size = fs::file_size(seg_path);
+    if (seg_file_size < header.segment_size) {
+        UnmapIndex();
+        throw FileError("Truncated corpus segment: " + seg_path.string());
+    }
+
+    // 途中で止まった追記の残りを捨てる
+    if (!read_only && seg_file_size > header.segment_size) {
+        Util::TruncateFile(seg_fd, header.segment_size);
+    }
+
+    names.reserve(header.num_records);
+    for (u32 idx = 0; idx < header.num_records; idx++) {
+        const auto &rec = GetRecord(idx);
+        std::string name(rec.name_len, '\0');
+        PReadAll(seg_fd, name.data(), rec.name_len, rec.name_offset, seg_path);
+        name_to_idx[name] = idx;
+        names.emplace_back(std::move(name));
+    }
+}
+
+PackedCorpusStore::~PackedCorpusStore() {
+    UnmapIndex();
+    if (seg_fd >= 0) Util::CloseFile(seg_fd);
+    if (idx_fd >= 0) Util::CloseFile(idx_fd);
+}
+
+bool PackedCorpusStore::Exists(const fs::path &dir) {
+    return fs::exists(IndexPath(dir)) && fs::exists(SegmentPath(dir));
+}
+
+PackedCorpusStore::Header &PackedCorpusStore::GetHeader() const {
+    return *reinterpret_cast<Header*>(idx_map);
+}
+
+PackedCorpusStore::Record &PackedCorpusStore::GetRecord(u32 idx) const {
+    return reinterpret_cast<Record*>(idx_map + sizeof(Header))[idx];
+}
+
+u64 PackedCorpusStore::GetSegmentSize() const {
+    return GetHeader().segment_size;
+}
+
+std::optional<u32> PackedCorpusStore::Find(const std::string &name) const {
+    auto itr = name_to_idx.find(name);
+    if (itr == name_to_idx.end()) return std::nullopt;
+    return itr->second;
+}
+
+u32 PackedCorpusStore::GetLen(u32 idx) const {
+    return GetRecord(idx).len;
+}
+
+u32 PackedCorpusStore::GetFlags(u32 idx) const {
+    return GetRecord(idx).flags;
+}
+
+u32 PackedCorpusStore::GetParent(u32 idx) const {
+    return GetRecord(idx).parent;
+}
+
+void PackedCorpusStore::Read(u32 idx, u8 *buf) const {
+    const auto &rec = GetRecord(idx);
+    PReadAll(seg_fd, buf, rec.len, rec.data_offset, SegmentPath(dir));
+}
+
+u32 PackedCorpusStore::Put(const std::string &name, const u8 *buf, u32 len) {
+    CheckWritable();
+
+    auto found = Find(name);
+    if (found) {
+        const u64 data_offset = AppendToSegment(buf, len);
+        auto &rec = GetRecord(*found);
+        rec.data_offset = data_offset;
+        rec.len = len;
+        return *found;
+    }
+
+    // ReserveRecordsでマップし直すので、ヘッダへの参照は持たない
+    const u32 idx = GetHeader().num_records;
+    ReserveRecords(u64(idx) + 1);
+
+    const u64 name_offset = AppendToSegment(name.data(), name.size());
+    const u64 data_offset = AppendToSegment(buf, len);
+
+    auto &rec = GetRecord(idx);
+    rec.data_offset = data_offset;
+    rec.name_offset = name_offset;
+    rec.len = len;
+    rec.name_len = name.size();
+    rec.flags = 0;
+    rec.parent = NO_PARENT;
+
+    // レコードを書き終えてから数を増やす
+    GetHeader().num_records = u64(idx) + 1;
+
+    names.emplace_back(name);
+    name_to_idx[name] = idx;
+    return idx;
+}
+
+void PackedCorpusStore::Rename(u32 idx, const std::string &new_name) {
+    CheckWritable();
+
+    if (names[idx] == new_name) return;
+    if (Find(new_name))
+        throw FileError("Corpus entry already exists: " + new_name);
+
+    const u64 name_offset = AppendToSegment(new_name.data(), new_name.size());
+    auto &rec = GetRecord(idx);
+    rec.name_offset = name_offset;
+    rec.name_len = new_name.size();
+
+    name_to_idx.erase(names[idx]);
+    name_to_idx[new_name] = idx;
+    names[idx] = new_name;
+}
+
+void PackedCorpusStore::SetFlag(u32 idx, Flag flag, bool val) {
+    CheckWritable();
+
+    auto &rec = GetRecord(idx);
+    if (val) rec.flags |= flag;
+    else rec.flags &= ~u32(flag);
+}
+
+void PackedCorpusStore::SetParent(u32 idx, u32 parent) {
+    CheckWritable();
+    GetRecord(idx).parent = parent;
+}
+
+void PackedCorpusStore::Sync() {
+    if (read_only) return;
+
+    // レコードが指す内容を先に書き込む
+    if (fdatasync(seg_fd))
+        throw FileError("Unable to sync '" + SegmentPath(dir).string() + "': " + std::strerror(errno));
+    if (msync(idx_map, idx_map_len, MS_SYNC))
+        throw FileError("Unable to sync '" + IndexPath(dir).string() + "': " + std::strerror(errno));
+}
+
+void PackedCorpusStore::Export(const fs::path &queue_dir) const {
+    Util::CreateDir(queue_dir.string());
+    Util::CreateDir((queue_dir / ".state").string());
+    const auto det_done_dir = queue_dir / ".state" / "deterministic_done";
+    const auto redundant_dir = queue_dir / ".state" / "redundant_edges";
+    const auto variable_dir = queue_dir / ".state" / "variable_behavior";
+    Util::CreateDir(det_done_dir.string());
+    Util::CreateDir(redundant_dir.string());
+    Util::CreateDir(variable_dir.string());
+
+    std::vector<u8> buf;
+    for (u32 idx = 0; idx < size(); idx++) {
+        const auto &name = GetName(idx);
+        buf.resize(GetLen(idx));
+        Read(idx, buf.data());
+
+        int fd = Util::OpenFile((queue_dir / name).string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        Util::WriteFile(fd, buf.data(), buf.size());
+        Util::CloseFile(fd);
+
+        const u32 flags = GetFlags(idx);
+        if (flags & PASSED_DET) {
+            fd = Util::OpenFile((det_done_dir / name).string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+            Util::CloseFile(fd);
+        }
+        if (flags & FS_REDUNDANT) {
+            fd = Util::OpenFile((redundant_dir / name).string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+            Util::CloseFile(fd);
+        }
+        if (flags & VAR_BEHAVIOR) {
+            const auto link_path = variable_dir / name;
+            unlink(link_path.c_str());
+            if (symlink(("../../" + name).c_str(), link_path.c_str()) == -1) {
+                fd = Util::OpenFile(link_path.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+                Util::CloseFile(fd);
+            }
+        }
+    }
+}
+
+void PackedCorpusStore::MapIndex(u64 num_records) {
+    UnmapIndex();
+
+    idx_map_len = sizeof(Header) + num_records * sizeof(Record);
+    const int prot = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+    void *p = mmap(nullptr, idx_map_len, prot, MAP_SHARED, idx_fd, 0);
+    if (p == MAP_FAILED) {
+        idx_map_len = 0;
+        throw FileError("Unable to mmap '" + IndexPath(dir).string() + "': " + std::strerror(errno));
+    }
+
+    idx_map = static_cast<u8*>(p);
+    capacity = num_records;
+}
+
+void PackedCorpusStore::UnmapIndex() {
+    if (idx_map) munmap(idx_map, idx_map_len);
+    idx_map = nullptr;
+    idx_map_len = 0;
+    capacity = 0;
+}
+
+void PackedCorpusStore::ReserveRecords(u64 num_records) {
+    if (idx_map && num_records <= capacity) return;
+
+    u64 new_capacity = std::max(capacity, INITIAL_CAPACITY);
+    while (new_capacity < num_records) new_capacity *= 2;
+
+    Util::TruncateFile(idx_fd, sizeof(Header) + new_capacity * sizeof(Record));
+    MapIndex(new_capacity);
+}
+
+u64 PackedCorpusStore::AppendToSegment(const void *buf, u32 len) {
+    auto &header = GetHeader();
+    const u64 offset = header.segment_size;
+    PWriteAll(seg_fd, buf, len, offset, SegmentPath(dir));
+    header.segment_size = offset + len;
+    return offset;
+}
+
+void PackedCorpusStore::CheckWritable() const {
+    if (read_only)
+        throw FileError("Corpus store is read-only: " + dir.string());
+}
@@ -0,0 +1,158 @@
+#include "Executor/FeedbackMapRegistry.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Utils/Common.hpp"
+#include "Logger/Logger.hpp"
+
+// マップの先頭は必ずこの境界に揃える
+static constexpr u32 MAP_ALIGNMENT = 64;
+
+FeedbackMapRegistry::~FeedbackMapRegistry() {
+    // 正常な経路ではNativeLinuxExecutorのデストラクタでEraseされている
+    if (!segments.empty()) Erase();
+}
+
+void FeedbackMapRegistry::Register(const FeedbackMapSpec &spec) {
+    if (!segments.empty()) ERROR("Feedback maps must be registered before setup");
+    if (Has(spec.name)) ERROR("Feedback map '%s' is registered twice", spec.name.c_str());
+    maps.emplace_back(Map{spec, 0, 0});
+}
+
+void FeedbackMapRegistry::Setup() {
+    if (maps.empty()) return;
+
+    // まず各マップをどの共有メモリのどこに置くかを決める
+    // 最初の共有メモリの先頭は、最初に登録されたlegacy_env_varを持つマップに譲る
+    std::vector<u32> segment_sizes(1, 0);
+
+    bool head_taken = false;
+    for (auto &map : maps) {
+        if (map.spec.legacy_env_var.empty()) continue;
+
+        if (!head_taken) {
+            map.segment = 0;
+            head_taken = true;
+        } else {
+            map.segment = segment_sizes.size();
+            segment_sizes.emplace_back(0);
+        }
+        map.offset = 0;
+        segment_sizes[map.segment] = map.spec.size;
+    }
+
+    for (auto &map : maps) {
+        if (!map.spec.legacy_env_var.empty()) continue;
+
+        u32 offset = (segment_sizes[0] + MAP_ALIGNMENT - 1) & ~(MAP_ALIGNMENT - 1);
+        map.segment = 0;
+        map.offset = offset;
+        segment_sizes[0] = offset + map.spec.size;
+    }
+
+    for (u32 size : segment_sizes) {
+        int shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | IPC_EXCL | 0600);
+        if (shmid < 0) ERROR("shmget() failed");
+
+        u8 *base = (u8 *)shmat(shmid, nullptr, 0);
+        if (base == (u8 *)-1) ERROR("shmat() failed");
+
+        segments.emplace_back(Segment{shmid, base, size});
+    }
+
+    // ResetPolicy::ZEROのマップのうち、同じ共有メモリ内で隣接しているものは
+    // 間のパディングごと1つの範囲にまとめる
+    std::vector<const Map*> sorted;
+    for (const auto &map : maps) sorted.emplace_back(&map);
+    std::sort(sorted.begin(), sorted.end(), [](const Map *a, const Map *b) {
+        if (a->segment != b->segment) return a->segment < b->segment;
+        return a->offset < b->offset;
+    });
+
+    size_t last_segment = 0;
+    bool extendable = false;
+    for (const auto *map : sorted) {
+        if (map->spec.reset_policy != FeedbackMapSpec::ResetPolicy::ZERO) {
+            extendable = false;
+            continue;
+        }
+
+        u8 *begin = segments[map->segment].base + map->offset;
+        if (extendable && last_segment == map->segment) {
+            auto &range = reset_ranges.back();
+            range.second = begin + map->spec.size - range.first;
+        } else {
+            reset_ranges.emplace_back(begin, map->spec.size);
+        }
+        last_segment = map->segment;
+        extendable = true;
+    }
+}
+
+void FeedbackMapRegistry::Reset() {
+    for (const auto &range : reset_ranges) {
+        std::memset(range.first, 0, range.second);
+    }
+}
+
+void FeedbackMapRegistry::Erase() {
+    for (auto &segment : segments) {
+        if (shmdt(segment.base) == -1) ERROR("shmdt() failed");
+        if (shmctl(segment.shmid, IPC_RMID, 0) == -1) ERROR("shmctl() failed");
+    }
+    segments.clear();
+    reset_ranges.clear();
+}
+
+void FeedbackMapRegistry::ExportEnvironmentVariables() const {
+    std::string layout;
+    for (const auto &map : maps) {
+        const auto &segment = segments[map.segment];
+
+        if (!map.spec.legacy_env_var.empty()) {
+            setenv(map.spec.legacy_env_var.c_str(), std::to_string(segment.shmid).c_str(), 1);
+        }
+
+        if (!layout.empty()) layout += ';';
+        layout += Util::StrPrintf("%s:%d:%u:%u",
+                    map.spec.name.c_str(), segment.shmid, map.offset, map.spec.size);
+    }
+
+    if (layout.empty()) {
+        unsetenv(LAYOUT_ENV_VAR);
+    } else {
+        setenv(LAYOUT_ENV_VAR, layout.c_str(), 1);
+    }
+}
+
+const FeedbackMapRegistry::Map *FeedbackMapRegistry::Find(const std::string &name) const {
+    auto itr = std::find_if(maps.begin(), maps.end(),
+                  [&name](const Map &map) { return map.spec.name == name; });
+    if (itr == maps.end()) return nullptr;
+    return &*itr;
+}
+
+bool FeedbackMapRegistry::Has(const std::string &name) const {
+    return Find(name) != nullptr;
+}
+
+u8 *FeedbackMapRegistry::GetMap(const std::string &name) const {
+    auto map = Find(name);
+    if (!map || segments.empty()) return nullptr;
+    return segments[map->segment].base + map->offset;
+}
+
+u32 FeedbackMapRegistry::GetSize(const std::string &name) const {
+    auto map = Find(name);
+    if (!map) return 0;
+    return map->spec.size;
+}
+
+int FeedbackMapRegistry::GetShmid(const std::string &name) const {
+    auto map = Find(name);
+    if (!map || segments.empty()) return INVALID_SHMID;
+    return segments[map->segment].shmid;
+}
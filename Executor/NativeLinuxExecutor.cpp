@@ -59,7 +59,8 @@ NativeLinuxExecutor::NativeLinuxExecutor(
     const fs::path &path_to_write_input,
     bool need_afl_cov,
     bool need_bb_cov,
-    int cpuid_to_bind  // FIXME: bindに関するテストを足す(どうテストする？）
+    int cpuid_to_bind,  // FIXME: bindに関するテストを足す(どうテストする？）
+    const std::vector<FeedbackMapSpec> &additional_maps
 ) :
     Executor( argv, exec_timelimit_ms, exec_memlimit, path_to_write_input.string() ),
     forksrv( forksrv ),
@@ -132,6 +133,23 @@ NativeLinuxExecutor::NativeLinuxExecutor(
     SetCArgvAndDecideInputMode();
     OpenExecutorDependantFiles();
 
+    // AFLのedgeカバレッジを最初に登録し、__AFL_SHM_IDで渡す共有メモリの先頭に置かせる
+    if (need_afl_cov) {
+        feedback_maps.Register(
+            FeedbackMapSpec{"afl", AFLOption::MAP_SIZE, AFLOption::AFL_SHM_ENV_VAR}
+        );
+    }
+
+    if (need_bb_cov) {
+        feedback_maps.Register(
+            FeedbackMapSpec{"bb", AFLOption::MAP_SIZE, AFLOption::WYVERN_SHM_ENV_VAR}
+        );
+    }
+
+    for (const auto &spec : additional_maps) {
+        feedback_maps.Register(spec);
+    }
+
     // Executorの初期化をするこのタイミングで共有メモリを確保する
     // 各 NativeLinuxExecutor::Run() でそのメモリを参照できればよい
     SetupSharedMemories();
@@ -494,57 +512,42 @@ InplaceMemoryFeedback NativeLinuxExecutor::GetBBFeedback() {
     return InplaceMemoryFeedback(bb_trace_bits, AFLOption::MAP_SIZE, lock);
 }
 
+InplaceMemoryFeedback NativeLinuxExecutor::GetFeedback(const std::string &name) {
+    return InplaceMemoryFeedback(feedback_maps.GetMap(name), feedback_maps.GetSize(name), lock);
+}
+
 ExitStatusFeedback NativeLinuxExecutor::GetExitStatusFeedback() {
     return ExitStatusFeedback(last_exit_reason, last_signal);
 }
 
 // PUTに渡してconverage書き込んでもらうための共有メモリ群の初期化。
 // どのPUTに対してもこれらの共有メモリ渡して使い回す（毎回各PUT向けに確保すると重い）
+// マップの配置はFeedbackMapRegistryが決める
 void NativeLinuxExecutor::SetupSharedMemories() {
-    if (need_afl_cov) {
-        afl_shmid = shmget(IPC_PRIVATE, AFLOption::MAP_SIZE, IPC_CREAT | IPC_EXCL | 0600);
-        if (afl_shmid < 0) ERROR("shmget() failed");
-
-        afl_trace_bits = (u8 *)shmat(afl_shmid, nullptr, 0);
-        if (afl_trace_bits == (u8 *)-1) ERROR("shmat() failed");
-    }
+    feedback_maps.Setup();
 
-    if (need_bb_cov) {
-        bb_shmid = shmget(IPC_PRIVATE, AFLOption::MAP_SIZE, IPC_CREAT | IPC_EXCL | 0600);
-        if (bb_shmid < 0) ERROR("shmget() failed");
+    afl_shmid = feedback_maps.GetShmid("afl");
+    afl_trace_bits = feedback_maps.GetMap("afl");
 
-        bb_trace_bits = (u8 *)shmat(bb_shmid, nullptr, 0);
-        if (bb_trace_bits == (u8 *)-1) ERROR("shmat() failed");
-    }
+    bb_shmid = feedback_maps.GetShmid("bb");
+    bb_trace_bits = feedback_maps.GetMap("bb");
 }
 
 // 共有メモリは使い回すので、PUTに渡す前に毎回初期化してあげる
 void NativeLinuxExecutor::ResetSharedMemories() {
-    if (need_afl_cov) {
-        std::memset(afl_trace_bits, 0, AFLOption::MAP_SIZE);
-    }
-
-    if (need_bb_cov) {
-        std::memset(bb_trace_bits, 0, AFLOption::MAP_SIZE);
-    }
+    feedback_maps.Reset();
     MEM_BARRIER();
 }
 
 // Executorが死ぬときにSharedMemoryも消す
 void NativeLinuxExecutor::EraseSharedMemories() {
-    if (need_afl_cov) {
-        if (shmdt(afl_trace_bits) == -1) ERROR("shmdt() failed");
-        afl_trace_bits = nullptr;
-        if (shmctl(afl_shmid, IPC_RMID, 0) == -1) ERROR("shmctl() failed");
-        afl_shmid = INVALID_SHMID;
-    }
+    feedback_maps.Erase();
 
-    if (need_bb_cov) {
-        if (shmdt(bb_trace_bits) == -1) ERROR("shmdt() failed");
-        bb_trace_bits = nullptr;
-        if (shmctl(bb_shmid, IPC_RMID, 0) == -1) ERROR("shmctl() failed");
-        bb_shmid = INVALID_SHMID;
-    }
+    afl_trace_bits = nullptr;
+    afl_shmid = INVALID_SHMID;
+
+    bb_trace_bits = nullptr;
+    bb_shmid = INVALID_SHMID;
 }
 
 // afl-clang-fastやfuzzuf-ccでinsturmentを挿入されたPUTは、
@@ -554,22 +557,12 @@ void NativeLinuxExecutor::EraseSharedMemories() {
 // 親プロセスの環境変数を引き継ぐという性質を利用すると1回だけやっておくと良いことが分かる（まずければ移そう）
 // これの利点として、StrPrintfのせいでheap領域のCopy on Writeが無駄になるとかが避けられるとかもある
 void NativeLinuxExecutor::SetupEnvironmentVariablesForTarget() {
-    // 共有メモリのIDをPUTに渡す
-    if (need_afl_cov) {
-        std::string afl_shmstr = std::to_string(afl_shmid);
-        setenv(AFLOption::AFL_SHM_ENV_VAR, afl_shmstr.c_str(), 1);
-    } else {
-        // make sure to unset the environmental variable if it's unused
-        unsetenv(AFLOption::AFL_SHM_ENV_VAR);
-    }
+    // make sure to unset the environmental variables if they are unused
+    unsetenv(AFLOption::AFL_SHM_ENV_VAR);
+    unsetenv(AFLOption::WYVERN_SHM_ENV_VAR);
 
-    if (need_bb_cov) {
-        std::string bb_shmstr = std::to_string(bb_shmid);
-        setenv(AFLOption::WYVERN_SHM_ENV_VAR, bb_shmstr.c_str(), 1);
-    } else {
-        // make sure to unset the environmental variable if it's unused
-        unsetenv(AFLOption::WYVERN_SHM_ENV_VAR);
-    }
+    // 共有メモリのIDをPUTに渡す
+    feedback_maps.ExportEnvironmentVariables();
 
     /* This should improve performance a bit, since it stops the linker from
         doing extra work post-fork(). */
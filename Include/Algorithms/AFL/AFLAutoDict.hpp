@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "Options.hpp"
+#include "Utils/Common.hpp"
+#include "Utils/Random.hpp"
+#include "Algorithms/AFL/AFLDictData.hpp"
+
+// 自動辞書（AFLのa_extras）
+//
+// 責務：
+//  - トークンをAFLと同じ順に並べて公開すること
+//      - 全体をhit_cntの降順（同じなら短い順、さらに辞書順）に並べ、
+//        その先頭USE_AUTO_EXTRAS個だけを長さ順（同じならhit_cntの降順、辞書順）に並べ直したもの
+//  - 大文字小文字を同一視したハッシュで、既に持っているトークンをO(1)で見つけること
+//  - 追加やhit_cntの更新のたびにソートし直さず、位置が変わるエントリだけを動かすこと
+// 並びは全順序なので、AFLの元の実装と違い、BEHAVE_DETERMINISTICの有無によらず同じになる
+class AFLAutoDict {
+public:
+    AFLAutoDict();
+
+    AFLAutoDict(const AFLAutoDict&) = delete;
+    AFLAutoDict& operator=(const AFLAutoDict&) = delete;
+
+    // 大文字小文字を無視して同じトークンがあればそのhit_cntを1増やし、なければhit_cnt=0で追加する
+    // MAX_AUTO_EXTRAS個を持っている場合は、下位半分からrngで選んだものと置き換える
+    // lenはMAX_AUTO_EXTRA以下であること
+    void Add(const u8 *token, u32 len, fuzzuf::utils::random::prng &rng);
+
+    bool Contains(const u8 *token, u32 len) const;
+
+    // GetEntries()で得たものから作り直す。並びはそのまま使うので、並べ替えない
+    // 大文字小文字を同一視して重複するもの、MAX_AUTO_EXTRAを超えるもの、
+    // MAX_AUTO_EXTRAS個目より後のものは捨てる
+    void Restore(const std::vector<AFLDictData> &saved);
+
+    const std::vector<AFLDictData>& GetEntries() const { return entries; }
+    std::size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    // Addのたびに増える。エントリから作ったもの（照合器など）を作り直す必要があるかの判定に使う
+    u64 GetVersion() const { return version; }
+
+private:
+    // 大文字小文字を同一視したトークン。ヒープを使わずに持つ
+    struct FoldedToken {
+        u32 len = 0;
+        std::array<u8, AFLOption::MAX_AUTO_EXTRA> bytes{};
+
+        bool operator==(const FoldedToken &other) const;
+    };
+
+    struct FoldedTokenHash {
+        std::size_t operator()(const FoldedToken &token) const;
+    };
+
+    static FoldedToken Fold(const u8 *token, u32 len);
+
+    // entries[pos]の位置だけが正しくないときに、正しい位置まで動かす
+    void Settle(u32 pos);
+
+    void Swap(u32 i, u32 j);
+    // entries[from]をtoに移し、間にあるものを1つずつずらす
+    void Move(u32 from, u32 to);
+
+    u32 GetNumFront() const;
+
+    // 公開する順
+    std::vector<AFLDictData> entries;
+    // entries[i]のID。IDは置き換えられたエントリのものを使い回すので、MAX_AUTO_EXTRAS未満
+    std::vector<u32> ids;
+    // IDからentries内の位置と、キーを引く
+    std::vector<u32> pos_of;
+    std::vector<FoldedToken> key_of;
+
+    std::unordered_map<FoldedToken, u32, FoldedTokenHash> index;
+
+    u64 version = 0;
+};
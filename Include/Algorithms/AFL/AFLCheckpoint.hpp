@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Options.hpp"
+#include "Utils/Common.hpp"
+#include "Utils/Random.hpp"
+#include "Algorithms/AFL/AFLDictData.hpp"
+
+// 中断したファザーを、キューを較正し直さずに再開するためのもの
+// queue/.state/checkpointに定期的に保存され、そのキューを入力にして再開したときに読まれる
+//
+// 責務：
+//  - 較正を終えたキューの要素毎の結果と、virgin_bits等のビットマップ、top_rated、
+//    自動辞書、統計の値、乱数の状態を持つこと
+//  - 要素を名前で識別すること
+//      - 再開したときに名前と内容のハッシュ値が一致した要素だけを較正済みとし、それ以外は較正し直す
+struct AFLCheckpoint {
+    static constexpr u32 NO_ENTRY = u32(-1);
+
+    struct Entry {
+        std::string name;
+        Util::Hash128Value hash;      /* Hash of the contents             */
+        u32 exec_cksum = 0;           /* Checksum of the execution trace  */
+        u32 bitmap_size = 0;          /* Number of bits set in bitmap     */
+        u64 exec_us = 0;              /* Execution time (us)              */
+        u64 handicap = 0;             /* Number of queue cycles behind    */
+        u64 depth = 0;                /* Path depth                       */
+        bool trim_done = false;       /* Trimmed?                         */
+        bool was_fuzzed = false;      /* Had any fuzzing done yet?        */
+        bool has_new_cov = false;     /* Triggers new coverage?           */
+        bool var_behavior = false;    /* Variable behavior?               */
+
+        /* Trace bytes packed into bits, or empty if not kept */
+        std::vector<u8> trace_mini;
+    };
+
+    // 再開後もそのまま引き継ぐ統計の値
+    // u64だけを並べ、パディングを含まないようにしている
+    struct Counters {
+        u64 queue_cycle = 0;
+        u64 current_entry = 0;
+        u64 cycles_wo_finds = 0;
+        u64 total_execs = 0;
+        u64 total_crashes = 0;
+        u64 unique_crashes = 0;
+        u64 total_tmouts = 0;
+        u64 unique_tmouts = 0;
+        u64 unique_hangs = 0;
+        u64 last_crash_execs = 0;
+        u64 slowest_exec_ms = 0;
+        u64 trim_execs = 0;
+        u64 bytes_trim_in = 0;
+        u64 bytes_trim_out = 0;
+        u64 blocks_eff_total = 0;
+        u64 blocks_eff_select = 0;
+        u64 total_cal_us = 0;
+        u64 total_cal_cycles = 0;
+        u64 total_bitmap_size = 0;
+        u64 total_bitmap_entries = 0;
+    };
+
+    // 較正の結果を変えるものが変わっていれば、チェックポイントは使わない
+    u64 target_size = 0;
+    u64 target_mtime = 0;
+    u32 crash_mode = 0;
+
+    std::vector<Entry> entries;
+
+    /* Index of the winner in entries for each bitmap byte, or NO_ENTRY */
+    std::vector<u32> top_rated;
+
+    std::vector<u8> virgin_bits;
+    std::vector<u8> virgin_tmout;
+    std::vector<u8> virgin_crash;
+    std::vector<u8> var_bytes;
+
+    std::vector<u64> stage_finds;
+    std::vector<u64> stage_cycles;
+
+    /* Auto extras in the order of AFLAutoDict::GetEntries() */
+    std::vector<AFLDictData> a_extras;
+
+    fuzzuf::utils::random::prng::state_type rng{};
+
+    Counters counters;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include "Options.hpp"
+#include "Utils/Common.hpp"
+
+// Layout of the comparison log map, shared with the instrumentation runtime.
+// The map is registered to NativeLinuxExecutor as AFLOption::CMPLOG_MAP_NAME,
+// and its location is handed to the PUT via FeedbackMapRegistry::LAYOUT_ENV_VAR.
+//
+// The runtime is expected to append one CmpLogEntry per executed comparison
+// while header.num_entries < AFLOption::CMPLOG_MAX_ENTRIES, and to do nothing
+// otherwise. The fuzzer clears num_entries only right before the run whose
+// operands it wants to collect, so the other executions don't pay for logging.
+// A freshly allocated map is all zeros, i.e. logging is enabled, so the fuzzer
+// has to disable it with DisableLog() before the first execution.
+
+namespace afl {
+namespace cmplog {
+
+struct CmpLogHeader {
+    u32 num_entries;
+    u32 reserved;
+};
+
+struct CmpLogEntry {
+    u32 size;       /* Width of the operands in bytes (1, 2, 4 or 8) */
+    u32 reserved;
+    u64 operands[2];
+};
+
+constexpr u32 MAP_SIZE =
+    sizeof(CmpLogHeader) + sizeof(CmpLogEntry) * AFLOption::CMPLOG_MAX_ENTRIES;
+
+// Mark the log as full, so that the runtime appends nothing to it.
+inline void DisableLog(u8 *map) {
+    CmpLogHeader header{AFLOption::CMPLOG_MAX_ENTRIES, 0};
+    std::memcpy(map, &header, sizeof(header));
+}
+
+} // namespace cmplog
+} // namespace afl
@@ -20,7 +20,7 @@ struct AFLDictData {
       data( v ), hit_cnt( h ) {
     }
 
-    const std::vector<u8> get() const {
+    const word_t &get() const {
       return data;
     }
 
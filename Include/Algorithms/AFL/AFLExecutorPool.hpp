@@ -0,0 +1,110 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Utils/Common.hpp"
+#include "Feedback/PUTExitReasonType.hpp"
+#include "Executor/NativeLinuxExecutor.hpp"
+#include "Algorithms/AFL/AFLSetting.hpp"
+
+struct AFLState;
+
+// 決定的ステージのミュータント、dry runで較正する初期シード、トリミングの候補を、複数のNativeLinuxExecutorで並列に実行するためのプール
+//
+// 責務：
+//  - 各ワーカーは専用のExecutor（fork server、共有メモリ、入力を書き出すファイル）を持つこと
+//      - 1つ目のワーカーはAFLStateが使うExecutorをそのまま使う
+//  - ミュータントはシードに対するパッチとして与えられ、各ワーカーはシードの複製にパッチを当てて実行すること
+//  - 各ミュータントについて、逐次実行した場合にキューに残る可能性があるかを判定し、元の順で返すこと
+//      - 可能性があると判定されたものはAFLStateのExecutorで実行し直される前提なので、
+//        このクラス自体はAFLStateを一切書き換えない
+//  - 初期シードは較正と同じ回数だけ実行し、その結果を元の順で返すこと
+//      - AFLStateへの反映はafl::util::ReplayCalibrationがシードの順に行う
+//  - 長さの異なる任意の入力を実行し、トレースのチェックサムと終了の仕方を返すこと（トリミング用）
+// fork server modeでしか使えない。non fork server modeのタイムアウトはプロセス全体のSIGALRMで実現されているため
+class AFLExecutorPool {
+public:
+    // seed[pos, pos+len)をdata[data_off, data_off+len)で置き換えたものが1つのミュータントになる
+    struct Patch {
+        u32 pos;
+        u32 len;
+        u32 data_off;
+    };
+
+    struct Result {
+        u32 cksum = 0;
+        PUTExitReasonType exit_reason = PUTExitReasonType::FAULT_NONE;
+        // 新しいビットを持っているか、正常終了しなかった
+        bool interesting = false;
+    };
+
+    // 1つのシードを較正のために繰り返し実行した結果
+    struct Calibration {
+        // 最後の実行の終了の仕方。crash_modeと異なる場合は、そこで実行を止めている
+        PUTExitReasonType exit_reason = PUTExitReasonType::FAULT_NONE;
+        // 実行毎のトレースのチェックサムと、1回目の実行を始めてからその実行を終えるまでの時間
+        std::vector<u32> cksums;
+        std::vector<u64> elapsed_us;
+        // 1回目の実行のトレース
+        std::vector<u8> first_trace;
+        // 1回目と異なるチェックサムになったトレースについて、1回目と異なるバイトの位置と値
+        // トレースが変動するターゲットでも、異なるのは一部のバイトだけなので、トレース全体は持たない
+        std::unordered_map<u32, std::vector<std::pair<u32, u8>>> trace_diffs;
+
+        // チェックサムがcksumだった実行のトレースを組み立てる
+        std::vector<u8> GetTrace(u32 cksum) const;
+    };
+
+    // main_executorの他にnum_workers-1個のExecutorを作る
+    AFLExecutorPool(
+        const AFLSetting &setting,
+        NativeLinuxExecutor &main_executor,
+        u32 num_workers
+    );
+    ~AFLExecutorPool();
+
+    AFLExecutorPool(const AFLExecutorPool&) = delete;
+    AFLExecutorPool& operator=(const AFLExecutorPool&) = delete;
+
+    u32 GetNumWorkers(void) const { return executors.size(); }
+
+    // 実行したミュータントの数を返す。stop_soonが立った場合はpatches.size()より少ないことがある
+    u64 Run(
+        const AFLState &state,
+        const u8 *seed,
+        u32 len,
+        const std::vector<Patch> &patches,
+        const std::vector<u8> &data,
+        std::vector<Result> &results
+    );
+
+    // inputs[i]をそれぞれ較正と同じ回数だけ実行し、results[i]に入れる
+    // トレースが変動したものは、逐次に較正した場合の回数を必ず満たすようCAL_CYCLES_LONG回まで実行する
+    // 実行した回数を返す
+    u64 Calibrate(
+        const AFLState &state,
+        const std::vector<std::pair<const u8*, u32>> &inputs,
+        u32 tmout,
+        std::vector<Calibration> &results
+    );
+
+    // inputs[i]をそれぞれ1回実行し、cksumとexit_reasonをresults[i]に入れる（interestingは使わない）
+    // チェックサムがkeep_cksumになった実行があれば、そのトレースをkept_traceに入れる（空の場合のみ）
+    // 実行した数を返す。stop_soonが立った場合はinputs.size()より少ないことがある
+    u64 RunInputs(
+        const AFLState &state,
+        const std::vector<std::pair<const u8*, u32>> &inputs,
+        std::vector<Result> &results,
+        u32 keep_cksum,
+        std::vector<u8> &kept_trace
+    );
+
+    void ReceiveStopSignal(void);
+
+private:
+    std::vector<NativeLinuxExecutor*> executors;
+    std::vector<std::unique_ptr<NativeLinuxExecutor>> own_executors;
+};
@@ -8,6 +8,7 @@
 #include "Fuzzer/Fuzzer.hpp"
 #include "Algorithms/AFL/AFLSetting.hpp"
 #include "Algorithms/AFL/AFLState.hpp"
+#include "Algorithms/AFL/AFLExecutorPool.hpp"
 #include "Algorithms/AFL/CountClasses.hpp"
 
 #include "HierarFlow/HierarFlowRoutine.hpp"
@@ -48,6 +49,8 @@ private:
     // nor operator=(). So we have no choice but to delay those constructors 
     std::unique_ptr<AFLState> state;
     std::unique_ptr<NativeLinuxExecutor> executor;
+    // only when AFL_DET_SHARDS is set
+    std::unique_ptr<AFLExecutorPool> det_executor_pool;
     HierarFlowNode<void(void), bool(std::shared_ptr<AFLTestcase>)> fuzz_loop;
 };
 
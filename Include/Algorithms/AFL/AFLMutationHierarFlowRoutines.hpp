@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <memory>
+#include <vector>
+#include "Utils/AhoCorasick.hpp"
 #include "ExecInput/ExecInput.hpp"
 #include "Algorithms/AFL/AFLState.hpp"
+#include "Algorithms/AFL/AFLExecutorPool.hpp"
 #include "Algorithms/AFL/AFLMutator.hpp"
 #include "Algorithms/AFL/AFLUtil.hpp"
 
@@ -18,67 +22,109 @@ using AFLMutInputType = bool(AFLMutator&);
 using AFLMutCalleeRef = NullableRef<HierarFlowCallee<AFLMutInputType>>;
 using AFLMutOutputType = bool(const u8*, u32);
 
-struct BitFlip1WithAutoDictBuild
+// the common part of the deterministic stages
+// If state.det_executor_pool is set, mutants are not executed on the spot.
+// They are recorded as patches to the seed and executed in parallel by the pool,
+// and only the ones which may be kept in the queue are passed to the successors
+// again, in the original order.
+// Each stage also reports which position it is mutating, so that the progress
+// can be saved and an aborted run can resume from there (see ApplyDetMuts).
+struct DetStageBase
     : public HierarFlowRoutine<
         AFLMutInputType,
         AFLMutOutputType
     > {
+public:
+    DetStageBase(AFLState &state);
+    virtual ~DetStageBase() {}
+
+protected:
+    // Try the mutant in mutator, which differs from the seed only in [pos, pos+len).
+    // Same as CallSuccessors when the stage is executed sequentially.
+    // If this returns true, the stage must be aborted.
+    bool TryMutant(AFLMutator &mutator, u32 pos, u32 len);
+
+    // Execute all the recorded mutants. Must be called at the end of every stage
+    bool FlushMutants(AFLMutator &mutator);
+
+    // Called for every mutant executed in parallel, in the original order,
+    // to do what the successors would do with the checksum of its trace
+    virtual void ReplayMutant(const u8* /* buf */, u32 /* len */, u32 /* cksum */) {}
+
+    // true if an earlier run has finished the stage (one of STAGE_*) for this entry
+    bool IsStageDone(u32 stage) const;
+
+    // The position the stage should start from.
+    // Non-zero only for the stage where an earlier run stopped.
+    u32 GetResumePos(u32 stage) const;
+
+    // Must be called before mutating each position of the stage.
+    // All the mutants of the positions before pos must have been passed to TryMutant.
+    void EnterPosition(u32 stage, u32 pos);
+
+    AFLState &state;
+
+private:
+    // the values of state referred by DescribeOp and the updates
+    // at the time each mutant was made
+    struct StageCursor {
+        s32 stage_cur;
+        s32 stage_cur_byte;
+        s32 stage_cur_val;
+        u8 stage_val_type;
+    };
+
+    std::vector<AFLExecutorPool::Patch> patches;
+    std::vector<u8> patch_data;
+    std::vector<StageCursor> cursors;
+    std::vector<AFLExecutorPool::Result> results;
+    std::vector<u8> replay_buf;
+
+    // the arguments of the last EnterPosition
+    u32 cur_stage = AFLOption::STAGE_FLIP1;
+    u32 cur_pos = 0;
+};
+
+struct BitFlip1WithAutoDictBuild
+    : public DetStageBase {
 public:
     BitFlip1WithAutoDictBuild(AFLState &state);
 
     AFLMutCalleeRef operator()(AFLMutator& mutator);
 
-private:
-    AFLState &state;
+protected:
+    void ReplayMutant(const u8* buf, u32 len, u32 cksum) override;
 };
 
 struct BitFlipOther
-    : public HierarFlowRoutine<
-          AFLMutInputType,
-          AFLMutOutputType
-      > {
+    : public DetStageBase {
 public:
     BitFlipOther(AFLState &state);
 
     AFLMutCalleeRef operator()(AFLMutator& mutator);
-
-private:
-    AFLState &state;
 };
 
 struct ByteFlip1WithEffMapBuild
-    : public HierarFlowRoutine<
-          AFLMutInputType,
-          AFLMutOutputType
-      > {
+    : public DetStageBase {
 public:
     ByteFlip1WithEffMapBuild(AFLState &state);
 
     AFLMutCalleeRef operator()(AFLMutator& mutator);
 
-private:
-    AFLState &state;
+protected:
+    void ReplayMutant(const u8* buf, u32 len, u32 cksum) override;
 };
 
 struct ByteFlipOther
-    : public HierarFlowRoutine<
-          AFLMutInputType,
-          AFLMutOutputType
-      > {
+    : public DetStageBase {
 public:
     ByteFlipOther(AFLState &state);
 
     AFLMutCalleeRef operator()(AFLMutator& mutator);
-
-private:
-    AFLState &state;
 };
 
 struct Arith
-    : public HierarFlowRoutine<
-          AFLMutInputType,
-          AFLMutOutputType
-      > {
+    : public DetStageBase {
 public:
     Arith(AFLState &state);
 
@@ -88,9 +134,6 @@ public:
     bool DoArith(AFLMutator &mutator);
 
     AFLMutCalleeRef operator()(AFLMutator& mutator);
-
-private:
-    AFLState &state;
 };
 
 template<class UInt>
@@ -98,6 +141,13 @@ bool Arith::DoArith(AFLMutator &mutator) {
     using afl::util::EFF_APOS;
     constexpr auto byte_width = sizeof(UInt);   
 
+    int stage_idx;
+    if (byte_width == 1) stage_idx = AFLOption::STAGE_ARITH8;
+    else if (byte_width == 2) stage_idx = AFLOption::STAGE_ARITH16;
+    else if (byte_width == 4) stage_idx = AFLOption::STAGE_ARITH32;
+
+    if (IsStageDone(stage_idx)) return false;
+
     u64 orig_hit_cnt = state.queued_paths + state.unique_crashes;
     u32 num_mutable_pos = mutator.GetLen() + 1 - byte_width;
 
@@ -111,7 +161,9 @@ bool Arith::DoArith(AFLMutator &mutator) {
 
     state.stage_max = times_mut_per_unit * num_mutable_pos * AFLOption::ARITH_MAX;
     
-    for (u32 i=0; i < num_mutable_pos; i++) {
+    for (u32 i=GetResumePos(stage_idx); i < num_mutable_pos; i++) {
+        EnterPosition(stage_idx, i);
+
         if (!state.eff_map[EFF_APOS(i)] && !state.eff_map[EFF_APOS(i + byte_width - 1)]) {
             state.stage_max -= times_mut_per_unit * AFLOption::ARITH_MAX;
             continue;
@@ -124,14 +176,14 @@ bool Arith::DoArith(AFLMutator &mutator) {
 
             if (mutator.AddN<UInt>(i, j, false)) {
                 state.stage_cur_val = j;
-                if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) return true;
+                if (TryMutant(mutator, i, byte_width)) return true;
                 state.stage_cur++;
                 mutator.RestoreOverwrite<UInt>();
             } else state.stage_max--;
 
             if (mutator.SubN<UInt>(i, j, false)) {
                 state.stage_cur_val = -j;
-                if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) return true;
+                if (TryMutant(mutator, i, byte_width)) return true;
                 state.stage_cur++;
                 mutator.RestoreOverwrite<UInt>();
             } else state.stage_max--;
@@ -143,14 +195,14 @@ bool Arith::DoArith(AFLMutator &mutator) {
 
             if (mutator.AddN<UInt>(i, j, true)) {
                 state.stage_cur_val = j;
-                if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) return true;
+                if (TryMutant(mutator, i, byte_width)) return true;
                 state.stage_cur++;
                 mutator.RestoreOverwrite<UInt>();
             } else state.stage_max--;
 
             if (mutator.SubN<UInt>(i, j, true)) {
                 state.stage_cur_val = -j;
-                if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) return true;
+                if (TryMutant(mutator, i, byte_width)) return true;
                 state.stage_cur++;
                 mutator.RestoreOverwrite<UInt>();
             } else state.stage_max--;
@@ -158,10 +210,7 @@ bool Arith::DoArith(AFLMutator &mutator) {
         }
     }
 
-    int stage_idx;
-    if (byte_width == 1) stage_idx = AFLOption::STAGE_ARITH8;
-    else if (byte_width == 2) stage_idx = AFLOption::STAGE_ARITH16;
-    else if (byte_width == 4) stage_idx = AFLOption::STAGE_ARITH32;
+    if (FlushMutants(mutator)) return true;
 
     u64 new_hit_cnt = state.queued_paths + state.unique_crashes;
     state.stage_finds[stage_idx] += new_hit_cnt - orig_hit_cnt;
@@ -171,10 +220,7 @@ bool Arith::DoArith(AFLMutator &mutator) {
 }
 
 struct Interest
-    : public HierarFlowRoutine<
-          AFLMutInputType,
-          AFLMutOutputType
-      > {
+    : public DetStageBase {
 public:
     Interest(AFLState &state);
 
@@ -184,9 +230,6 @@ public:
     bool DoInterest(AFLMutator &mutator);
 
     AFLMutCalleeRef operator()(AFLMutator& mutator);
-
-private:
-    AFLState &state;
 };
 
 template<class UInt>
@@ -194,6 +237,13 @@ bool Interest::DoInterest(AFLMutator &mutator) {
     using afl::util::EFF_APOS;
     constexpr auto byte_width = sizeof(UInt);
 
+    int stage_idx;
+    if constexpr (byte_width == 1) stage_idx = AFLOption::STAGE_INTEREST8;
+    else if constexpr (byte_width == 2) stage_idx = AFLOption::STAGE_INTEREST16;
+    else if constexpr (byte_width == 4) stage_idx = AFLOption::STAGE_INTEREST32;
+
+    if (IsStageDone(stage_idx)) return false;
+
     u64 orig_hit_cnt = state.queued_paths + state.unique_crashes;
     u32 num_mutable_pos = mutator.GetLen() + 1 - byte_width;
 
@@ -215,7 +265,9 @@ bool Interest::DoInterest(AFLMutator &mutator) {
     state.stage_cur = 0;
     state.stage_max = num_endians * num_mutable_pos * interest_values->size();
 
-    for (u32 i=0; i < num_mutable_pos; i++) {
+    for (u32 i=GetResumePos(stage_idx); i < num_mutable_pos; i++) {
+        EnterPosition(stage_idx, i);
+
         /* Let's consult the effector map... */
 
         if (!state.eff_map[EFF_APOS(i)] && !state.eff_map[EFF_APOS(i + byte_width - 1)]) {
@@ -231,7 +283,7 @@ bool Interest::DoInterest(AFLMutator &mutator) {
             if (mutator.InterestN<UInt>(i, j, false)) {
                 state.stage_val_type = AFLOption::STAGE_VAL_LE;
 
-                if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) return true;
+                if (TryMutant(mutator, i, byte_width)) return true;
 
                 state.stage_cur++;
                 mutator.RestoreOverwrite<UInt>();
@@ -242,7 +294,7 @@ bool Interest::DoInterest(AFLMutator &mutator) {
             if (mutator.InterestN<UInt>(i, j, true)) {
                 state.stage_val_type = AFLOption::STAGE_VAL_BE;
 
-                if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) return true;
+                if (TryMutant(mutator, i, byte_width)) return true;
 
                 state.stage_cur++;
                 mutator.RestoreOverwrite<UInt>();
@@ -250,10 +302,7 @@ bool Interest::DoInterest(AFLMutator &mutator) {
         }
     }
 
-    int stage_idx;
-    if constexpr (byte_width == 1) stage_idx = AFLOption::STAGE_INTEREST8;
-    else if constexpr (byte_width == 2) stage_idx = AFLOption::STAGE_INTEREST16;
-    else if constexpr (byte_width == 4) stage_idx = AFLOption::STAGE_INTEREST32;
+    if (FlushMutants(mutator)) return true;
 
     u64 new_hit_cnt = state.queued_paths + state.unique_crashes;
     state.stage_finds[stage_idx] += new_hit_cnt - orig_hit_cnt;
@@ -267,24 +316,54 @@ bool Interest::DoInterest(AFLMutator &mutator) {
 //   a) use user-defined dictionary b) use automatically created dictionary
 // they are different stages but the processes are almost the same
 // so we put them into one template function
+// On inputs longer than DICT_SITES_MIN_LEN, the offsets where some token already
+// occurs are tried first, and then all the others. The occurrences are located
+// in one pass with a matcher compiled from the tokens, which is rebuilt only
+// when the dictionary changes.
 template<bool is_auto>
 struct DictOverwrite
-    : public HierarFlowRoutine<
-          AFLMutInputType,
-          AFLMutOutputType
-      > {
+    : public DetStageBase {
 public:
     DictOverwrite(AFLState &state);
 
     AFLMutCalleeRef operator()(AFLMutator& mutator);
 
 private:
-    AFLState &state;
+    void CompileMatcher(const std::vector<AFLDictData> &extras, u32 num_used_extra);
+
+    fuzzuf::utils::aho_corasick::matcher matcher;
+    u64 matcher_version = ~u64(0);
+    u32 matcher_size = 0;
+
+    // the offsets of the current seed in the order they are tried:
+    // the ones where some token occurs, then the rest, each in ascending order
+    std::vector<u32> order;
 };
 
 template<bool is_auto>
 DictOverwrite<is_auto>::DictOverwrite(AFLState &state)
-    : state(state) {}
+    : DetStageBase(state) {}
+
+template<bool is_auto>
+void DictOverwrite<is_auto>::CompileMatcher(
+    const std::vector<AFLDictData> &extras,
+    u32 num_used_extra
+) {
+    // user extras never change after they are loaded
+    u64 version = 0;
+    if constexpr (is_auto) version = state.a_extras.GetVersion();
+
+    if (version == matcher_version && num_used_extra == matcher_size) return;
+
+    matcher.clear();
+    for (u32 j=0; j<num_used_extra; j++) {
+        matcher.add(extras[j].data.data(), extras[j].data.size());
+    }
+    matcher.compile();
+
+    matcher_version = version;
+    matcher_size = num_used_extra;
+}
 
 template<bool is_auto>
 AFLMutCalleeRef DictOverwrite<is_auto>::operator()(
@@ -297,6 +376,15 @@ AFLMutCalleeRef DictOverwrite<is_auto>::operator()(
         if (state.extras.empty())   return GoToDefaultNext();
     }
 
+    int stage_idx;
+    if (is_auto) {
+        stage_idx = AFLOption::STAGE_EXTRAS_AO;
+    } else {
+        stage_idx = AFLOption::STAGE_EXTRAS_UO;
+    }
+
+    if (IsStageDone(stage_idx)) return GoToDefaultNext();
+
     /* Overwrite with user-supplied extras. */
 
     using afl::util::EFF_APOS;
@@ -312,6 +400,33 @@ AFLMutCalleeRef DictOverwrite<is_auto>::operator()(
         state.stage_short = "ext_UO";
         num_used_extra = state.extras.size();
     }
+    const auto& extras = is_auto ? state.a_extras.GetEntries() : state.extras;
+
+    /* On long inputs, overwriting most offsets just breaks the input in
+       uninteresting ways. Start with the offsets where some token is already
+       there, so that a token gets replaced by another one, and go through the
+       others after them. Every offset is still tried; this only brings the
+       likely finds forward. The progress is recorded as the number of offsets
+       done in this order, which is the offset itself without any site. */
+
+    order.clear();
+    if (mutator.GetLen() >= AFLOption::DICT_SITES_MIN_LEN) {
+        CompileMatcher(extras, num_used_extra);
+
+        matcher.scan(mutator.GetBuf(), mutator.GetLen(),
+            [this](std::size_t pos, u32) { order.emplace_back(pos); });
+        std::sort(order.begin(), order.end());
+        order.erase(std::unique(order.begin(), order.end()), order.end());
+
+        if (!order.empty()) {
+            u32 num_sites = order.size();
+            for (u32 i=0, j=0; i<mutator.GetLen(); i++) {
+                if (j < num_sites && order[j] == i) j++;
+                else order.emplace_back(i);
+            }
+        }
+    }
+
     state.stage_cur = 0;
     state.stage_max = mutator.GetLen() * num_used_extra;
 
@@ -319,9 +434,11 @@ AFLMutCalleeRef DictOverwrite<is_auto>::operator()(
 
     u64 orig_hit_cnt = state.queued_paths + state.unique_crashes;
 
-    auto& extras = is_auto ? state.a_extras : state.extras;
+    for (u32 k=GetResumePos(stage_idx); k<mutator.GetLen(); k++) {
+        u32 i = order.empty() ? k : order[k];
+
+        EnterPosition(stage_idx, k);
 
-    for (u32 i=0; i<mutator.GetLen(); i++) {
         state.stage_cur_byte = i;
 
         /* Extras are sorted by size, from smallest to largest. This means
@@ -341,7 +458,7 @@ AFLMutCalleeRef DictOverwrite<is_auto>::operator()(
             using afl::util::UR;
             if (!is_auto) {
                 if ( extras.size() > AFLOption::MAX_DET_EXTRAS
-                  && UR(state.extras.size(), state.rand_fd) >= AFLOption::MAX_DET_EXTRAS) {
+                  && UR(state.extras.size(), state.rng) >= AFLOption::MAX_DET_EXTRAS) {
                     state.stage_max--;
                     continue;
                 }
@@ -358,7 +475,7 @@ AFLMutCalleeRef DictOverwrite<is_auto>::operator()(
             last_len = extra.data.size();
             mutator.Replace(i, &extra.data[0], last_len);
 
-            if (CallSuccessors(mutator.GetBuf(), mutator.GetLen())) {
+            if (TryMutant(mutator, i, last_len)) {
                 SetResponseValue(true);
                 return GoToParent();
             }
@@ -369,15 +486,13 @@ AFLMutCalleeRef DictOverwrite<is_auto>::operator()(
         mutator.Replace(i, mutator.GetSource().GetBuf() + i, last_len);
     }
 
-    u64 new_hit_cnt = state.queued_paths + state.unique_crashes;
-
-    int stage_idx;
-    if (is_auto) {
-        stage_idx = AFLOption::STAGE_EXTRAS_AO;
-    } else {
-        stage_idx = AFLOption::STAGE_EXTRAS_UO;
+    if (FlushMutants(mutator)) {
+        SetResponseValue(true);
+        return GoToParent();
     }
 
+    u64 new_hit_cnt = state.queued_paths + state.unique_crashes;
+
     state.stage_finds[stage_idx]  += new_hit_cnt - orig_hit_cnt;
     state.stage_cycles[stage_idx] += state.stage_max;
 
@@ -387,6 +502,22 @@ AFLMutCalleeRef DictOverwrite<is_auto>::operator()(
 using UserDictOverwrite = DictOverwrite<false>;
 using AutoDictOverwrite = DictOverwrite<true>;
 
+// the stage of replacing bytes which appear as an operand of a comparison
+// with the other operand of the comparison (so-called "input-to-state")
+// the operands are retrieved from the comparison log map filled by the PUT
+// its mutants are executed sequentially: only the progress is tracked with DetStageBase
+struct InputToState
+    : public DetStageBase {
+public:
+    InputToState(AFLState &state);
+
+    AFLMutCalleeRef operator()(AFLMutator& mutator);
+
+private:
+    bool has_seen_cmplog = false;
+    u32 empty_cmplog_runs = 0;
+};
+
 struct UserDictInsert
     : public HierarFlowRoutine<
           AFLMutInputType,
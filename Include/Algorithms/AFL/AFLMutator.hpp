@@ -30,7 +30,7 @@ public:
     // ムーブコンストラクタ
     AFLMutator(AFLMutator&&);
 
-    AFLMutator( const ExecInput&, const AFLState& );
+    AFLMutator( const ExecInput&, AFLState& );
     ~AFLMutator();
 
     u32 ChooseBlockLen(u32);
@@ -1,14 +1,20 @@
 #pragma once
 
+#include <array>
 #include <vector>
 #include <string>
 #include <memory>
+#include <unordered_map>
 
 #include "Options.hpp"
 #include "Utils/Common.hpp"
 #include "Utils/Filesystem.hpp"
+#include "Utils/Random.hpp"
+#include "Utils/AsyncFileWriter.hpp"
+#include "Mutator/MutationArena.hpp"
 #include "ExecInput/ExecInput.hpp"
 #include "ExecInput/ExecInputSet.hpp"
+#include "ExecInput/PackedCorpusStore.hpp"
 #include "Executor/NativeLinuxExecutor.hpp"
 #include "Feedback/InplaceMemoryFeedback.hpp"
 #include "Feedback/ExitStatusFeedback.hpp"
@@ -16,6 +22,10 @@
 #include "Algorithms/AFL/AFLMacro.hpp"
 #include "Algorithms/AFL/AFLTestcase.hpp"
 #include "Algorithms/AFL/AFLDictData.hpp"
+#include "Algorithms/AFL/AFLAutoDict.hpp"
+#include "Algorithms/AFL/AFLCheckpoint.hpp"
+
+class AFLExecutorPool;
 
 // 責務：
 //   - 本クラスのインスタンスのライフタイムは、HierarFlowのそれよりも長くなければならない
@@ -42,6 +52,9 @@ struct AFLState {
     void MaybeUpdatePlotFile(double bitmap_cvg, double eps);
     void ShowStats(void);
 
+    void SaveCheckpoint(void);
+    std::vector<bool> RestoreCheckpoint(const AFLCheckpoint &checkpoint);
+
     void ReceiveStopSignal(void);
 
     bool ShouldConstructAutoDict(void);
@@ -49,13 +62,23 @@ struct AFLState {
 
     const AFLSetting &setting;
     NativeLinuxExecutor& executor;
+    // dry runと決定的ステージを並列に実行する場合のみ非nullptr。1つ目のワーカーはexecutorを使う
+    AFLExecutorPool *det_executor_pool = nullptr;
     ExecInputSet input_set;
-
-    // TODO: what if this product works on environments other than *NIX?
-    int rand_fd = -1;
+    // キューの要素、クラッシュ、queue/.state/の印のファイルはこのスレッドで書き込む
+    // 書き込みを終えたことを保証する必要がある場合はflush()を呼ぶ
+    std::shared_ptr<fuzzuf::utils::async_file_writer> file_writer;
+    // AFL_PACKED_CORPUSが設定されている場合のみ非null
+    // 非nullの場合、queue/の要素とqueue/.state/の印はファイルではなくここに保存する
+    std::shared_ptr<PackedCorpusStore> corpus_store;
+
+    // このファザーの全ての乱数はここから引く
+    fuzzuf::utils::random::prng rng;
+    // シード毎に作られるAFLMutatorはここからバッファを借りる
+    MutationArena mutation_arena;
 
     // these will be required in dictionary construction
-    std::vector<u8> a_collect;
+    std::array<u8, AFLOption::MAX_AUTO_EXTRA> a_collect;
     u32 a_len;
 
     // this will be required in dictionary construction and eff_map construction
@@ -94,6 +117,18 @@ struct AFLState {
     std::vector<u8> eff_map;
     u32 prev_cksum;
 
+    // where the deterministic stages of the current entry are, which is saved
+    // periodically, and where they should resume from, if an earlier run left it
+    AFLDetProgress det_progress;
+    std::unique_ptr<AFLDetProgress> det_resume;
+    u64 last_det_checkpoint_ms = 0;
+
+    // the checkpoint left in the input directory by an earlier run, which
+    // PerformDryRun uses and then drops
+    std::unique_ptr<AFLCheckpoint> resume_checkpoint;
+    // checkpoints are saved only once every entry has been calibrated
+    bool dry_run_done = false;
+
     u32 seek_to = 0; // = find_start_position();
 
     /*
@@ -136,6 +171,7 @@ struct AFLState {
     bool persistent_mode = false;           /* Running in persistent mode?      */
     bool deferred_mode = false;             /* Deferred forkserver mode?        */
     bool fast_cal = false;                  /* Try to calibrate faster?         */
+    bool no_cmplog = false;                 /* PUT doesn't log comparisons?     */
 
     /* Regions yet untouched by fuzzing */
     std::vector<u8> virgin_bits; // its initialization depends on in_bitmap
@@ -149,6 +185,10 @@ struct AFLState {
     /* Bytes that appear to be variable */
     std::vector<u8> var_bytes    = std::vector<u8>(AFLOption::MAP_SIZE, 0);
 
+    /* Hashes of the contents of queue entries, with the number of entries
+       having each (only trimming can make two entries equal) */
+    std::unordered_map<Util::Hash128Value, u32, Util::Hash128Value::Hasher> content_hashes;
+
     u8 stop_soon = 0;                       /* Ctrl-C pressed?                  */
     bool clear_screen = true;               /* Window resized?                  */
 
@@ -159,6 +199,7 @@ struct AFLState {
     u32 queued_imported = 0;                /* Items imported via -S            */
     u32 queued_favored = 0;                 /* Paths deemed favorable           */
     u32 queued_with_cov = 0;                /* Paths with new coverage bytes    */
+    u32 queued_duplicates = 0;              /* Copies of queue entries rejected */
     u32 pending_not_fuzzed = 0;             /* Queued but not done yet          */
     u32 pending_favored = 0;                /* Pending favored paths            */
     u32 cur_skipped_paths = 0;              /* Abandoned inputs in cur cycle    */
@@ -166,6 +207,8 @@ struct AFLState {
     u32 max_depth = 0;                      /* Max path depth                   */
     u32 useless_at_start = 0;               /* Number of useless starting paths */
     u32 var_byte_count = 0;                 /* Bitmap bytes with var behavior   */
+    u32 virgin_touched_bytes = 0;           /* Non-255 bytes in virgin_bits     */
+    u32 virgin_cleared_bits = 0;            /* Bits cleared from virgin_bits    */
     u32 current_entry = 0;                  /* Current queue entry ID           */
     u32 havoc_div = 1;                      /* Cycle count divisor for havoc    */
 
@@ -225,6 +268,8 @@ struct AFLState {
 
     /* Fuzzing queue (vector)           */
     std::vector<std::shared_ptr<AFLTestcase>> case_queue; 
+    // case_queueの要素の、スケジューリングに使う値。添字はcase_queueと同じ
+    AFLQueueMeta queue_meta;
 
     /* Top entries for bitmap bytes     */
     std::vector<NullableRef<AFLTestcase>> top_rated 
@@ -234,7 +279,7 @@ struct AFLState {
     std::vector<AFLDictData> extras;
 
     /* Automatically selected extras    */
-    std::vector<AFLDictData> a_extras;
+    AFLAutoDict a_extras;
 
 private:
     bool should_construct_auto_dict;
@@ -2,34 +2,95 @@
 
 #include <memory>
 #include <bitset>
+#include <optional>
+#include <vector>
 
 #include "Options.hpp"
 #include "ExecInput/OnDiskExecInput.hpp"
 
+// 決定的ステージをどこまで実行したか。queue/.state/det_progress/に保存され、
+// 中断されたファザーを再開したときに、続きから決定的ステージを実行するのに使われる
+struct AFLDetProgress {
+    u32 stage = AFLOption::STAGE_FLIP1; /* Stage being executed (STAGE_*) */
+    u32 pos = 0;                  /* First byte not fully mutated yet */
+
+    u32 len = 0;                  /* Length of the entry              */
+    u32 exec_cksum = 0;           /* Checksum of the execution trace  */
+
+    /* Effector map, once bitflip 8/8 has started: */
+    u32 eff_cnt = 0;
+    std::vector<u8> eff_map;
+};
+
+// キューの要素のうち、スケジューリングでキュー全体を走査するときに読まれるものを、
+// キューでのID毎の配列として持つもの
+//
+// 責務：
+//  - 要素毎の値を、フィールド毎に連続した配列に置くこと
+//      - CullQueueのようにキュー全体を見る処理が、要素毎のAFLTestcaseを辿らずに済むようにする
+// 値の読み書きはAFLTestcaseを通して行う
+// キュー全体を走査するのはCullQueueだけで、配列を直接読むのもそこだけである
+// CalcScoreやConsiderSkipMutが読むのは選ばれた1つの要素の値で、
+// 平均の実行時間やビットマップの大きさは較正の度に足し込まれる合計から求まるので、
+// どちらもアクセサを通して読んでも配列を走査するより遅くはならない
+struct AFLQueueMeta {
+    // 既定値の要素を末尾に加え、そのIDを返す
+    u32 Add();
+    u32 size() const { return exec_us.size(); }
+
+    std::vector<u64> exec_us;     /* Execution time (us)              */
+    std::vector<u32> bitmap_size; /* Number of bits set in bitmap     */
+    std::vector<u64> handicap;    /* Number of queue cycles behind    */
+    std::vector<u64> depth;       /* Path depth                       */
+    std::vector<u8> favored;      /* Currently favored?               */
+    std::vector<u8> was_fuzzed;   /* Had any fuzzing done yet?        */
+    std::vector<u8> fs_redundant; /* Marked as redundant in the fs?   */
+};
+
+// キューの要素
+//
+// AFLQueueMetaに置かれた値は、queue_idで引くアクセサを通して読み書きする
 struct AFLTestcase {
-    explicit AFLTestcase(std::shared_ptr<OnDiskExecInput> input);
+    // metaに要素を加え、そのIDをqueue_idとする
+    AFLTestcase(std::shared_ptr<OnDiskExecInput> input, AFLQueueMeta &meta);
     ~AFLTestcase();
 
+    u64 &ExecUs() { return meta->exec_us[queue_id]; }
+    u64 ExecUs() const { return meta->exec_us[queue_id]; }
+    u32 &BitmapSize() { return meta->bitmap_size[queue_id]; }
+    u32 BitmapSize() const { return meta->bitmap_size[queue_id]; }
+    u64 &Handicap() { return meta->handicap[queue_id]; }
+    u64 Handicap() const { return meta->handicap[queue_id]; }
+    u64 &Depth() { return meta->depth[queue_id]; }
+    u64 Depth() const { return meta->depth[queue_id]; }
+    u8 &Favored() { return meta->favored[queue_id]; }
+    bool Favored() const { return meta->favored[queue_id]; }
+    u8 &WasFuzzed() { return meta->was_fuzzed[queue_id]; }
+    bool WasFuzzed() const { return meta->was_fuzzed[queue_id]; }
+    u8 &FsRedundant() { return meta->fs_redundant[queue_id]; }
+    bool FsRedundant() const { return meta->fs_redundant[queue_id]; }
+
     std::shared_ptr<OnDiskExecInput> input;
 
+    AFLQueueMeta *meta;
+    u32 queue_id;                 /* Index in the queue and in meta   */
+
     u8 cal_failed = 0;            /* Calibration failed?              */
     bool trim_done = false;       /* Trimmed?                         */
-    bool was_fuzzed = false;      /* Had any fuzzing done yet?        */
     bool passed_det = false;      /* Deterministic stages passed?     */
     bool has_new_cov = false;     /* Triggers new coverage?           */
     bool var_behavior = false;    /* Variable behavior?               */
-    bool favored = false;         /* Currently favored?               */
-    bool fs_redundant = false;    /* Marked as redundant in the fs?   */
 
-    u32 bitmap_size = 0;          /* Number of bits set in bitmap     */
     u32 exec_cksum = 0;           /* Checksum of the execution trace  */
 
-    u64 exec_us = 0;              /* Execution time (us)              */
-    u64 handicap = 0;             /* Number of queue cycles behind    */
-    u64 depth = 0;                /* Path depth                       */
+    /* Hash of the contents, once registered in the content index */
+    std::optional<Util::Hash128Value> content_hash;
 
     /* Trace bytes, if kept             */
     std::unique_ptr<std::bitset<AFLOption::MAP_SIZE>> trace_mini;
 
     u32 tc_ref = 0;               /* Trace bytes ref count            */
+
+    /* Progress of deterministic stages left by an earlier, aborted run */
+    std::unique_ptr<AFLDetProgress> det_progress;
 };
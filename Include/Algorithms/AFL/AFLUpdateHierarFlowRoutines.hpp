@@ -20,6 +20,11 @@ using AFLUpdInputType = bool(const u8*, u32, InplaceMemoryFeedback&, ExitStatusF
 using AFLUpdCalleeRef = NullableRef<HierarFlowCallee<AFLUpdInputType>>;
 using AFLUpdOutputType = void(void);
 
+// The bodies of ConstructAutoDict and ConstructEffMap.
+// These are also used to replay the checksums of mutants executed in parallel
+void CollectAutoDict(AFLState &state, const u8 *buf, u32 cksum);
+void MarkEffMap(AFLState &state, u32 len, u32 cksum);
+
 struct NormalUpdate
     : public HierarFlowRoutine<
         AFLUpdInputType,
@@ -1,10 +1,14 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include "Utils/Common.hpp"
+#include "Utils/Random.hpp"
 #include "Feedback/InplaceMemoryFeedback.hpp"
 #include "Feedback/PUTExitReasonType.hpp"
 #include "Algorithms/AFL/AFLState.hpp"
+#include "Algorithms/AFL/AFLCheckpoint.hpp"
+#include "Algorithms/AFL/AFLExecutorPool.hpp"
 #include "Algorithms/AFL/AFLTestcase.hpp"
 
 namespace afl {
@@ -22,7 +26,7 @@ namespace util {
     template<class UInt>
     UInt EFF_SPAN_ALEN(UInt p, UInt l);
 
-    u32 UR(u32 limit, int rand_fd);
+    u32 UR(u32 limit, fuzzuf::utils::random::prng &rng);
 
     std::string DescribeInteger(u64 val);
     std::string DescribeFloat(double val);
@@ -33,10 +37,28 @@ namespace util {
     void MarkAsVariable(const AFLState& state, AFLTestcase &testcase);
     void MarkAsRedundant(const AFLState& state, AFLTestcase &testcase, bool val);
 
+    u32 DetStageRank(u32 stage);
+
+    void WriteDetProgress(const std::string &path, const AFLDetProgress &progress);
+    std::unique_ptr<AFLDetProgress> ReadDetProgress(const std::string &path);
+    void SaveDetProgress(const AFLState& state, const AFLTestcase &testcase, 
+                         const AFLDetProgress &progress);
+    void RemoveDetProgress(const AFLState& state, const AFLTestcase &testcase);
+    void CheckpointDetProgress(AFLState& state, const AFLTestcase &testcase);
+
+    void WriteCheckpoint(const std::string &path, const AFLCheckpoint &checkpoint);
+    std::unique_ptr<AFLCheckpoint> ReadCheckpoint(const std::string &path);
+
     template<class UInt> 
-    u8 DoHasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size, AFLState &state);
+    u8 DoHasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size, AFLState *state);
 
     u8 HasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size, AFLState &state);
+    // virgin_mapがAFLStateのものでない場合向け。AFLStateには一切触れないので、どのスレッドからでも呼べる
+    u8 HasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size);
+
+    Util::Hash128Value HashContent(const u8 *buf, u32 len);
+    bool IsKnownContent(const AFLState &state, const Util::Hash128Value &hash);
+    void MarkAsKnownContent(AFLState &state, AFLTestcase &testcase, const Util::Hash128Value &hash);
 
     template<class UInt>
     void SimplifyTrace(UInt *mem, u32 map_size);
@@ -54,6 +76,8 @@ namespace util {
         const InplaceMemoryFeedback &inp_feed
     );
 
+    u32 CalibrationTimeout(const AFLState &state, bool from_queue);
+
     PUTExitReasonType CalibrateCaseWithFeedDestroyed(
         AFLTestcase &testcase,
         const u8 *buf,
@@ -64,6 +88,13 @@ namespace util {
         u32 handicap,
         bool from_queue
     );
+
+    PUTExitReasonType ReplayCalibration(
+        AFLTestcase &testcase,
+        AFLState &state,
+        const AFLExecutorPool::Calibration &calibration,
+        u32 handicap
+    );
  
 std::shared_ptr<AFLTestcase> AddToQueue(
     AFLState &state,
@@ -101,10 +132,11 @@ UInt afl::util::EFF_SPAN_ALEN(UInt p, UInt l) {
    the hit-count for a particular tuple; 2 if there are new tuples seen.
    Updates the map, so subsequent calls will always return 0.
    This function is called after every exec() on a fairly large buffer, so
-   it needs to be fast. We do this in 32-bit and 64-bit flavors. */
+   it needs to be fast. We do this in 32-bit and 64-bit flavors.
+   state may be null when virgin_map doesn't belong to it. */
 
 template<class UInt>
-u8 afl::util::DoHasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size, AFLState &state) {
+u8 afl::util::DoHasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size, AFLState *state) {
     // we assume the word size is the same as sizeof(size_t)
     static_assert(sizeof(UInt) == sizeof(size_t));
 
@@ -122,6 +154,10 @@ u8 afl::util::DoHasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size, A
 
     u32 i = map_size >> wlog;
 
+    /* Keep the coverage counters of virgin_bits up to date, so that the
+       status screen doesn't have to rescan the whole map. */
+    bool is_virgin_bits = state && virgin_map == &state->virgin_bits[0];
+
     u8 ret = 0;
     while (i--) {
         /* Optimize for (*current & *virgin) == 0 - i.e., no bits in current bitmap
@@ -145,6 +181,16 @@ u8 afl::util::DoHasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size, A
                 if (ret != 2) ret = 1;
             }
 
+            if (is_virgin_bits) {
+                const u8* cur = (const u8*)current;
+                const u8* vir = (const u8*)virgin;
+
+                for (int j=0; j < width; j++) {
+                    if (cur[j] && vir[j] == 0xff) state->virgin_touched_bytes++;
+                }
+                state->virgin_cleared_bits += __builtin_popcountll(*current & *virgin);
+            }
+
             *virgin &= ~*current;
         }
 
@@ -152,7 +198,7 @@ u8 afl::util::DoHasNewBits(const u8 *trace_bits, u8 *virgin_map, u32 map_size, A
         virgin++;
     }
 
-    if (ret && virgin_map == &state.virgin_bits[0]) state.bitmap_changed = 1;
+    if (ret && is_virgin_bits) state->bitmap_changed = 1;
 
     return ret;
 }
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "Options.hpp"
+#include "Utils/Common.hpp"
+#include "Utils/Filesystem.hpp"
+#include "Utils/Random.hpp"
+
+namespace fuzzuf::algorithm::libfuzzer {
+
+// コーパスの要素。libFuzzerのInputInfoに相当する
+struct InputInfo {
+    std::vector<u8> data;
+    // queue/の下のファイル名。内容のハッシュの16進表記
+    std::string name;
+
+    // この要素が最小の入力になっている特徴の数。0になると要素は削除される
+    std::size_t num_features = 0;
+    std::size_t num_executed_mutations = 0;
+    std::size_t num_successful_mutations = 0;
+    // 同じ特徴を持つより小さい入力で置き換えられたことがある
+    bool reduced = false;
+
+    // 追加された時にこの要素だけが持っていた特徴(昇順)
+    // 変異後の入力がこれらを全て持ち、かつ小さければ置き換える
+    std::vector<u32> unique_feature_set;
+};
+
+// libFuzzerのInputCorpusに相当するもの
+//
+// 責務：
+//  - 特徴毎に、それを持つ最小の入力の大きさとその入力を覚えておくこと
+//      - 特徴はAFLのエッジとヒットカウントのクラスの組で、FEATURE_SET_SIZE通りある
+//      - どの特徴についても最小でなくなった入力はコーパスから削除する
+//  - 変異元の入力を、後から追加されたものほど選ばれやすいように選ぶこと
+//  - queue_dirが空でない場合、コーパスの要素をqueue_dir/<name>に書き出し、削除された要素のファイルを消すこと
+//
+// 削除された要素も添字を保つためにinputsに残り、dataが空になる
+class Corpus {
+public:
+    static constexpr std::size_t FEATURE_SET_SIZE = std::size_t(AFLOption::MAP_SIZE) * 8;
+
+    explicit Corpus(const fs::path &queue_dir);
+
+    Corpus(const Corpus&) = delete;
+    Corpus& operator=(const Corpus&) = delete;
+
+    // 削除された要素を含む要素数
+    std::size_t size() const { return inputs.size(); }
+    std::size_t NumActiveUnits() const;
+    bool empty() const { return NumActiveUnits() == 0; }
+    std::size_t MaxInputSize() const;
+    std::size_t SizeInBytes() const;
+
+    InputInfo &operator[](std::size_t idx) { return *inputs[idx]; }
+    const InputInfo &operator[](std::size_t idx) const { return *inputs[idx]; }
+
+    // 見つかった特徴の数
+    std::size_t NumFeatures() const { return num_added_features; }
+    // 特徴が見つかるか、より小さい入力で見つかった回数
+    std::size_t NumFeatureUpdates() const { return num_updated_features; }
+
+    bool HasUnit(const u8 *data, std::size_t size) const;
+
+    // 大きさnew_sizeの入力で特徴featureが見つかった
+    // 新しい特徴であるか、shrinkが真でこれまでより小さい入力で見つかった場合は真を返し、
+    // 次にAddToCorpusされる入力をその特徴の最小の入力とする
+    bool AddFeature(u32 feature, u32 new_size, bool shrink);
+
+    InputInfo &AddToCorpus(
+        const u8 *data,
+        std::size_t size,
+        std::size_t num_features,
+        std::vector<u32> &&feature_set
+    );
+
+    // iiを同じ特徴を持つより小さい入力で置き換える
+    void Replace(InputInfo &ii, const u8 *data, std::size_t size);
+
+    InputInfo &ChooseUnitToMutate(fuzzuf::utils::random::prng &rng);
+
+    static std::string ComputeName(const u8 *data, std::size_t size);
+
+private:
+    void DeleteInput(std::size_t idx);
+    void WriteUnitFile(const InputInfo &ii);
+    void DeleteUnitFile(const InputInfo &ii);
+    void UpdateCorpusDistribution();
+
+    fs::path queue_dir;
+
+    // 要素への参照を返すので、再確保で要素が動かないようにunique_ptrで持つ
+    std::vector<std::unique_ptr<InputInfo>> inputs;
+    // 同じ内容の要素が複数ある場合に備えて重複を許す
+    std::unordered_multiset<std::string> names;
+
+    std::vector<u32> smallest_element_per_feature;
+    // 0は特徴がまだ見つかっていないことを表す
+    std::vector<u32> input_sizes_per_feature;
+    std::size_t num_added_features = 0;
+    std::size_t num_updated_features = 0;
+
+    // 要素i番目の重みは、削除されていなければi+1
+    std::vector<u64> cumulative_weights;
+    bool distribution_needs_update = true;
+};
+
+} // namespace fuzzuf::algorithm::libfuzzer
@@ -8,6 +8,8 @@
 #include <algorithm>
 #include <boost/container/static_vector.hpp>
 #include <nlohmann/json.hpp>
+#include "Utils/AhoCorasick.hpp"
+#include "Utils/MapFile.hpp"
 namespace fuzzuf::algorithm::libfuzzer::dictionary {
   template< typename Word >
   class basic_dictionary_entry_t {
@@ -35,6 +37,10 @@ namespace fuzzuf::algorithm::libfuzzer::dictionary {
       return position_hint;
     }
 
+    void set_position_hint( size_t ph ) {
+      position_hint = ph;
+    }
+
     void increment_use_count() {
       ++use_count;
     }
@@ -120,7 +126,49 @@ namespace fuzzuf::algorithm::libfuzzer::dictionary {
    l << root.dump();
    return l;
   }
+
+  // mapped_dictionaryは要素のバイト列がmmapした変換済みの辞書ファイル(tools/dict2mpの出力)の領域を指している
+  // ロード時にバイト列のコピーもパースも行わず、同じ辞書を使うプロセス同士でページキャッシュを共有できる
+  // 要素が1つでも残っている間はmmapした領域は解放されない
+  using mapped_dictionary_entry_t = basic_dictionary_entry_t< utils::mapped_file_t >;
+  using mapped_dictionary_t = std::vector< mapped_dictionary_entry_t >;
   
+  // 辞書の全ての要素を登録した照合器を作る。照合器のIDは辞書内の添字になる
+  // 辞書を読み込んだ時に1回だけ作り、入力毎にupdate_position_hintに渡す事を想定している
+  template< typename Dict >
+  utils::aho_corasick::matcher compile_matcher( const Dict &dict ) {
+    utils::aho_corasick::matcher m;
+    for( const auto &v: dict ) {
+      const auto &word = v.get();
+      m.add( word.empty() ? nullptr : &*word.begin(), word.size() );
+    }
+    m.compile();
+    return m;
+  }
+
+  // data[0, len)を1回走査し、position_hintを持たない要素のうち
+  // dataに現れるものに、最初に現れた位置をposition_hintとして設定する
+  // mはcompile_matcher( dict )で作ったものであること
+  // position_hintを設定した要素の数を返す
+  template< typename Dict >
+  size_t update_position_hint(
+    Dict &dict,
+    const utils::aho_corasick::matcher &m,
+    const uint8_t *data,
+    size_t len
+  ) {
+    size_t count = 0u;
+    m.scan( data, len, [&]( size_t pos, uint32_t id ) {
+      auto &v = dict[ id ];
+      // 同じ要素の出現は開始位置の昇順に報告されるので、最初の報告が最初の出現
+      if( !v.has_position_hint() ) {
+        v.set_position_hint( pos );
+        ++count;
+      }
+    } );
+    return count;
+  }
+
   void load(
     const std::string &filename,
     static_dictionary_t&,
@@ -135,6 +183,14 @@ namespace fuzzuf::algorithm::libfuzzer::dictionary {
     const std::function< void( std::string&& ) > &eout
   );
 
+  // mapped_dictionary_tには変換済みの辞書しかロードできない。strictは無視される
+  void load(
+    const std::string &filename,
+    mapped_dictionary_t&,
+    bool strict,
+    const std::function< void( std::string&& ) > &eout
+  );
+
 }
 #endif
 
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <csignal>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "Utils/Common.hpp"
+#include "Utils/Random.hpp"
+#include "Fuzzer/Fuzzer.hpp"
+#include "Feedback/InplaceMemoryFeedback.hpp"
+#include "Algorithms/libFuzzer/LibFuzzerSetting.hpp"
+#include "Algorithms/libFuzzer/Corpus.hpp"
+#include "Algorithms/libFuzzer/MutationDispatcher.hpp"
+
+#include "Executor/NativeLinuxExecutor.hpp"
+
+namespace fuzzuf::algorithm::libfuzzer {
+
+// libFuzzerのFuzzer::Loopに相当するもの
+//
+// 責務：
+//  - シードと辞書を読み込み、MutateAndTestOneを繰り返すこと
+//      - PUTはlibFuzzerのようにプロセス内ではなく、NativeLinuxExecutorのフォークサーバで実行する
+//      - フィードバックはAFLのエッジカバレッジで、ヒットカウントのクラスを区別したものを特徴とする
+//  - 新しい特徴を見つけた入力をCorpusに加え、同じ特徴を持つより小さい入力が見つかれば置き換えること
+//  - クラッシュとタイムアウトを起こした入力を、それぞれout_dir/crashesとout_dir/hangsに保存すること
+//  - libFuzzerと同じ形式の状況表示を標準出力に出すこと
+class LibFuzzer : public Fuzzer {
+public:
+    explicit LibFuzzer(
+        // 参照渡しした変数は内部でコピーするので、ライフタイムの心配はありません。LibFuzzerSetting クラスを参照
+        const std::vector<std::string> &argv,
+        const std::string &in_dir,
+        const std::string &out_dir,
+        u32 exec_timelimit_ms,
+        u32 exec_memlimit,
+        bool forksrv,
+        const std::vector<std::string> &dict_paths,
+        u32 max_len
+    );
+
+    ~LibFuzzer();
+
+    void OneLoop(void);
+
+    void ReceiveStopSignal(void);
+
+    const Corpus &GetCorpus() const { return corpus; }
+    const MutationDispatcher &GetMutationDispatcher() const { return md; }
+    u64 GetTotalNumberOfRuns() const { return total_number_of_runs; }
+
+private:
+    enum class RunResult {
+        NONE,
+        NEW,     // 新しい特徴が見つかり、コーパスに加えた
+        REDUCE   // 変異元の入力を、同じ特徴を持つより小さい入力で置き換えた
+    };
+
+    void LoadDictionaries();
+    void ReadAndExecuteSeedCorpus();
+    void MutateAndTestOne();
+
+    // data[0, size)を実行し、見つかった特徴に応じてコーパスを更新する
+    // iiは変異元の入力で、iiが追加された時に持っていた特徴を全て持ち、かつiiより小さければiiを置き換える
+    RunResult RunOne(
+        const u8 *data,
+        u32 size,
+        InputInfo *ii,
+        bool force_add_to_corpus,
+        bool *found_unique_features
+    );
+
+    // 実行後のフィードバックから特徴を列挙する
+    template<class Func>
+    void CollectFeatures(const InplaceMemoryFeedback &inp_feed, Func &&func);
+
+    void SaveArtifact(const char *dir, const char *prefix, const u8 *data, u32 size);
+
+    void PrintStats(const char *where, const char *end = "\n");
+    void PrintStatusForNewUnit(u32 size, const char *text);
+
+    LibFuzzerSetting setting;
+
+    std::unique_ptr<NativeLinuxExecutor> executor;
+
+    fuzzuf::utils::random::prng rng;
+    MutationDispatcher md;
+    Corpus corpus;
+
+    u32 max_mutation_len;
+    std::vector<u8> current_unit;
+    std::vector<u32> unique_feature_set_tmp;
+
+    // エッジ毎に、いずれかのヒットカウントで実行されたことがあるか
+    std::vector<u8> covered_edges;
+    std::size_t num_covered_edges = 0;
+
+    // 保存したクラッシュとタイムアウトの、終了理由とトレースのチェックサムの組
+    std::unordered_set<u64> seen_artifacts;
+
+    u64 total_number_of_runs = 0;
+    u64 start_time;
+
+    volatile std::sig_atomic_t stop_soon = 0;
+};
+
+} // namespace fuzzuf::algorithm::libfuzzer
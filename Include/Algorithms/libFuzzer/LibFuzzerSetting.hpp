@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "Utils/Filesystem.hpp"
+#include "Utils/Common.hpp"
+#include "Options.hpp"
+
+namespace fuzzuf::algorithm::libfuzzer {
+
+struct LibFuzzerSetting {
+    explicit LibFuzzerSetting(
+        const std::vector<std::string> &argv,
+        const std::string &in_dir,
+        const std::string &out_dir,
+        u32 exec_timelimit_ms,
+        u64 exec_memlimit,
+        bool forksrv,
+        const std::vector<std::string> &dict_paths,
+        u32 max_len,
+        int cpuid_to_bind
+    );
+
+    ~LibFuzzerSetting();
+
+    const std::vector<std::string> argv;
+    const fs::path in_dir;
+    const fs::path out_dir;
+    const u32 exec_timelimit_ms;
+    const u64 exec_memlimit;
+    const bool forksrv;
+    // AFL形式の辞書、またはtools/dict2mpで変換した辞書のパス
+    const std::vector<std::string> dict_paths;
+    // 0の場合はシードの最大長とLibFuzzerOption::DEFAULT_MAX_LENの大きい方を使う
+    const u32 max_len;
+    const u32 mutate_depth = LibFuzzerOption::MUTATE_DEPTH;
+    const bool reduce_inputs = true;
+    const bool shrink = false;
+    const int cpuid_to_bind;
+};
+
+} // namespace fuzzuf::algorithm::libfuzzer
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Utils/Common.hpp"
+#include "Utils/Random.hpp"
+#include "Algorithms/libFuzzer/Dictionary.hpp"
+
+namespace fuzzuf::algorithm::libfuzzer {
+
+// libFuzzerのMutationDispatcherに相当するもの
+//
+// 責務：
+//  - 与えられたバッファをlibFuzzerの標準の変異の中からランダムに選んだ1つで書き換えること
+//      - 変異はmax_sizeを超えない範囲で行い、変異できなかった場合は別の変異を試す
+//  - 1回のMutateAndTestOneの中で適用した変異と使った辞書の要素を記録し、
+//    新しい特徴が見つかった場合はそれらの辞書の要素のsuccess_countを増やすこと
+//      - 成功した手動辞書の要素は永続自動辞書にも追加する
+//  - 辞書の要素は、use_countとsuccess_countから見積もった成功率が高いものほど選ばれやすくすること
+//  - 乱数生成器はファザーが所有し、このインスタンスより長く生存すること
+class MutationDispatcher {
+public:
+    using Dictionary = dictionary::dynamic_dictionary_t;
+
+    // 並びはlibFuzzerのDefaultMutatorsの順
+    enum MutatorType : u32 {
+        ERASE_BYTES,
+        INSERT_BYTE,
+        INSERT_REPEATED_BYTES,
+        CHANGE_BYTE,
+        CHANGE_BIT,
+        SHUFFLE_BYTES,
+        CHANGE_ASCII_INTEGER,
+        CHANGE_BINARY_INTEGER,
+        COPY_PART,
+        CROSS_OVER,            // SetCrossOverWithで相手が与えられている場合のみ成功する
+        MANUAL_DICT,           // 手動辞書が空でない場合のみ成功する
+        PERSISTENT_AUTO_DICT,  // 永続自動辞書が空でない場合のみ成功する
+        NUM_MUTATORS
+    };
+
+    static const char *GetMutatorName(MutatorType type);
+
+    explicit MutationDispatcher(fuzzuf::utils::random::prng &rng);
+
+    MutationDispatcher(const MutationDispatcher&) = delete;
+    MutationDispatcher& operator=(const MutationDispatcher&) = delete;
+
+    Dictionary &GetManualDictionary() { return manual_dict; }
+    const Dictionary &GetPersistentAutoDictionary() const { return persistent_auto_dict; }
+
+    // CROSS_OVERの相手。dataはMutateを呼ぶ間、生存していること
+    void SetCrossOverWith(const u8 *data, std::size_t size);
+
+    // 変異の系列の記録を始める
+    void StartMutationSequence();
+    // 直前のStartMutationSequenceから後の変異で新しい特徴が見つかった
+    void RecordSuccessfulMutationSequence();
+    // "ChangeByte-CopyPart-"のような、記録された変異の系列の説明
+    std::string DescribeMutationSequence() const;
+    std::size_t GetMutationSequenceLength() const { return current_sequence.size(); }
+
+    // data[0, size)をランダムに選んだ変異で書き換え、新しい大きさを返す
+    // dataはmax_sizeバイト以上の領域を持つこと
+    std::size_t Mutate(u8 *data, std::size_t size, std::size_t max_size);
+
+    // 指定した変異を1回適用する。適用できなかった場合は0を返す
+    std::size_t ApplyMutator(MutatorType type, u8 *data, std::size_t size, std::size_t max_size);
+
+private:
+    // 辞書の要素への参照。Dictionaryは伸びると再確保されるので添字で持つ
+    struct DictEntryRef {
+        bool persistent;
+        std::size_t idx;
+    };
+
+    std::size_t EraseBytes(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t InsertByte(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t InsertRepeatedBytes(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t ChangeByte(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t ChangeBit(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t ShuffleBytes(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t ChangeASCIIInteger(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t ChangeBinaryInteger(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t CopyPart(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t CrossOver(u8 *data, std::size_t size, std::size_t max_size);
+    std::size_t AddWordFromDictionary(bool persistent, u8 *data, std::size_t size, std::size_t max_size);
+
+    // from[0, from_size)の一部をto[0, to_size)の一部に上書きする
+    std::size_t CopyPartOf(const u8 *from, std::size_t from_size, u8 *to, std::size_t to_size);
+    // from[0, from_size)の一部をto[0, to_size)の途中に挿入する
+    std::size_t InsertPartOf(const u8 *from, std::size_t from_size,
+                             u8 *to, std::size_t to_size, std::size_t max_to_size);
+
+    // 成功率の見積もりが高い方を、ランダムに選んだ2つの要素から選ぶ
+    std::size_t ChooseDictEntry(const Dictionary &dict);
+
+    u8 RandCh();
+    bool RandBool() { return rng() & 1; }
+    u32 Rand(u32 limit) { return rng.below(limit); }
+
+    fuzzuf::utils::random::prng &rng;
+
+    Dictionary manual_dict;
+    Dictionary persistent_auto_dict;
+
+    const u8 *cross_over_with = nullptr;
+    std::size_t cross_over_with_size = 0;
+
+    std::vector<MutatorType> current_sequence;
+    std::vector<DictEntryRef> current_dict_sequence;
+
+    // CopyPartOfやCrossOverで重なり合う領域を扱うための作業領域
+    std::vector<u8> tmp;
+};
+
+} // namespace fuzzuf::algorithm::libfuzzer
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "CLI/PutArgs.hpp"
+#include "Exceptions.hpp"
+#include "Utils/OptParser.hpp"
+#include "Utils/CheckIfStringIsDecimal.hpp"
+#include "Options.hpp" // includes AFLOption
+
+// Used only for CLI
+// ファザー固有のオプションは"--"の後、PUTのコマンドラインの前に置く
+// 例: fuzzuf libfuzzer --in_dir=seeds -- --dict=foo.dict --max_len=1024 ./put @@
+template <class TFuzzer, class TLibFuzzer>
+std::unique_ptr<TFuzzer> BuildLibFuzzerFromArgs(FuzzerArgs &fuzzer_args, GlobalFuzzerOptions &global_options) {
+    enum optionIndex {
+        Dict,
+        MaxLen
+    };
+
+    const option::Descriptor usage[] = {
+        {optionIndex::Dict, 0, "", "dict", option::Arg::Optional, "    --dict DICT_FILE \tUse the dictionary. Can be specified more than once." },
+        {optionIndex::MaxLen, 0, "", "max_len", option::Arg::Optional, "    --max_len MAX_LEN \tMaximum length of the test input. Default is the larger one of 4096 and the largest seed." },
+        {0, 0, 0, 0, 0, 0}
+    };
+
+    option::Stats  stats(usage, fuzzer_args.argc, fuzzer_args.argv);
+    option::Option options[stats.options_max], buffer[stats.buffer_max];
+    option::Parser parse(usage, fuzzer_args.argc, fuzzer_args.argv, options, buffer);
+
+    if (parse.error()) {
+        throw exceptions::cli_error(Util::StrPrintf("Failed to parse libFuzzer command line"), __FILE__, __LINE__);
+    }
+
+    std::vector<std::string> dict_paths;
+    u32 max_len = 0;
+
+    for (int i = 0; i < parse.optionsCount(); ++i) {
+        option::Option& opt = buffer[i];
+
+        if (!opt.arg) {
+            throw exceptions::cli_error(Util::StrPrintf("Option %s does not have value", opt.name), __FILE__, __LINE__);
+        }
+
+        switch(opt.index()) {
+            case optionIndex::Dict: {
+                dict_paths.emplace_back(opt.arg);
+                break;
+            }
+            case optionIndex::MaxLen: {
+                if (!CheckIfStringIsDecimal(opt.arg)) {
+                    throw exceptions::cli_error(
+                        Util::StrPrintf("Option \"--max_len\" has non decimal caractors: %s", opt.arg),
+                        __FILE__, __LINE__);
+                }
+                max_len = atoi(opt.arg);
+                break;
+            }
+        }
+    }
+
+    PutArgs put = {
+        .argc = parse.nonOptionsCount(),
+        .argv = parse.nonOptions()
+    };
+
+    if (put.argc == 0) {
+        throw exceptions::cli_error(Util::StrPrintf("Command line of PUT is not specified"), __FILE__, __LINE__);
+    }
+
+    // これはTraceレベルのログ
+    DEBUG("[*] PUT: put = [");
+    for (auto v : put.Args()) {
+        DEBUG("\t\"%s\",", v.c_str());
+    }
+    DEBUG("    ]");
+
+    return std::unique_ptr<TFuzzer>(
+            dynamic_cast<TFuzzer *>(
+                new TLibFuzzer(
+                    put.Args(),
+                    global_options.in_dir,
+                    global_options.out_dir,
+                    global_options.exec_timelimit_ms.value_or(AFLOption::EXEC_TIMEOUT),
+                    global_options.exec_memlimit.value_or(AFLOption::MEM_LIMIT),
+                    /* forksrv */ true,
+                    dict_paths,
+                    max_len
+                )
+            )
+        );
+}
@@ -40,11 +40,9 @@ protected:
     u32 len;
 
     // ExecInput instances can be created only in ExecInputSet
-    // (i.e. it's the factory of ExecInput)
+    // (i.e. it's the factory of ExecInput), which also assigns their IDs
+    friend class ExecInputSet;
     ExecInput();
     ExecInput(const u8*, u32);
     ExecInput(std::unique_ptr<u8[]>&&, u32);
-
-private:
-    static u64 id_counter;
 };
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "Utils/Common.hpp"
+
+// OnDiskExecInputの内容をファイルから読み直さずに済ませるためのキャッシュ
+//
+// 責務：
+//  - ExecInputのIDをキーに、内容のバッファを保持すること
+//      - バッファはExecInputと共有するので、ロード中のExecInputの内容を二重に持つことはない
+//  - 保持するバッファの長さの合計がcapacityを超えないよう、最も長く使われていないものから捨てること
+//  - ヒット数とミス数を数えること
+// 内容の書き換えに追従する責務はOnDiskExecInputにある
+class ExecInputCache {
+public:
+    explicit ExecInputCache(u64 capacity);
+
+    ExecInputCache(const ExecInputCache&) = delete;
+    ExecInputCache& operator=(const ExecInputCache&) = delete;
+
+    // ヒットした場合はbufとlenに内容を入れてtrueを返す
+    bool Get(u64 id, std::shared_ptr<u8[]> &buf, u32 &len);
+    // 既に同じIDのバッファがあれば置き換える。capacityより長いものは保持しない
+    void Put(u64 id, std::shared_ptr<u8[]> buf, u32 len);
+    void Erase(u64 id);
+    void Clear();
+
+    u64 GetCapacity() const { return capacity; }
+    u64 GetSize() const { return size; }
+    u64 GetHits() const { return hits; }
+    u64 GetMisses() const { return misses; }
+
+private:
+    struct Entry {
+        u64 id;
+        std::shared_ptr<u8[]> buf;
+        u32 len;
+    };
+
+    void EvictIfOver();
+
+    u64 capacity;
+    u64 size = 0;
+    u64 hits = 0;
+    u64 misses = 0;
+
+    // 先頭ほど最近使われたもの
+    std::list<Entry> entries;
+    std::unordered_map<u64, std::list<Entry>::iterator> index;
+};
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "Utils/Common.hpp"
+#include "Utils/AsyncFileWriter.hpp"
 #include "ExecInput/ExecInput.hpp"
+#include "ExecInput/ExecInputCache.hpp"
 #include "ExecInput/OnDiskExecInput.hpp"
 #include "ExecInput/OnMemoryExecInput.hpp"
+#include "ExecInput/PackedCorpusStore.hpp"
 
 class ExecInput;
 class OnDiskExecInput;
@@ -14,23 +18,38 @@ class OnMemoryExecInput;
 // TODO: maybe it would be more convenient 
 // if we provide OnDiskExecInputSet, OnMemoryExecInputSet, ...
 
+// ExecInputの生成と、IDからの検索を担うもの
+//
+// 要素はスロットの配列に置かれ、IDは(スロットの添字 << GENERATION_BITS) | 世代 である
+// 世代は生成毎に振られる番号なので、消された要素のIDでスロットを再利用した要素を引くことはない
+// 検索と削除はハッシュを使わずO(1)で、生きている要素の添字は連続した配列に並ぶ
 class ExecInputSet {
 public:
+    static constexpr u32 GENERATION_BITS = 40;
+    // スロットの添字が全て1になるとINVALID_INPUT_IDと区別できないので、それより少ない
+    static constexpr u32 MAX_SLOTS = (1u << (64 - GENERATION_BITS)) - 1;
+
     template<class Derived, class... Args>
     std::shared_ptr<Derived> CreateInput(Args&&... args) {
-        std::shared_ptr<Derived> new_input(new Derived(args...));
-        elems[new_input->GetID()] = new_input;
+        // 制御ブロックと要素を1回で確保する
+        std::shared_ptr<Derived> new_input = 
+            std::make_shared<Constructible<Derived>>(std::forward<Args>(args)...);
+        new_input->id = Insert(new_input);
         return new_input;
     }
 
     template<class... Args>
     std::shared_ptr<OnDiskExecInput> CreateOnDisk(Args&&... args) {
-        return CreateInput<OnDiskExecInput>(args...);
+        auto new_input = CreateInput<OnDiskExecInput>(std::forward<Args>(args)...);
+        new_input->cache = disk_cache;
+        new_input->writer = writer;
+        new_input->store = packed_store;
+        return new_input;
     }
 
     template<class... Args>
     std::shared_ptr<OnMemoryExecInput> CreateOnMemory(Args&&... args) {
-        return CreateInput<OnMemoryExecInput>(args...);
+        return CreateInput<OnMemoryExecInput>(std::forward<Args>(args)...);
     }
 
     ExecInputSet();
@@ -43,7 +62,45 @@ public:
 
     std::vector<u64> get_ids(void);
 
+    // これ以降に作られるOnDiskExecInputの内容を、合計capacityバイトまでメモリ上にキャッシュする
+    void EnableDiskCache(u64 capacity);
+    // キャッシュが無効な場合はnullptr
+    const ExecInputCache *GetDiskCache(void) const;
+
+    // これ以降に作られるOnDiskExecInputのファイルへの書き込みを、writerのスレッドで行う
+    void EnableAsyncWriter(std::shared_ptr<fuzzuf::utils::async_file_writer> writer);
+
+    // これ以降に作られるOnDiskExecInputのうち、store->GetDir()の直下にあるものの内容をstoreに置く
+    void EnablePackedStore(std::shared_ptr<PackedCorpusStore> store);
+
 private:
-    // key: input->id, val: input
-    std::unordered_map<u64, std::shared_ptr<ExecInput>> elems;
+    // ExecInputの派生クラスのコンストラクタはExecInputSetにしか公開されていないので、
+    // make_sharedから呼べるようにするためのもの
+    template<class Derived>
+    struct Constructible : public Derived {
+        template<class... Args>
+        Constructible(Args&&... args) : Derived(std::forward<Args>(args)...) {}
+    };
+
+    struct Slot {
+        // 空きスロットの場合はINVALID_INPUT_ID
+        u64 id = ExecInput::INVALID_INPUT_ID;
+        // live_slotsの中での位置
+        u32 live_pos = 0;
+        std::shared_ptr<ExecInput> input;
+    };
+
+    // inputをスロットに置き、そのIDを返す
+    u64 Insert(std::shared_ptr<ExecInput> input);
+    // idが生きている要素を指していればそのスロット
+    Slot *FindSlot(u64 id);
+
+    std::vector<Slot> slots;
+    std::vector<u32> free_slots;
+    // 生きている要素のスロットの添字
+    std::vector<u32> live_slots;
+
+    std::shared_ptr<ExecInputCache> disk_cache;
+    std::shared_ptr<fuzzuf::utils::async_file_writer> writer;
+    std::shared_ptr<PackedCorpusStore> packed_store;
 };
@@ -4,8 +4,11 @@
 
 #include "Utils/Common.hpp"
 #include "Utils/Filesystem.hpp"
+#include "Utils/AsyncFileWriter.hpp"
 #include "ExecInput/ExecInput.hpp"
+#include "ExecInput/ExecInputCache.hpp"
 #include "ExecInput/ExecInputSet.hpp"
+#include "ExecInput/PackedCorpusStore.hpp"
 
 class OnDiskExecInput : public ExecInput {
 public:     
@@ -45,6 +48,19 @@ private:
     friend class ExecInputSet;
     OnDiskExecInput(const fs::path&, bool hardlinked=false);
 
+    // pathがstoreのディレクトリの直下にあり、内容をstoreに置くか
+    bool InStore(const fs::path& path) const;
+    // 内容をstoreの要素dest_pathとして保存する。ロードの状態は変えない
+    void PutIntoStore(const fs::path& dest_path);
+
     fs::path path;
     bool hardlinked;
+    // ExecInputSetがキャッシュを有効にしている場合のみ非null
+    std::shared_ptr<ExecInputCache> cache;
+    // ExecInputSetが非同期の書き込みを有効にしている場合のみ非null
+    // 非nullの場合、Save/OverwriteThenUnloadは書き込みを要求するだけで、完了を待たない
+    std::shared_ptr<fuzzuf::utils::async_file_writer> writer;
+    // ExecInputSetがPackedCorpusStoreを有効にしている場合のみ非null
+    // 非nullの場合、store->GetDir()の直下のパスはファイルではなくstoreの要素を指す
+    std::shared_ptr<PackedCorpusStore> store;
 };
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Utils/Common.hpp"
+#include "Utils/Filesystem.hpp"
+
+// キューの要素を1つずつファイルにする代わりに、1つのログにまとめて保存するもの
+//
+// 責務：
+//  - 要素の内容と名前を、dir/corpus.segの末尾に追記すること
+//      - 内容の書き換えも追記で、古い内容は残るが参照されなくなる
+//  - 要素毎の位置、長さ、フラグ、派生元を、mmapしたdir/corpus.idxのレコードとして持つこと
+//      - レコードの添字は要素が追加された順で、書き換えや名前の変更では変わらない
+//  - 保存した要素を、AFLのキューディレクトリの形式に書き出せること
+//
+// corpus.segに追記してからcorpus.idxのレコードを書くので、途中で止まった場合でも
+// corpus.idxから参照されている内容は全て読める
+// 同時に複数のスレッドから使うことはできない
+class PackedCorpusStore {
+public:
+    // AFLがqueue/.state/の下のファイルで表していた印
+    enum Flag : u32 {
+        PASSED_DET   = 1u << 0, // deterministic_done
+        FS_REDUNDANT = 1u << 1, // redundant_edges
+        VAR_BEHAVIOR = 1u << 2  // variable_behavior
+    };
+
+    static constexpr u32 NO_PARENT = u32(-1);
+
+    // read_onlyが偽の場合、ファイルが無ければ作る
+    explicit PackedCorpusStore(const fs::path &dir, bool read_only = false);
+    ~PackedCorpusStore();
+
+    PackedCorpusStore(const PackedCorpusStore&) = delete;
+    PackedCorpusStore& operator=(const PackedCorpusStore&) = delete;
+
+    // dirに保存されたものがあるか
+    static bool Exists(const fs::path &dir);
+
+    const fs::path &GetDir() const { return dir; }
+    u32 size() const { return names.size(); }
+    // corpus.segの長さ。参照されなくなった内容も含む
+    u64 GetSegmentSize() const;
+
+    std::optional<u32> Find(const std::string &name) const;
+    const std::string &GetName(u32 idx) const { return names[idx]; }
+    u32 GetLen(u32 idx) const;
+    u32 GetFlags(u32 idx) const;
+    // 派生元の要素のキューでのID。シードの場合はNO_PARENT
+    u32 GetParent(u32 idx) const;
+
+    // 内容をbuf[0, GetLen(idx))に読む
+    void Read(u32 idx, u8 *buf) const;
+
+    // nameの内容をbuf[0, len)にし、その添字を返す。nameが無ければ追加する
+    u32 Put(const std::string &name, const u8 *buf, u32 len);
+    void Rename(u32 idx, const std::string &new_name);
+    void SetFlag(u32 idx, Flag flag, bool val);
+    void SetParent(u32 idx, u32 parent);
+
+    // ここまでの変更をディスクに書き込む
+    void Sync();
+
+    // 全ての要素をqueue_dir/<name>に書き出し、フラグをqueue_dir/.state/の下の印にする
+    void Export(const fs::path &queue_dir) const;
+
+private:
+    struct Header;
+    struct Record;
+
+    Header &GetHeader() const;
+    Record &GetRecord(u32 idx) const;
+
+    void MapIndex(u64 num_records);
+    void UnmapIndex();
+    void ReserveRecords(u64 num_records);
+    // corpus.segの末尾にbuf[0, len)を書き、その位置を返す
+    u64 AppendToSegment(const void *buf, u32 len);
+    void CheckWritable() const;
+
+    fs::path dir;
+    bool read_only;
+
+    int seg_fd = -1;
+    int idx_fd = -1;
+    u8 *idx_map = nullptr;
+    std::size_t idx_map_len = 0;
+    // idx_mapに入るレコードの数
+    u64 capacity = 0;
+
+    std::vector<std::string> names;
+    std::unordered_map<std::string, u32> name_to_idx;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Utils/Common.hpp"
+
+// PUTと共有するフィードバック用のメモリ領域（以下マップ）の定義
+struct FeedbackMapSpec {
+    // PUTを実行する前にマップをどう初期化するか
+    enum class ResetPolicy {
+        ZERO, // 毎回0で埋める（カバレッジ等）
+        KEEP  // 初期化しない（実行を跨いで値を蓄積するもの等）
+    };
+
+    // GetFeedback等でマップを指定するための名前
+    std::string name;
+    u32 size;
+    // 空でない場合、このマップを先頭に置いた共有メモリのIDをこの環境変数でPUTに渡す
+    // （__AFL_SHM_IDのように、共有メモリの先頭にマップがあることを前提とするinstrumentation向け）
+    std::string legacy_env_var;
+    ResetPolicy reset_policy = ResetPolicy::ZERO;
+};
+
+// 複数のマップをまとめて確保・初期化・解放するクラス
+//
+// 責務：
+//  - 登録された全てのマップを可能な限り1つの共有メモリに配置すること
+//      - legacy_env_varを持つマップは共有メモリの先頭に置かれる必要があるため、
+//        2つ目以降のそのようなマップには個別の共有メモリが割り当てられる
+//      - legacy_env_varを持たないマップは最初の共有メモリの後ろに詰めて配置される
+//  - 全てのマップの配置をLAYOUT_ENV_VARひとつでPUTに渡すこと
+//      - 書式は "名前:共有メモリのID:オフセット:サイズ" を ';' で繋げたもの
+//  - Reset()は隣接するResetPolicy::ZEROのマップをまとめて1回のmemsetで初期化すること
+class FeedbackMapRegistry {
+public:
+    static constexpr int INVALID_SHMID = -1;
+    static constexpr const char *LAYOUT_ENV_VAR = "__FUZZUF_SHM_MAPS";
+
+    FeedbackMapRegistry() = default;
+    ~FeedbackMapRegistry();
+
+    FeedbackMapRegistry( const FeedbackMapRegistry& ) = delete;
+    FeedbackMapRegistry &operator=( const FeedbackMapRegistry& ) = delete;
+
+    // Setup()より前に呼ぶこと
+    void Register(const FeedbackMapSpec &spec);
+
+    void Setup();
+    void Reset();
+    void Erase();
+    void ExportEnvironmentVariables() const;
+
+    bool Has(const std::string &name) const;
+    // 登録されていない名前を指定した場合はnullptr, 0, INVALID_SHMIDが返る
+    u8 *GetMap(const std::string &name) const;
+    u32 GetSize(const std::string &name) const;
+    int GetShmid(const std::string &name) const;
+
+private:
+    struct Map {
+        FeedbackMapSpec spec;
+        size_t segment;
+        u32 offset;
+    };
+
+    struct Segment {
+        int shmid;
+        u8 *base;
+        u32 size;
+    };
+
+    const Map *Find(const std::string &name) const;
+
+    std::vector<Map> maps;
+    std::vector<Segment> segments;
+    // Reset()でmemsetする範囲
+    std::vector<std::pair<u8*, u32>> reset_ranges;
+};
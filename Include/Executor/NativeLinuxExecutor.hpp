@@ -8,6 +8,7 @@
 #include "Utils/Filesystem.hpp"
 #include "Exceptions.hpp"
 #include "Executor/Executor.hpp"
+#include "Executor/FeedbackMapRegistry.hpp"
 #include "Utils/Common.hpp"
 #include "Feedback/InplaceMemoryFeedback.hpp"
 #include "Feedback/ExitStatusFeedback.hpp"
@@ -51,6 +52,10 @@ public:
 
     const int cpu_core_count;
 
+    // PUTと共有する全てのマップ
+    // AFLのedgeカバレッジは"afl"、basic blockカバレッジは"bb"という名前で登録される
+    FeedbackMapRegistry feedback_maps;
+
     // NativeLinuxExecutor::INVALID_SHMIDが入っている場合は有効なIDを保持していないことを意味する
     int bb_shmid;  
     int afl_shmid; 
@@ -78,7 +83,8 @@ public:
         const fs::path &path_to_write_input,
         bool need_afl_cov,
         bool need_bb_cov,
-        int cpuid_to_bind
+        int cpuid_to_bind,
+        const std::vector<FeedbackMapSpec> &additional_maps = {}
     );
     ~NativeLinuxExecutor();
 
@@ -96,6 +102,7 @@ public:
     // Environment-epecific methods
     InplaceMemoryFeedback GetAFLFeedback();
     InplaceMemoryFeedback GetBBFeedback();
+    InplaceMemoryFeedback GetFeedback(const std::string &name);
     ExitStatusFeedback GetExitStatusFeedback();
 
     void TerminateForkServer();
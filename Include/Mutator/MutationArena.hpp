@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "Options.hpp"
+#include "Utils/Common.hpp"
+
+// Mutatorが使うバッファの置き場
+//
+// 責務：
+//  - ファザーが1つ持ち、シード毎に作られるMutatorに貸し出すことで、Mutatorの生成と破棄でメモリを確保・解放しないようにする
+//      - 各バッファは最初にMAX_FILEだけ確保し、それを超える場合はstd::vectorに従って倍々に伸ばす
+//      - 一度伸びたバッファは縮めずに次のシードでも使う
+//  - 同時に2つ以上のMutatorに貸し出してはならない
+struct MutationArena {
+    MutationArena() {
+        outbuf.reserve(AFLOption::MAX_FILE);
+        splbuf.reserve(AFLOption::MAX_FILE);
+    }
+
+    MutationArena(const MutationArena&) = delete;
+    MutationArena &operator=(const MutationArena&) = delete;
+
+    // シードのコピー。ミューテーションはここに対して行われる
+    std::vector<u8> outbuf;
+    // Spliceの結果
+    std::vector<u8> splbuf;
+    // HavocBatchが生成したミュータントを詰めて置く領域
+    std::vector<u8> havoc_buf;
+    // havoc_buf内の各ミュータントの(オフセット, 長さ)
+    std::vector<std::pair<std::size_t, u32>> havoc_mutants;
+};
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <array>
 #include <cassert>
-#include <random>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "Options.hpp"
 #include "Utils/Common.hpp"
+#include "Utils/Random.hpp"
+#include "Mutator/MutationArena.hpp"
 #include "ExecInput/ExecInput.hpp"
 #include "Algorithms/AFL/AFLDictData.hpp"
 
@@ -16,10 +21,51 @@
 //  - 本クラスのインスタンスの生存期間は、シードを与えてインスタンスを生成したときから、最後のファズ生成終了後までとする
 //  - ファズはメンバー変数 `outbuf` に一時保存され、`GetBuf()` メソッドにより依存元に与えられる
 class Mutator {
+public:
+    // havocで使う変異の種類。並びは元のAFLのhavocのcaseの順
+    enum HavocOp : u32 {
+        HAVOC_FLIP_BIT,
+        HAVOC_INTEREST8,
+        HAVOC_INTEREST16,
+        HAVOC_INTEREST32,
+        HAVOC_SUB8,
+        HAVOC_ADD8,
+        HAVOC_SUB16,
+        HAVOC_ADD16,
+        HAVOC_SUB32,
+        HAVOC_ADD32,
+        HAVOC_XOR_BYTE,
+        HAVOC_DELETE,
+        HAVOC_CLONE,
+        HAVOC_OVERWRITE,
+        HAVOC_OVERWRITE_EXTRA, // 辞書が空でない場合のみ選ばれる
+        HAVOC_INSERT_EXTRA,    // 辞書が空でない場合のみ選ばれる
+        NUM_HAVOC_OPS
+    };
+
+    // 各変異が選ばれる相対的な頻度
+    using HavocWeights = std::array<u32, NUM_HAVOC_OPS>;
+    static const HavocWeights DEFAULT_HAVOC_WEIGHTS;
+
 protected:
+    // havoc_weightsを展開した表の長さの上限
+    static constexpr u32 MAX_HAVOC_DISPATCH = 256;
+    // 辞書の有無で選べる変異が変わるので、havoc_weightsを展開した表は2つ持つ
+    struct HavocDispatch {
+        std::array<u8, MAX_HAVOC_DISPATCH> ops;
+        u32 size = 0;
+    };
+
     // NOTE: const参照を持つ時点でMutatorはExecInputよりライフタイムが短くあるべき
     const ExecInput &input;
 
+    // 乱数生成器とバッファの置き場を渡されなかった場合にのみ、このインスタンス専用のものを持つ
+    std::unique_ptr<fuzzuf::utils::random::prng> own_rng;
+    fuzzuf::utils::random::prng &rng;
+    std::unique_ptr<MutationArena> own_arena;
+    MutationArena &arena;
+
+    // 以下のバッファは全てarenaの中を指す
     u32 len;
     u8 *outbuf;
     u8 *tmpbuf;
@@ -27,8 +73,11 @@ protected:
     u8 *splbuf;
     u32 spl_len;
 
-    std::mt19937 mt_engine; // TODO: テスト容易性のために Dependency Injection 可能にする
-    int rand_fd;
+    HavocWeights havoc_weights = DEFAULT_HAVOC_WEIGHTS;
+    std::array<HavocDispatch, 2> havoc_dispatch;
+
+    const HavocDispatch &GetHavocDispatch(bool with_extras);
+    void LoadSeed();
 
 public:
     static const std::vector<s8>  interesting_8;
@@ -44,6 +93,9 @@ public:
     Mutator(Mutator&&);
 
     Mutator( const ExecInput& );
+    // rngとarenaはファザー等が所有し、このインスタンスより長く生存すること
+    Mutator( const ExecInput&, fuzzuf::utils::random::prng &rng );
+    Mutator( const ExecInput&, fuzzuf::utils::random::prng &rng, MutationArena &arena );
     virtual ~Mutator();
 
     u8 *GetBuf() { return outbuf; }
@@ -53,7 +105,7 @@ public:
     u32 FlipBit(u32 pos, int n);
     u32 FlipByte(u32, int);
     
-    void Replace(int pos, u8 *buf, u32 len);
+    void Replace(int pos, const u8 *buf, u32 len);
 
     template<typename T> T   ReadMem(u32 pos);
     template<typename T> u32 Overwrite(u32 pos, T chr);
@@ -62,6 +114,9 @@ public:
     template<typename T> u32 SubN(int pos, int val, int be);
     template<typename T> u32 InterestN(int pos, int idx, int be);
 
+    void SetHavocWeights(const HavocWeights &weights);
+
+    // 現在のバッファにstacking回の変異を重ねる。RestoreHavocで元に戻す
     void Havoc(
             u32 stacking, 
             const std::vector<AFLDictData>& extras, 
@@ -69,6 +124,16 @@ public:
          );
     void RestoreHavoc(void);
 
+    // 現在のバッファからstackings[i]回の変異を重ねたミュータントをstackings.size()個まとめて生成する
+    // 現在のバッファは変更しない。Havocの効果が残っている間に呼んではならない
+    void HavocBatch(
+            const std::vector<u32> &stackings,
+            const std::vector<AFLDictData>& extras, 
+            const std::vector<AFLDictData>& a_extras
+         );
+    // HavocBatchで生成したi番目のミュータント。次にHavocかHavocBatchを呼ぶまで有効
+    std::pair<const u8*, u32> GetHavocMutant(std::size_t i) const;
+
     const ExecInput &GetSource();
     
     bool Splice(const ExecInput &target);
@@ -1,6 +1,7 @@
 #ifndef __OPTIONS_HPP__
 #define __OPTIONS_HPP__
 
+#include "config.h"
 #include "Utils/Common.hpp"
 
 // FIXME: this should be moved to Include/Algorithms/AFL/
@@ -35,6 +36,7 @@ static const u32 STAGE_EXTRAS_UI    =      13;
 static const u32 STAGE_EXTRAS_AO    =      14;
 static const u32 STAGE_HAVOC        =      15;
 static const u32 STAGE_SPLICE       =      16;
+static const u32 STAGE_ITS          =      17;
 
 static const u32 CAL_CYCLES         =       8;
 static const u32 CAL_CYCLES_LONG    =       40;
@@ -62,6 +64,29 @@ static const s32 HAVOC_MIN          =       16;
     128 stacked tweaks: */
 static const u32 HAVOC_STACK_POW2   =       7;
 
+/* Number of havoc mutants generated at once. Batching changes the order in
+    which random numbers are drawn, so it is disabled when fuzzuf has to
+    behave exactly the same as original AFL: */
+#ifdef BEHAVE_DETERMINISTIC
+static const u32 HAVOC_BATCH        =       1;
+#else
+static const u32 HAVOC_BATCH        =       16;
+#endif
+
+/* Number of deterministic mutants collected before they are executed at
+    once in parallel (only when AFL_DET_SHARDS is set), and the number of
+    mutants a worker takes from the batch at a time: */
+static const u32 DET_SHARD_BATCH    =       8192;
+static const u32 DET_SHARD_CHUNK    =       64;
+
+/* Number of initial test cases calibrated at once in parallel during the
+    dry run (only when AFL_DET_SHARDS is set): */
+static const u32 DRY_RUN_BATCH      =       256;
+
+/* Number of input files a thread takes at a time when the input directory
+    is scanned and the files are linked into the queue on all cores: */
+static const u32 SEED_SCAN_CHUNK    =       64;
+
 /* Caps on block sizes for cloning and deletion operations. Each of these
     ranges has a 33% probability of getting picked, except for the first
   two cycles where smaller blocks are favored: */
@@ -83,6 +108,12 @@ static const u32 CAL_CHANCES        =       3;
     
 static const u32 MAP_SIZE_POW2      =       16;
 static const u32 MAP_SIZE           =       (1 << MAP_SIZE_POW2);
+/* Maximum number of comparisons recorded in the comparison log map: */
+static const u32 CMPLOG_MAX_ENTRIES =       4096;
+/* Consecutive seeds logging no comparisons before giving up on the log: */
+static const u32 CMPLOG_EMPTY_MAX   =       16;
+/* Maximum number of input-to-state replacements tried per logged comparison: */
+static const u32 CMPLOG_MAX_CANDIDATES =    16;
 static const u32 STATUS_UPDATE_FREQ =       1;
 static const u32 EXEC_FAIL_SIG      =       0xfee1dead;
 
@@ -94,6 +125,7 @@ constexpr const char *PERSIST_ENV_VAR  =       "__AFL_PERSISTENT";
 constexpr const char *DEFER_ENV_VAR    =       "__AFL_DEFER_FORKSRV";
 constexpr const char *AFL_SHM_ENV_VAR     =    "__AFL_SHM_ID";
 constexpr const char *WYVERN_SHM_ENV_VAR  =    "__WYVERN_SHM_ID";   
+constexpr const char *CMPLOG_MAP_NAME     =    "cmplog";
  
 /* those fd numbers are used by the fork server inside PUT */
 const int FORKSRV_FD_READ  = 198;
@@ -118,6 +150,14 @@ static const u32 MAX_FILE           =       (1 * 1024 * 1024);
 /* The same, for the test case minimizer: */
 static const u32 TMIN_MAX_FILE      =       (10 * 1024 * 1024);
 
+/* Total size of the queue entries kept in memory, so that splicing and
+    seed loading don't have to read the files again: */
+static const u64 CORPUS_CACHE_SIZE  =       (128 * 1024 * 1024);
+
+/* Total size of queue entries and crashes waiting to be written to disk
+    by the background writer before the fuzzing loop has to wait: */
+static const u64 ASYNC_WRITE_BUFFER_SIZE =  (32 * 1024 * 1024);
+
 /* Block normalization steps for afl-tmin: */
 static const u32 TMIN_SET_MIN_SIZE  =       4;
 static const u32 TMIN_SET_STEPS     =       128;
@@ -134,6 +174,16 @@ static const u32 MAX_AUTO_EXTRA     =       32;
     but with proportionally lower odds: */
 static const u32 MAX_DET_EXTRAS     =       200;
 
+/* Minimum input file length at which the dictionary overwrite stages try
+    the offsets where some token of the dictionary already occurs before all
+    the other offsets. This changes the order of the mutants, so it is
+    disabled when fuzzuf has to behave exactly the same as original AFL: */
+#ifdef BEHAVE_DETERMINISTIC
+static const u32 DICT_SITES_MIN_LEN =       (MAX_FILE + 1);
+#else
+static const u32 DICT_SITES_MIN_LEN =       1024;
+#endif
+
 /* Maximum number of auto-extracted dictionary tokens to actually use in fuzzing
     (first value), and to keep in memory as candidates. The latter should be much
     higher than the former. */
@@ -157,6 +207,10 @@ static const u32 UI_TARGET_HZ       =       5;
 static const u32 STATS_UPDATE_SEC   =       60;
 static const u32 PLOT_UPDATE_SEC    =       60;
 
+/* Interval of saving the progress of deterministic stages, so that an
+    aborted run can continue from there (sec): */
+static const u32 DET_CHECKPOINT_SEC =       60;
+
 /* Smoothing divisor for CPU load and exec speed stats (1 - no smoothing). */
 static const u32 AVG_SMOOTHING      =       16;
     
@@ -165,10 +219,31 @@ static const u32 AVG_SMOOTHING      =       16;
 static const u32 TRIM_MIN_BYTES     =       4;
 static const u32 TRIM_START_STEPS   =       16;
 static const u32 TRIM_END_STEPS     =       1024;
+
+/* Number of blocks the trimmer tries at a time on all executors (only when
+    AFL_DET_SHARDS is set): */
+static const u32 TRIM_SHARD_BLOCKS  =       64;
     
 /* A made-up hashing seed: */
 static const u32 HASH_CONST         =       0xa5b35705;
     
 };
 
+namespace LibFuzzerOption {
+
+/* Default maximum length of test cases, used if the seeds are all smaller: */
+static const u32 DEFAULT_MAX_LEN    =    4096;
+
+/* Number of consecutive mutations applied to a corpus unit before it is
+    reloaded from the corpus (-mutate_depth): */
+static const u32 MUTATE_DEPTH       =       5;
+
+/* Number of tries before a mutator is considered unusable for an input: */
+static const u32 MUTATE_TRIES       =     100;
+
+/* Capacity of the persistent auto dictionary: */
+static const u32 MAX_AUTO_DICT      =  1 << 14;
+
+};
+
 #endif
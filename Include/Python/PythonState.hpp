@@ -5,6 +5,8 @@
 
 #include "ExecInput/ExecInputSet.hpp"
 #include "Mutator/Mutator.hpp"
+#include "Utils/Random.hpp"
+#include "Mutator/MutationArena.hpp"
 #include "Feedback/PersistentMemoryFeedback.hpp"
 #include "Python/PythonSetting.hpp"
 #include "Python/PythonTestcase.hpp"
@@ -15,6 +17,11 @@ struct PythonState {
 
     const PythonSetting &setting;
     ExecInputSet input_set;
+    // キーはシードのID。ExecInputのIDではなく、Python側に見せる通し番号
     std::unordered_map<u64, std::unique_ptr<PythonTestcase>> test_set;
+    // 次に実行した入力に振る通し番号。AFLと同じく、保存するファイルの名前にも使う
+    u64 next_seed_id = 0;
+    fuzzuf::utils::random::prng rng;
+    MutationArena mutation_arena;
     std::unique_ptr<Mutator> mutator;
 };
@@ -0,0 +1,79 @@
+#ifndef FUZZUF_INCLUDE_UTILS_AHO_CORASICK_HPP
+#define FUZZUF_INCLUDE_UTILS_AHO_CORASICK_HPP
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fuzzuf::utils::aho_corasick {
+
+/*
+ * Aho-Corasick法による複数パターンのバイト列照合器
+ *
+ * add()でトークンを登録し、compile()で遷移表を作った後は、
+ * scan()で入力を1回走査するだけで、全てのトークンの全ての出現位置を列挙できる
+ * 辞書を読み込んだ時に1回だけ作り、シード毎にscan()を呼ぶ事を想定している
+ *
+ * 遷移表はトークンに現れるバイトだけを区別した等価クラスを列に持つ完全なDFAなので、
+ * 1バイトあたりの処理は表引き1回で済む
+ * scan()はconstなので、compile()後は複数のスレッドから同時に呼んでよい
+ */
+class matcher {
+public:
+  matcher();
+
+  // トークンを登録し、そのIDを返す。IDは登録した順に0から振られる
+  // 同じトークンを複数回登録した場合は、それぞれのIDで報告される
+  // 空のトークンは登録できるが、報告されない
+  std::uint32_t add( const std::uint8_t *token, std::size_t len );
+
+  // 登録されたトークンから遷移表を作る。scan()の前に呼ぶ事
+  // compile()後にadd()した場合は、再度compile()するまでscan()してはならない
+  void compile();
+
+  // 登録されたトークンを全て消す
+  void clear();
+
+  std::size_t size() const { return lengths.size(); }
+  bool empty() const { return lengths.empty(); }
+  std::size_t get_length( std::uint32_t id ) const { return lengths[ id ]; }
+
+  /*
+   * data[0, len)に現れる全てのトークンについて、func( 開始位置, ID )を呼ぶ
+   * 出現は終了位置の昇順に報告される。終了位置が同じ場合は長いトークンが先
+   */
+  template< typename F >
+  void scan( const std::uint8_t *data, std::size_t len, F &&func ) const {
+    if( out_link.empty() ) return;
+    std::uint32_t state = 0u;
+    for( std::size_t i = 0u; i != len; ++i ) {
+      state = delta[ std::size_t( state ) * num_classes + byte_class[ data[ i ] ] ];
+      for( auto s = has_output[ state ] ? state : out_link[ state ]; s != no_state; s = out_link[ s ] ) {
+        for( auto o = out_begin[ s ]; o != out_begin[ s + 1 ]; ++o ) {
+          const auto id = out_ids[ o ];
+          func( i + 1u - lengths[ id ], id );
+        }
+      }
+    }
+  }
+
+private:
+  static constexpr std::uint32_t no_state = ~std::uint32_t( 0 );
+
+  std::vector< std::vector< std::uint8_t > > tokens;
+  std::vector< std::size_t > lengths;
+
+  std::array< std::uint32_t, 256u > byte_class;
+  std::uint32_t num_classes;
+  // 状態数*num_classesの遷移表
+  std::vector< std::uint32_t > delta;
+  // 状態sで終わるトークンのIDはout_ids[ out_begin[ s ], out_begin[ s + 1 ] )
+  std::vector< std::uint32_t > out_begin;
+  std::vector< std::uint32_t > out_ids;
+  std::vector< std::uint8_t > has_output;
+  // 失敗リンクを辿って最初に見つかる、トークンで終わる状態
+  std::vector< std::uint32_t > out_link;
+};
+
+}
+#endif
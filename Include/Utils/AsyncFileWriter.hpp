@@ -0,0 +1,112 @@
+#ifndef FUZZUF_INCLUDE_UTILS_ASYNC_FILE_WRITER_HPP
+#define FUZZUF_INCLUDE_UTILS_ASYNC_FILE_WRITER_HPP
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fuzzuf::utils {
+
+/*
+ * ファイルの書き込み、空ファイルの作成、削除をバックグラウンドのスレッドで行う
+ *
+ * 新しいキューの要素やクラッシュの保存が続いた場合でも、
+ * 実行ループがファイルシステムの遅延で止まらないようにするためのもの
+ *
+ * 操作は要求された順に1つのスレッドで行われるので、同じパスへの操作の順序は保たれる
+ * スレッドは溜まっている操作をまとめて取り出して処理する
+ * 書き込み待ちの内容は書き込みが終わるまでメモリ上に保持され、get_pending()で読める
+ * 書き込み待ちの内容の合計がcapacityバイトを超える場合、要求した側は空きができるまで待つ
+ *
+ * 操作の失敗は要求した時点では報告されず、次のflush()で例外として報告される
+ * 1つのインスタンスを複数のスレッドから同時に使ってもよい
+ */
+class async_file_writer {
+public:
+  using buffer_t = std::shared_ptr< const std::uint8_t[] >;
+
+  explicit async_file_writer( std::size_t capacity );
+  // 書き込み待ちの操作を全て終えてからスレッドを止める。失敗は標準エラー出力に出す
+  ~async_file_writer();
+
+  async_file_writer( const async_file_writer& ) = delete;
+  async_file_writer &operator=( const async_file_writer& ) = delete;
+
+  // pathの内容をdata[0, len)にする。dataはコピーされる
+  void write( const std::string &path, const std::uint8_t *data, std::size_t len );
+  // pathの内容をdata[0, len)にする。dataは書き込みが終わるまで共有される
+  void write( const std::string &path, buffer_t data, std::size_t len );
+  // write()と同じだが、pathが既に存在する場合は失敗する
+  void write_exclusive( const std::string &path, const std::uint8_t *data, std::size_t len );
+  // 空のファイルpathを作る。pathが既に存在する場合は失敗する
+  void create( const std::string &path );
+  // pathを削除する
+  void remove( const std::string &path );
+
+  // pathへの書き込みが終わっていない場合はその内容をdataとlenに入れてtrueを返す
+  bool get_pending( const std::string &path, buffer_t &data, std::size_t &len ) const;
+
+  // この呼び出しより前に要求された操作が全て終わるまで待つ
+  // 失敗した操作があった場合は最初の失敗のメッセージを持つFileErrorを投げる
+  void flush();
+
+  std::size_t get_capacity() const { return capacity; }
+  // これまでにスレッドが操作をまとめて取り出した回数
+  std::uint64_t get_num_batches() const;
+
+private:
+  enum class op_type {
+    write,
+    write_exclusive,
+    create,
+    remove
+  };
+
+  struct operation {
+    op_type type;
+    std::string path;
+    buffer_t data;
+    std::size_t len;
+    std::uint64_t seq;
+  };
+
+  struct pending_entry {
+    buffer_t data;
+    std::size_t len;
+    std::uint64_t seq;
+  };
+
+  void enqueue( op_type type, const std::string &path, buffer_t data, std::size_t len );
+  void run();
+  // 失敗した場合はメッセージを返す
+  static std::string perform( const operation &op );
+
+  const std::size_t capacity;
+
+  mutable std::mutex guard;
+  std::condition_variable not_empty;
+  std::condition_variable done;
+
+  std::deque< operation > queue;
+  // パス毎の最後の書き込み
+  std::unordered_map< std::string, pending_entry > pending;
+  // 書き込み待ちの内容の合計の長さ
+  std::size_t pending_bytes = 0u;
+  std::uint64_t next_seq = 1u;
+  // この番号までの操作は終わっている
+  std::uint64_t done_seq = 0u;
+  std::uint64_t num_batches = 0u;
+  std::vector< std::string > errors;
+  bool stopping = false;
+
+  std::thread worker;
+};
+
+}
+#endif
@@ -0,0 +1,36 @@
+#ifndef FUZZUF_INCLUDE_UTILS_BITMAP_KERNEL_HPP
+#define FUZZUF_INCLUDE_UTILS_BITMAP_KERNEL_HPP
+#include <tuple>
+#include <Utils/Common.hpp>
+namespace fuzzuf::utils::bitmap_kernel {
+
+// ビットマップを走査するカーネルの実装の種類
+// 値が大きいほど速い実装であるとする
+enum class isa_t {
+  SCALAR,
+  SSE2,
+  AVX2
+};
+
+// 実行中のCPUで利用可能な最も速い実装を返す
+// CPUの機能の検出は初回の呼び出し時にのみ行われる
+isa_t detect();
+
+// isaで指定した実装が実行中のCPUで利用可能かを返す
+bool is_available( isa_t isa );
+
+// isaの名前を返す
+const char *to_string( isa_t isa );
+
+// 以下の関数はUtil::CountBits等と同じ結果を返す
+// isaで指定した実装が実行中のCPUで利用可能でない場合の動作は未定義
+// 通常はUtil::CountBits等を使うこと(detect()の結果の実装が使われる)
+u32 count_bits( isa_t isa, const u8 *mem, u32 len );
+u32 count_bytes( isa_t isa, const u8 *mem, u32 len );
+u32 count_non_255_bytes( isa_t isa, const u8 *mem, u32 len );
+void minimize_bits( isa_t isa, u8 *dst, const u8 *src, u32 len );
+std::tuple< s32, s32 > locate_diffs( isa_t isa, const u8 *ptr1, const u8 *ptr2, u32 len );
+
+}
+#endif
+
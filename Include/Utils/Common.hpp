@@ -144,6 +144,25 @@ u64 GetCurTimeMs();
 
 u32 Hash32(const void* key, u32 len, u32 seed);
 
+// 内容が同じかどうかをファイル等の単位で判定するための128ビットのハッシュ値
+// unordered_set等のキーにする場合はHash128Value::Hasherを使う
+struct Hash128Value {
+    u64 low = 0;
+    u64 high = 0;
+
+    bool operator==(const Hash128Value &rhs) const {
+        return low == rhs.low && high == rhs.high;
+    }
+    bool operator!=(const Hash128Value &rhs) const { return !(*this == rhs); }
+
+    struct Hasher {
+        std::size_t operator()(const Hash128Value &v) const { return v.low; }
+    };
+};
+
+// MurmurHash3のx64_128。Hash32と違い、8バイトに満たない端の部分も含めてハッシュする
+Hash128Value Hash128(const void* key, std::size_t len, u32 seed);
+
 u32 CountBits( const u8* mem, u32 len);
 u32 CountBytes( const u8* mem, u32 len);
 u32 CountNon255Bytes( const u8* mem, u32 len);
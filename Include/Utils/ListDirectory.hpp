@@ -0,0 +1,14 @@
+#ifndef FUZZUF_INCLUDE_UTILS_LIST_DIRECTORY_HPP
+#define FUZZUF_INCLUDE_UTILS_LIST_DIRECTORY_HPP
+#include <string>
+#include <vector>
+namespace fuzzuf::utils {
+
+// dirの直下のエントリの名前を、"."と".."も含めてnamesの末尾に追加する
+// getdents64でまとめて読むので、エントリ毎にreaddirを呼ぶscandirより速い
+// 順序はファイルシステムが返した順のままなので、必要なら呼び出し側で並べ替える
+// 失敗した場合はerrnoを設定してfalseを返す。その場合namesの内容は不定
+bool list_directory( const std::string &dir, std::vector< std::string > &names );
+
+}
+#endif
@@ -0,0 +1,169 @@
+#ifndef FUZZUF_INCLUDE_UTILS_MAPPED_DICTIONARY_HPP
+#define FUZZUF_INCLUDE_UTILS_MAPPED_DICTIONARY_HPP
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <Exceptions.hpp>
+#include <Utils/MapFile.hpp>
+#include <Utils/AFLDictParser.hpp>
+/*
+ * 事前に変換した辞書をmmapして、パースせずに使えるようにした
+ * 扱える形式は以下の2つで、どちらもtools/dict2mpで作れる
+ *
+ * msgpack: 要素のバイト列(binまたはstr)の配列
+ *   ロード時に1回だけ走査して各要素の位置の表を作る
+ * flat: 以下の並びからなるファイル。整数はリトルエンディアン
+ *   char magic[ 8 ] = "FZDICT01"
+ *   uint32_t count
+ *   uint32_t reserved = 0
+ *   uint32_t offsets[ count + 1 ] 要素iのバイト列はdata[ offsets[ i ], offsets[ i + 1 ] )
+ *   uint8_t data[ offsets[ count ] ]
+ *   位置の表もファイルの中にあるので、ロード時にメモリを確保しない
+ *
+ * ファイルは読み込み専用でmmapされるので、同じ辞書を使う同一ホスト上のファザー同士でページキャッシュが共有される
+ */
+namespace fuzzuf::utils::dictionary {
+  class mapped_dictionary {
+  public:
+    using word_t = mapped_file_t;
+
+    static constexpr char flat_magic[ 8 ] = { 'F', 'Z', 'D', 'I', 'C', 'T', '0', '1' };
+    static constexpr std::size_t flat_header_size = 16u;
+
+    /**
+     * @brief filenameで指定された変換済みの辞書をmmapする
+     * @param filename ファイル名
+     * 開けない場合はstd::system_errorを、変換済みの辞書でない場合はexceptions::invalid_fileを投げる
+     */
+    explicit mapped_dictionary( const std::string &filename );
+
+    // filenameが変換済みの辞書であればそれをmmapしたものを返し、そうでなければnulloptを返す
+    // AFL辞書のファイル名に付くレベル指定(name@level)などで開けない場合もnulloptを返す
+    static std::optional< mapped_dictionary > try_open( const std::string &filename );
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0u; }
+
+    // i番目の要素のバイト列。返り値が残っている間はmmapした領域は解放されない
+    word_t operator[]( std::size_t i ) const {
+      const auto [ b, e ] = get_bounds( i );
+      return boost::make_iterator_range( std::next( file.begin(), b ), std::next( file.begin(), e ) );
+    }
+
+    // i番目の要素のバイト列の先頭と長さ。mmapした領域の寿命はこのインスタンスに従う
+    const std::uint8_t *get_data( std::size_t i ) const { return file.begin().get() + get_bounds( i ).first; }
+    std::size_t get_size( std::size_t i ) const {
+      const auto [ b, e ] = get_bounds( i );
+      return e - b;
+    }
+
+  private:
+    // fileが変換済みの辞書でない場合はexceptions::invalid_fileを投げる
+    explicit mapped_dictionary( mapped_file_t &&file_ );
+
+    // i番目の要素のバイト列の[ 開始, 終了 )のファイル上の位置
+    std::pair< std::size_t, std::size_t > get_bounds( std::size_t i ) const {
+      if( offsets )
+        return { data_offset + load_u32( offsets + i * 4u ), data_offset + load_u32( offsets + i * 4u + 4u ) };
+      return { ranges[ i * 2u ], ranges[ i * 2u + 1u ] };
+    }
+
+    bool parse_flat();
+    bool parse_msgpack();
+
+    static std::uint32_t load_u32( const std::uint8_t *p ) {
+      std::uint32_t v;
+      std::memcpy( &v, p, sizeof( v ) );
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      v = __builtin_bswap32( v );
+#endif
+      return v;
+    }
+
+    mapped_file_t file;
+    std::size_t count = 0u;
+    // flat形式の場合の位置の表と、要素のバイト列が始まるファイル上の位置
+    const std::uint8_t *offsets = nullptr;
+    std::size_t data_offset = 0u;
+    // msgpack形式の場合の各要素の[ 開始, 終了 )のファイル上の位置
+    std::vector< std::size_t > ranges;
+  };
+
+  // dictの要素をflat形式にしたバイト列を返す
+  // 条件: dictの要素はメンバ関数get()を持ち、get()はバイト列のrangeを返す
+  template< typename Dict >
+  std::vector< std::uint8_t > to_flat_dictionary( const Dict &dict ) {
+    std::vector< std::uint8_t > out( mapped_dictionary::flat_magic, mapped_dictionary::flat_magic + 8u );
+    const auto push_u32 = [&out]( std::uint32_t v ) {
+      for( int i = 0; i != 4; ++i ) out.push_back( ( v >> ( i * 8 ) ) & 0xFFu );
+    };
+    push_u32( dict.size() );
+    push_u32( 0u );
+    std::uint32_t offset = 0u;
+    push_u32( offset );
+    for( const auto &v: dict ) {
+      offset += v.get().size();
+      push_u32( offset );
+    }
+    for( const auto &v: dict ) out.insert( out.end(), v.get().begin(), v.get().end() );
+    return out;
+  }
+
+  // dictの要素をmsgpackのbinの配列にしたバイト列を返す
+  // 条件: dictの要素はメンバ関数get()を持ち、get()はバイト列のrangeを返す
+  template< typename Dict >
+  std::vector< std::uint8_t > to_msgpack_dictionary( const Dict &dict ) {
+    std::vector< std::uint8_t > out;
+    const auto push_be = [&out]( std::size_t v, int bytes ) {
+      for( int i = bytes - 1; i >= 0; --i ) out.push_back( ( v >> ( i * 8 ) ) & 0xFFu );
+    };
+    if( dict.size() < ( std::size_t( 1u ) << 4 ) ) out.push_back( 0x90u | dict.size() );
+    else if( dict.size() < ( std::size_t( 1u ) << 16 ) ) { out.push_back( 0xdcu ); push_be( dict.size(), 2 ); }
+    else { out.push_back( 0xddu ); push_be( dict.size(), 4 ); }
+    for( const auto &v: dict ) {
+      const std::size_t size = v.get().size();
+      if( size < ( std::size_t( 1u ) << 8 ) ) { out.push_back( 0xc4u ); push_be( size, 1 ); }
+      else if( size < ( std::size_t( 1u ) << 16 ) ) { out.push_back( 0xc5u ); push_be( size, 2 ); }
+      else { out.push_back( 0xc6u ); push_be( size, 4 ); }
+      out.insert( out.end(), v.get().begin(), v.get().end() );
+    }
+    return out;
+  }
+
+  // 変換済みの辞書の要素をdestの後ろに追加する
+  // 要素のバイト列の型がmapped_file_tと異なる場合はコピーする
+  // destの要素数やバイト列の長さの上限を超える場合はeoutにメッセージを渡してexceptions::invalid_fileを投げる
+  template< typename T >
+  auto load_mapped_dictionary(
+    const mapped_dictionary &src,
+    T &dest,
+    const std::function< void( std::string&& ) > &eout
+  ) -> std::void_t< dictionary_word_t< T > > {
+    using word_t = dictionary_word_t< T >;
+    if( dest.max_size() - dest.size() < src.size() ) {
+      eout( "Too many entries." );
+      throw exceptions::invalid_file( "invalid dictionary file", __FILE__, __LINE__ );
+    }
+    if constexpr( !std::is_same_v< word_t, mapped_file_t > ) {
+      static const word_t word;
+      for( std::size_t i = 0u; i != src.size(); ++i ) {
+        if( word.max_size() < src.get_size( i ) ) {
+          eout( "entry " + std::to_string( i ) + " is too long." );
+          throw exceptions::invalid_file( "invalid dictionary file", __FILE__, __LINE__ );
+        }
+      }
+    }
+    for( std::size_t i = 0u; i != src.size(); ++i ) {
+      if constexpr( std::is_same_v< word_t, mapped_file_t > )
+        emplace_word( dest, src[ i ] );
+      else
+        emplace_word( dest, word_t( src.get_data( i ), src.get_data( i ) + src.get_size( i ) ) );
+    }
+  }
+}
+#endif
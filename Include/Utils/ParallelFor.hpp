@@ -0,0 +1,49 @@
+#ifndef FUZZUF_INCLUDE_UTILS_PARALLEL_FOR_HPP
+#define FUZZUF_INCLUDE_UTILS_PARALLEL_FOR_HPP
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+namespace fuzzuf::utils {
+
+// [0, n)の各iについてfunc(i)を、呼び出したスレッドを含む最大num_threads個のスレッドで呼ぶ
+// 各スレッドはchunk個ずつiを取っていくので、funcの処理が軽い場合はchunkを大きくする
+// funcが例外を投げた場合、残りのiは処理されないことがあり、全スレッドの終了後に最初の例外を投げ直す
+template< typename Func >
+void parallel_for( std::size_t n, unsigned int num_threads, std::size_t chunk, Func &&func ) {
+  if( chunk == 0 ) chunk = 1;
+  std::size_t num_chunks = ( n + chunk - 1 ) / chunk;
+  num_threads = std::max< std::size_t >( 1, std::min< std::size_t >( num_threads, num_chunks ) );
+
+  std::atomic< std::size_t > next( 0 );
+  std::atomic< bool > failed( false );
+  std::vector< std::exception_ptr > errors( num_threads );
+
+  auto work = [&]( unsigned int thread_id ) {
+    try {
+      while( !failed ) {
+        std::size_t begin = next.fetch_add( chunk );
+        if( begin >= n ) break;
+        std::size_t end = std::min( begin + chunk, n );
+        for( std::size_t i = begin; i != end; ++i ) func( i );
+      }
+    } catch( ... ) {
+      errors[ thread_id ] = std::current_exception();
+      failed = true;
+    }
+  };
+
+  std::vector< std::thread > threads;
+  for( unsigned int i = 1; i < num_threads; ++i ) threads.emplace_back( work, i );
+  work( 0 );
+  for( auto &thread : threads ) thread.join();
+
+  for( auto &error : errors ) {
+    if( error ) std::rethrow_exception( error );
+  }
+}
+
+}
+#endif
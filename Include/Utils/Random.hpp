@@ -0,0 +1,101 @@
+#ifndef FUZZUF_INCLUDE_UTILS_RANDOM_HPP
+#define FUZZUF_INCLUDE_UTILS_RANDOM_HPP
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace fuzzuf::utils::random {
+
+/*
+ * xoshiro256**による疑似乱数生成器
+ *
+ * libcのrandom()と異なり状態はインスタンス毎に独立しているため、
+ * ファザーやワーカー毎に1つずつ持たせる事で、互いの系列に干渉せずに乱数を引ける
+ * 1つのインスタンスを複数のスレッドから同時に使ってはならない
+ * 別のスレッドで使う乱数生成器が必要な場合はsplit()で作る事
+ *
+ * 64bitの出力を下位32bit、上位32bitの順で2つの32bit乱数として使う
+ * havocのように1回の変異で何度も乱数を引く処理の為に、
+ * batch_size個の32bit乱数をまとめて生成しておき、そこから順に返す
+ *
+ * UniformRandomBitGeneratorの要件を満たすので、std::shuffle等にも渡せる
+ */
+class prng {
+public:
+  using result_type = std::uint32_t;
+
+  // 1回の補充でまとめて生成する32bit乱数の数(偶数であること)
+  static constexpr std::size_t batch_size = 64u;
+  // BEHAVE_DETERMINISTICが定義されている場合に全てのインスタンスが使うシード
+  static constexpr std::uint64_t deterministic_seed = 0u;
+
+  // seedをsplitmix64で展開して内部状態を初期化する
+  explicit prng( std::uint64_t seed );
+
+  // BEHAVE_DETERMINISTICが定義されている場合はdeterministic_seedで、
+  // そうでない場合は/dev/urandomから読んだ値で初期化した乱数生成器を返す
+  static prng create();
+
+  static constexpr result_type min() { return 0u; }
+  static constexpr result_type max() { return std::numeric_limits< result_type >::max(); }
+
+  result_type operator()() {
+    if( pos == batch_size ) refill();
+    return buf[ pos++ ];
+  }
+
+  /*
+   * [0, limit)の一様乱数を返す
+   * random() % limitのような偏りが生じないよう、Lemireの方法で棄却を行う
+   * 棄却が起きるのは確率limit/2^32未満なので、殆どの場合は乗算1回で済む
+   * limitは0であってはならない
+   */
+  std::uint32_t below( std::uint32_t limit ) {
+    std::uint64_t m = std::uint64_t( ( *this )() ) * limit;
+    if( std::uint32_t( m ) < limit ) {
+      const std::uint32_t threshold = -limit % limit;
+      while( std::uint32_t( m ) < threshold )
+        m = std::uint64_t( ( *this )() ) * limit;
+    }
+    return std::uint32_t( m >> 32 );
+  }
+
+  // 32bit乱数をn個outに書き出す
+  // 結果はoperator()をn回呼んだ場合と同じになる
+  void fill( result_type *out, std::size_t n );
+
+  /*
+   * 現在の系列と重ならない系列を持つ乱数生成器を作る
+   * 返り値は現在の状態を引き継ぎ、このインスタンスは2^128個先まで進む
+   * ワーカー毎に乱数生成器を分ける場合に使う
+   */
+  prng split();
+
+  /*
+   * 乱数生成器の状態をそのまま写したもの
+   * ファイルに保存しておき、後で同じ系列の続きから乱数を引く為に使う
+   * パディングを含まないので、バイト列として読み書きできる
+   */
+  struct state_type {
+    std::array< std::uint64_t, 4 > s;
+    std::array< result_type, batch_size > buf;
+    std::uint64_t pos;
+  };
+
+  state_type get_state() const;
+  // posがbatch_sizeより大きい場合は、補充済みの乱数を捨てたものとして扱う
+  void set_state( const state_type &state );
+
+private:
+  std::uint64_t next();
+  void refill();
+  void jump();
+
+  std::array< std::uint64_t, 4 > s;
+  std::array< result_type, batch_size > buf;
+  std::size_t pos;
+};
+
+}
+#endif
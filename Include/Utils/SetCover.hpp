@@ -0,0 +1,24 @@
+#ifndef FUZZUF_INCLUDE_UTILS_SET_COVER_HPP
+#define FUZZUF_INCLUDE_UTILS_SET_COVER_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+namespace fuzzuf::utils {
+
+// set_coverに渡す1つの集合
+// 要素はビット集合の各ビットで、0でない語の位置と値だけを持つ
+struct set_cover_item {
+  // 小さいほど選ばれやすい
+  std::uint64_t size = 0u;
+  std::vector< std::uint32_t > word_pos;
+  std::vector< std::uint64_t > words;
+};
+
+// items全体が持つ要素を全て覆う集合を、貪欲な重み付き集合被覆で選び、その添字を昇順に返す
+// 要素ごとにそれを持つ最も小さい集合（同じ大きさなら添字が小さい方）を選んでおき、
+// 持っている集合が少ない要素から順に、まだ覆われていなければその集合を採用する
+// 結果はitemsの内容と順序だけで決まる。num_wordsは各ビット集合の語数
+std::vector< std::size_t > set_cover( const std::vector< set_cover_item > &items, std::uint32_t num_words );
+
+}
+#endif
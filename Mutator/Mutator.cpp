@@ -1,7 +1,6 @@
 #include "Mutator/Mutator.hpp"
 
 #include <cassert>
-#include <random>
 
 #include "Algorithms/AFL/AFLDictData.hpp"
 #include "Algorithms/AFL/AFLUtil.hpp"
@@ -62,41 +61,70 @@ const std::vector<s32> Mutator::interesting_32 { INTERESTING_8,
 
 Mutator::Mutator( const ExecInput &input ) :
         input( input ),
-        len( input.GetLen() ),
-        outbuf( new u8[len] ),
-        tmpbuf( nullptr ),
-        temp_len( 0 ),
-        splbuf( nullptr ),
-        spl_len( 0 ),
-        rand_fd( Util::OpenFile("/dev/urandom", O_RDONLY | O_CLOEXEC) )
+        own_rng( new fuzzuf::utils::random::prng(fuzzuf::utils::random::prng::create()) ),
+        rng( *own_rng ),
+        own_arena( new MutationArena() ),
+        arena( *own_arena )
 {
-    std::memcpy(outbuf, input.GetBuf(), len);
+    LoadSeed();
 }
 
-Mutator::~Mutator() {
-    if (outbuf) delete[] outbuf;
-    if (tmpbuf) delete[] tmpbuf;
-    if (splbuf) delete[] splbuf;
-    if (rand_fd != -1) {
-      Util::CloseFile(rand_fd);
-      rand_fd = -1;
-    }
+Mutator::Mutator( const ExecInput &input, fuzzuf::utils::random::prng &rng ) :
+        input( input ),
+        rng( rng ),
+        own_arena( new MutationArena() ),
+        arena( *own_arena )
+{
+    LoadSeed();
+}
+
+Mutator::Mutator( 
+    const ExecInput &input, 
+    fuzzuf::utils::random::prng &rng, 
+    MutationArena &arena 
+) :
+        input( input ),
+        rng( rng ),
+        arena( arena )
+{
+    LoadSeed();
 }
 
+// Copy the seed into the arena. This allocates only when the seed is 
+// larger than any seed seen before.
+void Mutator::LoadSeed() {
+    len = input.GetLen();
+    arena.outbuf.resize(len);
+    outbuf = arena.outbuf.data();
+    tmpbuf = nullptr;
+    temp_len = 0;
+    splbuf = nullptr;
+    spl_len = 0;
+
+    std::memcpy(outbuf, input.GetBuf(), len);
+}
+
+// All the buffers belong to the arena
+Mutator::~Mutator() {}
+
 Mutator::Mutator(Mutator&& src):
         input( src.input ),
+        own_rng( std::move(src.own_rng) ),
+        rng( src.rng ),
+        own_arena( std::move(src.own_arena) ),
+        arena( src.arena ),
         len( src.len ),
         outbuf( src.outbuf ),
         tmpbuf( src.tmpbuf ),
         temp_len( src.temp_len),
         splbuf( src.splbuf ),
         spl_len( src.spl_len ),
-        rand_fd( src.rand_fd )
+        havoc_weights( src.havoc_weights ),
+        havoc_dispatch( src.havoc_dispatch )
 {
     src.outbuf = nullptr;
     src.tmpbuf = nullptr;
     src.splbuf = nullptr;
-    src.rand_fd = -1;
 }
 
 const ExecInput& Mutator::GetSource() {
@@ -112,7 +140,7 @@ u32 Mutator::ChooseBlockLen(u32 limit) {
 
     // just an alias of afl::util::UR
     auto UR = [this](u32 limit) {
-        return afl::util::UR(limit, rand_fd);
+        return afl::util::UR(limit, rng);
     };
 
     switch (UR(rlim)) {
@@ -143,15 +171,7 @@ u32 Mutator::ChooseBlockLen(u32 limit) {
 // パフォーマンスを気にしてこの実装になっているなら、debugビルドのときだけassertが有効になるdebug_assertを用意すればいい
 
 u32 Mutator::OverwriteWithSet(u32 pos, const std::vector<char> &char_set) {
-  std::vector<char> out;
-  std::sample(
-      char_set.begin(),
-      char_set.end(),
-      std::back_inserter(out),
-      1,
-      mt_engine
-  );
-  outbuf[pos] = out[0];
+  outbuf[pos] = char_set[rng.below(char_set.size())];
   return 1;
 }
 
@@ -184,310 +204,334 @@ u32 Mutator::FlipByte(u32 pos, int n) {
     return 1;    
 }
 
-void Mutator::Replace(int pos, u8 *buf, u32 len) {
+void Mutator::Replace(int pos, const u8 *buf, u32 len) {
     std::memcpy(outbuf+pos, buf, len);
 }
 
-void Mutator::Havoc(
-    u32 stacking, 
-    const std::vector<AFLDictData> &extras, 
-    const std::vector<AFLDictData> &a_extras
-) {
-    DEBUG("Havoc(%u) <Before>\n", stacking);
+/* The havoc engine. Every operator is a plain function working on the
+   mutant being assembled at the tail of havoc_buf, so that a whole batch
+   of stacked mutants can be generated in one call without allocating.
+
+   Each operator draws its random numbers in a fixed order, which is the
+   same as the order original AFL evaluates them in with BEHAVE_DETERMINISTIC. */
+
+namespace {
 
-    // FIXME: all the operations can be rewritten with vector<u8>
+struct HavocTarget {
+    std::vector<u8> &havoc_buf;
+    std::size_t begin;
+    Mutator &mutator;
+    fuzzuf::utils::random::prng &rng;
+    const std::vector<AFLDictData> &extras;
+    const std::vector<AFLDictData> &a_extras;
 
-    if (temp_len < len) {
-        delete[] tmpbuf;
-        tmpbuf = nullptr;
+    u8 *Buf() { return havoc_buf.data() + begin; }
+    u32 Len() const { return havoc_buf.size() - begin; }
+    u32 UR(u32 limit) { return rng.below(limit); }
+
+    // Open a gap of n bytes at pos. The content of the gap is unspecified.
+    void Insert(u32 pos, u32 n) {
+        u32 old_len = Len();
+        havoc_buf.resize(havoc_buf.size() + n);
+        std::memmove(Buf() + pos + n, Buf() + pos, old_len - pos);
     }
 
-    if (!tmpbuf) {
-        tmpbuf = new u8[len];
+    void Erase(u32 pos, u32 n) {
+        std::memmove(Buf() + pos, Buf() + pos + n, Len() - pos - n);
+        havoc_buf.resize(havoc_buf.size() - n);
     }
 
-    std::memcpy(tmpbuf, outbuf, len);
-    temp_len = len;
- 
-    // swap outbuf and tmpbuf to use mutation function on tmpbuf
-    // also, if we want to restore the original buffer
-    // we can just swap them again
-    std::swap(outbuf, tmpbuf);
-    std::swap(len, temp_len);
+    // The value used to fill a block: a random byte (50%) or a byte from the buffer.
+    u8 FillValue() {
+        return UR(2) ? UR(256) : Buf()[UR(Len())];
+    }
+};
 
-    // just an alias of afl::util::UR
-    auto UR = [this](u32 limit) {
-        return afl::util::UR(limit, rand_fd);
-    };
+template<typename T>
+T HavocRead(HavocTarget &t, u32 pos) {
+    T v;
+    std::memcpy(&v, t.Buf() + pos, sizeof(T));
+    return v;
+}
 
-    for (std::size_t i = 0; i < stacking; i++) {
-        const u32 num_cases = (extras.empty() && a_extras.empty()) ? 15 : 17;
-        switch (UR(num_cases)) {
-        case 0:
-            /* Flip a single bit somewhere. Spooky! */
-            FlipBit(UR(len << 3), 1);
-            break;
-        case 1: 
-            /* Set byte to interesting value. */
-#ifdef BEHAVE_DETERMINISTIC
-            {
-                auto a = UR(len);
-                auto b = UR(interesting_8.size());
-                InterestN<u8>(a, b, false);
-            }
-#else
-            InterestN<u8>(UR(len), UR(interesting_8.size()), false);
-#endif
-            break;
-        case 2:
-            /* Set word to interesting value, randomly choosing endian. */
-            if (len < 2) break;
-#ifdef BEHAVE_DETERMINISTIC
-            {
-                auto c = !UR(2);
-                auto a = UR(len - 1);
-                auto b = UR(interesting_16.size());
-                InterestN<u16>(a, b, c);
-            }
-#else
-            InterestN<u16>(UR(len - 1), UR(interesting_16.size()), !UR(2));
-#endif
-            break;
-        case 3:
-            /* Set dword to interesting value, randomly choosing endian. */
-            if (len < 4) break;
-#ifdef BEHAVE_DETERMINISTIC
-            {
-                auto c = !UR(2);
-                auto a = UR(len - 3);
-                auto b = UR(interesting_32.size());
-                InterestN<u32>(a, b, c);
-            }
-#else
-            InterestN<u32>(UR(len - 3), UR(interesting_32.size()), !UR(2));
-#endif
-            break;
-        case 4:
-            /* Randomly subtract from byte. */
-#ifdef BEHAVE_DETERMINISTIC
-            {
-                auto a = UR(len);
-                auto b = 1 + UR(AFLOption::ARITH_MAX);
-                SubN<u8>(a, b, false);
-            }
-#else
-            SubN<u8>(UR(len), 1 + UR(AFLOption::ARITH_MAX), false);
-#endif
-            break;
-        case 5:
-            /* Randomly add to byte. */
-#ifdef BEHAVE_DETERMINISTIC
-            {
-                auto a = UR(len);
-                auto b = 1 + UR(AFLOption::ARITH_MAX);
-                AddN<u8>(a, b, false);
-            }
-#else
-            AddN<u8>(UR(len), 1 + UR(AFLOption::ARITH_MAX), false);
-#endif
-            break;
-        case 6:
-            /* Randomly subtract from word, random endian. */
-            if (len < 2) break;
-#ifdef BEHAVE_DETERMINISTIC
-            {
-                auto c = !UR(2);
-                auto a = UR(len - 1);
-                auto b = 1 + UR(AFLOption::ARITH_MAX);
-                SubN<u16>(a, b, c);
-            }
-#else
-            SubN<u16>(UR(len - 1), 1 + UR(AFLOption::ARITH_MAX), !UR(2));
-#endif
-            break;
-        case 7:
-            /* Randomly add to word, random endian. */
-            if (len < 2) break;
-#ifdef BEHAVE_DETERMINISTIC
-            {
-                auto c = !UR(2);
-                auto a = UR(len - 1);
-                auto b = 1 + UR(AFLOption::ARITH_MAX);
-                AddN<u16>(a, b, c);
-            }
-#else
-            AddN<u16>(UR(len - 1), 1 + UR(AFLOption::ARITH_MAX), !UR(2));
-#endif
-            break;
-        case 8:
-            /* Randomly subtract from dword, random endian. */
-            if (len < 4) break;
-#ifdef BEHAVE_DETERMINISTIC
-            {
-                auto c = !UR(2);
-                auto a = UR(len - 3);
-                auto b = 1 + UR(AFLOption::ARITH_MAX);
-                SubN<u32>(a, b, c);
-            }
-#else
-            SubN<u32>(UR(len - 3), 1 + UR(AFLOption::ARITH_MAX), !UR(2));
-#endif
-            break;
-        case 9:
-            /* Randomly add to dword, random endian. */
-            if (len < 4) break;
-#ifdef BEHAVE_DETERMINISTIC
-            {
-                auto c = !UR(2);
-                auto a = UR(len - 3);
-                auto b = 1 + UR(AFLOption::ARITH_MAX);
-                AddN<u32>(a, b, c);
-            }
-#else
-            AddN<u32>(UR(len - 3), 1 + UR(AFLOption::ARITH_MAX), !UR(2));
-#endif
-            break;
-        case 10:
-          /* Just set a random byte to a random value. Because,
-             why not. We use XOR with 1-255 to eliminate the
-             possibility of a no-op. */
-#ifdef BEHAVE_DETERMINISTIC
-             {
-                auto a = 1 + UR(255);
-                outbuf[UR(len)] ^= a;
-             }
-#else
-             outbuf[UR(len)] ^= 1 + UR(255);
-#endif
-             break;
-        case 11 ... 12: {
-            /* Delete bytes. We're making this a bit more likely
-               than insertion (the next option) in hopes of keeping
-               files reasonably small. */
-
-            u32 del_from, del_len;
-            if (len < 2) break;
-
-            /* Don't delete too much. */
-            del_len = ChooseBlockLen(len - 1);
-            del_from = UR(len - del_len + 1);
-            std::memmove(outbuf + del_from, outbuf + del_from + del_len,
-                     len - del_from - del_len);
-            len -= del_len;
-            break;
-        }
-        case 13:
-            if (len + AFLOption::HAVOC_BLK_XL < AFLOption::MAX_FILE) {
-            /* Clone bytes (75%) or insert a block of constant bytes (25%). */
-                u8  actually_clone = UR(4);
-                u32 clone_from, clone_to, clone_len;
-                u8* new_buf;
-                if (actually_clone) {
-                    clone_len  = ChooseBlockLen(len);
-                    clone_from = UR(len - clone_len + 1);
-                } else {
-                    clone_len = ChooseBlockLen(AFLOption::HAVOC_BLK_XL);
-                    clone_from = 0;
-                }
-
-                clone_to   = UR(len);
-
-                new_buf = new u8[len + clone_len];
-
-                /* Head */
-                std::memcpy(new_buf, outbuf, clone_to);
-                /* Inserted part */
-                if (actually_clone)
-                    std::memcpy(new_buf + clone_to, outbuf + clone_from, clone_len);
-                else
-                    std::memset(new_buf + clone_to,
-                                UR(2) ? UR(256) : outbuf[UR(len)], clone_len);
-                /* Tail */
-                std::memcpy(new_buf + clone_to + clone_len, outbuf + clone_to,
-                    len - clone_to);
-                delete[] outbuf;
-                outbuf = new_buf;
-                len += clone_len;
-            }
-            break;
-        case 14: {
-            /* Overwrite bytes with a randomly selected chunk (75%) or fixed
-               bytes (25%). */
-            u32 copy_from, copy_to, copy_len;
-
-            if (len < 2) break;
-
-            copy_len  = ChooseBlockLen(len - 1);
-            copy_from = UR(len - copy_len + 1);
-            copy_to   = UR(len - copy_len + 1);
-
-            if (UR(4)) {
-                if (copy_from != copy_to)
-                    std::memmove(outbuf + copy_to, outbuf + copy_from, copy_len);
-
-            } else std::memset(outbuf + copy_to,
-                          UR(2) ? UR(256) : outbuf[UR(len)], copy_len);
-            break;
-        }
+template<typename T>
+void HavocWrite(HavocTarget &t, u32 pos, T v) {
+    std::memcpy(t.Buf() + pos, &v, sizeof(T));
+}
 
-        /* Values 15 and 16 can be selected only if there are any extras
-           present in the dictionaries. */
-        case 15: {
-            /* Overwrite bytes with an extra. */
+template<typename T>
+T HavocSwap(T v) {
+    if constexpr (sizeof(T) == 2) return SWAP16(v);
+    else if constexpr (sizeof(T) == 4) return SWAP32(v);
+    else return v;
+}
 
-            bool use_auto = extras.empty() || (!a_extras.empty() && UR(2));
-            u32 idx = use_auto ? UR(a_extras.size()) : UR(extras.size());
-            const AFLDictData &extra = use_auto ? a_extras[idx] : extras[idx];
+/* Flip a single bit somewhere. Spooky! */
 
-            u32 extra_len = extra.data.size();
-            if (extra_len > len) break;
+void HavocFlipBit(HavocTarget &t) {
+    FLIP_BIT(t.Buf(), t.UR(t.Len() << 3));
+}
 
-            u32 insert_at = UR(len - extra_len + 1);
-            std::memcpy(outbuf + insert_at, &extra.data[0], extra_len);
+/* Set byte, word or dword to interesting value, randomly choosing endian. */
 
-            break;
-        }
+template<typename T, typename V>
+void HavocInterest(HavocTarget &t, const std::vector<V> &values) {
+    if (t.Len() < sizeof(T)) return;
+
+    bool be = sizeof(T) > 1 && !t.UR(2);
+    u32 pos = t.UR(t.Len() - sizeof(T) + 1);
+    T val = values[t.UR(values.size())];
+    HavocWrite<T>(t, pos, be ? HavocSwap<T>(val) : val);
+}
+
+void HavocInterest8(HavocTarget &t) {
+    HavocInterest<u8>(t, Mutator::interesting_8);
+}
+
+void HavocInterest16(HavocTarget &t) {
+    HavocInterest<u16>(t, Mutator::interesting_16);
+}
+
+void HavocInterest32(HavocTarget &t) {
+    HavocInterest<u32>(t, Mutator::interesting_32);
+}
+
+/* Randomly add to or subtract from byte, word or dword, random endian. */
+
+template<typename T, bool subtract>
+void HavocArith(HavocTarget &t) {
+    if (t.Len() < sizeof(T)) return;
+
+    bool be = sizeof(T) > 1 && !t.UR(2);
+    u32 pos = t.UR(t.Len() - sizeof(T) + 1);
+    T val = 1 + t.UR(AFLOption::ARITH_MAX);
+
+    T orig = HavocRead<T>(t, pos);
+    if (be) orig = HavocSwap<T>(orig);
+    T r = subtract ? T(orig - val) : T(orig + val);
+    HavocWrite<T>(t, pos, be ? HavocSwap<T>(r) : r);
+}
+
+/* Just set a random byte to a random value. Because, why not. We use XOR
+   with 1-255 to eliminate the possibility of a no-op. */
+
+void HavocXorByte(HavocTarget &t) {
+    u8 val = 1 + t.UR(255);
+    t.Buf()[t.UR(t.Len())] ^= val;
+}
+
+/* Delete bytes. */
+
+void HavocDelete(HavocTarget &t) {
+    if (t.Len() < 2) return;
 
-        case 16: {
-            u32 insert_at = UR(len + 1);
+    /* Don't delete too much. */
 
-            /* Insert an extra. Do the same dice-rolling stuff as for the
-               previous case. */
+    u32 del_len = t.mutator.ChooseBlockLen(t.Len() - 1);
+    u32 del_from = t.UR(t.Len() - del_len + 1);
+    t.Erase(del_from, del_len);
+}
+
+/* Clone bytes (75%) or insert a block of constant bytes (25%). */
+
+void HavocClone(HavocTarget &t) {
+    u32 len = t.Len();
+    if (len + AFLOption::HAVOC_BLK_XL >= AFLOption::MAX_FILE) return;
+
+    bool actually_clone = t.UR(4);
+    u32 clone_from, clone_len;
+    if (actually_clone) {
+        clone_len  = t.mutator.ChooseBlockLen(len);
+        clone_from = t.UR(len - clone_len + 1);
+    } else {
+        clone_len  = t.mutator.ChooseBlockLen(AFLOption::HAVOC_BLK_XL);
+        clone_from = 0;
+    }
+
+    u32 clone_to = t.UR(len);
+
+    if (actually_clone) {
+        t.Insert(clone_to, clone_len);
 
-            bool use_auto = extras.empty() || (!a_extras.empty() && UR(2));
-            u32 idx = use_auto ? UR(a_extras.size()) : UR(extras.size());
-            const AFLDictData &extra = use_auto ? a_extras[idx] : extras[idx];
+        /* The part of the source behind clone_to has been shifted by the gap. */
 
-            u32 extra_len = extra.data.size();
+        u32 head = clone_from < clone_to ? std::min(clone_len, clone_to - clone_from) : 0;
+        std::memcpy(t.Buf() + clone_to, t.Buf() + clone_from, head);
+        std::memcpy(t.Buf() + clone_to + head, t.Buf() + clone_from + head + clone_len,
+                    clone_len - head);
+    } else {
+        u8 val = t.FillValue();
+        t.Insert(clone_to, clone_len);
+        std::memset(t.Buf() + clone_to, val, clone_len);
+    }
+}
 
-            if (len + extra_len >= AFLOption::MAX_FILE) break;
+/* Overwrite bytes with a randomly selected chunk (75%) or fixed bytes (25%). */
 
-            u8* new_buf = new u8[len + extra_len];
+void HavocOverwrite(HavocTarget &t) {
+    if (t.Len() < 2) return;
 
-            /* Head */
-            std::memcpy(new_buf, outbuf, insert_at);
+    u32 copy_len  = t.mutator.ChooseBlockLen(t.Len() - 1);
+    u32 copy_from = t.UR(t.Len() - copy_len + 1);
+    u32 copy_to   = t.UR(t.Len() - copy_len + 1);
+
+    if (t.UR(4)) {
+        if (copy_from != copy_to)
+            std::memmove(t.Buf() + copy_to, t.Buf() + copy_from, copy_len);
+    } else {
+        u8 val = t.FillValue();
+        std::memset(t.Buf() + copy_to, val, copy_len);
+    }
+}
+
+const AFLDictData &HavocChooseExtra(HavocTarget &t) {
+    bool use_auto = t.extras.empty() || (!t.a_extras.empty() && t.UR(2));
+    if (use_auto) return t.a_extras[t.UR(t.a_extras.size())];
+    return t.extras[t.UR(t.extras.size())];
+}
+
+/* Overwrite bytes with an extra. */
+
+void HavocOverwriteExtra(HavocTarget &t) {
+    const AFLDictData &extra = HavocChooseExtra(t);
+
+    u32 extra_len = extra.data.size();
+    if (extra_len > t.Len()) return;
+
+    u32 insert_at = t.UR(t.Len() - extra_len + 1);
+    std::memcpy(t.Buf() + insert_at, &extra.data[0], extra_len);
+}
+
+/* Insert an extra. */
+
+void HavocInsertExtra(HavocTarget &t) {
+    u32 insert_at = t.UR(t.Len() + 1);
+
+    const AFLDictData &extra = HavocChooseExtra(t);
+
+    u32 extra_len = extra.data.size();
+    if (t.Len() + extra_len >= AFLOption::MAX_FILE) return;
+
+    t.Insert(insert_at, extra_len);
+    std::memcpy(t.Buf() + insert_at, &extra.data[0], extra_len);
+}
+
+struct HavocOperator {
+    void (*func)(HavocTarget&);
+    bool needs_extras;
+};
+
+// Indexed by Mutator::HavocOp
+constexpr HavocOperator HAVOC_OPERATORS[] = {
+    { HavocFlipBit,            false },
+    { HavocInterest8,          false },
+    { HavocInterest16,         false },
+    { HavocInterest32,         false },
+    { HavocArith<u8, true>,    false },
+    { HavocArith<u8, false>,   false },
+    { HavocArith<u16, true>,   false },
+    { HavocArith<u16, false>,  false },
+    { HavocArith<u32, true>,   false },
+    { HavocArith<u32, false>,  false },
+    { HavocXorByte,            false },
+    { HavocDelete,             false },
+    { HavocClone,              false },
+    { HavocOverwrite,          false },
+    { HavocOverwriteExtra,     true  },
+    { HavocInsertExtra,        true  },
+};
+
+static_assert(std::size(HAVOC_OPERATORS) == Mutator::NUM_HAVOC_OPS,
+              "HAVOC_OPERATORS must have an entry for each Mutator::HavocOp");
+
+} // namespace
+
+/* Same distribution as original AFL: deletion is twice as likely as the
+   others, in hopes of keeping files reasonably small. */
+
+const Mutator::HavocWeights Mutator::DEFAULT_HAVOC_WEIGHTS 
+    = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1 };
+
+void Mutator::SetHavocWeights(const HavocWeights &weights) {
+    havoc_weights = weights;
+    for (auto &dispatch : havoc_dispatch) dispatch.size = 0;
+}
 
-            /* Inserted part */
-            std::memcpy(new_buf + insert_at, &extra.data[0], extra_len);
+/* Expand the weights into a table so that an operator is chosen with a
+   single UR(). With the default weights, this results in the same choice
+   as original AFL's switch (UR(15 or 17)). */
 
-            /* Tail */
-            std::memcpy(new_buf + insert_at + extra_len, outbuf + insert_at,
-                   len - insert_at);
+const Mutator::HavocDispatch &Mutator::GetHavocDispatch(bool with_extras) {
+    auto &dispatch = havoc_dispatch[with_extras];
+    if (dispatch.size) return dispatch;
 
-            delete[] outbuf;
-            outbuf   = new_buf;
-            len += extra_len;
-            
-            break;
+    for (u32 op=0; op < NUM_HAVOC_OPS; op++) {
+        if (HAVOC_OPERATORS[op].needs_extras && !with_extras) continue;
+        if (dispatch.size + havoc_weights[op] > MAX_HAVOC_DISPATCH) {
+            ERROR("Havoc: the sum of weights must not exceed %u", MAX_HAVOC_DISPATCH);
         }
+        std::fill_n(dispatch.ops.begin() + dispatch.size, havoc_weights[op], op);
+        dispatch.size += havoc_weights[op];
+    }
+
+    if (!dispatch.size) ERROR("Havoc: no operator has positive weight");
+    return dispatch;
+}
+
+void Mutator::HavocBatch(
+    const std::vector<u32> &stackings, 
+    const std::vector<AFLDictData> &extras, 
+    const std::vector<AFLDictData> &a_extras
+) {
+    // outbuf must not point into havoc_buf which we are going to overwrite
+    assert(!tmpbuf);
+
+    const auto &dispatch = GetHavocDispatch(!extras.empty() || !a_extras.empty());
+
+    auto &havoc_buf = arena.havoc_buf;
+    auto &havoc_mutants = arena.havoc_mutants;
+    havoc_buf.clear();
+    havoc_mutants.clear();
+
+    for (u32 stacking : stackings) {
+        std::size_t begin = havoc_buf.size();
+        havoc_buf.insert(havoc_buf.end(), outbuf, outbuf + len);
+
+        HavocTarget target{havoc_buf, begin, *this, rng, extras, a_extras};
+        for (u32 i=0; i < stacking; i++) {
+            HAVOC_OPERATORS[dispatch.ops[rng.below(dispatch.size)]].func(target);
         }
+
+        havoc_mutants.emplace_back(begin, target.Len());
     }
 }
 
+std::pair<const u8*, u32> Mutator::GetHavocMutant(std::size_t i) const {
+    const auto &[begin, mutant_len] = arena.havoc_mutants[i];
+    return {arena.havoc_buf.data() + begin, mutant_len};
+}
+
+void Mutator::Havoc(
+    u32 stacking, 
+    const std::vector<AFLDictData> &extras, 
+    const std::vector<AFLDictData> &a_extras
+) {
+    DEBUG("Havoc(%u) <Before>\n", stacking);
+
+    HavocBatch({stacking}, extras, a_extras);
+
+    // Let outbuf point to the mutant until RestoreHavoc() is called
+    tmpbuf = outbuf;
+    temp_len = len;
+    outbuf = arena.havoc_buf.data() + arena.havoc_mutants[0].first;
+    len = arena.havoc_mutants[0].second;
+}
+
 // FIXME: add a test which uses this with AFLMutationHierarFlowRoutines
 void Mutator::RestoreHavoc(void) {
-    std::swap(outbuf, tmpbuf);
-    std::swap(len, temp_len);
+    outbuf = tmpbuf;
+    len = temp_len;
+    tmpbuf = nullptr;
 }
 
 // return true if the splice occurred, and false otherwise
@@ -499,17 +543,13 @@ bool Mutator::Splice(const ExecInput& target) {
 
     /* Split somewhere between the first and last differing byte. */
 
-    u32 split_at = f_diff + afl::util::UR(l_diff - f_diff, rand_fd);
+    u32 split_at = f_diff + afl::util::UR(l_diff - f_diff, rng);
 
     /* Do the thing. */
 
-    if (!splbuf) {
-        splbuf = new u8[target.GetLen()];
-    } else if (spl_len < target.GetLen()) {
-        // We reallocate a buffer only when its size is not enough
-        delete[] splbuf;
-        splbuf = new u8[target.GetLen()];
-    }
+    // The arena reallocates the buffer only when its capacity is not enough
+    arena.splbuf.resize(target.GetLen());
+    splbuf = arena.splbuf.data();
 
     spl_len = target.GetLen();
     std::memcpy(splbuf, outbuf, split_at);
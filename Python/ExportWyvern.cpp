@@ -25,7 +25,7 @@ PYBIND11_PLUGIN(wyvern) {
         .def("get_buf", &PySeed::GetBuf)
         .def("get_feedback", &PySeed::GetFeedback)
         .def("__repr__", [](const PySeed &self) {
-            return Util::StrPrintf("Seed(id=%ld, ...)", self.GetID());
+            return Util::StrPrintf("Seed(id=%llu, ...)", static_cast<unsigned long long>(self.GetID()));
         });
 
     // 後方互換性のためPython側の"get_trace"という古い名前はget_bb_traceにしない（一旦）
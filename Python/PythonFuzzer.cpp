@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstddef>
 #include "Python/PythonFuzzer.hpp"
 #include "Options.hpp"
@@ -234,19 +235,26 @@ void PythonFuzzer::SelectSeed(u64 seed_id) {
     auto itr = state->test_set.find(seed_id);
     if (itr == state->test_set.end()) ERROR("specified seed ID is not found"); 
     
-    state->mutator.reset(new Mutator(*itr->second->input));
+    // The arena can be lent to only one mutator at a time
+    state->mutator.reset();
+    state->mutator.reset(new Mutator(*itr->second->input, state->rng, state->mutation_arena));
 }
 
 void PythonFuzzer::RemoveSeed(u64 seed_id) {
     auto itr = state->test_set.find(seed_id);
     if (itr == state->test_set.end()) ERROR("specified seed ID is not found");
 
-    state->input_set.erase(seed_id);
-    state->test_set.erase(seed_id);
+    state->input_set.erase(itr->second->input->GetID());
+    state->test_set.erase(itr);
 }
 
 std::vector<u64> PythonFuzzer::GetSeedIDs(void) {
-    return state->input_set.get_ids();
+    std::vector<u64> seed_ids;
+    seed_ids.reserve(state->test_set.size());
+    for( auto& itr : state->test_set )
+        seed_ids.emplace_back(itr.first);
+    std::sort(seed_ids.begin(), seed_ids.end());
+    return seed_ids;
 }
 
 std::optional<PySeed> PythonFuzzer::GetPySeed(u64 seed_id) {
@@ -36,17 +36,18 @@ NullableRef<HierarFlowCallee<PyUpdInputType>> PyUpdate::operator()(
 ) {
 
     auto input = state.input_set.CreateOnMemory(buf, len);
+    u64 seed_id = state.next_seed_id++;
 
     std::string fn;
     if ( exit_status.exit_reason == PUTExitReasonType::FAULT_TMOUT ) {
-        fn = Util::StrPrintf("%s/hangs/%06u",
-            state.setting.out_dir.c_str(), input->GetID());
+        fn = Util::StrPrintf("%s/hangs/%06llu",
+            state.setting.out_dir.c_str(), static_cast<unsigned long long>(seed_id));
     } else if ( exit_status.exit_reason == PUTExitReasonType::FAULT_CRASH ) {
-        fn = Util::StrPrintf("%s/crashes/%06u",
-            state.setting.out_dir.c_str(), input->GetID());
+        fn = Util::StrPrintf("%s/crashes/%06llu",
+            state.setting.out_dir.c_str(), static_cast<unsigned long long>(seed_id));
     } else {
-        fn = Util::StrPrintf("%s/queue/id:%06u",
-            state.setting.out_dir.c_str(), input->GetID());
+        fn = Util::StrPrintf("%s/queue/id:%06llu",
+            state.setting.out_dir.c_str(), static_cast<unsigned long long>(seed_id));
     }
 
     input->SaveToFile(fn);
@@ -54,12 +55,12 @@ NullableRef<HierarFlowCallee<PyUpdInputType>> PyUpdate::operator()(
     // Currently, we do not push malformed inputs into the testcase set
     if ( exit_status.exit_reason == PUTExitReasonType::FAULT_TMOUT
       || exit_status.exit_reason == PUTExitReasonType::FAULT_CRASH ) {
+        state.input_set.erase(input->GetID());
         SetResponseValue(ExecInput::INVALID_INPUT_ID);
     } else {
-        u64 id = input->GetID();
-        SetResponseValue(id);
+        SetResponseValue(seed_id);
 
-        state.test_set.emplace(id, 
+        state.test_set.emplace(seed_id, 
             std::make_unique<PythonTestcase>(
                 std::move(input),
                 std::move(afl_inp_feed.ConvertToPersistent()),
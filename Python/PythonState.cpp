@@ -2,6 +2,7 @@
 
 PythonState::PythonState(const PythonSetting &setting) 
     : setting( setting ),
-      input_set() {}
+      input_set(),
+      rng( fuzzuf::utils::random::prng::create() ) {}
 
 PythonState::~PythonState() {}
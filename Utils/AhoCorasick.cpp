@@ -0,0 +1,96 @@
+#include "Utils/AhoCorasick.hpp"
+
+#include <algorithm>
+#include <deque>
+
+namespace fuzzuf::utils::aho_corasick {
+
+matcher::matcher() : num_classes( 1u ) {
+  byte_class.fill( 0u );
+}
+
+std::uint32_t matcher::add( const std::uint8_t *token, std::size_t len ) {
+  tokens.emplace_back( token, token + len );
+  lengths.push_back( len );
+  return std::uint32_t( lengths.size() - 1u );
+}
+
+void matcher::clear() {
+  tokens.clear();
+  lengths.clear();
+  byte_class.fill( 0u );
+  num_classes = 1u;
+  delta.clear();
+  out_begin.clear();
+  out_ids.clear();
+  has_output.clear();
+  out_link.clear();
+}
+
+void matcher::compile() {
+  // トークンに現れないバイトは全てクラス0にまとめる
+  std::array< bool, 256u > used{};
+  for( const auto &token: tokens )
+    for( auto c: token ) used[ c ] = true;
+  num_classes = 1u;
+  for( std::size_t c = 0u; c != 256u; ++c )
+    byte_class[ c ] = used[ c ] ? num_classes++ : 0u;
+
+  // トライを作る。この時点ではdeltaの未定義の遷移はno_state
+  delta.assign( num_classes, no_state );
+  std::vector< std::vector< std::uint32_t > > outputs( 1u );
+  for( std::uint32_t id = 0u; id != tokens.size(); ++id ) {
+    if( tokens[ id ].empty() ) continue;
+    std::uint32_t state = 0u;
+    for( auto c: tokens[ id ] ) {
+      auto &next = delta[ std::size_t( state ) * num_classes + byte_class[ c ] ];
+      if( next == no_state ) {
+        next = std::uint32_t( outputs.size() );
+        outputs.emplace_back();
+        delta.resize( delta.size() + num_classes, no_state );
+      }
+      state = delta[ std::size_t( state ) * num_classes + byte_class[ c ] ];
+    }
+    outputs[ state ].push_back( id );
+  }
+  const std::size_t num_states = outputs.size();
+
+  // 幅優先で失敗リンクを求めながら、未定義の遷移を失敗リンク先の遷移で埋める
+  std::vector< std::uint32_t > fail( num_states, 0u );
+  has_output.assign( num_states, 0u );
+  out_link.assign( num_states, no_state );
+  for( std::size_t s = 0u; s != num_states; ++s )
+    has_output[ s ] = !outputs[ s ].empty();
+
+  std::deque< std::uint32_t > queue;
+  for( std::uint32_t c = 0u; c != num_classes; ++c ) {
+    auto &next = delta[ c ];
+    if( next == no_state ) next = 0u;
+    else queue.push_back( next );
+  }
+  while( !queue.empty() ) {
+    const auto state = queue.front();
+    queue.pop_front();
+    const auto f = fail[ state ];
+    out_link[ state ] = has_output[ f ] ? f : out_link[ f ];
+    for( std::uint32_t c = 0u; c != num_classes; ++c ) {
+      auto &next = delta[ std::size_t( state ) * num_classes + c ];
+      const auto fallback = delta[ std::size_t( f ) * num_classes + c ];
+      if( next == no_state ) next = fallback;
+      else {
+        fail[ next ] = fallback;
+        queue.push_back( next );
+      }
+    }
+  }
+
+  out_begin.assign( num_states + 1u, 0u );
+  out_ids.clear();
+  for( std::size_t s = 0u; s != num_states; ++s ) {
+    out_begin[ s ] = std::uint32_t( out_ids.size() );
+    out_ids.insert( out_ids.end(), outputs[ s ].begin(), outputs[ s ].end() );
+  }
+  out_begin[ num_states ] = std::uint32_t( out_ids.size() );
+}
+
+}
@@ -0,0 +1,168 @@
+#include "Utils/AsyncFileWriter.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Utils/Common.hpp"
+
+namespace fuzzuf::utils {
+
+async_file_writer::async_file_writer( std::size_t capacity_ )
+  : capacity( capacity_ ), worker( [this] { run(); } ) {}
+
+async_file_writer::~async_file_writer() {
+  try {
+    flush();
+  }
+  catch( const FileError &e ) {
+    std::cerr << e.what() << std::endl;
+  }
+  {
+    std::lock_guard< std::mutex > lock( guard );
+    stopping = true;
+  }
+  not_empty.notify_all();
+  worker.join();
+}
+
+void async_file_writer::write( const std::string &path, const std::uint8_t *data, std::size_t len ) {
+  std::shared_ptr< std::uint8_t[] > copy( new std::uint8_t[ len ] );
+  if( len ) std::memcpy( copy.get(), data, len );
+  write( path, buffer_t( std::move( copy ) ), len );
+}
+
+void async_file_writer::write( const std::string &path, buffer_t data, std::size_t len ) {
+  enqueue( op_type::write, path, std::move( data ), len );
+}
+
+void async_file_writer::write_exclusive( const std::string &path, const std::uint8_t *data, std::size_t len ) {
+  std::shared_ptr< std::uint8_t[] > copy( new std::uint8_t[ len ] );
+  if( len ) std::memcpy( copy.get(), data, len );
+  enqueue( op_type::write_exclusive, path, buffer_t( std::move( copy ) ), len );
+}
+
+void async_file_writer::create( const std::string &path ) {
+  enqueue( op_type::create, path, nullptr, 0u );
+}
+
+void async_file_writer::remove( const std::string &path ) {
+  enqueue( op_type::remove, path, nullptr, 0u );
+}
+
+bool async_file_writer::get_pending( const std::string &path, buffer_t &data, std::size_t &len ) const {
+  std::lock_guard< std::mutex > lock( guard );
+  const auto found = pending.find( path );
+  if( found == pending.end() ) return false;
+  data = found->second.data;
+  len = found->second.len;
+  return true;
+}
+
+void async_file_writer::flush() {
+  std::unique_lock< std::mutex > lock( guard );
+  const auto target = next_seq - 1u;
+  done.wait( lock, [&] { return done_seq >= target; } );
+  if( !errors.empty() ) {
+    std::string message = errors.front();
+    if( errors.size() > 1u )
+      message += Util::StrPrintf( " (and %zu more errors)", errors.size() - 1u );
+    errors.clear();
+    throw FileError( message );
+  }
+}
+
+std::uint64_t async_file_writer::get_num_batches() const {
+  std::lock_guard< std::mutex > lock( guard );
+  return num_batches;
+}
+
+void async_file_writer::enqueue( op_type type, const std::string &path, buffer_t data, std::size_t len ) {
+  {
+    std::unique_lock< std::mutex > lock( guard );
+    // 1つで容量を超える書き込みは、他が全て終わってから受け付ける
+    done.wait( lock, [&] { return pending_bytes == 0u || pending_bytes + len <= capacity; } );
+    const auto seq = next_seq++;
+    if( type == op_type::write || type == op_type::write_exclusive ) {
+      auto &entry = pending[ path ];
+      pending_bytes -= entry.len;
+      entry = pending_entry{ data, len, seq };
+      pending_bytes += len;
+    }
+    else if( type == op_type::remove ) {
+      const auto found = pending.find( path );
+      if( found != pending.end() ) {
+        pending_bytes -= found->second.len;
+        pending.erase( found );
+      }
+    }
+    queue.push_back( operation{ type, path, std::move( data ), len, seq } );
+  }
+  not_empty.notify_one();
+}
+
+void async_file_writer::run() {
+  std::deque< operation > batch;
+  while( true ) {
+    {
+      std::unique_lock< std::mutex > lock( guard );
+      not_empty.wait( lock, [&] { return stopping || !queue.empty(); } );
+      if( queue.empty() ) return;
+      batch.swap( queue );
+      ++num_batches;
+    }
+
+    std::vector< std::string > failures;
+    for( const auto &op: batch ) {
+      auto message = perform( op );
+      if( !message.empty() ) failures.emplace_back( std::move( message ) );
+    }
+
+    {
+      std::lock_guard< std::mutex > lock( guard );
+      for( const auto &op: batch ) {
+        if( op.type != op_type::write && op.type != op_type::write_exclusive ) continue;
+        const auto found = pending.find( op.path );
+        // 後から同じパスへの書き込みが要求されていれば、その内容は残す
+        if( found != pending.end() && found->second.seq == op.seq ) {
+          pending_bytes -= found->second.len;
+          pending.erase( found );
+        }
+      }
+      done_seq = batch.back().seq;
+      errors.insert( errors.end(), failures.begin(), failures.end() );
+    }
+    done.notify_all();
+    batch.clear();
+  }
+}
+
+std::string async_file_writer::perform( const operation &op ) {
+  if( op.type == op_type::remove ) {
+    if( unlink( op.path.c_str() ) )
+      return "Unable to remove '" + op.path + "': " + std::strerror( errno );
+    return "";
+  }
+
+  int flags = O_WRONLY | O_CREAT;
+  if( op.type == op_type::write ) flags |= O_TRUNC;
+  else flags |= O_EXCL;
+
+  const int fd = open( op.path.c_str(), flags, 0600 );
+  if( fd < 0 )
+    return "Unable to open file: " + op.path + ": " + std::strerror( errno );
+
+  std::string message;
+  try {
+    if( op.len ) Util::WriteFile( fd, op.data.get(), op.len );
+  }
+  catch( const FileError &e ) {
+    message = e.what() + std::string( ": " ) + op.path;
+  }
+  close( fd );
+  return message;
+}
+
+}
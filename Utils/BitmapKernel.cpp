@@ -0,0 +1,319 @@
+#include "config.h"
+#include <numeric>
+#include <iterator>
+#include <algorithm>
+#ifdef HAS_CXX_STD_BIT
+#include <bit>
+#endif
+#ifdef __x86_64__
+#include <immintrin.h>
+#define FUZZUF_BITMAP_KERNEL_X86
+#endif
+#include "Utils/BitmapKernel.hpp"
+
+// Util::CountBits等の実装
+// これらはキャリブレーション、splice、ステータス画面の更新、eff_mapの判定の度に
+// 64KiBのビットマップ全体に対して呼ばれる為、SIMD版を用意して実行時に選択する
+// SIMD版は端数をスカラー版で処理する為、任意の長さに対してスカラー版と同じ結果を返す
+
+namespace fuzzuf::utils::bitmap_kernel {
+
+namespace {
+
+/* Scalar implementations. These are the original ones in Utils/Common.cpp */
+
+u32 count_bits_scalar( const u8* mem, u32 len ) {
+    assert( len % sizeof( u32 ) == 0 );
+    const u32* ptr = reinterpret_cast< const u32* >( mem );
+#ifdef __cpp_lib_bitops
+    return std::accumulate(
+      ptr, std::next( ptr, len >> 2 ), u32( 0 ),
+      []( u32 sum, u32 v ){ return sum + std::popcount( v ); }
+    );
+#else
+    u32  i   = (len >> 2);
+    u32  ret = 0;
+
+    while (i--) {
+
+        u32 v = *(ptr++);
+
+        /* This gets called on the inverse, virgin bitmap; optimize for sparse
+        data. */
+
+        if (v == 0xffffffff) {
+            ret += 32;
+            continue;
+        }
+
+        v -= ((v >> 1) & 0x55555555);
+        v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+        ret += (((v + (v >> 4)) & 0xF0F0F0F) * 0x01010101) >> 24;
+    }
+    return ret;
+#endif
+}
+
+u32 count_eq_scalar( const u8* mem, u32 len, u8 val ) {
+    return std::count( mem, std::next( mem, len ), val );
+}
+
+void minimize_bits_scalar( u8* dst, const u8* src, u32 begin, u32 len ) {
+    u32 i = begin;
+    src += begin;
+    while (i < len) {
+        if (*(src++)) dst[i >> 3] |= 1 << (i & 7);
+        i++;
+    }
+}
+
+s32 first_diff_scalar( const u8* ptr1, const u8* ptr2, u32 begin, u32 end ) {
+    for (u32 pos = begin; pos < end; pos++) {
+        if (ptr1[pos] != ptr2[pos]) return pos;
+    }
+    return -1;
+}
+
+s32 last_diff_scalar( const u8* ptr1, const u8* ptr2, u32 begin, u32 end ) {
+    for (u32 pos = end; pos > begin; pos--) {
+        if (ptr1[pos - 1] != ptr2[pos - 1]) return pos - 1;
+    }
+    return -1;
+}
+
+std::tuple< s32, s32 > locate_diffs_scalar( const u8* ptr1, const u8* ptr2, u32 len ) {
+    s32 f_loc = first_diff_scalar( ptr1, ptr2, 0, len );
+    if (f_loc == -1) return std::make_tuple( -1, -1 );
+    return std::make_tuple( f_loc, last_diff_scalar( ptr1, ptr2, f_loc, len ) );
+}
+
+#ifdef FUZZUF_BITMAP_KERNEL_X86
+
+/* SSE2 implementations. SSE2 is always available on x86_64. */
+
+__attribute__((target("sse2")))
+u32 count_bits_sse2( const u8* mem, u32 len ) {
+    assert( len % sizeof( u32 ) == 0 );
+    const __m128i m1 = _mm_set1_epi8( 0x55 );
+    const __m128i m2 = _mm_set1_epi8( 0x33 );
+    const __m128i m4 = _mm_set1_epi8( 0x0f );
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    u32 i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128( reinterpret_cast< const __m128i* >( mem + i ) );
+        v = _mm_sub_epi8( v, _mm_and_si128( _mm_srli_epi16( v, 1 ), m1 ) );
+        v = _mm_add_epi8( _mm_and_si128( v, m2 ), _mm_and_si128( _mm_srli_epi16( v, 2 ), m2 ) );
+        v = _mm_and_si128( _mm_add_epi8( v, _mm_srli_epi16( v, 4 ) ), m4 );
+        acc = _mm_add_epi64( acc, _mm_sad_epu8( v, zero ) );
+    }
+    u64 ret = u64( _mm_cvtsi128_si64( acc ) ) + u64( _mm_cvtsi128_si64( _mm_unpackhi_epi64( acc, acc ) ) );
+    return ret + count_bits_scalar( mem + i, len - i );
+}
+
+__attribute__((target("sse2")))
+u32 count_eq_sse2( const u8* mem, u32 len, u8 val ) {
+    const __m128i pattern = _mm_set1_epi8( val );
+    u32 ret = 0;
+    u32 i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128( reinterpret_cast< const __m128i* >( mem + i ) );
+        ret += __builtin_popcount( _mm_movemask_epi8( _mm_cmpeq_epi8( v, pattern ) ) );
+    }
+    return ret + count_eq_scalar( mem + i, len - i, val );
+}
+
+__attribute__((target("sse2")))
+void minimize_bits_sse2( u8* dst, const u8* src, u32 len ) {
+    const __m128i zero = _mm_setzero_si128();
+    u32 i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + i ) );
+        u16 bits = ~u16( _mm_movemask_epi8( _mm_cmpeq_epi8( v, zero ) ) );
+        u16 cur;
+        std::memcpy( &cur, dst + ( i >> 3 ), sizeof( cur ) );
+        cur |= bits;
+        std::memcpy( dst + ( i >> 3 ), &cur, sizeof( cur ) );
+    }
+    minimize_bits_scalar( dst, src, i, len );
+}
+
+__attribute__((target("sse2")))
+std::tuple< s32, s32 > locate_diffs_sse2( const u8* ptr1, const u8* ptr2, u32 len ) {
+    const u32 vec_end = len & ~u32( 15 );
+
+    s32 f_loc = -1;
+    for (u32 i = 0; i < vec_end && f_loc == -1; i += 16) {
+        __m128i a = _mm_loadu_si128( reinterpret_cast< const __m128i* >( ptr1 + i ) );
+        __m128i b = _mm_loadu_si128( reinterpret_cast< const __m128i* >( ptr2 + i ) );
+        u32 diff = ~u32( _mm_movemask_epi8( _mm_cmpeq_epi8( a, b ) ) ) & 0xffffu;
+        if (diff) f_loc = i + __builtin_ctz( diff );
+    }
+    if (f_loc == -1) f_loc = first_diff_scalar( ptr1, ptr2, vec_end, len );
+    if (f_loc == -1) return std::make_tuple( -1, -1 );
+
+    s32 l_loc = last_diff_scalar( ptr1, ptr2, vec_end, len );
+    for (u32 i = vec_end; i > 0 && l_loc == -1; i -= 16) {
+        __m128i a = _mm_loadu_si128( reinterpret_cast< const __m128i* >( ptr1 + i - 16 ) );
+        __m128i b = _mm_loadu_si128( reinterpret_cast< const __m128i* >( ptr2 + i - 16 ) );
+        u32 diff = ~u32( _mm_movemask_epi8( _mm_cmpeq_epi8( a, b ) ) ) & 0xffffu;
+        if (diff) l_loc = i - 16 + ( 31 - __builtin_clz( diff ) );
+    }
+    return std::make_tuple( f_loc, l_loc );
+}
+
+/* AVX2 implementations. */
+
+__attribute__((target("avx2,popcnt")))
+u32 count_bits_avx2( const u8* mem, u32 len ) {
+    assert( len % sizeof( u32 ) == 0 );
+    /* Count the bits of each nibble with a lookup table (pshufb) and sum the
+       bytes up with psadbw. */
+    const __m256i lut = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+    );
+    const __m256i low_mask = _mm256_set1_epi8( 0x0f );
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    u32 i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( mem + i ) );
+        __m256i lo = _mm256_and_si256( v, low_mask );
+        __m256i hi = _mm256_and_si256( _mm256_srli_epi16( v, 4 ), low_mask );
+        __m256i cnt = _mm256_add_epi8(
+          _mm256_shuffle_epi8( lut, lo ),
+          _mm256_shuffle_epi8( lut, hi )
+        );
+        acc = _mm256_add_epi64( acc, _mm256_sad_epu8( cnt, zero ) );
+    }
+    u64 ret =
+      u64( _mm256_extract_epi64( acc, 0 ) ) + u64( _mm256_extract_epi64( acc, 1 ) ) +
+      u64( _mm256_extract_epi64( acc, 2 ) ) + u64( _mm256_extract_epi64( acc, 3 ) );
+    return ret + count_bits_scalar( mem + i, len - i );
+}
+
+__attribute__((target("avx2,popcnt")))
+u32 count_eq_avx2( const u8* mem, u32 len, u8 val ) {
+    const __m256i pattern = _mm256_set1_epi8( val );
+    u32 ret = 0;
+    u32 i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( mem + i ) );
+        ret += _mm_popcnt_u32( _mm256_movemask_epi8( _mm256_cmpeq_epi8( v, pattern ) ) );
+    }
+    return ret + count_eq_scalar( mem + i, len - i, val );
+}
+
+__attribute__((target("avx2")))
+void minimize_bits_avx2( u8* dst, const u8* src, u32 len ) {
+    const __m256i zero = _mm256_setzero_si256();
+    u32 i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( src + i ) );
+        u32 bits = ~u32( _mm256_movemask_epi8( _mm256_cmpeq_epi8( v, zero ) ) );
+        u32 cur;
+        std::memcpy( &cur, dst + ( i >> 3 ), sizeof( cur ) );
+        cur |= bits;
+        std::memcpy( dst + ( i >> 3 ), &cur, sizeof( cur ) );
+    }
+    minimize_bits_scalar( dst, src, i, len );
+}
+
+__attribute__((target("avx2")))
+std::tuple< s32, s32 > locate_diffs_avx2( const u8* ptr1, const u8* ptr2, u32 len ) {
+    const u32 vec_end = len & ~u32( 31 );
+
+    s32 f_loc = -1;
+    for (u32 i = 0; i < vec_end && f_loc == -1; i += 32) {
+        __m256i a = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( ptr1 + i ) );
+        __m256i b = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( ptr2 + i ) );
+        u32 diff = ~u32( _mm256_movemask_epi8( _mm256_cmpeq_epi8( a, b ) ) );
+        if (diff) f_loc = i + __builtin_ctz( diff );
+    }
+    if (f_loc == -1) f_loc = first_diff_scalar( ptr1, ptr2, vec_end, len );
+    if (f_loc == -1) return std::make_tuple( -1, -1 );
+
+    s32 l_loc = last_diff_scalar( ptr1, ptr2, vec_end, len );
+    for (u32 i = vec_end; i > 0 && l_loc == -1; i -= 32) {
+        __m256i a = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( ptr1 + i - 32 ) );
+        __m256i b = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( ptr2 + i - 32 ) );
+        u32 diff = ~u32( _mm256_movemask_epi8( _mm256_cmpeq_epi8( a, b ) ) );
+        if (diff) l_loc = i - 32 + ( 31 - __builtin_clz( diff ) );
+    }
+    return std::make_tuple( f_loc, l_loc );
+}
+
+#endif
+
+}
+
+isa_t detect() {
+  static const isa_t detected = []() {
+#ifdef FUZZUF_BITMAP_KERNEL_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "popcnt" ) )
+      return isa_t::AVX2;
+    if( __builtin_cpu_supports( "sse2" ) )
+      return isa_t::SSE2;
+#endif
+    return isa_t::SCALAR;
+  }();
+  return detected;
+}
+
+bool is_available( isa_t isa ) {
+  return isa <= detect();
+}
+
+const char *to_string( isa_t isa ) {
+  switch( isa ) {
+  case isa_t::SCALAR: return "scalar";
+  case isa_t::SSE2: return "sse2";
+  case isa_t::AVX2: return "avx2";
+  }
+  return "unknown";
+}
+
+u32 count_bits( [[maybe_unused]] isa_t isa, const u8 *mem, u32 len ) {
+#ifdef FUZZUF_BITMAP_KERNEL_X86
+  if( isa == isa_t::AVX2 ) return count_bits_avx2( mem, len );
+  if( isa == isa_t::SSE2 ) return count_bits_sse2( mem, len );
+#endif
+  return count_bits_scalar( mem, len );
+}
+
+u32 count_bytes( [[maybe_unused]] isa_t isa, const u8 *mem, u32 len ) {
+#ifdef FUZZUF_BITMAP_KERNEL_X86
+  if( isa == isa_t::AVX2 ) return len - count_eq_avx2( mem, len, 0 );
+  if( isa == isa_t::SSE2 ) return len - count_eq_sse2( mem, len, 0 );
+#endif
+  return len - count_eq_scalar( mem, len, 0 );
+}
+
+u32 count_non_255_bytes( [[maybe_unused]] isa_t isa, const u8 *mem, u32 len ) {
+#ifdef FUZZUF_BITMAP_KERNEL_X86
+  if( isa == isa_t::AVX2 ) return len - count_eq_avx2( mem, len, 255 );
+  if( isa == isa_t::SSE2 ) return len - count_eq_sse2( mem, len, 255 );
+#endif
+  return len - count_eq_scalar( mem, len, 255 );
+}
+
+void minimize_bits( [[maybe_unused]] isa_t isa, u8 *dst, const u8 *src, u32 len ) {
+#ifdef FUZZUF_BITMAP_KERNEL_X86
+  if( isa == isa_t::AVX2 ) return minimize_bits_avx2( dst, src, len );
+  if( isa == isa_t::SSE2 ) return minimize_bits_sse2( dst, src, len );
+#endif
+  minimize_bits_scalar( dst, src, 0, len );
+}
+
+std::tuple< s32, s32 > locate_diffs( [[maybe_unused]] isa_t isa, const u8 *ptr1, const u8 *ptr2, u32 len ) {
+#ifdef FUZZUF_BITMAP_KERNEL_X86
+  if( isa == isa_t::AVX2 ) return locate_diffs_avx2( ptr1, ptr2, len );
+  if( isa == isa_t::SSE2 ) return locate_diffs_sse2( ptr1, ptr2, len );
+#endif
+  return locate_diffs_scalar( ptr1, ptr2, len );
+}
+
+}
+
@@ -1,4 +1,5 @@
 #include "config.h"
+#include <atomic>
 #include <memory>
 #include <thread>
 #include <cassert>
@@ -25,6 +26,7 @@ namespace filesystem = boost::filesystem;
 #include <signal.h>
 #include <execinfo.h>
 #include "Utils/Common.hpp"
+#include "Utils/BitmapKernel.hpp"
 #include "Logger/Logger.hpp"
 
 
@@ -451,84 +453,122 @@ u32 Hash32(const void* key, u32 len, u32 seed) {
 
 #endif /* ^__x86_64__ */
 
-/* Count the number of bits set in the provided bitmap. Used for the status
-   screen several times every second, does not have to be fast. */
+/* MurmurHash3_x64_128 by Austin Appleby (public domain). Used to tell files
+   with the same contents apart from the rest, so unlike Hash32() it takes
+   the tail bytes into account. */
 
-u32 CountBits( const u8* mem, u32 len) {
-    assert( len % sizeof( u32 ) == 0 );
-    const u32* ptr = reinterpret_cast< const u32* >( mem );
-#ifdef __cpp_lib_bitops
-    return std::accumulate(
-      ptr, std::next( ptr, len >> 2 ), u32( 0 ),
-      []( u32 sum, u32 v ){ return sum + std::popcount( v ); }
-    );
-#else
-    u32  i   = (len >> 2);
-    u32  ret = 0;
+static inline u64 Rotl64(u64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
 
-    while (i--) {
+static inline u64 FMix64(u64 k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
 
-        u32 v = *(ptr++);
+Hash128Value Hash128(const void* key, std::size_t len, u32 seed) {
+    const u8* data = (const u8*)key;
+    const std::size_t nblocks = len / 16;
 
-        /* This gets called on the inverse, virgin bitmap; optimize for sparse
-        data. */
+    u64 h1 = seed;
+    u64 h2 = seed;
 
-        if (v == 0xffffffff) {
-            ret += 32;
-            continue;
-        }
+    const u64 c1 = 0x87c37b91114253d5ULL;
+    const u64 c2 = 0x4cf5ad432745937fULL;
 
-        v -= ((v >> 1) & 0x55555555);
-        v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-        ret += (((v + (v >> 4)) & 0xF0F0F0F) * 0x01010101) >> 24;
+    for (std::size_t i=0; i < nblocks; i++) {
+        u64 k1, k2;
+        std::memcpy(&k1, data + i * 16, 8);
+        std::memcpy(&k2, data + i * 16 + 8, 8);
+
+        k1 *= c1; k1  = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = Rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2  = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = Rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
     }
-    return ret;
-#endif
+
+    const u8* tail = data + nblocks * 16;
+
+    u64 k1 = 0;
+    u64 k2 = 0;
+
+    switch (len & 15) {
+    case 15: k2 ^= u64(tail[14]) << 48; [[fallthrough]];
+    case 14: k2 ^= u64(tail[13]) << 40; [[fallthrough]];
+    case 13: k2 ^= u64(tail[12]) << 32; [[fallthrough]];
+    case 12: k2 ^= u64(tail[11]) << 24; [[fallthrough]];
+    case 11: k2 ^= u64(tail[10]) << 16; [[fallthrough]];
+    case 10: k2 ^= u64(tail[ 9]) << 8;  [[fallthrough]];
+    case  9: k2 ^= u64(tail[ 8]);
+             k2 *= c2; k2  = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+             [[fallthrough]];
+    case  8: k1 ^= u64(tail[ 7]) << 56; [[fallthrough]];
+    case  7: k1 ^= u64(tail[ 6]) << 48; [[fallthrough]];
+    case  6: k1 ^= u64(tail[ 5]) << 40; [[fallthrough]];
+    case  5: k1 ^= u64(tail[ 4]) << 32; [[fallthrough]];
+    case  4: k1 ^= u64(tail[ 3]) << 24; [[fallthrough]];
+    case  3: k1 ^= u64(tail[ 2]) << 16; [[fallthrough]];
+    case  2: k1 ^= u64(tail[ 1]) << 8;  [[fallthrough]];
+    case  1: k1 ^= u64(tail[ 0]);
+             k1 *= c1; k1  = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= len;
+    h2 ^= len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = FMix64(h1);
+    h2 = FMix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    return Hash128Value{h1, h2};
 }
 
+/* Count the number of bits set in the provided bitmap. Used for the status
+   screen several times every second. The implementation is chosen at runtime
+   from the ones in Utils/BitmapKernel.cpp. */
 
-#define FF(_b)  (0xffu << ((_b) << 3))
+u32 CountBits( const u8* mem, u32 len) {
+    namespace bk = fuzzuf::utils::bitmap_kernel;
+    return bk::count_bits( bk::detect(), mem, len );
+}
 
 /* Count the number of bytes set in the bitmap. Called fairly sporadically,
    mostly to update the status screen or calibrate and examine confirmed
    new paths. */
 
 u32 CountBytes( const u8* mem, u32 len) {
-    return len - std::count(
-      mem, std::next( mem, len ), u8( 0 )
-    );
+    namespace bk = fuzzuf::utils::bitmap_kernel;
+    return bk::count_bytes( bk::detect(), mem, len );
 }
 
-
 /* Count the number of non-255 bytes set in the bitmap. Used strictly for the
    status screen, several calls per second or so. */
 u32 CountNon255Bytes( const u8* mem, u32 len) {
-    return len - std::count(
-      mem, std::next( mem, len ), u8( 255 )
-    );
+    namespace bk = fuzzuf::utils::bitmap_kernel;
+    return bk::count_non_255_bytes( bk::detect(), mem, len );
 }
 
 void MinimizeBits(u8* dst, const u8* src, u32 len) {
-    u32 i = 0;
-    while (i < len) {
-        if (*(src++)) dst[i >> 3] |= 1 << (i & 7);
-        i++;
-    }
+    namespace bk = fuzzuf::utils::bitmap_kernel;
+    bk::minimize_bits( bk::detect(), dst, src, len );
 }
 
 /* Helper function to compare buffers; returns first and last differing offset. We
    use this to find reasonable locations for splicing two files. */
 
 std::tuple< s32, s32 > LocateDiffs( const u8* ptr1, const u8* ptr2, u32 len ) {
-    s32 f_loc = -1;
-    s32 l_loc = -1;
-    for (u32 pos = 0; pos < len; pos++) {
-        if (*(ptr1++) != *(ptr2++)) {
-            if (f_loc == -1) f_loc = pos;
-            l_loc = pos;
-        }
-    }
-    return std::make_tuple( f_loc, l_loc );
+    namespace bk = fuzzuf::utils::bitmap_kernel;
+    return bk::locate_diffs( bk::detect(), ptr1, ptr2, len );
 }
 
 constexpr const char *stacktrace_dumpfile = "./backtrace.dump";
@@ -576,10 +616,9 @@ set_segv_handler::set_segv_handler() {
 }
 
 
-// TODO: multithread support
 u64 GlobalCounter() {
-    static u64 counter = 0;
-    return counter++;
+    static std::atomic<u64> counter(0);
+    return counter.fetch_add(1, std::memory_order_relaxed);
 }
 
 #ifdef FLC_FOUND
@@ -0,0 +1,50 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <boost/scope_exit.hpp>
+#include <Utils/ListDirectory.hpp>
+
+namespace fuzzuf::utils {
+
+namespace {
+  // glibcが公開していないカーネルの構造体
+  struct linux_dirent64 {
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+  };
+
+  constexpr std::size_t buffer_size = 256 * 1024;
+}
+
+bool list_directory( const std::string &dir, std::vector< std::string > &names ) {
+  int fd = open( dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+  if( fd == -1 ) return false;
+  BOOST_SCOPE_EXIT( &fd ) {
+    int saved_errno = errno;
+    close( fd );
+    errno = saved_errno;
+  } BOOST_SCOPE_EXIT_END
+
+  std::vector< char > buf( buffer_size );
+  while( true ) {
+    long nread = syscall( SYS_getdents64, fd, buf.data(), buf.size() );
+    if( nread == -1 ) return false;
+    if( nread == 0 ) break;
+    for( long off = 0; off < nread; ) {
+      const auto *entry = reinterpret_cast< const linux_dirent64* >( buf.data() + off );
+      names.emplace_back( entry->d_name );
+      off += entry->d_reclen;
+    }
+  }
+  return true;
+}
+
+}
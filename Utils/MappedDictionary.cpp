@@ -0,0 +1,110 @@
+#include <Utils/MappedDictionary.hpp>
+
+#include <fcntl.h>
+
+namespace fuzzuf::utils::dictionary {
+
+mapped_dictionary::mapped_dictionary( const std::string &filename )
+  : mapped_dictionary( map_file( filename, O_RDONLY, false ) ) {}
+
+mapped_dictionary::mapped_dictionary( mapped_file_t &&file_ )
+  : file( std::move( file_ ) ) {
+  if( !parse_flat() && !parse_msgpack() )
+    throw exceptions::invalid_file(
+      "not a precompiled dictionary file",
+      __FILE__,
+      __LINE__
+    );
+}
+
+std::optional< mapped_dictionary > mapped_dictionary::try_open( const std::string &filename ) {
+  std::optional< mapped_file_t > file;
+  try {
+    file = map_file( filename, O_RDONLY, false );
+  }
+  catch( const std::system_error& ) {
+    return std::nullopt;
+  }
+  try {
+    return mapped_dictionary( std::move( *file ) );
+  }
+  catch( const exceptions::invalid_file& ) {
+    return std::nullopt;
+  }
+}
+
+// 位置の表の大きさと単調性だけを確かめる。要素のバイト列には触れない
+bool mapped_dictionary::parse_flat() {
+  const std::size_t file_size = file.size();
+  const std::uint8_t *head = file.begin().get();
+  if( file_size < flat_header_size + 4u ) return false;
+  if( std::memcmp( head, flat_magic, sizeof( flat_magic ) ) ) return false;
+
+  const std::size_t count_ = load_u32( head + 8u );
+  if( ( file_size - flat_header_size ) / 4u <= count_ ) return false;
+  const std::uint8_t *offsets_ = head + flat_header_size;
+  const std::size_t data_offset_ = flat_header_size + ( count_ + 1u ) * 4u;
+
+  std::uint32_t prev = 0u;
+  for( std::size_t i = 0u; i <= count_; ++i ) {
+    const auto offset = load_u32( offsets_ + i * 4u );
+    if( offset < prev ) return false;
+    prev = offset;
+  }
+  if( load_u32( offsets_ ) != 0u || data_offset_ + prev != file_size ) return false;
+
+  count = count_;
+  offsets = offsets_;
+  data_offset = data_offset_;
+  return true;
+}
+
+// dict2mpが出力する、binまたはstrの配列だけを受け付ける
+bool mapped_dictionary::parse_msgpack() {
+  const std::size_t file_size = file.size();
+  const std::uint8_t *head = file.begin().get();
+  std::size_t pos = 0u;
+
+  // posからbytesバイトのビッグエンディアンの整数を読む
+  const auto read_be = [&]( std::size_t bytes, std::size_t &v ) {
+    if( file_size - pos < bytes ) return false;
+    v = 0u;
+    for( std::size_t i = 0u; i != bytes; ++i ) v = ( v << 8 ) | head[ pos++ ];
+    return true;
+  };
+
+  if( file_size == 0u ) return false;
+  std::size_t count_ = 0u;
+  const auto array_type = head[ pos++ ];
+  if( ( array_type & 0xf0u ) == 0x90u ) count_ = array_type & 0x0fu;
+  else if( array_type == 0xdcu ) { if( !read_be( 2u, count_ ) ) return false; }
+  else if( array_type == 0xddu ) { if( !read_be( 4u, count_ ) ) return false; }
+  else return false;
+
+  // 各要素は少なくとも1バイトのヘッダを持つので、これを超える要素数はあり得ない
+  if( count_ > file_size - pos ) return false;
+
+  std::vector< std::size_t > ranges_;
+  ranges_.reserve( count_ * 2u );
+  for( std::size_t i = 0u; i != count_; ++i ) {
+    if( pos == file_size ) return false;
+    const auto type = head[ pos++ ];
+    std::size_t size = 0u;
+    if( ( type & 0xe0u ) == 0xa0u ) size = type & 0x1fu;
+    else if( type == 0xc4u || type == 0xd9u ) { if( !read_be( 1u, size ) ) return false; }
+    else if( type == 0xc5u || type == 0xdau ) { if( !read_be( 2u, size ) ) return false; }
+    else if( type == 0xc6u || type == 0xdbu ) { if( !read_be( 4u, size ) ) return false; }
+    else return false;
+    if( file_size - pos < size ) return false;
+    ranges_.push_back( pos );
+    ranges_.push_back( pos + size );
+    pos += size;
+  }
+  if( pos != file_size ) return false;
+
+  count = count_;
+  ranges = std::move( ranges_ );
+  return true;
+}
+
+}
@@ -0,0 +1,105 @@
+#include "config.h"
+#include "Utils/Random.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+
+#include "Utils/Common.hpp"
+
+namespace fuzzuf::utils::random {
+
+static inline std::uint64_t rotl( std::uint64_t x, int k ) {
+  return ( x << k ) | ( x >> ( 64 - k ) );
+}
+
+prng::prng( std::uint64_t seed ) : pos( batch_size ) {
+  // splitmix64
+  for( auto &v: s ) {
+    std::uint64_t z = ( seed += 0x9e3779b97f4a7c15ull );
+    z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+    z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebull;
+    v = z ^ ( z >> 31 );
+  }
+}
+
+prng prng::create() {
+#ifdef BEHAVE_DETERMINISTIC
+  return prng( deterministic_seed );
+#else
+  std::uint64_t seed;
+  int fd = Util::OpenFile( "/dev/urandom", O_RDONLY | O_CLOEXEC );
+  Util::ReadFile( fd, &seed, sizeof( seed ) );
+  Util::CloseFile( fd );
+  return prng( seed );
+#endif
+}
+
+std::uint64_t prng::next() {
+  const std::uint64_t result = rotl( s[ 1 ] * 5u, 7 ) * 9u;
+  const std::uint64_t t = s[ 1 ] << 17;
+  s[ 2 ] ^= s[ 0 ];
+  s[ 3 ] ^= s[ 1 ];
+  s[ 1 ] ^= s[ 2 ];
+  s[ 0 ] ^= s[ 3 ];
+  s[ 2 ] ^= t;
+  s[ 3 ] = rotl( s[ 3 ], 45 );
+  return result;
+}
+
+void prng::refill() {
+  for( std::size_t i = 0u; i != batch_size; i += 2u ) {
+    const std::uint64_t v = next();
+    buf[ i ] = result_type( v );
+    buf[ i + 1u ] = result_type( v >> 32 );
+  }
+  pos = 0u;
+}
+
+void prng::fill( result_type *out, std::size_t n ) {
+  while( n ) {
+    if( pos == batch_size ) refill();
+    const std::size_t count = std::min( n, batch_size - pos );
+    std::copy_n( buf.data() + pos, count, out );
+    pos += count;
+    out += count;
+    n -= count;
+  }
+}
+
+void prng::jump() {
+  static constexpr std::uint64_t JUMP[] = {
+    0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull,
+    0xa9582618e03fc9aaull, 0x39abdc4529b1661cull
+  };
+
+  std::array< std::uint64_t, 4 > t{ 0u, 0u, 0u, 0u };
+  for( auto j: JUMP ) {
+    for( int b = 0; b != 64; ++b ) {
+      if( j & ( std::uint64_t( 1u ) << b ) ) {
+        for( std::size_t i = 0u; i != t.size(); ++i ) t[ i ] ^= s[ i ];
+      }
+      next();
+    }
+  }
+  s = t;
+}
+
+prng prng::split() {
+  prng child = *this;
+  jump();
+  // 補充済みの乱数は子に譲り、こちらは新しい系列から引き直す
+  pos = batch_size;
+  return child;
+}
+
+prng::state_type prng::get_state() const {
+  return state_type{ s, buf, pos };
+}
+
+void prng::set_state( const state_type &state ) {
+  s = state.s;
+  buf = state.buf;
+  pos = std::min< std::uint64_t >( state.pos, batch_size );
+}
+
+}
@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Utils/SetCover.hpp>
+
+namespace fuzzuf::utils {
+
+namespace {
+  constexpr std::size_t no_item = std::size_t( -1 );
+}
+
+std::vector< std::size_t > set_cover( const std::vector< set_cover_item > &items, std::uint32_t num_words ) {
+  const std::size_t num_elems = std::size_t( num_words ) * 64u;
+  std::vector< std::size_t > best( num_elems, no_item );
+  std::vector< std::uint32_t > count( num_elems, 0u );
+  for( std::size_t s = 0u; s != items.size(); ++s ) {
+    const auto &item = items[ s ];
+    for( std::size_t i = 0u; i != item.words.size(); ++i ) {
+      for( std::uint64_t bits = item.words[ i ]; bits; bits &= bits - 1u ) {
+        std::size_t e = std::size_t( item.word_pos[ i ] ) * 64u + __builtin_ctzll( bits );
+        ++count[ e ];
+        // 添字の昇順に見ているので、同じ大きさなら先の集合が残る
+        if( best[ e ] == no_item || item.size < items[ best[ e ] ].size ) best[ e ] = s;
+      }
+    }
+  }
+
+  // 持っている集合が少ない要素ほど、選べる集合が限られるので先に決める
+  std::vector< std::size_t > order;
+  for( std::size_t e = 0u; e != num_elems; ++e ) {
+    if( count[ e ] ) order.emplace_back( e );
+  }
+  std::stable_sort( order.begin(), order.end(), [&count]( std::size_t l, std::size_t r ) { return count[ l ] < count[ r ]; } );
+
+  std::vector< std::uint64_t > covered( num_words, 0u );
+  std::vector< bool > taken( items.size(), false );
+  for( std::size_t e : order ) {
+    if( covered[ e / 64u ] & ( std::uint64_t( 1u ) << ( e % 64u ) ) ) continue;
+    const auto &item = items[ best[ e ] ];
+    taken[ best[ e ] ] = true;
+    for( std::size_t i = 0u; i != item.words.size(); ++i ) covered[ item.word_pos[ i ] ] |= item.words[ i ];
+  }
+
+  std::vector< std::size_t > selected;
+  for( std::size_t s = 0u; s != items.size(); ++s ) {
+    if( taken[ s ] ) selected.emplace_back( s );
+  }
+  return selected;
+}
+
+}
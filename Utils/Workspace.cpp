@@ -11,6 +11,7 @@ void SetupDirs(std::string out_dir) {
         Util::CreateDir(out_dir + "/queue/.state/auto_extras/");
         Util::CreateDir(out_dir + "/queue/.state/redundant_edges/");
         Util::CreateDir(out_dir + "/queue/.state/variable_behavior/");
+        Util::CreateDir(out_dir + "/queue/.state/det_progress/");
         Util::CreateDir(out_dir + "/crashes");
         Util::CreateDir(out_dir + "/hangs");
         
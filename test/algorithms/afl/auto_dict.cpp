@@ -0,0 +1,136 @@
+#define BOOST_TEST_MODULE algorithms.afl.auto_dict
+#define BOOST_TEST_DYN_LINK
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "Options.hpp"
+#include "Utils/Random.hpp"
+#include "Algorithms/AFL/AFLAutoDict.hpp"
+#include "Algorithms/AFL/AFLUtil.hpp"
+
+namespace {
+
+// AFLの元の実装と同じく、追加のたびに全体をソートし直す自動辞書
+void ReferenceAdd(
+  std::vector< AFLDictData > &a_extras,
+  const std::vector< u8 > &mem,
+  fuzzuf::utils::random::prng &rng
+) {
+  auto equal_nocase = [&]( const AFLDictData &extra ) {
+    return extra.data.size() == mem.size() && std::equal(
+      mem.begin(), mem.end(), extra.data.begin(),
+      []( u8 c1, u8 c2 ) { return std::tolower( c1 ) == std::tolower( c2 ); }
+    );
+  };
+
+  auto itr = std::find_if( a_extras.begin(), a_extras.end(), equal_nocase );
+  if( itr != a_extras.end() ) itr->hit_cnt++;
+  else if( a_extras.size() < AFLOption::MAX_AUTO_EXTRAS ) a_extras.emplace_back( AFLDictData{ mem, 0 } );
+  else {
+    u32 idx = AFLOption::MAX_AUTO_EXTRAS / 2;
+    idx += afl::util::UR( ( AFLOption::MAX_AUTO_EXTRAS + 1 ) / 2, rng );
+    a_extras[ idx ].data = mem;
+    a_extras[ idx ].hit_cnt = 0;
+  }
+
+  std::sort( a_extras.begin(), a_extras.end(), []( const AFLDictData &e1, const AFLDictData &e2 ) {
+    if( e1.hit_cnt != e2.hit_cnt ) return e1.hit_cnt > e2.hit_cnt;
+    if( e1.data.size() != e2.data.size() ) return e1.data.size() < e2.data.size();
+    return e1.data < e2.data;
+  } );
+
+  size_t lim = std::min< size_t >( AFLOption::USE_AUTO_EXTRAS, a_extras.size() );
+  std::sort( a_extras.begin(), a_extras.begin() + lim, []( const AFLDictData &e1, const AFLDictData &e2 ) {
+    if( e1.data.size() != e2.data.size() ) return e1.data.size() < e2.data.size();
+    if( e1.hit_cnt != e2.hit_cnt ) return e1.hit_cnt > e2.hit_cnt;
+    return e1.data < e2.data;
+  } );
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(AutoDictNocase) {
+  auto rng = fuzzuf::utils::random::prng( 0u );
+  AFLAutoDict dict;
+
+  const std::string token = "MaGiC";
+  dict.Add( reinterpret_cast< const u8* >( token.data() ), token.size(), rng );
+  BOOST_CHECK_EQUAL( dict.size(), 1 );
+
+  // 大文字小文字を無視して同じものは、hit_cntが増えるだけ
+  const std::string lower = "magic";
+  BOOST_CHECK( dict.Contains( reinterpret_cast< const u8* >( lower.data() ), lower.size() ) );
+  dict.Add( reinterpret_cast< const u8* >( lower.data() ), lower.size(), rng );
+  BOOST_CHECK_EQUAL( dict.size(), 1 );
+  BOOST_CHECK_EQUAL( dict.GetEntries()[ 0 ].hit_cnt, 1 );
+  BOOST_CHECK( dict.GetEntries()[ 0 ].get() == std::vector< u8 >( token.begin(), token.end() ) );
+}
+
+// 元の実装と同じ並びになり、追い出されるものも同じになる事を確認する
+BOOST_AUTO_TEST_CASE(AutoDictSameOrderAsReference) {
+  auto rng = fuzzuf::utils::random::prng( 1u );
+  auto dict_rng = fuzzuf::utils::random::prng( 2u );
+  auto ref_rng = fuzzuf::utils::random::prng( 2u );
+
+  AFLAutoDict dict;
+  std::vector< AFLDictData > reference;
+
+  // 追い出しが起きるように、MAX_AUTO_EXTRASより多くの種類のトークンを使う
+  std::vector< std::vector< u8 > > tokens;
+  for( u32 i = 0; i < AFLOption::MAX_AUTO_EXTRAS * 2; i++ ) {
+    u32 len = AFLOption::MIN_AUTO_EXTRA + rng.below( 6 );
+    std::vector< u8 > token( len );
+    for( auto &c : token ) c = 'a' + rng.below( 4 ) + ( rng.below( 2 ) ? 'A' - 'a' : 0 );
+    tokens.emplace_back( std::move( token ) );
+  }
+
+  for( u32 i = 0; i < 20000; i++ ) {
+    // 一部のトークンを選ばれやすくして、hit_cntに差をつける
+    const auto &token = tokens[ rng.below( 8 ) ? rng.below( 64 ) : rng.below( tokens.size() ) ];
+    dict.Add( token.data(), token.size(), dict_rng );
+    ReferenceAdd( reference, token, ref_rng );
+
+    const auto &entries = dict.GetEntries();
+    BOOST_REQUIRE_EQUAL( entries.size(), reference.size() );
+    for( size_t j = 0; j < entries.size(); j++ ) {
+      BOOST_REQUIRE( entries[ j ].data == reference[ j ].data );
+      BOOST_REQUIRE_EQUAL( entries[ j ].hit_cnt, reference[ j ].hit_cnt );
+    }
+  }
+  BOOST_CHECK_EQUAL( dict.size(), AFLOption::MAX_AUTO_EXTRAS );
+}
+
+// GetEntries()から作り直したものは、元のものと同じ並びのまま、同じように更新される
+BOOST_AUTO_TEST_CASE(AutoDictRestore) {
+  auto rng = fuzzuf::utils::random::prng( 3u );
+  auto dict_rng = fuzzuf::utils::random::prng( 4u );
+
+  AFLAutoDict dict;
+  for( u32 i = 0; i < AFLOption::MAX_AUTO_EXTRAS * 2; i++ ) {
+    std::vector< u8 > token( AFLOption::MIN_AUTO_EXTRA + rng.below( 4 ) );
+    for( auto &c : token ) c = 'a' + rng.below( 6 );
+    dict.Add( token.data(), token.size(), dict_rng );
+  }
+
+  AFLAutoDict restored;
+  restored.Restore( dict.GetEntries() );
+  auto restored_rng = dict_rng;
+
+  for( u32 i = 0; i < 1000; i++ ) {
+    std::vector< u8 > token( AFLOption::MIN_AUTO_EXTRA + rng.below( 4 ) );
+    for( auto &c : token ) c = 'a' + rng.below( 6 );
+    dict.Add( token.data(), token.size(), dict_rng );
+    restored.Add( token.data(), token.size(), restored_rng );
+  }
+
+  const auto &entries = dict.GetEntries();
+  const auto &restored_entries = restored.GetEntries();
+  BOOST_REQUIRE_EQUAL( entries.size(), restored_entries.size() );
+  for( size_t j = 0; j < entries.size(); j++ ) {
+    BOOST_CHECK( entries[ j ].data == restored_entries[ j ].data );
+    BOOST_CHECK_EQUAL( entries[ j ].hit_cnt, restored_entries[ j ].hit_cnt );
+  }
+}
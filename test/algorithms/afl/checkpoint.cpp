@@ -0,0 +1,308 @@
+#define BOOST_TEST_MODULE algorithms.afl.checkpoint
+#define BOOST_TEST_DYN_LINK
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include "config.h"
+#ifdef HAS_CXX_STD_FILESYSTEM
+#include <filesystem>
+#else
+#include <boost/filesystem.hpp>
+#endif
+#include <create_file.hpp>
+#include <move_to_program_location.hpp>
+
+#include "Utils/Workspace.hpp"
+#include "Algorithms/AFL/AFLCheckpoint.hpp"
+#include "Algorithms/AFL/AFLSetting.hpp"
+#include "Algorithms/AFL/AFLState.hpp"
+#include "Algorithms/AFL/AFLUtil.hpp"
+#include "Executor/NativeLinuxExecutor.hpp"
+
+// 保存したチェックポイントがそのまま読み出せる事を確認する
+BOOST_AUTO_TEST_CASE(CheckpointRoundTrip) {
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+#ifdef HAS_CXX_STD_FILESYSTEM
+  namespace fs = std::filesystem;
+#else
+  namespace fs = boost::filesystem;
+#endif
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  // 存在しない場合
+  auto path = ( root_dir / "checkpoint" ).string();
+  BOOST_CHECK( afl::util::ReadCheckpoint( path ) == nullptr );
+
+  AFLCheckpoint checkpoint;
+  checkpoint.target_size = 12345;
+  checkpoint.target_mtime = 67890;
+  checkpoint.crash_mode = 2;
+
+  AFLCheckpoint::Entry seed;
+  seed.name = "id:000000,orig:seed";
+  seed.hash = Util::Hash128Value{ 0x0123456789abcdefULL, 0xfedcba9876543210ULL };
+  seed.exec_cksum = 0xdeadbeef;
+  seed.bitmap_size = 42;
+  seed.exec_us = 300;
+  seed.depth = 1;
+  seed.was_fuzzed = true;
+  seed.has_new_cov = true;
+  seed.trace_mini.assign( AFLOption::MAP_SIZE / 8, 0 );
+  seed.trace_mini[ 3 ] = 0x81;
+  checkpoint.entries.emplace_back( seed );
+
+  AFLCheckpoint::Entry child;
+  child.name = "id:000001,src:000000,op:havoc,rep:2,+cov";
+  child.hash = Util::Hash128Value{ 1, 2 };
+  child.handicap = 3;
+  child.depth = 2;
+  child.trim_done = true;
+  child.var_behavior = true;
+  checkpoint.entries.emplace_back( child );
+
+  checkpoint.top_rated.assign( AFLOption::MAP_SIZE, AFLCheckpoint::NO_ENTRY );
+  checkpoint.top_rated[ 24 ] = 0;
+  checkpoint.top_rated[ 31 ] = 0;
+
+  checkpoint.virgin_bits.assign( AFLOption::MAP_SIZE, 255 );
+  checkpoint.virgin_bits[ 24 ] = 0x7f;
+  checkpoint.virgin_tmout.assign( AFLOption::MAP_SIZE, 255 );
+  checkpoint.virgin_crash.assign( AFLOption::MAP_SIZE, 255 );
+  checkpoint.virgin_crash[ 100 ] = 0;
+  checkpoint.var_bytes.assign( AFLOption::MAP_SIZE, 0 );
+  checkpoint.var_bytes[ 5 ] = 1;
+
+  checkpoint.stage_finds.assign( 32, 0 );
+  checkpoint.stage_finds[ AFLOption::STAGE_HAVOC ] = 7;
+  checkpoint.stage_cycles.assign( 32, 0 );
+  checkpoint.stage_cycles[ AFLOption::STAGE_HAVOC ] = 1000;
+
+  checkpoint.a_extras.emplace_back( AFLDictData::word_t{ 'a', 'b', 'c' }, 5 );
+  checkpoint.a_extras.emplace_back( AFLDictData::word_t{ 'x', 'y', 'z', 'w' }, 0 );
+
+  fuzzuf::utils::random::prng rng( 1u );
+  rng();
+  checkpoint.rng = rng.get_state();
+
+  checkpoint.counters.queue_cycle = 4;
+  checkpoint.counters.current_entry = 1;
+  checkpoint.counters.total_execs = 100000;
+  checkpoint.counters.unique_crashes = 2;
+  checkpoint.counters.total_cal_us = 2400;
+  checkpoint.counters.total_cal_cycles = 8;
+
+  afl::util::WriteCheckpoint( path, checkpoint );
+
+  auto loaded = afl::util::ReadCheckpoint( path );
+  BOOST_REQUIRE( loaded != nullptr );
+  BOOST_CHECK_EQUAL( loaded->target_size, checkpoint.target_size );
+  BOOST_CHECK_EQUAL( loaded->target_mtime, checkpoint.target_mtime );
+  BOOST_CHECK_EQUAL( loaded->crash_mode, checkpoint.crash_mode );
+
+  BOOST_REQUIRE_EQUAL( loaded->entries.size(), 2 );
+  for( size_t i = 0; i < 2; i++ ) {
+    const auto &expected = checkpoint.entries[ i ];
+    const auto &actual = loaded->entries[ i ];
+    BOOST_CHECK_EQUAL( actual.name, expected.name );
+    BOOST_CHECK( actual.hash == expected.hash );
+    BOOST_CHECK_EQUAL( actual.exec_cksum, expected.exec_cksum );
+    BOOST_CHECK_EQUAL( actual.bitmap_size, expected.bitmap_size );
+    BOOST_CHECK_EQUAL( actual.exec_us, expected.exec_us );
+    BOOST_CHECK_EQUAL( actual.handicap, expected.handicap );
+    BOOST_CHECK_EQUAL( actual.depth, expected.depth );
+    BOOST_CHECK_EQUAL( actual.trim_done, expected.trim_done );
+    BOOST_CHECK_EQUAL( actual.was_fuzzed, expected.was_fuzzed );
+    BOOST_CHECK_EQUAL( actual.has_new_cov, expected.has_new_cov );
+    BOOST_CHECK_EQUAL( actual.var_behavior, expected.var_behavior );
+    BOOST_CHECK( actual.trace_mini == expected.trace_mini );
+  }
+
+  BOOST_CHECK( loaded->top_rated == checkpoint.top_rated );
+  BOOST_CHECK( loaded->virgin_bits == checkpoint.virgin_bits );
+  BOOST_CHECK( loaded->virgin_tmout == checkpoint.virgin_tmout );
+  BOOST_CHECK( loaded->virgin_crash == checkpoint.virgin_crash );
+  BOOST_CHECK( loaded->var_bytes == checkpoint.var_bytes );
+  BOOST_CHECK( loaded->stage_finds == checkpoint.stage_finds );
+  BOOST_CHECK( loaded->stage_cycles == checkpoint.stage_cycles );
+
+  BOOST_REQUIRE_EQUAL( loaded->a_extras.size(), 2 );
+  BOOST_CHECK( loaded->a_extras[ 0 ].data == checkpoint.a_extras[ 0 ].data );
+  BOOST_CHECK_EQUAL( loaded->a_extras[ 0 ].hit_cnt, 5 );
+  BOOST_CHECK( loaded->a_extras[ 1 ].data == checkpoint.a_extras[ 1 ].data );
+
+  fuzzuf::utils::random::prng restored( 2u );
+  restored.set_state( loaded->rng );
+  BOOST_CHECK_EQUAL( restored(), rng() );
+
+  BOOST_CHECK_EQUAL( loaded->counters.queue_cycle, 4 );
+  BOOST_CHECK_EQUAL( loaded->counters.current_entry, 1 );
+  BOOST_CHECK_EQUAL( loaded->counters.total_execs, 100000 );
+  BOOST_CHECK_EQUAL( loaded->counters.unique_crashes, 2 );
+  BOOST_CHECK_EQUAL( loaded->counters.total_cal_us, 2400 );
+  BOOST_CHECK_EQUAL( loaded->counters.total_cal_cycles, 8 );
+
+  // 書き込み途中のファイルは残らない
+  BOOST_CHECK( !fs::exists( path + ".tmp" ) );
+
+  // 途中で切れている場合は無視される
+  fs::resize_file( path, fs::file_size( path ) - 1 );
+  BOOST_CHECK( afl::util::ReadCheckpoint( path ) == nullptr );
+
+  create_file( path, "AFCP" );
+  BOOST_CHECK( afl::util::ReadCheckpoint( path ) == nullptr );
+}
+
+// AFLFuzzerを通さずにAFLStateを組み立てる
+// zerooneは標準入力の先頭8バイトがそれぞれ'1'かどうかでだけ異なるトレースになる
+struct StateFixture {
+  StateFixture( const std::string &root_dir ) :
+    out_dir( root_dir + "/output" ),
+    setting(
+      { "../../put_binaries/zeroone" },
+      root_dir + "/input", out_dir,
+      1000, AFLOption::MEM_LIMIT,
+      true, false,
+      NativeLinuxExecutor::CPUID_DO_NOT_BIND
+    )
+  {
+    SetupDirs( out_dir );
+    executor.reset(
+      new NativeLinuxExecutor(
+        setting.argv,
+        setting.exec_timelimit_ms,
+        setting.exec_memlimit,
+        setting.forksrv,
+        out_dir + "/" + AFLOption::DEFAULT_OUTFILE,
+        true,                 // need_afl_cov
+        false,                // need_bb_cov
+        setting.cpuid_to_bind
+      )
+    );
+    state.reset( new AFLState( setting, *executor ) );
+    state->not_on_tty = true;
+  }
+
+  std::shared_ptr< AFLTestcase > Add( const std::string &name, const std::string &str ) {
+    return afl::util::AddToQueue(
+      *state, out_dir + "/queue/" + name, reinterpret_cast< const u8* >( str.data() ), str.size(), false
+    );
+  }
+
+  // バッファを実行してキューに加え、較正まで済ませる
+  std::shared_ptr< AFLTestcase > AddCalibrated( const std::string &name, const std::string &str ) {
+    auto testcase = Add( name, str );
+    auto buf = reinterpret_cast< const u8* >( str.data() );
+    ExitStatusFeedback exit_status;
+    auto inp_feed = state->RunExecutorWithClassifyCounts( buf, str.size(), exit_status );
+    auto res = afl::util::CalibrateCaseWithFeedDestroyed(
+      *testcase, buf, str.size(), *state, inp_feed, exit_status, 0, true
+    );
+    BOOST_CHECK( res == PUTExitReasonType::FAULT_NONE );
+    return testcase;
+  }
+
+  std::string out_dir;
+  AFLSetting setting;
+  std::unique_ptr< NativeLinuxExecutor > executor;
+  std::unique_ptr< AFLState > state;
+};
+
+// チェックポイントから、内容の変わっていない要素の較正の結果と、全体の状態が引き継がれる事を確認する
+BOOST_AUTO_TEST_CASE(RestoreCheckpoint) {
+  MoveToProgramLocation();
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+#ifdef HAS_CXX_STD_FILESYSTEM
+  namespace fs = std::filesystem;
+#else
+  namespace fs = boost::filesystem;
+#endif
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  BOOST_CHECK( fs::create_directory( root_dir / "saved" ) );
+  BOOST_CHECK( fs::create_directory( root_dir / "resumed" ) );
+
+  StateFixture saved( ( root_dir / "saved" ).string() );
+  std::vector< std::shared_ptr< AFLTestcase > > saved_cases{
+    saved.AddCalibrated( "a", "10110010" ),
+    saved.AddCalibrated( "b", "01000000" ),
+    saved.AddCalibrated( "c", "11111111" )
+  };
+  saved_cases[ 0 ]->WasFuzzed() = true;
+  saved.state->pending_not_fuzzed--;
+
+  // 最初の要素をファジングしている途中で止めた
+  saved.state->current_entry = 0;
+  saved.state->queue_cycle = 3;
+  saved.state->dry_run_done = true;
+  saved.state->file_writer->flush();
+  saved.state->SaveCheckpoint();
+
+  auto checkpoint = afl::util::ReadCheckpoint( saved.out_dir + "/queue/.state/checkpoint" );
+  BOOST_REQUIRE( checkpoint != nullptr );
+  BOOST_REQUIRE_EQUAL( checkpoint->entries.size(), 3 );
+
+  // cだけ、チェックポイントを保存した後に内容が変わった
+  StateFixture resumed( ( root_dir / "resumed" ).string() );
+  std::vector< std::shared_ptr< AFLTestcase > > resumed_cases{
+    resumed.Add( "a", "10110010" ),
+    resumed.Add( "b", "01000000" ),
+    resumed.Add( "c", "11111110" )
+  };
+  BOOST_CHECK_EQUAL( resumed.state->pending_not_fuzzed, 3 );
+
+  // -Bで与えたビットマップに相当する
+  const u32 extra_idx = AFLOption::MAP_SIZE - 1;
+  BOOST_CHECK_EQUAL( saved.state->virgin_bits[ extra_idx ], 255 );
+  resumed.state->virgin_bits[ extra_idx ] = 0x0f;
+
+  auto restored = resumed.state->RestoreCheckpoint( *checkpoint );
+  BOOST_CHECK( restored == std::vector< bool >( { true, true, false } ) );
+
+  for( u32 i = 0; i != 2; ++i ) {
+    BOOST_CHECK_EQUAL( resumed_cases[ i ]->exec_cksum, saved_cases[ i ]->exec_cksum );
+    BOOST_CHECK_EQUAL( resumed_cases[ i ]->BitmapSize(), saved_cases[ i ]->BitmapSize() );
+    BOOST_CHECK_EQUAL( resumed_cases[ i ]->WasFuzzed(), saved_cases[ i ]->WasFuzzed() );
+  }
+  BOOST_CHECK_EQUAL( resumed_cases[ 2 ]->exec_cksum, 0 );
+  BOOST_CHECK_EQUAL( resumed.state->pending_not_fuzzed, 2 );
+
+  // 較正し直すcが勝っていたバイトは、空のまま残る
+  std::vector< u32 > tc_ref( 3, 0 );
+  for( u32 i = 0; i != AFLOption::MAP_SIZE; ++i ) {
+    const auto &winner = saved.state->top_rated[ i ];
+    const auto &actual = resumed.state->top_rated[ i ];
+    if( !winner || winner.value().get().queue_id == 2 ) {
+      BOOST_CHECK( !actual );
+      continue;
+    }
+    BOOST_REQUIRE( actual );
+    BOOST_CHECK_EQUAL( actual.value().get().queue_id, winner.value().get().queue_id );
+    tc_ref[ actual.value().get().queue_id ]++;
+  }
+  for( u32 i = 0; i != 3; ++i ) {
+    BOOST_CHECK_EQUAL( resumed_cases[ i ]->tc_ref, tc_ref[ i ] );
+  }
+  BOOST_CHECK_EQUAL( resumed_cases[ 2 ]->tc_ref, 0 );
+
+  // 既に立っていたビットは消えない
+  for( u32 i = 0; i != AFLOption::MAP_SIZE; ++i ) {
+    u8 expected = saved.state->virgin_bits[ i ];
+    if( i == extra_idx ) expected &= 0x0f;
+    BOOST_CHECK_EQUAL( resumed.state->virgin_bits[ i ], expected );
+  }
+
+  // SelectSeedが次に選ぶのは、止めた時の要素で、周回は進まない
+  BOOST_CHECK_EQUAL( resumed.state->current_entry + 1, 0 );
+  BOOST_CHECK_EQUAL( resumed.state->queue_cycle, 3 );
+}
@@ -0,0 +1,242 @@
+#define BOOST_TEST_MODULE algorithms.afl.content_index
+#define BOOST_TEST_DYN_LINK
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include "config.h"
+#include "Utils/Filesystem.hpp"
+#include "Utils/Workspace.hpp"
+#include "Algorithms/AFL/AFLFuzzer.hpp"
+#include "Algorithms/AFL/AFLSetting.hpp"
+#include "Algorithms/AFL/AFLState.hpp"
+#include "Algorithms/AFL/AFLUtil.hpp"
+#include "Algorithms/AFL/AFLOtherHierarFlowRoutines.hpp"
+#include "Algorithms/AFL/AFLUpdateHierarFlowRoutines.hpp"
+#include "Executor/NativeLinuxExecutor.hpp"
+#include <create_file.hpp>
+#include <move_to_program_location.hpp>
+
+// zerooneは標準入力の先頭8バイトがそれぞれ'1'かどうかでだけ異なるトレースになる
+static const std::string put_path = "../../put_binaries/zeroone";
+
+static std::vector< u8 > ToBytes( const std::string &str ) {
+  return std::vector< u8 >( str.begin(), str.end() );
+}
+
+static std::vector< std::string > ListQueue( const fs::path &queue_dir ) {
+  std::vector< std::string > names;
+  for( const auto &e : fs::directory_iterator( queue_dir ) ) {
+    if( fs::is_regular_file( e.path() ) ) names.emplace_back( e.path().filename().string() );
+  }
+  std::sort( names.begin(), names.end() );
+  return names;
+}
+
+// AFLFuzzerを通さずにAFLStateを組み立てる
+struct StateFixture {
+  StateFixture( const fs::path &root_dir ) :
+    out_dir( root_dir / "output" ),
+    setting(
+      { put_path },
+      ( root_dir / "input" ).string(), out_dir.string(),
+      1000, AFLOption::MEM_LIMIT,
+      true, false,
+      NativeLinuxExecutor::CPUID_DO_NOT_BIND
+    )
+  {
+    SetupDirs( out_dir.string() );
+    executor.reset(
+      new NativeLinuxExecutor(
+        setting.argv,
+        setting.exec_timelimit_ms,
+        setting.exec_memlimit,
+        setting.forksrv,
+        out_dir / AFLOption::DEFAULT_OUTFILE,
+        true,                 // need_afl_cov
+        false,                // need_bb_cov
+        setting.cpuid_to_bind
+      )
+    );
+    state.reset( new AFLState( setting, *executor ) );
+    state->not_on_tty = true;
+  }
+
+  // バッファを実行してキューに加え、較正まで済ませる
+  std::shared_ptr< AFLTestcase > AddCalibrated( const std::string &name, const std::vector< u8 > &buf ) {
+    auto testcase = afl::util::AddToQueue( *state, ( out_dir / "queue" / name ).string(), buf.data(), buf.size(), false );
+    ExitStatusFeedback exit_status;
+    auto inp_feed = state->RunExecutorWithClassifyCounts( buf.data(), buf.size(), exit_status );
+    auto res = afl::util::CalibrateCaseWithFeedDestroyed(
+      *testcase, buf.data(), buf.size(), *state, inp_feed, exit_status, 0, true
+    );
+    BOOST_CHECK( res == PUTExitReasonType::FAULT_NONE );
+    return testcase;
+  }
+
+  fs::path out_dir;
+  AFLSetting setting;
+  std::unique_ptr< NativeLinuxExecutor > executor;
+  std::unique_ptr< AFLState > state;
+};
+
+// 同じ内容の要素は参照カウントで管理され、全ての要素が別の内容になるまで既知として扱われる事を確認する
+BOOST_AUTO_TEST_CASE(ContentIndexRefCount) {
+  MoveToProgramLocation();
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+  StateFixture fixture( root_dir );
+  auto &state = *fixture.state;
+
+  auto buf = ToBytes( "11110000" );
+  auto trimmed = ToBytes( "1111" );
+  auto hash = afl::util::HashContent( buf.data(), buf.size() );
+  auto trimmed_hash = afl::util::HashContent( trimmed.data(), trimmed.size() );
+
+  BOOST_CHECK( !afl::util::IsKnownContent( state, hash ) );
+
+  auto first = afl::util::AddToQueue( state, ( fixture.out_dir / "queue" / "first" ).string(), buf.data(), buf.size(), false );
+  auto second = afl::util::AddToQueue( state, ( fixture.out_dir / "queue" / "second" ).string(), buf.data(), buf.size(), false );
+  BOOST_CHECK( afl::util::IsKnownContent( state, hash ) );
+  BOOST_CHECK_EQUAL( state.content_hashes.at( hash ), 2 );
+
+  // トリミングで1つ目の内容が変わっても、2つ目が残っている
+  afl::util::MarkAsKnownContent( state, *first, trimmed_hash );
+  BOOST_CHECK( afl::util::IsKnownContent( state, hash ) );
+  BOOST_CHECK( afl::util::IsKnownContent( state, trimmed_hash ) );
+  BOOST_CHECK_EQUAL( state.content_hashes.at( hash ), 1 );
+
+  // 同じ内容で登録し直しても数は変わらない
+  afl::util::MarkAsKnownContent( state, *first, trimmed_hash );
+  BOOST_CHECK_EQUAL( state.content_hashes.at( trimmed_hash ), 1 );
+
+  afl::util::MarkAsKnownContent( state, *second, trimmed_hash );
+  BOOST_CHECK( !afl::util::IsKnownContent( state, hash ) );
+  BOOST_CHECK_EQUAL( state.content_hashes.at( trimmed_hash ), 2 );
+  BOOST_CHECK_EQUAL( state.content_hashes.size(), 1 );
+}
+
+// トリミングで短くなった要素は、トリミング後の内容で登録し直される事を確認する
+BOOST_AUTO_TEST_CASE(ContentIndexAfterTrim) {
+  MoveToProgramLocation();
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+  StateFixture fixture( root_dir );
+  auto &state = *fixture.state;
+
+  auto buf = ToBytes( "10110010" + std::string( 248, 'x' ) );
+  auto testcase = fixture.AddCalibrated( "padded", buf );
+  auto old_hash = afl::util::HashContent( buf.data(), buf.size() );
+  BOOST_CHECK( afl::util::IsKnownContent( state, old_hash ) );
+
+  testcase->input->Load();
+  afl::pipeline::other::TrimCase trim( state, std::nullopt );
+  trim( testcase );
+
+  auto &input = *testcase->input;
+  BOOST_CHECK_LT( input.GetLen(), buf.size() );
+  BOOST_CHECK( !afl::util::IsKnownContent( state, old_hash ) );
+  BOOST_CHECK( afl::util::IsKnownContent( state, afl::util::HashContent( input.GetBuf(), input.GetLen() ) ) );
+  BOOST_CHECK_EQUAL( state.content_hashes.size(), 1 );
+}
+
+// 新しいビットを持っていても、既にキューにある内容は加えられない事を確認する
+BOOST_AUTO_TEST_CASE(SaveIfInterestingRejectsDuplicate) {
+  MoveToProgramLocation();
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+  StateFixture fixture( root_dir );
+  auto &state = *fixture.state;
+
+  auto buf = ToBytes( "01100000" );
+  afl::pipeline::update::NormalUpdate update( state );
+
+  auto run = [&]() {
+    ExitStatusFeedback exit_status;
+    auto inp_feed = state.RunExecutorWithClassifyCounts( buf.data(), buf.size(), exit_status );
+    update( buf.data(), buf.size(), inp_feed, exit_status );
+  };
+
+  run();
+  BOOST_CHECK_EQUAL( state.queued_paths, 1 );
+  BOOST_CHECK_EQUAL( state.queued_duplicates, 0 );
+
+  // ターゲットの挙動が変動した場合のように、同じ入力がまた新しいビットを持つ
+  std::fill( state.virgin_bits.begin(), state.virgin_bits.end(), 255 );
+  run();
+  BOOST_CHECK_EQUAL( state.queued_paths, 1 );
+  BOOST_CHECK_EQUAL( state.queued_duplicates, 1 );
+
+  state.file_writer->flush();
+  BOOST_CHECK_EQUAL( ListQueue( fixture.out_dir / "queue" ).size(), 1 );
+}
+
+// 入力ディレクトリにある同じ内容のシードは1つしか読まれず、
+// 以前のキューから再開する場合は、IDがずれないように全て読まれる事を確認する
+BOOST_AUTO_TEST_CASE(ReadTestcasesSkipsDuplicates) {
+  MoveToProgramLocation();
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  auto input_dir = root_dir / "input";
+  BOOST_CHECK( fs::create_directory( input_dir ) );
+  create_file( ( input_dir / "a" ).string(), "10110010" );
+  create_file( ( input_dir / "b" ).string(), "01000000" );
+  create_file( ( input_dir / "c" ).string(), "10110010" );
+
+  auto output_dir = root_dir / "output";
+  {
+    AFLFuzzer fuzzer(
+      { put_path },
+      input_dir.string(), output_dir.string(),
+      1000, AFLOption::MEM_LIMIT,
+      true
+    );
+  }
+  auto queue = ListQueue( output_dir / "queue" );
+  BOOST_CHECK_EQUAL( queue.size(), 2 );
+  BOOST_CHECK_EQUAL( queue[ 0 ], "id:000000,orig:a" );
+  BOOST_CHECK_EQUAL( queue[ 1 ], "id:000001,orig:b" );
+
+  // トリミングで2つの要素が同じ内容になった場合に相当する
+  auto resume_dir = root_dir / "resume";
+  fs::create_directory( resume_dir );
+  for( const auto &name : queue ) {
+    fs::copy_file( output_dir / "queue" / name, resume_dir / name );
+  }
+  fs::remove( resume_dir / queue[ 1 ] );
+  fs::copy_file( resume_dir / queue[ 0 ], resume_dir / queue[ 1 ] );
+
+  auto resumed_dir = root_dir / "resumed";
+  {
+    AFLFuzzer fuzzer(
+      { put_path },
+      resume_dir.string(), resumed_dir.string(),
+      1000, AFLOption::MEM_LIMIT,
+      true
+    );
+  }
+  BOOST_CHECK( ListQueue( resumed_dir / "queue" ) == queue );
+}
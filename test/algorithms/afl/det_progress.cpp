@@ -0,0 +1,70 @@
+#define BOOST_TEST_MODULE algorithms.afl.det_progress
+#define BOOST_TEST_DYN_LINK
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include "config.h"
+#ifdef HAS_CXX_STD_FILESYSTEM
+#include <filesystem>
+#else
+#include <boost/filesystem.hpp>
+#endif
+#include <create_file.hpp>
+
+#include "Algorithms/AFL/AFLUtil.hpp"
+
+// 保存した決定的ステージの途中経過がそのまま読み出せる事を確認する
+BOOST_AUTO_TEST_CASE(DetProgressRoundTrip) {
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+#ifdef HAS_CXX_STD_FILESYSTEM
+  namespace fs = std::filesystem;
+#else
+  namespace fs = boost::filesystem;
+#endif
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  // 存在しない場合
+  auto path = ( root_dir / "id:000000" ).string();
+  BOOST_CHECK( afl::util::ReadDetProgress( path ) == nullptr );
+
+  AFLDetProgress progress;
+  progress.stage = AFLOption::STAGE_ARITH16;
+  progress.pos = 42;
+  progress.len = 100;
+  progress.exec_cksum = 0xdeadbeef;
+  progress.eff_cnt = 2;
+  progress.eff_map = { 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+  afl::util::WriteDetProgress( path, progress );
+
+  auto loaded = afl::util::ReadDetProgress( path );
+  BOOST_CHECK( loaded != nullptr );
+  BOOST_CHECK_EQUAL( loaded->stage, progress.stage );
+  BOOST_CHECK_EQUAL( loaded->pos, progress.pos );
+  BOOST_CHECK_EQUAL( loaded->len, progress.len );
+  BOOST_CHECK_EQUAL( loaded->exec_cksum, progress.exec_cksum );
+  BOOST_CHECK_EQUAL( loaded->eff_cnt, progress.eff_cnt );
+  BOOST_CHECK( loaded->eff_map == progress.eff_map );
+
+  // 書き込み途中のファイルは残らない
+  BOOST_CHECK( !fs::exists( path + ".tmp" ) );
+
+  // 壊れている場合は無視される
+  create_file( path, "AFDP" );
+  BOOST_CHECK( afl::util::ReadDetProgress( path ) == nullptr );
+}
+
+// 決定的ステージの実行順は、STAGE_*の値の順とは異なる
+BOOST_AUTO_TEST_CASE(DetStageOrder) {
+  using afl::util::DetStageRank;
+  BOOST_CHECK( DetStageRank( AFLOption::STAGE_FLIP1 ) < DetStageRank( AFLOption::STAGE_FLIP8 ) );
+  BOOST_CHECK( DetStageRank( AFLOption::STAGE_INTEREST32 ) < DetStageRank( AFLOption::STAGE_ITS ) );
+  BOOST_CHECK( DetStageRank( AFLOption::STAGE_ITS ) < DetStageRank( AFLOption::STAGE_EXTRAS_UO ) );
+  BOOST_CHECK( DetStageRank( AFLOption::STAGE_EXTRAS_UO ) < DetStageRank( AFLOption::STAGE_EXTRAS_AO ) );
+  // 決定的ステージでないもの
+  BOOST_CHECK( DetStageRank( AFLOption::STAGE_HAVOC ) > DetStageRank( AFLOption::STAGE_EXTRAS_AO ) );
+}
@@ -0,0 +1,155 @@
+#define BOOST_TEST_MODULE algorithms.afl.dry_run
+#define BOOST_TEST_DYN_LINK
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include "config.h"
+#include "Utils/Filesystem.hpp"
+#include "Utils/Workspace.hpp"
+#include "Algorithms/AFL/AFLFuzzer.hpp"
+#include "Algorithms/AFL/AFLCheckpoint.hpp"
+#include "Algorithms/AFL/AFLExecutorPool.hpp"
+#include "Algorithms/AFL/AFLSetting.hpp"
+#include "Algorithms/AFL/AFLState.hpp"
+#include "Algorithms/AFL/AFLUtil.hpp"
+#include "Executor/NativeLinuxExecutor.hpp"
+#include <move_to_program_location.hpp>
+
+// シードに対してdry runだけを行い、その結果をチェックポイントとして読み出す
+static std::unique_ptr< AFLCheckpoint > DryRun( const fs::path &input_dir, const fs::path &output_dir ) {
+  {
+    AFLFuzzer fuzzer(
+      { "../../put_binaries/libjpeg/libjpeg_turbo_fuzzer", "@@" },
+      input_dir.native(), output_dir.native(),
+      AFLOption::EXEC_TIMEOUT, AFLOption::MEM_LIMIT,
+      true
+    );
+  }
+  return afl::util::ReadCheckpoint( ( output_dir / "queue/.state/checkpoint" ).string() );
+}
+
+// executorのプールで並列に行ったdry runが、逐次に行った場合と同じ結果になる事を確認する
+BOOST_AUTO_TEST_CASE(DryRunInParallelMatchesSerial) {
+  MoveToProgramLocation();
+
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  // 元のシードの先頭を切り出したものをシードに加える
+  // top_ratedは実行時間と長さの積で決まるので、長さを倍以上離して実行時間のゆらぎに左右されないようにする
+  std::ifstream seed_file( "../../put_binaries/libjpeg/seeds/seed.jpg", std::ios::binary );
+  std::vector< char > seed( ( std::istreambuf_iterator< char >( seed_file ) ), std::istreambuf_iterator< char >() );
+  BOOST_CHECK( !seed.empty() );
+
+  auto input_dir = root_dir / "input";
+  fs::create_directory( input_dir );
+  for( std::size_t len : { seed.size(), std::size_t( 160 ), std::size_t( 64 ), std::size_t( 24 ) } ) {
+    std::ofstream out( ( input_dir / ( "seed_" + std::to_string( len ) ) ).string(), std::ios::binary );
+    out.write( seed.data(), std::min( len, seed.size() ) );
+  }
+
+  auto serial = DryRun( input_dir, root_dir / "serial" );
+
+  setenv( "AFL_DET_SHARDS", "2", 1 );
+  BOOST_SCOPE_EXIT( void ) {
+    unsetenv( "AFL_DET_SHARDS" );
+  } BOOST_SCOPE_EXIT_END
+  auto parallel = DryRun( input_dir, root_dir / "parallel" );
+
+  BOOST_REQUIRE( serial != nullptr );
+  BOOST_REQUIRE( parallel != nullptr );
+
+  BOOST_CHECK( parallel->virgin_bits == serial->virgin_bits );
+  BOOST_CHECK( parallel->var_bytes == serial->var_bytes );
+  BOOST_CHECK( parallel->top_rated == serial->top_rated );
+
+  BOOST_REQUIRE_EQUAL( parallel->entries.size(), serial->entries.size() );
+  for( std::size_t i = 0; i != serial->entries.size(); ++i ) {
+    const auto &s = serial->entries[ i ];
+    const auto &p = parallel->entries[ i ];
+    BOOST_CHECK_EQUAL( p.name, s.name );
+    BOOST_CHECK_EQUAL( p.exec_cksum, s.exec_cksum );
+    BOOST_CHECK_EQUAL( p.bitmap_size, s.bitmap_size );
+    BOOST_CHECK_EQUAL( p.var_behavior, s.var_behavior );
+  }
+}
+
+// トレースが変動した場合に、1回目のトレースとの差分から各回のトレースが組み立てられる事を確認する
+BOOST_AUTO_TEST_CASE(ReplayVariableCalibration) {
+  MoveToProgramLocation();
+
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  auto out_dir = root_dir / "output";
+  AFLSetting setting(
+    { "../../put_binaries/libjpeg/libjpeg_turbo_fuzzer", "@@" },
+    ( root_dir / "input" ).string(), out_dir.string(),
+    AFLOption::EXEC_TIMEOUT, AFLOption::MEM_LIMIT,
+    true, false,
+    NativeLinuxExecutor::CPUID_DO_NOT_BIND
+  );
+  SetupDirs( out_dir.string() );
+  NativeLinuxExecutor executor(
+    setting.argv,
+    setting.exec_timelimit_ms,
+    setting.exec_memlimit,
+    setting.forksrv,
+    out_dir / AFLOption::DEFAULT_OUTFILE,
+    true,                 // need_afl_cov
+    false,                // need_bb_cov
+    setting.cpuid_to_bind
+  );
+  AFLState state( setting, executor );
+
+  const u8 buf[] = "seed";
+  auto testcase = afl::util::AddToQueue( state, ( out_dir / "queue/seed" ).string(), buf, 4, false );
+
+  // 1回目と3回目は同じで、2回目と4回目以降はそれぞれ別の箇所が異なる
+  AFLExecutorPool::Calibration calibration;
+  calibration.first_trace.assign( AFLOption::MAP_SIZE, 0 );
+  calibration.first_trace[ 10 ] = 1;
+  calibration.first_trace[ 20 ] = 2;
+  calibration.trace_diffs[ 0x1111 ] = { { 20, 0 }, { 30, 1 } };
+  calibration.trace_diffs[ 0x2222 ] = { { 40, 4 } };
+  calibration.cksums = { 0x1000, 0x1111, 0x1000 };
+  for( u32 i = calibration.cksums.size(); i != AFLOption::CAL_CYCLES_LONG; ++i ) {
+    calibration.cksums.emplace_back( 0x2222 );
+  }
+  for( u32 i = 0; i != calibration.cksums.size(); ++i ) {
+    calibration.elapsed_us.emplace_back( ( i + 1 ) * 100 );
+  }
+
+  auto res = afl::util::ReplayCalibration( *testcase, state, calibration, 0 );
+  BOOST_CHECK( res == PUTExitReasonType::FAULT_NONE );
+
+  BOOST_CHECK_EQUAL( testcase->exec_cksum, 0x1000 );
+  BOOST_CHECK( testcase->var_behavior );
+  BOOST_CHECK_EQUAL( testcase->ExecUs(), 100 );
+
+  // 最後のトレースは10, 20, 40番目が立っている
+  BOOST_CHECK_EQUAL( testcase->BitmapSize(), 3 );
+
+  BOOST_CHECK_EQUAL( state.var_byte_count, 3 );
+  std::vector< u8 > expected_var_bytes( AFLOption::MAP_SIZE, 0 );
+  expected_var_bytes[ 20 ] = expected_var_bytes[ 30 ] = expected_var_bytes[ 40 ] = 1;
+  BOOST_CHECK( state.var_bytes == expected_var_bytes );
+  for( u32 i : { 10, 20, 30, 40 } ) {
+    BOOST_CHECK( state.virgin_bits[ i ] != 255 );
+  }
+}
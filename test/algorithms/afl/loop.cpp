@@ -56,3 +56,13 @@ BOOST_AUTO_TEST_CASE(AFLLoopForkMode) {
   AFLLoop(true);
   std::cout << "[*] AFLLoopForkMode ended\n";
 }
+
+BOOST_AUTO_TEST_CASE(AFLLoopShardedDetMode) {
+  std::cout << "[*] AFLLoopShardedDetMode started\n";
+  setenv("AFL_DET_SHARDS", "2", 1);
+  BOOST_SCOPE_EXIT( void ) {
+    unsetenv("AFL_DET_SHARDS");
+  } BOOST_SCOPE_EXIT_END
+  AFLLoop(true);
+  std::cout << "[*] AFLLoopShardedDetMode ended\n";
+}
@@ -0,0 +1,130 @@
+#define BOOST_TEST_MODULE algorithms.afl.trim
+#define BOOST_TEST_DYN_LINK
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include "config.h"
+#include "Utils/Filesystem.hpp"
+#include "Utils/Workspace.hpp"
+#include "Algorithms/AFL/AFLExecutorPool.hpp"
+#include "Algorithms/AFL/AFLSetting.hpp"
+#include "Algorithms/AFL/AFLState.hpp"
+#include "Algorithms/AFL/AFLUtil.hpp"
+#include "Algorithms/AFL/AFLOtherHierarFlowRoutines.hpp"
+#include "Executor/NativeLinuxExecutor.hpp"
+#include <move_to_program_location.hpp>
+
+// zerooneは標準入力の先頭8バイトがそれぞれ'1'かどうかでだけ異なるトレースになる
+static const std::string put_path = "../../put_binaries/zeroone";
+
+// AFLFuzzerを通さずにAFLStateを組み立てる
+struct StateFixture {
+  StateFixture( const fs::path &root_dir ) :
+    out_dir( root_dir / "output" ),
+    setting(
+      { put_path },
+      ( root_dir / "input" ).string(), out_dir.string(),
+      1000, AFLOption::MEM_LIMIT,
+      true, false,
+      NativeLinuxExecutor::CPUID_DO_NOT_BIND
+    )
+  {
+    SetupDirs( out_dir.string() );
+    executor.reset(
+      new NativeLinuxExecutor(
+        setting.argv,
+        setting.exec_timelimit_ms,
+        setting.exec_memlimit,
+        setting.forksrv,
+        out_dir / AFLOption::DEFAULT_OUTFILE,
+        true,                 // need_afl_cov
+        false,                // need_bb_cov
+        setting.cpuid_to_bind
+      )
+    );
+    state.reset( new AFLState( setting, *executor ) );
+    state->not_on_tty = true;
+  }
+
+  // バッファを実行してキューに加え、較正まで済ませる
+  std::shared_ptr< AFLTestcase > AddCalibrated( const std::string &name, const std::vector< u8 > &buf ) {
+    auto testcase = afl::util::AddToQueue( *state, ( out_dir / "queue" / name ).string(), buf.data(), buf.size(), false );
+    ExitStatusFeedback exit_status;
+    auto inp_feed = state->RunExecutorWithClassifyCounts( buf.data(), buf.size(), exit_status );
+    auto res = afl::util::CalibrateCaseWithFeedDestroyed(
+      *testcase, buf.data(), buf.size(), *state, inp_feed, exit_status, 0, true
+    );
+    BOOST_CHECK( res == PUTExitReasonType::FAULT_NONE );
+    return testcase;
+  }
+
+  // 要素をトリミングし、トリミング後の内容が元と同じトレースになる事を確認して、その長さを返す
+  u32 Trim( const std::shared_ptr< AFLTestcase > &testcase, u32 orig_len ) {
+    const auto total_execs = state->total_execs;
+
+    testcase->input->Load();
+    afl::pipeline::other::TrimCase trim( *state, std::nullopt );
+    trim( testcase );
+    BOOST_CHECK( testcase->trim_done );
+
+    auto &input = *testcase->input;
+    BOOST_CHECK_GT( state->trim_execs, 0 );
+    BOOST_CHECK_EQUAL( state->trim_execs, state->total_execs - total_execs );
+    BOOST_CHECK_EQUAL( state->bytes_trim_in, orig_len );
+    BOOST_CHECK_EQUAL( state->bytes_trim_out, input.GetLen() );
+
+    const auto exec_cksum = testcase->exec_cksum;
+    ExitStatusFeedback exit_status;
+    auto inp_feed = state->RunExecutorWithClassifyCounts( input.GetBuf(), input.GetLen(), exit_status );
+    BOOST_CHECK( exit_status.exit_reason == PUTExitReasonType::FAULT_NONE );
+    BOOST_CHECK_EQUAL( inp_feed.CalcCksum32(), exec_cksum );
+    return input.GetLen();
+  }
+
+  fs::path out_dir;
+  AFLSetting setting;
+  std::unique_ptr< NativeLinuxExecutor > executor;
+  std::unique_ptr< AFLState > state;
+};
+
+// executorのプールで並列に行ったトリミングが、トレースを変えずに、逐次の場合と同じだけ入力を縮める事を確認する
+BOOST_AUTO_TEST_CASE(TrimInParallel) {
+  MoveToProgramLocation();
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  // 長さを2の冪にしない事で、末尾の半端なブロックも試される
+  const std::string known = "10110010";
+  for( u32 pad_len : { 248u, 300u, 1000u } ) {
+    const std::string str = known + std::string( pad_len, 'x' );
+    const std::vector< u8 > buf( str.begin(), str.end() );
+    const auto serial_dir = root_dir / ( "serial_" + std::to_string( pad_len ) );
+    const auto parallel_dir = root_dir / ( "parallel_" + std::to_string( pad_len ) );
+    BOOST_CHECK( fs::create_directory( serial_dir ) );
+    BOOST_CHECK( fs::create_directory( parallel_dir ) );
+
+    StateFixture serial( serial_dir );
+    const auto serial_len = serial.Trim( serial.AddCalibrated( "padded", buf ), buf.size() );
+
+    StateFixture parallel( parallel_dir );
+    AFLExecutorPool pool( parallel.setting, *parallel.executor, 4 );
+    parallel.state->det_executor_pool = &pool;
+    auto testcase = parallel.AddCalibrated( "padded", buf );
+    const auto parallel_len = parallel.Trim( testcase, buf.size() );
+    parallel.state->det_executor_pool = nullptr;
+
+    BOOST_CHECK_LE( parallel_len, serial_len );
+
+    // トレースを決める先頭8バイトより後ろは全て取り除ける
+    BOOST_CHECK_EQUAL( serial_len, known.size() );
+    const auto &input = *testcase->input;
+    BOOST_CHECK( std::string( input.GetBuf(), input.GetBuf() + input.GetLen() ) == known );
+  }
+}
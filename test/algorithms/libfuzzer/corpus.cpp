@@ -0,0 +1,95 @@
+#define BOOST_TEST_MODULE algorithms.libfuzzer.corpus
+#define BOOST_TEST_DYN_LINK
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include <Algorithms/libFuzzer/Corpus.hpp>
+#include <Utils/Filesystem.hpp>
+#include <Utils/Random.hpp>
+
+using fuzzuf::algorithm::libfuzzer::Corpus;
+
+// 新しい特徴を持つ入力が加わり、全ての特徴についてより小さい入力が見つかった入力は削除される事を確認する
+BOOST_AUTO_TEST_CASE(AddFeature) {
+  Corpus corpus( "" );
+  const std::vector< std::uint8_t > large( 8u, 'a' );
+  const std::vector< std::uint8_t > small( 4u, 'b' );
+
+  BOOST_CHECK( corpus.AddFeature( 1u, large.size(), true ) );
+  BOOST_CHECK( corpus.AddFeature( 2u, large.size(), true ) );
+  corpus.AddToCorpus( large.data(), large.size(), 2u, { 1u, 2u } );
+  BOOST_CHECK_EQUAL( corpus.NumFeatures(), 2u );
+  BOOST_CHECK_EQUAL( corpus.NumActiveUnits(), 1u );
+
+  // 同じ大きさでは更新されない
+  BOOST_CHECK( !corpus.AddFeature( 1u, large.size(), true ) );
+  // shrinkが偽ならより小さい入力でも更新されない
+  BOOST_CHECK( !corpus.AddFeature( 1u, small.size(), false ) );
+
+  BOOST_CHECK( corpus.AddFeature( 1u, small.size(), true ) );
+  BOOST_CHECK_EQUAL( corpus.NumActiveUnits(), 1u );
+  BOOST_CHECK( corpus.AddFeature( 2u, small.size(), true ) );
+  // largeはどの特徴についても最小でなくなったので削除される
+  BOOST_CHECK_EQUAL( corpus.NumActiveUnits(), 0u );
+  corpus.AddToCorpus( small.data(), small.size(), 2u, { 1u, 2u } );
+
+  BOOST_CHECK_EQUAL( corpus.size(), 2u );
+  BOOST_CHECK_EQUAL( corpus.NumActiveUnits(), 1u );
+  BOOST_CHECK_EQUAL( corpus.NumFeatures(), 2u );
+  BOOST_CHECK_EQUAL( corpus.NumFeatureUpdates(), 4u );
+  BOOST_CHECK( corpus[ 0 ].data.empty() );
+
+  // 削除された入力は選ばれない
+  fuzzuf::utils::random::prng rng( 1u );
+  for( int i = 0; i != 100; ++i )
+    BOOST_CHECK( &corpus.ChooseUnitToMutate( rng ) == &corpus[ 1 ] );
+}
+
+// Replaceで入力が置き換わり、queue_dirのファイルも置き換わる事を確認する
+BOOST_AUTO_TEST_CASE(Replace) {
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  BOOST_REQUIRE( raw_dirname != nullptr );
+  const auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  Corpus corpus( root_dir );
+  const std::vector< std::uint8_t > large( 8u, 'a' );
+  const std::vector< std::uint8_t > small( 4u, 'b' );
+
+  BOOST_CHECK( corpus.AddFeature( 1u, large.size(), false ) );
+  auto &ii = corpus.AddToCorpus( large.data(), large.size(), 1u, { 1u } );
+  const auto large_name = ii.name;
+  BOOST_CHECK( fs::exists( root_dir / large_name ) );
+  BOOST_CHECK( corpus.HasUnit( large.data(), large.size() ) );
+
+  corpus.Replace( ii, small.data(), small.size() );
+  BOOST_CHECK( ii.reduced );
+  BOOST_CHECK_EQUAL_COLLECTIONS( ii.data.begin(), ii.data.end(), small.begin(), small.end() );
+  BOOST_CHECK( !fs::exists( root_dir / large_name ) );
+  BOOST_CHECK( fs::exists( root_dir / ii.name ) );
+  BOOST_CHECK( !corpus.HasUnit( large.data(), large.size() ) );
+  BOOST_CHECK( corpus.HasUnit( small.data(), small.size() ) );
+  BOOST_CHECK_EQUAL( fs::file_size( root_dir / ii.name ), small.size() );
+}
+
+// 後から加わった入力ほど選ばれやすい事を確認する
+BOOST_AUTO_TEST_CASE(ChooseUnitToMutate) {
+  Corpus corpus( "" );
+  for( std::uint32_t i = 0u; i != 4u; ++i ) {
+    const std::vector< std::uint8_t > data( i + 1u, 'a' );
+    BOOST_CHECK( corpus.AddFeature( i, data.size(), false ) );
+    corpus.AddToCorpus( data.data(), data.size(), 1u, { i } );
+  }
+  fuzzuf::utils::random::prng rng( 2u );
+  std::vector< std::size_t > count( 4u, 0u );
+  for( int i = 0; i != 10000; ++i )
+    ++count[ corpus.ChooseUnitToMutate( rng ).data.size() - 1u ];
+  // 重みは1:2:3:4
+  BOOST_CHECK_LT( count[ 0 ], count[ 1 ] );
+  BOOST_CHECK_LT( count[ 1 ], count[ 2 ] );
+  BOOST_CHECK_LT( count[ 2 ], count[ 3 ] );
+}
@@ -2,7 +2,11 @@
 #define BOOST_TEST_DYN_LINK
 #include <system_error>
 #include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include <create_file.hpp>
 #include <Algorithms/libFuzzer/Dictionary.hpp>
+#include <Utils/Filesystem.hpp>
+#include <Utils/MappedDictionary.hpp>
 #include <Exceptions.hpp>
 #include <config.h>
 
@@ -348,3 +352,82 @@ BOOST_AUTO_TEST_CASE(StrictMode) {
   }
 }
 
+
+// 入力を1回走査し、position_hintを持たない要素に最初の出現位置が設定される事を確認する
+BOOST_AUTO_TEST_CASE(UpdatePositionHint) {
+  namespace dict_ns = fuzzuf::algorithm::libfuzzer::dictionary;
+  dict_ns::dynamic_dictionary_t dict{
+    { { 'a', 'b' } },
+    { { 'b', 'c', 'd' } },
+    { { 'x', 'y' } },
+    { { 'c', 'd' }, 0u }
+  };
+  const auto m = dict_ns::compile_matcher( dict );
+  const std::string data( "zabcdabcd" );
+  const auto count = dict_ns::update_position_hint(
+    dict, m, reinterpret_cast< const uint8_t* >( data.data() ), data.size()
+  );
+  BOOST_CHECK_EQUAL( count, 2u );
+  BOOST_CHECK_EQUAL( dict[ 0 ].get_position_hint(), 1u );
+  BOOST_CHECK_EQUAL( dict[ 1 ].get_position_hint(), 2u );
+  // 現れない要素と、既にposition_hintを持つ要素はそのまま
+  BOOST_CHECK( !dict[ 2 ].has_position_hint() );
+  BOOST_CHECK_EQUAL( dict[ 3 ].get_position_hint(), 0u );
+}
+
+// tools/dict2mpで変換した辞書からも、元の辞書と同じ内容をロードできる事を確認する
+// mapped_dictionary_tにはバイト列をコピーせずにロードされ、変換前の辞書はロードできない
+BOOST_AUTO_TEST_CASE(LoadPrecompiledDictionary) {
+  namespace dict_ns = fuzzuf::algorithm::libfuzzer::dictionary;
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+  const auto eout = []( std::string &&m ) {
+    std::cerr << m << std::endl;
+  };
+
+  dict_ns::static_dictionary_t expected;
+  load( TEST_DICTIONARY_DIR "/test.dict", expected, false, eout );
+
+  const auto flat = fuzzuf::utils::dictionary::to_flat_dictionary( expected );
+  const auto mp = fuzzuf::utils::dictionary::to_msgpack_dictionary( expected );
+  const auto flat_path = ( root_dir / "test.flat" ).string();
+  const auto mp_path = ( root_dir / "test.mp" ).string();
+  create_file( flat_path, std::string( flat.begin(), flat.end() ) );
+  create_file( mp_path, std::string( mp.begin(), mp.end() ) );
+
+  for( const auto &path: { flat_path, mp_path } ) {
+    dict_ns::static_dictionary_t static_dict;
+    load( path, static_dict, false, eout );
+    BOOST_CHECK_EQUAL_COLLECTIONS(
+      static_dict.begin(),
+      static_dict.end(),
+      expected.begin(),
+      expected.end()
+    );
+
+    dict_ns::dynamic_dictionary_t dynamic_dict;
+    load( path, dynamic_dict, false, eout );
+    BOOST_CHECK_EQUAL( dynamic_dict.size(), expected.size() );
+
+    dict_ns::mapped_dictionary_t mapped_dict;
+    load( path, mapped_dict, false, eout );
+    BOOST_CHECK_EQUAL( mapped_dict.size(), expected.size() );
+    for( std::size_t i = 0u; i != expected.size() && i != mapped_dict.size(); ++i ) {
+      const auto &l = mapped_dict[ i ].get();
+      const auto &r = expected[ i ].get();
+      BOOST_CHECK( std::equal( l.begin(), l.end(), r.begin(), r.end() ) );
+      BOOST_CHECK( std::equal( r.begin(), r.end(), dynamic_dict[ i ].get().begin(), dynamic_dict[ i ].get().end() ) );
+    }
+  }
+
+  dict_ns::mapped_dictionary_t mapped_dict;
+  BOOST_CHECK_THROW(
+    load( TEST_DICTIONARY_DIR "/test.dict", mapped_dict, false, eout ),
+    exceptions::invalid_file
+  );
+}
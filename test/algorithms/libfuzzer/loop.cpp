@@ -0,0 +1,51 @@
+#define BOOST_TEST_MODULE algorithms.libfuzzer.loop
+#define BOOST_TEST_DYN_LINK
+#include <iostream>
+#include <boost/test/unit_test.hpp>
+#include <Algorithms/libFuzzer/LibFuzzer.hpp>
+#include <Utils/Filesystem.hpp>
+#include <boost/scope_exit.hpp>
+#include <move_to_program_location.hpp>
+
+BOOST_AUTO_TEST_CASE(LibFuzzerLoop) {
+  // cd $(dirname $0)
+  MoveToProgramLocation();
+
+  // Create root directory
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  BOOST_CHECK( raw_dirname != nullptr );
+
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    // Executed on this test exit
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  auto put_dir = fs::path( "../../put_binaries/libjpeg" );
+  auto input_dir = put_dir / "seeds";
+  auto output_dir = root_dir / "output";
+
+  // Create fuzzer instance
+  fuzzuf::algorithm::libfuzzer::LibFuzzer fuzzer(
+    { "../../put_binaries/libjpeg/libjpeg_turbo_fuzzer", "@@" },
+    input_dir.native(), output_dir.native(),
+    AFLOption::EXEC_TIMEOUT, AFLOption::MEM_LIMIT,
+    /* forksrv */ true,
+    {}, 0
+  );
+  BOOST_CHECK( !fuzzer.GetCorpus().empty() );
+
+  for (int i=0; i<100; i++) {
+      fuzzer.OneLoop();
+  }
+
+  // コーパスの要素は全てqueue/に書き出されている
+  const auto &corpus = fuzzer.GetCorpus();
+  for (std::size_t i=0; i<corpus.size(); i++) {
+      if (corpus[i].data.empty()) continue;
+      BOOST_CHECK( fs::exists( output_dir / "queue" / corpus[i].name ) );
+  }
+  BOOST_CHECK_GT( fuzzer.GetTotalNumberOfRuns(), 100u );
+}
@@ -0,0 +1,104 @@
+#define BOOST_TEST_MODULE algorithms.libfuzzer.mutation_dispatcher
+#define BOOST_TEST_DYN_LINK
+#include <algorithm>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <Algorithms/libFuzzer/MutationDispatcher.hpp>
+#include <Utils/Random.hpp>
+
+using fuzzuf::algorithm::libfuzzer::MutationDispatcher;
+
+// どの変異もmax_sizeを超える大きさを返さず、失敗した場合は0を返す事を確認する
+BOOST_AUTO_TEST_CASE(MaxSize) {
+  fuzzuf::utils::random::prng rng( 1u );
+  MutationDispatcher md( rng );
+  md.GetManualDictionary().push_back( { std::vector< std::uint8_t >{ 'h', 'o', 'g', 'e' } } );
+  const std::vector< std::uint8_t > other{ '1', '2', '3', 'a', 'b', 'c', 'd', 'e' };
+  md.SetCrossOverWith( other.data(), other.size() );
+
+  for( std::size_t max_size = 1u; max_size != 16u; ++max_size ) {
+    for( std::size_t size = 1u; size <= max_size; ++size ) {
+      for( std::uint32_t type = 0u; type != MutationDispatcher::NUM_MUTATORS; ++type ) {
+        for( int i = 0; i != 16; ++i ) {
+          std::vector< std::uint8_t > buf( max_size, '7' );
+          const auto new_size = md.ApplyMutator( MutationDispatcher::MutatorType( type ), buf.data(), size, max_size );
+          BOOST_CHECK_LE( new_size, max_size );
+        }
+      }
+      std::vector< std::uint8_t > buf( max_size, '7' );
+      const auto new_size = md.Mutate( buf.data(), size, max_size );
+      BOOST_CHECK_GE( new_size, 1u );
+      BOOST_CHECK_LE( new_size, max_size );
+    }
+  }
+}
+
+// 同じシードの乱数生成器を使えば同じ変異の系列になる事を確認する
+BOOST_AUTO_TEST_CASE(Deterministic) {
+  fuzzuf::utils::random::prng rng1( 2u );
+  fuzzuf::utils::random::prng rng2( 2u );
+  MutationDispatcher md1( rng1 );
+  MutationDispatcher md2( rng2 );
+
+  std::vector< std::uint8_t > buf1( 64u, 'x' );
+  std::vector< std::uint8_t > buf2( 64u, 'x' );
+  std::size_t size1 = 8u;
+  std::size_t size2 = 8u;
+  for( int i = 0; i != 1000; ++i ) {
+    size1 = md1.Mutate( buf1.data(), size1, buf1.size() );
+    size2 = md2.Mutate( buf2.data(), size2, buf2.size() );
+    BOOST_CHECK_EQUAL_COLLECTIONS( buf1.begin(), std::next( buf1.begin(), size1 ), buf2.begin(), std::next( buf2.begin(), size2 ) );
+  }
+  BOOST_CHECK_EQUAL( md1.DescribeMutationSequence(), md2.DescribeMutationSequence() );
+}
+
+// 辞書の要素を使うとuse_countが増え、成功した系列に含まれていた要素はsuccess_countが増えて永続自動辞書に加わる事を確認する
+BOOST_AUTO_TEST_CASE(SuccessfulDictionaryEntry) {
+  fuzzuf::utils::random::prng rng( 3u );
+  MutationDispatcher md( rng );
+  md.GetManualDictionary().push_back( { std::vector< std::uint8_t >{ 'h', 'o', 'g', 'e' } } );
+
+  // 永続自動辞書が空の間は失敗する
+  std::vector< std::uint8_t > buf( 32u, 'x' );
+  BOOST_CHECK_EQUAL( md.ApplyMutator( MutationDispatcher::PERSISTENT_AUTO_DICT, buf.data(), 8u, buf.size() ), 0u );
+
+  md.StartMutationSequence();
+  const auto new_size = md.ApplyMutator( MutationDispatcher::MANUAL_DICT, buf.data(), 8u, buf.size() );
+  BOOST_CHECK( new_size == 8u || new_size == 12u );
+  BOOST_CHECK_EQUAL( md.GetManualDictionary()[ 0 ].get_use_count(), 1u );
+  BOOST_CHECK_EQUAL( md.GetManualDictionary()[ 0 ].get_success_count(), 0u );
+  BOOST_CHECK( std::search( buf.begin(), std::next( buf.begin(), new_size ), md.GetManualDictionary()[ 0 ].get().begin(), md.GetManualDictionary()[ 0 ].get().end() ) != buf.end() );
+
+  md.RecordSuccessfulMutationSequence();
+  BOOST_CHECK_EQUAL( md.GetManualDictionary()[ 0 ].get_success_count(), 1u );
+  BOOST_REQUIRE_EQUAL( md.GetPersistentAutoDictionary().size(), 1u );
+  BOOST_CHECK( md.GetPersistentAutoDictionary()[ 0 ].get() == md.GetManualDictionary()[ 0 ].get() );
+
+  // 同じ要素は永続自動辞書に重複して加わらない
+  md.StartMutationSequence();
+  md.ApplyMutator( MutationDispatcher::MANUAL_DICT, buf.data(), 8u, buf.size() );
+  md.RecordSuccessfulMutationSequence();
+  BOOST_CHECK_EQUAL( md.GetPersistentAutoDictionary().size(), 1u );
+  BOOST_CHECK_NE( md.ApplyMutator( MutationDispatcher::PERSISTENT_AUTO_DICT, buf.data(), 8u, buf.size() ), 0u );
+}
+
+// CROSS_OVERは相手が与えられていなければ失敗し、与えられていれば2つの入力の一部を組み合わせた入力を作る事を確認する
+BOOST_AUTO_TEST_CASE(CrossOver) {
+  fuzzuf::utils::random::prng rng( 4u );
+  MutationDispatcher md( rng );
+  std::vector< std::uint8_t > buf( 32u, 'x' );
+  BOOST_CHECK_EQUAL( md.ApplyMutator( MutationDispatcher::CROSS_OVER, buf.data(), 8u, buf.size() ), 0u );
+
+  const std::vector< std::uint8_t > other( 8u, 'y' );
+  md.SetCrossOverWith( other.data(), other.size() );
+  bool found = false;
+  for( int i = 0; i != 100; ++i ) {
+    std::fill( buf.begin(), buf.end(), 'x' );
+    const auto new_size = md.ApplyMutator( MutationDispatcher::CROSS_OVER, buf.data(), 8u, buf.size() );
+    BOOST_REQUIRE_NE( new_size, 0u );
+    const auto end = std::next( buf.begin(), new_size );
+    BOOST_CHECK( std::all_of( buf.begin(), end, []( auto c ) { return c == 'x' || c == 'y'; } ) );
+    found = found || std::find( buf.begin(), end, 'y' ) != end;
+  }
+  BOOST_CHECK( found );
+}
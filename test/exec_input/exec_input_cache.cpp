@@ -0,0 +1,229 @@
+#define BOOST_TEST_MODULE exec_input.cache
+#define BOOST_TEST_DYN_LINK
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include "config.h"
+#ifdef HAS_CXX_STD_FILESYSTEM
+#include <filesystem>
+#else
+#include <boost/filesystem.hpp>
+#endif
+#include <create_file.hpp>
+
+#include "ExecInput/ExecInputCache.hpp"
+#include "ExecInput/ExecInputSet.hpp"
+
+static std::shared_ptr<u8[]> MakeBuf(const std::string &data) {
+  std::shared_ptr<u8[]> buf(new u8[data.size()]);
+  std::memcpy(buf.get(), data.data(), data.size());
+  return buf;
+}
+
+BOOST_AUTO_TEST_CASE(ExecInputCacheEviction) {
+  ExecInputCache cache(8);
+
+  cache.Put(1, MakeBuf("abcd"), 4);
+  cache.Put(2, MakeBuf("efgh"), 4);
+  BOOST_CHECK_EQUAL(cache.GetSize(), 8);
+
+  std::shared_ptr<u8[]> buf;
+  u32 len = 0;
+  // 1を使ったので、次に追い出されるのは2
+  BOOST_CHECK(cache.Get(1, buf, len));
+  BOOST_CHECK_EQUAL(len, 4);
+  BOOST_CHECK(std::memcmp(buf.get(), "abcd", 4) == 0);
+
+  cache.Put(3, MakeBuf("ij"), 2);
+  BOOST_CHECK_EQUAL(cache.GetSize(), 6);
+  BOOST_CHECK(!cache.Get(2, buf, len));
+  BOOST_CHECK(cache.Get(3, buf, len));
+  BOOST_CHECK(cache.Get(1, buf, len));
+
+  // capacityより長いものは保持しない
+  cache.Put(4, MakeBuf("klmnopqrs"), 9);
+  BOOST_CHECK(!cache.Get(4, buf, len));
+  BOOST_CHECK_EQUAL(cache.GetSize(), 6);
+
+  // 同じIDは置き換え
+  cache.Put(1, MakeBuf("t"), 1);
+  BOOST_CHECK_EQUAL(cache.GetSize(), 3);
+  BOOST_CHECK(cache.Get(1, buf, len));
+  BOOST_CHECK_EQUAL(len, 1);
+
+  cache.Erase(3);
+  BOOST_CHECK(!cache.Get(3, buf, len));
+  BOOST_CHECK_EQUAL(cache.GetSize(), 1);
+
+  BOOST_CHECK_EQUAL(cache.GetHits(), 4);
+  BOOST_CHECK_EQUAL(cache.GetMisses(), 3);
+
+  cache.Clear();
+  BOOST_CHECK_EQUAL(cache.GetSize(), 0);
+  BOOST_CHECK(!cache.Get(1, buf, len));
+}
+
+BOOST_AUTO_TEST_CASE(ExecInputCacheOnDisk) {
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+#ifdef HAS_CXX_STD_FILESYSTEM
+  namespace fs = std::filesystem;
+#else
+  namespace fs = boost::filesystem;
+#endif
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+  auto path = root_dir / "0";
+  create_file( path.string(), "Hello" );
+
+  ExecInputSet input_set;
+  input_set.EnableDiskCache(1024);
+  auto input = input_set.CreateOnDisk(path);
+  const auto *cache = input_set.GetDiskCache();
+  BOOST_CHECK(cache != nullptr);
+
+  input->Load();
+  input->Unload();
+  BOOST_CHECK_EQUAL(cache->GetMisses(), 1);
+
+  // ファイルが変わってもキャッシュから読むので、2回目はヒットする
+  create_file( path.string(), "World" );
+  input->Load();
+  BOOST_CHECK_EQUAL(cache->GetHits(), 1);
+  BOOST_CHECK(std::memcmp(input->GetBuf(), "Hello", 5) == 0);
+  input->Unload();
+
+  // 書き換えはキャッシュに反映される
+  input->OverwriteThenUnload((const u8*)"Fuzz!!", 6);
+  input->Load();
+  BOOST_CHECK_EQUAL(input->GetLen(), 6);
+  BOOST_CHECK(std::memcmp(input->GetBuf(), "Fuzz!!", 6) == 0);
+
+  input->OverwriteKeepingLoaded((const u8*)"ab", 2);
+  input->Unload();
+  input->Load();
+  BOOST_CHECK_EQUAL(input->GetLen(), 2);
+  BOOST_CHECK(std::memcmp(input->GetBuf(), "ab", 2) == 0);
+  input->Unload();
+
+  auto id = input->GetID();
+  input_set.erase(id);
+  BOOST_CHECK_EQUAL(cache->GetSize(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ExecInputAsyncWriter) {
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+#ifdef HAS_CXX_STD_FILESYSTEM
+  namespace fs = std::filesystem;
+#else
+  namespace fs = boost::filesystem;
+#endif
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+  auto path = root_dir / "0";
+
+  auto writer = std::make_shared<fuzzuf::utils::async_file_writer>(1024);
+  ExecInputSet input_set;
+  input_set.EnableAsyncWriter(writer);
+  auto input = input_set.CreateOnDisk(path);
+
+  // 書き込みが終わっていなくても、書き換えた内容を読める
+  input->OverwriteThenUnload((const u8*)"Hello", 5);
+  input->Load();
+  BOOST_CHECK_EQUAL(input->GetLen(), 5);
+  BOOST_CHECK(std::memcmp(input->GetBuf(), "Hello", 5) == 0);
+  input->Unload();
+
+  input->OverwriteKeepingLoaded((const u8*)"World!", 6);
+  input->Unload();
+  input->LoadByMmap();
+  BOOST_CHECK_EQUAL(input->GetLen(), 6);
+  BOOST_CHECK(std::memcmp(input->GetBuf(), "World!", 6) == 0);
+  input->Unload();
+
+  writer->flush();
+  BOOST_CHECK_EQUAL(fs::file_size(path), 6);
+
+  // リンクは書き込みが終わるのを待ってから作られる
+  input->OverwriteThenUnload((const u8*)"Linked", 6);
+  auto new_path = root_dir / "1";
+  BOOST_CHECK(input->LinkAndRefer(new_path));
+  BOOST_CHECK_EQUAL(fs::file_size(new_path), 6);
+
+  // ハードリンクの内容を書き換えても、元のファイルは変わらない
+  input->OverwriteKeepingLoaded((const u8*)"ab", 2);
+  writer->flush();
+  BOOST_CHECK_EQUAL(fs::file_size(path), 6);
+  BOOST_CHECK_EQUAL(fs::file_size(new_path), 2);
+}
+
+BOOST_AUTO_TEST_CASE(ExecInputOverwriteSharedBuf) {
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+#ifdef HAS_CXX_STD_FILESYSTEM
+  namespace fs = std::filesystem;
+#else
+  namespace fs = boost::filesystem;
+#endif
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+  auto path = root_dir / "0";
+
+  // FIFOを開く所で書き込みのスレッドを止め、後に続く書き込みを待たせておく
+  auto fifo_path = root_dir / "fifo";
+  BOOST_REQUIRE(mkfifo(fifo_path.c_str(), 0600) == 0);
+
+  auto writer = std::make_shared<fuzzuf::utils::async_file_writer>(1024);
+  ExecInputSet input_set;
+  input_set.EnableDiskCache(1024);
+  input_set.EnableAsyncWriter(writer);
+  auto input = input_set.CreateOnDisk(path);
+  writer->write(fifo_path.string(), (const u8*)"x", 1);
+
+  // 所有権を渡した内容は、キャッシュと書き込み待ちの操作の両方に共有される
+  std::unique_ptr<u8[]> owned(new u8[5]);
+  std::memcpy(owned.get(), "Hello", 5);
+  const u8 *shared = owned.get();
+  input->OverwriteThenUnload(std::move(owned), 5);
+  input->Load();
+  BOOST_CHECK(input->GetBuf() == shared);
+
+  // 共有されているバッファの上に書き換えてはいけない
+  input->OverwriteKeepingLoaded((const u8*)"abc", 3);
+  BOOST_CHECK(input->GetBuf() != shared);
+  BOOST_CHECK(std::memcmp(shared, "Hello", 5) == 0);
+  fuzzuf::utils::async_file_writer::buffer_t pending;
+  std::size_t pending_len = 0;
+  BOOST_CHECK(writer->get_pending(path.string(), pending, pending_len));
+  BOOST_CHECK_EQUAL(pending_len, 3);
+  BOOST_CHECK(std::memcmp(pending.get(), "abc", 3) == 0);
+  input->Unload();
+  input->Load();
+  BOOST_CHECK_EQUAL(input->GetLen(), 3);
+  BOOST_CHECK(std::memcmp(input->GetBuf(), "abc", 3) == 0);
+  input->Unload();
+
+  // FIFOを読んで書き込みのスレッドを進める
+  int fd = open(fifo_path.c_str(), O_RDONLY);
+  BOOST_REQUIRE(fd >= 0);
+  char c;
+  while (read(fd, &c, 1) > 0) {}
+  close(fd);
+  writer->flush();
+  BOOST_CHECK_EQUAL(fs::file_size(path), 3);
+}
@@ -32,3 +32,38 @@ BOOST_AUTO_TEST_CASE(ExecInputSetTest) {
   BOOST_CHECK(input_set.get_ref(id) != std::nullopt);
   BOOST_CHECK(input_set.get_ref(last_id) == std::nullopt);
 }
+
+// 削除した要素のスロットが再利用されても、古いIDでは引けない
+BOOST_AUTO_TEST_CASE(ExecInputSetSlotReuse) {
+  ExecInputSet input_set;
+
+  auto a = input_set.CreateOnMemory((const u8*)"a", 1)->GetID();
+  auto b = input_set.CreateOnMemory((const u8*)"b", 1)->GetID();
+  auto c = input_set.CreateOnMemory((const u8*)"c", 1)->GetID();
+  BOOST_CHECK(a != ExecInput::INVALID_INPUT_ID);
+
+  input_set.erase(a);
+  input_set.erase(a);
+  BOOST_CHECK_EQUAL(input_set.size(), 2);
+
+  auto d = input_set.CreateOnMemory((const u8*)"d", 1)->GetID();
+  BOOST_CHECK(d != a);
+  BOOST_CHECK(input_set.get_ref(a) == std::nullopt);
+  BOOST_CHECK(input_set.get_shared(a) == nullptr);
+  BOOST_CHECK_EQUAL(input_set.get_ref(d)->get().GetBuf()[0], 'd');
+
+  // 残った要素は削除の影響を受けない
+  BOOST_CHECK_EQUAL(input_set.get_ref(b)->get().GetBuf()[0], 'b');
+  BOOST_CHECK_EQUAL(input_set.get_ref(c)->get().GetBuf()[0], 'c');
+  auto ids = input_set.get_ids();
+  std::set<u64> id_set(ids.begin(), ids.end());
+  BOOST_CHECK(id_set == std::set<u64>({ b, c, d }));
+
+  // 要素は削除後も、共有している側からは使える
+  auto shared = input_set.get_shared(b);
+  input_set.erase(b);
+  BOOST_CHECK_EQUAL(shared->GetBuf()[0], 'b');
+  BOOST_CHECK_EQUAL(shared->GetID(), b);
+
+  BOOST_CHECK(input_set.get_ref(ExecInput::INVALID_INPUT_ID) == std::nullopt);
+}
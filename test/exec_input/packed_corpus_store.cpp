@@ -0,0 +1,164 @@
+#define BOOST_TEST_MODULE exec_input.packed_corpus_store
+#define BOOST_TEST_DYN_LINK
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include <create_file.hpp>
+
+#include "Utils/Filesystem.hpp"
+#include "ExecInput/ExecInputSet.hpp"
+#include "ExecInput/PackedCorpusStore.hpp"
+
+namespace {
+  std::string ReadEntry(const PackedCorpusStore &store, u32 idx) {
+    std::string data(store.GetLen(idx), '\0');
+    store.Read(idx, reinterpret_cast<u8*>(data.data()));
+    return data;
+  }
+
+  std::string ReadAll(const fs::path &path) {
+    std::ifstream ifs(path.string(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  }
+}
+
+#define PACKED_CORPUS_STORE_TEST_TEMP_DIR \
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" ); \
+  const auto raw_dirname = mkdtemp( root_dir_template.data() ); \
+  if( !raw_dirname ) throw -1; \
+  auto root_dir = fs::path( raw_dirname ); \
+  BOOST_SCOPE_EXIT( &root_dir ) { \
+    fs::remove_all( root_dir ); \
+  } BOOST_SCOPE_EXIT_END
+
+// 追加、書き換え、名前の変更、フラグは開き直しても残る
+BOOST_AUTO_TEST_CASE(PackedCorpusStoreReopen) {
+  PACKED_CORPUS_STORE_TEST_TEMP_DIR
+
+  {
+    PackedCorpusStore store(root_dir);
+    BOOST_CHECK_EQUAL(store.size(), 0);
+
+    // 最初の容量を超える数を追加する
+    for (u32 i = 0; i < 2000; i++) {
+      auto name = "id:" + std::to_string(i);
+      auto data = "data" + std::to_string(i);
+      BOOST_CHECK_EQUAL(store.Put(name, (const u8*)data.data(), data.size()), i);
+    }
+
+    BOOST_CHECK_EQUAL(store.Put("id:1", (const u8*)"new", 3), 1);
+    store.Rename(2, "id:2,renamed");
+    BOOST_CHECK_THROW(store.Rename(3, "id:4"), FileError);
+    store.SetFlag(5, PackedCorpusStore::PASSED_DET, true);
+    store.SetFlag(5, PackedCorpusStore::FS_REDUNDANT, true);
+    store.SetFlag(5, PackedCorpusStore::FS_REDUNDANT, false);
+    store.SetParent(6, 5);
+    store.Sync();
+  }
+
+  PackedCorpusStore store(root_dir, true);
+  BOOST_CHECK_EQUAL(store.size(), 2000);
+  BOOST_CHECK_EQUAL(ReadEntry(store, 0), "data0");
+  BOOST_CHECK_EQUAL(ReadEntry(store, 1), "new");
+  BOOST_CHECK_EQUAL(ReadEntry(store, 1999), "data1999");
+  BOOST_CHECK(!store.Find("id:2"));
+  BOOST_CHECK_EQUAL(*store.Find("id:2,renamed"), 2);
+  BOOST_CHECK_EQUAL(ReadEntry(store, 2), "data2");
+  BOOST_CHECK_EQUAL(store.GetFlags(5), PackedCorpusStore::PASSED_DET);
+  BOOST_CHECK_EQUAL(store.GetParent(5), PackedCorpusStore::NO_PARENT);
+  BOOST_CHECK_EQUAL(store.GetParent(6), 5);
+  BOOST_CHECK_THROW(store.Put("id:0", (const u8*)"x", 1), FileError);
+}
+
+// corpus.idxに記録される前に止まった追記は、開き直すと捨てられる
+BOOST_AUTO_TEST_CASE(PackedCorpusStoreTornAppend) {
+  PACKED_CORPUS_STORE_TEST_TEMP_DIR
+
+  u64 segment_size;
+  {
+    PackedCorpusStore store(root_dir);
+    store.Put("a", (const u8*)"Hello", 5);
+    segment_size = store.GetSegmentSize();
+  }
+  {
+    std::ofstream ofs((root_dir / "corpus.seg").string(), std::ios::binary | std::ios::app);
+    ofs << "garbage";
+  }
+
+  PackedCorpusStore store(root_dir);
+  BOOST_CHECK_EQUAL(fs::file_size(root_dir / "corpus.seg"), segment_size);
+  BOOST_CHECK_EQUAL(store.Put("b", (const u8*)"World", 5), 1);
+  BOOST_CHECK_EQUAL(ReadEntry(store, 0), "Hello");
+  BOOST_CHECK_EQUAL(ReadEntry(store, 1), "World");
+}
+
+// AFLのキューディレクトリの形式に書き出せる
+BOOST_AUTO_TEST_CASE(PackedCorpusStoreExport) {
+  PACKED_CORPUS_STORE_TEST_TEMP_DIR
+
+  PackedCorpusStore store(root_dir);
+  store.Put("id:000000,orig:a", (const u8*)"abc", 3);
+  store.Put("id:000001,src:000000,op:havoc", (const u8*)"", 0);
+  store.SetFlag(0, PackedCorpusStore::PASSED_DET, true);
+  store.SetFlag(1, PackedCorpusStore::FS_REDUNDANT, true);
+  store.SetFlag(1, PackedCorpusStore::VAR_BEHAVIOR, true);
+
+  auto queue_dir = root_dir / "queue";
+  store.Export(queue_dir);
+  BOOST_CHECK_EQUAL(ReadAll(queue_dir / "id:000000,orig:a"), "abc");
+  BOOST_CHECK(fs::exists(queue_dir / "id:000001,src:000000,op:havoc"));
+  BOOST_CHECK(fs::exists(queue_dir / ".state/deterministic_done/id:000000,orig:a"));
+  BOOST_CHECK(!fs::exists(queue_dir / ".state/deterministic_done/id:000001,src:000000,op:havoc"));
+  BOOST_CHECK(fs::exists(queue_dir / ".state/redundant_edges/id:000001,src:000000,op:havoc"));
+  BOOST_CHECK(fs::exists(queue_dir / ".state/variable_behavior/id:000001,src:000000,op:havoc"));
+}
+
+// ストアのディレクトリの直下のOnDiskExecInputはストアに読み書きし、それ以外はファイルを使う
+BOOST_AUTO_TEST_CASE(PackedCorpusStoreOnDiskExecInput) {
+  PACKED_CORPUS_STORE_TEST_TEMP_DIR
+
+  auto queue_dir = root_dir / "queue";
+  fs::create_directory(queue_dir);
+  auto seed_path = root_dir / "seed";
+  create_file(seed_path.string(), "Hello");
+
+  auto store = std::make_shared<PackedCorpusStore>(queue_dir);
+  ExecInputSet input_set;
+  input_set.EnablePackedStore(store);
+
+  // シードをキューに移すと、内容はストアに入る
+  auto seed = input_set.CreateOnDisk(seed_path);
+  BOOST_CHECK(seed->LinkAndRefer(queue_dir / "id:000000,orig:seed"));
+  BOOST_CHECK(!fs::exists(queue_dir / "id:000000,orig:seed"));
+  BOOST_CHECK_EQUAL(ReadEntry(*store, 0), "Hello");
+
+  auto input = input_set.CreateOnDisk(queue_dir / "id:000001");
+  input->OverwriteThenUnload((const u8*)"World", 5);
+  BOOST_CHECK_EQUAL(store->size(), 2);
+  input->Load();
+  BOOST_CHECK_EQUAL(input->GetLen(), 5);
+  BOOST_CHECK(std::memcmp(input->GetBuf(), "World", 5) == 0);
+
+  input->OverwriteKeepingLoaded((const u8*)"ab", 2);
+  input->Unload();
+  input->LoadByMmap();
+  BOOST_CHECK_EQUAL(input->GetLen(), 2);
+  BOOST_CHECK(std::memcmp(input->GetBuf(), "ab", 2) == 0);
+  input->Unload();
+
+  // ストア内での移動は名前を変えるだけ
+  BOOST_CHECK(input->LinkAndRefer(queue_dir / "id:000001,renamed"));
+  BOOST_CHECK_EQUAL(store->size(), 2);
+  BOOST_CHECK_EQUAL(*store->Find("id:000001,renamed"), 1);
+
+  // ストアの外へはコピーになる
+  auto out_path = root_dir / "copied";
+  BOOST_CHECK(!input->Link(out_path));
+  input->Copy(out_path);
+  BOOST_CHECK_EQUAL(ReadAll(out_path), "ab");
+}
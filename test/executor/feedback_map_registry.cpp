@@ -0,0 +1,56 @@
+#define BOOST_TEST_MODULE native_linux_executor.feedback_map_registry
+#define BOOST_TEST_DYN_LINK
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <Executor/FeedbackMapRegistry.hpp>
+#include <Utils/Common.hpp>
+
+// 先頭に置く必要のあるマップ以外は1つの共有メモリにまとめて配置されること
+BOOST_AUTO_TEST_CASE(FeedbackMapRegistryLayout) {
+  FeedbackMapRegistry registry;
+  registry.Register( FeedbackMapSpec{ "afl", 65536u, "__AFL_SHM_ID" } );
+  registry.Register( FeedbackMapSpec{ "cmp", 1000u, "" } );
+  registry.Register( FeedbackMapSpec{ "bb", 65536u, "__WYVERN_SHM_ID" } );
+  registry.Register( FeedbackMapSpec{ "mem", 100u, "", FeedbackMapSpec::ResetPolicy::KEEP } );
+  registry.Setup();
+
+  BOOST_CHECK( registry.Has( "afl" ) );
+  BOOST_CHECK( !registry.Has( "none" ) );
+  BOOST_CHECK( registry.GetMap( "none" ) == nullptr );
+  BOOST_CHECK_EQUAL( registry.GetSize( "cmp" ), 1000u );
+
+  // aflは最初の共有メモリの先頭、bbは別の共有メモリの先頭に置かれる
+  BOOST_CHECK_EQUAL( registry.GetShmid( "afl" ), registry.GetShmid( "cmp" ) );
+  BOOST_CHECK_EQUAL( registry.GetShmid( "afl" ), registry.GetShmid( "mem" ) );
+  BOOST_CHECK( registry.GetShmid( "afl" ) != registry.GetShmid( "bb" ) );
+  BOOST_CHECK( registry.GetMap( "cmp" ) >= registry.GetMap( "afl" ) + 65536 );
+
+  registry.ExportEnvironmentVariables();
+  BOOST_CHECK_EQUAL( std::string( getenv( "__AFL_SHM_ID" ) ), std::to_string( registry.GetShmid( "afl" ) ) );
+  BOOST_CHECK_EQUAL( std::string( getenv( "__WYVERN_SHM_ID" ) ), std::to_string( registry.GetShmid( "bb" ) ) );
+  const std::string layout( getenv( FeedbackMapRegistry::LAYOUT_ENV_VAR ) );
+  BOOST_CHECK( layout.find( "cmp:" + std::to_string( registry.GetShmid( "cmp" ) ) + ":" ) != std::string::npos );
+
+  registry.Erase();
+}
+
+// ResetPolicy::ZEROのマップだけが初期化されること
+BOOST_AUTO_TEST_CASE(FeedbackMapRegistryReset) {
+  FeedbackMapRegistry registry;
+  registry.Register( FeedbackMapSpec{ "afl", 65536u, "__AFL_SHM_ID" } );
+  registry.Register( FeedbackMapSpec{ "mem", 100u, "", FeedbackMapSpec::ResetPolicy::KEEP } );
+  registry.Register( FeedbackMapSpec{ "cmp", 1000u, "" } );
+  registry.Setup();
+
+  for( const auto name: { "afl", "mem", "cmp" } )
+    std::memset( registry.GetMap( name ), 1, registry.GetSize( name ) );
+  registry.Reset();
+
+  BOOST_CHECK_EQUAL( Util::CountBytes( registry.GetMap( "afl" ), registry.GetSize( "afl" ) ), 0u );
+  BOOST_CHECK_EQUAL( Util::CountBytes( registry.GetMap( "mem" ), registry.GetSize( "mem" ) ), 100u );
+  BOOST_CHECK_EQUAL( Util::CountBytes( registry.GetMap( "cmp" ), registry.GetSize( "cmp" ) ), 0u );
+
+  registry.Erase();
+}
@@ -1,11 +1,14 @@
 #define BOOST_TEST_MODULE mutator.mutator
 #define BOOST_TEST_DYN_LINK
 #include <string>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 
 #include "ExecInput/OnMemoryExecInput.hpp"
 #include "ExecInput/ExecInputSet.hpp"
 #include "Mutator/Mutator.hpp"
+#include "Algorithms/AFL/AFLDictData.hpp"
+#include "Utils/Random.hpp"
 #include "Utils/HexDump.hpp"
 
 BOOST_AUTO_TEST_CASE(MutatorMutator) {
@@ -43,3 +46,116 @@ BOOST_AUTO_TEST_CASE(MutatorMutator) {
     BOOST_CHECK(result_equal_to_given_fuzz);
     BOOST_CHECK_EQUAL(mutator.GetLen(), sizeof(buf_fuzz));
 }
+
+// 同じ乱数系列から、テーブル化する前のHavocと同じミュータントが生成される
+// goldenは変異をswitchで選んでいた頃の実装で、下と同じシード、辞書、乱数系列から生成したもの
+// HavocBatchでまとめて生成しても同じになり、元のバッファは変化しない
+BOOST_AUTO_TEST_CASE(MutatorHavocBatch) {
+    u8 buf_seed[] = {0x7d, 0xae,  0x9, 0x6, 0x40, 0xe9, 0x92, 0x5f,
+                     0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80};
+
+    ExecInputSet input_set;
+    auto input = input_set.CreateOnMemory(buf_seed, sizeof(buf_seed));
+
+    std::vector<AFLDictData> extras{ AFLDictData(std::vector<u8>{'a', 'b', 'c'}) };
+    std::vector<AFLDictData> a_extras{ AFLDictData(std::vector<u8>{'X', 'Y', 'Z', 'W'}) };
+    std::vector<u32> stackings{ 2, 4, 8, 16, 32, 64, 2, 4, 8, 16 };
+
+    const std::vector<std::vector<u8>> golden{
+        {0x7d, 0xae, 0x09, 0x06, 0x40, 0xe9, 0x92, 0x5f, 0x10, 0x20, 0x15, 0x00, 0x50, 0x60, 0x70, 0x80},
+        {0x7d, 0x20, 0x00, 0x06, 0x40, 0xe9, 0x92, 0x5f, 0x10, 0x20, 0x20, 0x40, 0x70, 0x57, 0x70, 0x80},
+        {0x30, 0x60, 0x10, 0x62, 0x63, 0x00, 0x64},
+        {0x80, 0x00, 0x04, 0x00, 0x00, 0x61, 0x62, 0x70, 0x5f, 0x80, 0x59, 0x5a, 0x57, 0x80},
+        {0x4f, 0x4f},
+        {0x61, 0x62, 0x63, 0x58, 0x64, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x80, 0x5a, 0x57},
+        {0x92, 0x5f, 0x10, 0x40, 0x50, 0x60, 0x70, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80},
+        {0x7d, 0x61, 0x62, 0x63, 0xae, 0x09, 0x11, 0x61, 0x62, 0x63, 0xff, 0xff, 0x7f, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80},
+        {0x80, 0x00, 0x40, 0xe9, 0x92, 0x5f, 0x10, 0x20, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x93},
+        {0x61, 0x62, 0x62, 0xe8, 0x80, 0x04, 0xff, 0x5f, 0x41, 0xc6, 0xc6, 0xc6, 0xc6, 0xc6, 0xc6, 0xc6, 0x2f, 0x41, 0x50, 0x58, 0x59, 0x5a, 0x57, 0x80}
+    };
+
+    fuzzuf::utils::random::prng rng_single(1u);
+    auto single_mutator = Mutator(*input, rng_single);
+    for (std::size_t i = 0; i < stackings.size(); i++) {
+        single_mutator.Havoc(stackings[i], extras, a_extras);
+
+        BOOST_CHECK_EQUAL(single_mutator.GetLen(), golden[i].size());
+        BOOST_CHECK(std::vector<u8>(single_mutator.GetBuf(), single_mutator.GetBuf() + single_mutator.GetLen()) == golden[i]);
+
+        single_mutator.RestoreHavoc();
+        BOOST_CHECK_EQUAL(single_mutator.GetLen(), sizeof(buf_seed));
+        BOOST_CHECK(std::memcmp(single_mutator.GetBuf(), buf_seed, sizeof(buf_seed)) == 0);
+    }
+
+    fuzzuf::utils::random::prng rng_batch(1u);
+    auto batch_mutator = Mutator(*input, rng_batch);
+    batch_mutator.HavocBatch(stackings, extras, a_extras);
+
+    BOOST_CHECK(std::memcmp(batch_mutator.GetBuf(), buf_seed, sizeof(buf_seed)) == 0);
+    BOOST_CHECK_EQUAL(batch_mutator.GetLen(), sizeof(buf_seed));
+
+    for (std::size_t i = 0; i < stackings.size(); i++) {
+        auto [buf, len] = batch_mutator.GetHavocMutant(i);
+        BOOST_CHECK_EQUAL(len, golden[i].size());
+        BOOST_CHECK(std::vector<u8>(buf, buf + len) == golden[i]);
+    }
+}
+
+// 重みが0の変異は選ばれない
+BOOST_AUTO_TEST_CASE(MutatorHavocWeights) {
+    u8 buf_seed[] = {0x7d, 0xae,  0x9, 0x6, 0x40, 0xe9, 0x92, 0x5f};
+
+    ExecInputSet input_set;
+    auto input = input_set.CreateOnMemory(buf_seed, sizeof(buf_seed));
+
+    fuzzuf::utils::random::prng rng(2u);
+    auto mutator = Mutator(*input, rng);
+
+    Mutator::HavocWeights weights{};
+    weights[Mutator::HAVOC_FLIP_BIT] = 1;
+    mutator.SetHavocWeights(weights);
+
+    // 1ビット反転を1回だけ行うと、ちょうど1ビットだけ異なるミュータントができる
+    std::vector<u32> stackings(100, 1);
+    mutator.HavocBatch(stackings, {}, {});
+    for (std::size_t i = 0; i < stackings.size(); i++) {
+        auto [buf, len] = mutator.GetHavocMutant(i);
+        BOOST_CHECK_EQUAL(len, sizeof(buf_seed));
+
+        u32 diff_bits = 0;
+        for (u32 j = 0; j < len; j++) diff_bits += __builtin_popcount(buf[j] ^ buf_seed[j]);
+        BOOST_CHECK_EQUAL(diff_bits, 1);
+    }
+}
+
+// 同じMutationArenaを順に借りたMutatorは、それぞれ自分のシードから始まる
+BOOST_AUTO_TEST_CASE(MutatorSharedArena) {
+    u8 buf_long[]  = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90, 0xa0};
+    u8 buf_short[] = {0x01, 0x02, 0x03, 0x04};
+
+    ExecInputSet input_set;
+    auto input_long  = input_set.CreateOnMemory(buf_long, sizeof(buf_long));
+    auto input_short = input_set.CreateOnMemory(buf_short, sizeof(buf_short));
+
+    fuzzuf::utils::random::prng rng(3u);
+    MutationArena arena;
+
+    {
+        auto mutator = Mutator(*input_long, rng, arena);
+        mutator.Havoc(64, {}, {});
+        mutator.RestoreHavoc();
+        mutator.FlipBit(0, 8);
+    }
+
+    auto mutator = Mutator(*input_short, rng, arena);
+    BOOST_CHECK_EQUAL(mutator.GetLen(), sizeof(buf_short));
+    BOOST_CHECK(std::memcmp(mutator.GetBuf(), buf_short, sizeof(buf_short)) == 0);
+
+    // 元のシードより長い相手とのSplice
+    if (mutator.Splice(*input_long)) {
+        BOOST_CHECK_EQUAL(mutator.GetLen(), sizeof(buf_long));
+        mutator.RestoreSplice();
+    }
+    BOOST_CHECK_EQUAL(mutator.GetLen(), sizeof(buf_short));
+    BOOST_CHECK(std::memcmp(mutator.GetBuf(), buf_short, sizeof(buf_short)) == 0);
+}
@@ -0,0 +1,75 @@
+#define BOOST_TEST_MODULE fuzzerhandle.seed_ids
+#define BOOST_TEST_DYN_LINK
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <Python/PythonFuzzer.hpp>
+#include "config.h"
+#ifdef HAS_CXX_STD_FILESYSTEM
+#include <filesystem>
+#else
+#include <boost/filesystem.hpp>
+#endif
+#include <boost/scope_exit.hpp>
+#include <create_file.hpp>
+#include "Utils/Common.hpp"
+
+// シードのIDが0からの通し番号で、AFLと同じくqueue/id:NNNNNNという名前で保存されることを確認する
+BOOST_AUTO_TEST_CASE(PythonFuzzerSeedIDs) {
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+#ifdef HAS_CXX_STD_FILESYSTEM
+  namespace fs = std::filesystem;
+#else
+  namespace fs = boost::filesystem;
+#endif
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  auto input_dir = root_dir / "input";
+  auto output_dir = root_dir / "output";
+  BOOST_CHECK_EQUAL( fs::create_directory( input_dir ), true );
+  create_file( ( input_dir / "0" ).string(), "Hello, World!" );
+
+  auto fuzzer = PythonFuzzer(
+    { "../../put_binaries/command_wrapper", "/bin/cat" },
+    input_dir.native(), output_dir.native(),
+    1000, 10000,
+    true,
+    true, true // need_afl_cov, need_bb_cov
+  );
+  fuzzer.SuppressLog();
+
+  std::mt19937 rand;
+  std::uniform_int_distribution<> pos_dist( 0, 12 * 8 - 1 );
+  std::vector< u64 > returned_ids{ fuzzer.GetSeedIDs()[ 0 ] };
+  for( int i = 0; i != 10; ++i ) {
+    fuzzer.SelectSeed( returned_ids[ 0 ] );
+    returned_ids.emplace_back( fuzzer.FlipBit( pos_dist( rand ), 1 ) );
+  }
+  returned_ids.emplace_back( fuzzer.AddSeed( 3, { 'a', 'b', 'c' } ) );
+
+  const auto seed_ids = fuzzer.GetSeedIDs();
+  BOOST_CHECK_EQUAL_COLLECTIONS( seed_ids.begin(), seed_ids.end(), returned_ids.begin(), returned_ids.end() );
+  for( u64 i = 0; i != seed_ids.size(); ++i ) {
+    BOOST_CHECK_EQUAL( seed_ids[ i ], i );
+
+    // C++側のAFLと同じ書式の名前で、そのシードの内容が保存されている
+    const auto path = output_dir / "queue" / Util::StrPrintf( "id:%06llu", static_cast< unsigned long long >( i ) );
+    BOOST_REQUIRE( fs::exists( path ) );
+    auto seed = fuzzer.GetPySeed( seed_ids[ i ] );
+    BOOST_REQUIRE( seed );
+    const auto buf = seed->GetBuf();
+    BOOST_CHECK_EQUAL( fs::file_size( path ), buf.size() );
+  }
+
+  // 消したシードのIDは再び使われない
+  fuzzer.RemoveSeed( seed_ids.back() );
+  BOOST_CHECK_EQUAL( fuzzer.GetSeedIDs().size(), seed_ids.size() - 1 );
+  BOOST_CHECK_EQUAL( fuzzer.AddSeed( 3, { 'd', 'e', 'f' } ), seed_ids.size() );
+  BOOST_CHECK( !fuzzer.GetPySeed( seed_ids.back() ) );
+}
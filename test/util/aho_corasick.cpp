@@ -0,0 +1,108 @@
+#define BOOST_TEST_MODULE util.aho_corasick
+#define BOOST_TEST_DYN_LINK
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <Utils/AhoCorasick.hpp>
+#include <Utils/Random.hpp>
+
+namespace ac = fuzzuf::utils::aho_corasick;
+
+using occurrence_t = std::tuple< std::size_t, std::uint32_t >;
+
+static std::vector< occurrence_t > Scan( const ac::matcher &m, const std::string &data ) {
+  std::vector< occurrence_t > found;
+  m.scan(
+    reinterpret_cast< const std::uint8_t* >( data.data() ), data.size(),
+    [&]( std::size_t pos, std::uint32_t id ) { found.emplace_back( pos, id ); }
+  );
+  std::sort( found.begin(), found.end() );
+  return found;
+}
+
+static std::vector< occurrence_t > NaiveScan( const std::vector< std::string > &tokens, const std::string &data ) {
+  std::vector< occurrence_t > found;
+  for( std::size_t pos = 0u; pos != data.size(); ++pos )
+    for( std::uint32_t id = 0u; id != tokens.size(); ++id )
+      if( !tokens[ id ].empty() && data.compare( pos, tokens[ id ].size(), tokens[ id ] ) == 0 )
+        found.emplace_back( pos, id );
+  std::sort( found.begin(), found.end() );
+  return found;
+}
+
+static ac::matcher Compile( const std::vector< std::string > &tokens ) {
+  ac::matcher m;
+  for( const auto &t: tokens )
+    m.add( reinterpret_cast< const std::uint8_t* >( t.data() ), t.size() );
+  m.compile();
+  return m;
+}
+
+// 重なり合う出現や、他のトークンの接尾辞になっているトークンも全て報告される
+BOOST_AUTO_TEST_CASE(UtilAhoCorasickOverlap) {
+  const std::vector< std::string > tokens{ "he", "she", "his", "hers", "", "he" };
+  const auto m = Compile( tokens );
+  BOOST_CHECK_EQUAL( m.size(), 6u );
+  BOOST_CHECK_EQUAL( m.get_length( 3u ), 4u );
+
+  const auto found = Scan( m, "ushers" );
+  const std::vector< occurrence_t > expected{
+    occurrence_t( 1u, 1u ), occurrence_t( 2u, 0u ), occurrence_t( 2u, 3u ), occurrence_t( 2u, 5u )
+  };
+  BOOST_CHECK( found == expected );
+
+  // 出現は終了位置の昇順に報告される
+  std::vector< std::size_t > ends;
+  m.scan(
+    reinterpret_cast< const std::uint8_t* >( "ushers" ), 6u,
+    [&]( std::size_t pos, std::uint32_t id ) { ends.push_back( pos + m.get_length( id ) ); }
+  );
+  BOOST_CHECK( std::is_sorted( ends.begin(), ends.end() ) );
+}
+
+// トークンが無い場合やcompile前は何も報告されない
+BOOST_AUTO_TEST_CASE(UtilAhoCorasickEmpty) {
+  ac::matcher m;
+  BOOST_CHECK( Scan( m, "abc" ).empty() );
+  m.compile();
+  BOOST_CHECK( Scan( m, "abc" ).empty() );
+
+  m.add( reinterpret_cast< const std::uint8_t* >( "b" ), 1u );
+  m.compile();
+  BOOST_CHECK_EQUAL( Scan( m, "abc" ).size(), 1u );
+  m.clear();
+  BOOST_CHECK( m.empty() );
+  m.compile();
+  BOOST_CHECK( Scan( m, "abc" ).empty() );
+}
+
+// ランダムなトークンと入力について、素朴な照合と同じ結果になる
+// 小さいアルファベットを使って、出現が多く重なるようにする
+BOOST_AUTO_TEST_CASE(UtilAhoCorasickSameAsNaive) {
+  fuzzuf::utils::random::prng rng( 1u );
+  for( int round = 0; round != 200; ++round ) {
+    const std::uint32_t alphabet = 2u + rng.below( 4u );
+    std::vector< std::string > tokens( 1u + rng.below( 20u ) );
+    for( auto &t: tokens ) {
+      t.resize( rng.below( 6u ) );
+      for( auto &c: t ) c = char( 'a' + rng.below( alphabet ) );
+    }
+    std::string data( rng.below( 300u ), '\0' );
+    for( auto &c: data ) c = char( 'a' + rng.below( alphabet + 1u ) );
+
+    const auto m = Compile( tokens );
+    BOOST_CHECK( Scan( m, data ) == NaiveScan( tokens, data ) );
+  }
+}
+
+// バイナリのトークンも扱える
+BOOST_AUTO_TEST_CASE(UtilAhoCorasickBinary) {
+  const std::vector< std::string > tokens{ std::string( "\x00\xff", 2u ), std::string( "\xff\x00\xff", 3u ) };
+  const auto m = Compile( tokens );
+  const std::string data( "\xff\x00\xff\x00\xff", 5u );
+  BOOST_CHECK( Scan( m, data ) == NaiveScan( tokens, data ) );
+  BOOST_CHECK_EQUAL( Scan( m, data ).size(), 4u );
+}
@@ -0,0 +1,116 @@
+#define BOOST_TEST_MODULE util.async_file_writer
+#define BOOST_TEST_DYN_LINK
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include <Utils/Common.hpp>
+#include <Utils/Filesystem.hpp>
+#include <Utils/AsyncFileWriter.hpp>
+
+namespace {
+  std::string ReadAll( const fs::path &path ) {
+    std::ifstream ifs( path.string(), std::ios::binary );
+    return std::string( std::istreambuf_iterator< char >( ifs ), std::istreambuf_iterator< char >() );
+  }
+
+  std::vector< std::uint8_t > ToBytes( const std::string &s ) {
+    return std::vector< std::uint8_t >( s.begin(), s.end() );
+  }
+}
+
+#define ASYNC_FILE_WRITER_TEST_TEMP_DIR \
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" ); \
+  const auto raw_dirname = mkdtemp( root_dir_template.data() ); \
+  if( !raw_dirname ) throw -1; \
+  auto root_dir = fs::path( raw_dirname ); \
+  BOOST_SCOPE_EXIT( &root_dir ) { \
+    fs::remove_all( root_dir ); \
+  } BOOST_SCOPE_EXIT_END
+
+// 書き込みが終わるまでは内容をget_pendingで読め、flushの後はファイルにある
+BOOST_AUTO_TEST_CASE(AsyncFileWriterWrite) {
+  ASYNC_FILE_WRITER_TEST_TEMP_DIR
+
+  fuzzuf::utils::async_file_writer writer( 1024u * 1024u );
+  const auto path = ( root_dir / "a" ).string();
+  const auto data = ToBytes( "hello" );
+  writer.write( path, data.data(), data.size() );
+
+  fuzzuf::utils::async_file_writer::buffer_t pending;
+  std::size_t len = 0u;
+  if( writer.get_pending( path, pending, len ) ) {
+    BOOST_CHECK_EQUAL( std::string( pending.get(), pending.get() + len ), "hello" );
+  }
+
+  writer.flush();
+  BOOST_CHECK( !writer.get_pending( path, pending, len ) );
+  BOOST_CHECK_EQUAL( ReadAll( path ), "hello" );
+
+  // 上書きは切り詰める
+  const auto shorter = ToBytes( "hi" );
+  writer.write( path, shorter.data(), shorter.size() );
+  writer.flush();
+  BOOST_CHECK_EQUAL( ReadAll( path ), "hi" );
+}
+
+// 同じパスへの操作は要求した順に行われる
+BOOST_AUTO_TEST_CASE(AsyncFileWriterOrder) {
+  ASYNC_FILE_WRITER_TEST_TEMP_DIR
+
+  fuzzuf::utils::async_file_writer writer( 1024u * 1024u );
+  const auto path = ( root_dir / "b" ).string();
+  const auto first = ToBytes( "first" );
+  const auto second = ToBytes( "second" );
+  for( int i = 0; i != 100; ++i ) {
+    writer.write( path, first.data(), first.size() );
+    writer.remove( path );
+    writer.write( path, second.data(), second.size() );
+  }
+  fuzzuf::utils::async_file_writer::buffer_t pending;
+  std::size_t len = 0u;
+  if( writer.get_pending( path, pending, len ) ) {
+    BOOST_CHECK_EQUAL( std::string( pending.get(), pending.get() + len ), "second" );
+  }
+  writer.flush();
+  BOOST_CHECK_EQUAL( ReadAll( path ), "second" );
+
+  const auto marker = ( root_dir / "marker" ).string();
+  writer.create( marker );
+  writer.remove( marker );
+  writer.create( marker );
+  writer.flush();
+  BOOST_CHECK( fs::exists( marker ) );
+  BOOST_CHECK_EQUAL( fs::file_size( marker ), 0u );
+}
+
+// 失敗は次のflushで報告され、報告された失敗はその次のflushでは報告されない
+BOOST_AUTO_TEST_CASE(AsyncFileWriterError) {
+  ASYNC_FILE_WRITER_TEST_TEMP_DIR
+
+  fuzzuf::utils::async_file_writer writer( 1024u * 1024u );
+  const auto data = ToBytes( "crash" );
+  const auto path = ( root_dir / "c" ).string();
+  writer.write_exclusive( path, data.data(), data.size() );
+  writer.write_exclusive( path, data.data(), data.size() );
+  writer.write( ( root_dir / "no_such_dir" / "d" ).string(), data.data(), data.size() );
+  BOOST_CHECK_THROW( writer.flush(), FileError );
+  BOOST_CHECK_NO_THROW( writer.flush() );
+  BOOST_CHECK_EQUAL( ReadAll( path ), "crash" );
+}
+
+// 容量より大きい書き込みが続いても止まらない
+BOOST_AUTO_TEST_CASE(AsyncFileWriterCapacity) {
+  ASYNC_FILE_WRITER_TEST_TEMP_DIR
+
+  fuzzuf::utils::async_file_writer writer( 16u );
+  const std::vector< std::uint8_t > data( 100u, 'x' );
+  for( int i = 0; i != 200; ++i )
+    writer.write( ( root_dir / std::to_string( i % 10 ) ).string(), data.data(), data.size() - i % 7 );
+  writer.flush();
+  for( int i = 190; i != 200; ++i )
+    BOOST_CHECK_EQUAL( fs::file_size( root_dir / std::to_string( i % 10 ) ), data.size() - i % 7 );
+}
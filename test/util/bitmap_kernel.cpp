@@ -0,0 +1,78 @@
+#define BOOST_TEST_MODULE util.bitmap_kernel
+#define BOOST_TEST_DYN_LINK
+#include <array>
+#include <vector>
+#include <iostream>
+#include <boost/test/unit_test.hpp>
+#include <Utils/Common.hpp>
+#include <Utils/BitmapKernel.hpp>
+#include "random_data.hpp"
+
+namespace bk = fuzzuf::utils::bitmap_kernel;
+
+// 実行中のCPUで利用可能な全ての実装
+static std::vector< bk::isa_t > available_isa() {
+  std::vector< bk::isa_t > isa;
+  for( auto v: { bk::isa_t::SCALAR, bk::isa_t::SSE2, bk::isa_t::AVX2 } )
+    if( bk::is_available( v ) ) isa.push_back( v );
+  return isa;
+}
+
+// SIMD版の端数処理を確認する為、様々な長さとオフセットでスカラー版と結果を比較する
+BOOST_AUTO_TEST_CASE(UtilBitmapKernelCount) {
+  for( auto isa: available_isa() ) {
+    std::cout << "isa: " << bk::to_string( isa ) << std::endl;
+    BOOST_CHECK_EQUAL( bk::count_bits( isa, random_data1.data(), random_data1.size() ), 262309 );
+    BOOST_CHECK_EQUAL( bk::count_bits( isa, random_data2.data(), random_data2.size() ), 1892 );
+    BOOST_CHECK_EQUAL( bk::count_bits( isa, random_data3.data(), random_data3.size() ), 448 );
+    for( u32 offset = 0u; offset != 8u; ++offset ) {
+      for( u32 len = 0u; len <= 260u; len += 4u ) {
+        const u8 *mem = random_data2.data() + offset;
+        BOOST_CHECK_EQUAL(
+          bk::count_bits( isa, mem, len ),
+          bk::count_bits( bk::isa_t::SCALAR, mem, len )
+        );
+        BOOST_CHECK_EQUAL(
+          bk::count_bytes( isa, mem, len + offset ),
+          bk::count_bytes( bk::isa_t::SCALAR, mem, len + offset )
+        );
+        BOOST_CHECK_EQUAL(
+          bk::count_non_255_bytes( isa, mem, len + offset ),
+          bk::count_non_255_bytes( bk::isa_t::SCALAR, mem, len + offset )
+        );
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(UtilBitmapKernelMinimizeBits) {
+  for( auto isa: available_isa() ) {
+    for( u32 len = 0u; len <= 520u; len += 8u ) {
+      std::vector< u8 > expected( len / 8u, 0 );
+      std::vector< u8 > result( len / 8u, 0 );
+      bk::minimize_bits( bk::isa_t::SCALAR, expected.data(), random_data2.data(), len );
+      bk::minimize_bits( isa, result.data(), random_data2.data(), len );
+      BOOST_CHECK( result == expected );
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(UtilBitmapKernelLocateDiffs) {
+  std::vector< u8 > a( random_data1.begin(), std::next( random_data1.begin(), 300 ) );
+  for( auto isa: available_isa() ) {
+    for( u32 first = 0u; first < a.size(); first += 7u ) {
+      for( u32 last = first; last < a.size(); last += 13u ) {
+        auto b = a;
+        b[ first ] ^= 0x01u;
+        b[ last ] ^= 0x80u;
+        const auto [f,l] = bk::locate_diffs( isa, a.data(), b.data(), b.size() );
+        BOOST_CHECK_EQUAL( f, s32( first ) );
+        BOOST_CHECK_EQUAL( l, s32( last ) );
+      }
+    }
+    const auto [f,l] = bk::locate_diffs( isa, a.data(), a.data(), a.size() );
+    BOOST_CHECK_EQUAL( f, -1 );
+    BOOST_CHECK_EQUAL( l, -1 );
+  }
+}
+
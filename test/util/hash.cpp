@@ -2,6 +2,8 @@
 #define BOOST_TEST_DYN_LINK
 #include <array>
 #include <iostream>
+#include <string>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 #include <Utils/Common.hpp>
 #include "random_data.hpp"
@@ -17,3 +19,21 @@ BOOST_AUTO_TEST_CASE(UtilHash32) {
 #endif
 }
 
+
+BOOST_AUTO_TEST_CASE(UtilHash128) {
+  // MurmurHash3_x64_128の既知の値
+  const std::string fox( "The quick brown fox jumps over the lazy dog" );
+  auto h = Util::Hash128( fox.data(), fox.size(), 0 );
+  BOOST_CHECK_EQUAL( h.low, 0xe34bbc7bbc071b6cULL );
+  BOOST_CHECK_EQUAL( h.high, 0x7a433ca9c49a9347ULL );
+
+  auto empty = Util::Hash128( nullptr, 0, 0 );
+  BOOST_CHECK_EQUAL( empty.low, 0u );
+  BOOST_CHECK_EQUAL( empty.high, 0u );
+
+  // 末尾の1バイトだけが違うものも区別する
+  std::vector< std::uint8_t > a( random_data1.begin(), random_data1.end() );
+  auto b = a;
+  b.back() ^= 1;
+  BOOST_CHECK( Util::Hash128( a.data(), a.size(), 0xa5b35705 ) != Util::Hash128( b.data(), b.size(), 0xa5b35705 ) );
+}
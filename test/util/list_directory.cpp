@@ -0,0 +1,57 @@
+#define BOOST_TEST_MODULE util.list_directory
+#define BOOST_TEST_DYN_LINK
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include <Utils/Common.hpp>
+#include <Utils/Filesystem.hpp>
+#include <Utils/ListDirectory.hpp>
+
+#define LIST_DIRECTORY_TEST_TEMP_DIR \
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" ); \
+  const auto raw_dirname = mkdtemp( root_dir_template.data() ); \
+  if( !raw_dirname ) throw -1; \
+  auto root_dir = fs::path( raw_dirname ); \
+  BOOST_SCOPE_EXIT( &root_dir ) { \
+    fs::remove_all( root_dir ); \
+  } BOOST_SCOPE_EXIT_END
+
+// 1回のgetdents64に収まらない数のエントリでも、scandirと同じものが返る
+BOOST_AUTO_TEST_CASE(ListDirectorySameAsScandir) {
+  LIST_DIRECTORY_TEST_TEMP_DIR
+
+  for( int i = 0; i < 10000; ++i ) {
+    std::ofstream( ( root_dir / ( "file_with_a_fairly_long_name_" + std::to_string( i ) ) ).string() );
+  }
+  fs::create_directory( root_dir / "subdir" );
+
+  std::vector< std::string > names;
+  BOOST_REQUIRE( fuzzuf::utils::list_directory( root_dir.string(), names ) );
+  std::sort( names.begin(), names.end() );
+
+  struct dirent **nl;
+  int nl_cnt = Util::ScanDirAlpha( root_dir.string(), &nl );
+  BOOST_REQUIRE_GE( nl_cnt, 0 );
+  std::vector< std::string > expected;
+  for( int i = 0; i < nl_cnt; ++i ) {
+    expected.emplace_back( nl[ i ]->d_name );
+    free( nl[ i ] );
+  }
+  free( nl );
+  std::sort( expected.begin(), expected.end() );
+
+  BOOST_CHECK_EQUAL( names.size(), 10003u );
+  BOOST_CHECK( names == expected );
+}
+
+BOOST_AUTO_TEST_CASE(ListDirectoryNotFound) {
+  LIST_DIRECTORY_TEST_TEMP_DIR
+
+  std::vector< std::string > names;
+  BOOST_CHECK( !fuzzuf::utils::list_directory( ( root_dir / "missing" ).string(), names ) );
+  BOOST_CHECK_EQUAL( errno, ENOENT );
+}
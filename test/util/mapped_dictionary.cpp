@@ -0,0 +1,117 @@
+#define BOOST_TEST_MODULE util.mapped_dictionary
+#define BOOST_TEST_DYN_LINK
+#include <string>
+#include <system_error>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/scope_exit.hpp>
+#include <create_file.hpp>
+#include <Exceptions.hpp>
+#include <Utils/Filesystem.hpp>
+#include <Utils/MappedDictionary.hpp>
+
+namespace dict = fuzzuf::utils::dictionary;
+
+namespace {
+  struct entry_t {
+    using word_t = std::vector< std::uint8_t >;
+    entry_t( const word_t &w ) : word( w ) {}
+    const word_t &get() const { return word; }
+    word_t word;
+  };
+
+  std::vector< entry_t > Sample() {
+    std::vector< entry_t > d;
+    d.emplace_back( entry_t::word_t{ 'a', 'b', 'c' } );
+    d.emplace_back( entry_t::word_t{} );
+    d.emplace_back( entry_t::word_t( 300u, 0xffu ) );
+    d.emplace_back( entry_t::word_t{ 0x00u } );
+    // fixarrayに収まらない要素数にする
+    for( int i = 0; i != 20; ++i ) d.emplace_back( entry_t::word_t( i, std::uint8_t( i ) ) );
+    return d;
+  }
+
+  std::string ToString( const std::vector< std::uint8_t > &v ) {
+    return std::string( v.begin(), v.end() );
+  }
+
+  void CheckSame( const dict::mapped_dictionary &m, const std::vector< entry_t > &expected ) {
+    BOOST_CHECK_EQUAL( m.size(), expected.size() );
+    for( std::size_t i = 0u; i != expected.size() && i != m.size(); ++i ) {
+      const auto &e = expected[ i ].get();
+      BOOST_CHECK_EQUAL( m.get_size( i ), e.size() );
+      BOOST_CHECK( std::equal( e.begin(), e.end(), m.get_data( i ), m.get_data( i ) + m.get_size( i ) ) );
+      const auto word = m[ i ];
+      BOOST_CHECK( std::equal( e.begin(), e.end(), word.begin(), word.end() ) );
+    }
+  }
+}
+
+// flat形式とmsgpack形式のどちらも、書き出した内容をそのまま読める
+// 要素のバイト列はmapped_dictionaryが消えた後も使える
+BOOST_AUTO_TEST_CASE(MappedDictionaryRoundTrip) {
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  const auto sample = Sample();
+  const auto flat = ( root_dir / "flat" ).string();
+  const auto mp = ( root_dir / "mp" ).string();
+  create_file( flat, ToString( dict::to_flat_dictionary( sample ) ) );
+  create_file( mp, ToString( dict::to_msgpack_dictionary( sample ) ) );
+
+  CheckSame( dict::mapped_dictionary( flat ), sample );
+  CheckSame( dict::mapped_dictionary( mp ), sample );
+
+  dict::mapped_dictionary::word_t word = dict::mapped_dictionary( flat )[ 0 ];
+  BOOST_CHECK_EQUAL( std::string( word.begin(), word.end() ), "abc" );
+
+  const std::vector< entry_t > empty;
+  create_file( flat, ToString( dict::to_flat_dictionary( empty ) ) );
+  create_file( mp, ToString( dict::to_msgpack_dictionary( empty ) ) );
+  BOOST_CHECK( dict::mapped_dictionary( flat ).empty() );
+  BOOST_CHECK( dict::mapped_dictionary( mp ).empty() );
+}
+
+// 壊れたファイルや変換前の辞書は変換済みの辞書として扱わない
+BOOST_AUTO_TEST_CASE(MappedDictionaryInvalid) {
+  std::string root_dir_template( "/tmp/fuzzuf_test.XXXXXX" );
+  const auto raw_dirname = mkdtemp( root_dir_template.data() );
+  if( !raw_dirname ) throw -1;
+  auto root_dir = fs::path( raw_dirname );
+  BOOST_SCOPE_EXIT( &root_dir ) {
+    fs::remove_all( root_dir );
+  } BOOST_SCOPE_EXIT_END
+
+  const auto path = ( root_dir / "dict" ).string();
+  const auto sample = Sample();
+
+  auto flat = ToString( dict::to_flat_dictionary( sample ) );
+  auto mp = ToString( dict::to_msgpack_dictionary( sample ) );
+
+  // 末尾が欠けている
+  create_file( path, flat.substr( 0u, flat.size() - 1u ) );
+  BOOST_CHECK_THROW( dict::mapped_dictionary{ path }, exceptions::invalid_file );
+  create_file( path, mp.substr( 0u, mp.size() - 1u ) );
+  BOOST_CHECK( !dict::mapped_dictionary::try_open( path ) );
+
+  // 位置の表が単調でない
+  flat[ dict::mapped_dictionary::flat_header_size + 4u ] = char( 0xff );
+  create_file( path, flat );
+  BOOST_CHECK( !dict::mapped_dictionary::try_open( path ) );
+
+  // 要素がbinでもstrでもない
+  mp[ 3u ] = char( 0xc0 );
+  create_file( path, mp );
+  BOOST_CHECK( !dict::mapped_dictionary::try_open( path ) );
+
+  create_file( path, "\"foo\"\nbar=\"baz\"\n" );
+  BOOST_CHECK( !dict::mapped_dictionary::try_open( path ) );
+
+  BOOST_CHECK( !dict::mapped_dictionary::try_open( ( root_dir / "nonexistent" ).string() ) );
+  BOOST_CHECK_THROW( dict::mapped_dictionary{ ( root_dir / "nonexistent" ).string() }, std::system_error );
+}
@@ -0,0 +1,28 @@
+#define BOOST_TEST_MODULE util.parallel_for
+#define BOOST_TEST_DYN_LINK
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <Utils/ParallelFor.hpp>
+
+// 全てのiについてちょうど1回ずつ呼ばれる
+BOOST_AUTO_TEST_CASE(ParallelForVisitsEachIndexOnce) {
+  std::vector< std::atomic< int > > visits( 1000 );
+  fuzzuf::utils::parallel_for( visits.size(), 4u, 7u, [&]( std::size_t i ) { ++visits[ i ]; } );
+  for( auto &v : visits ) BOOST_CHECK_EQUAL( v.load(), 1 );
+
+  // n == 0やスレッド数が0でも動く
+  fuzzuf::utils::parallel_for( 0u, 4u, 7u, [&]( std::size_t i ) { ++visits[ i ]; } );
+  fuzzuf::utils::parallel_for( visits.size(), 0u, 0u, [&]( std::size_t i ) { ++visits[ i ]; } );
+  for( auto &v : visits ) BOOST_CHECK_EQUAL( v.load(), 2 );
+}
+
+BOOST_AUTO_TEST_CASE(ParallelForRethrows) {
+  BOOST_CHECK_THROW(
+    fuzzuf::utils::parallel_for( 1000u, 4u, 1u, []( std::size_t i ) {
+      if( i == 500 ) throw std::runtime_error( "failed" );
+    } ),
+    std::runtime_error
+  );
+}
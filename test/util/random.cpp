@@ -0,0 +1,81 @@
+#define BOOST_TEST_MODULE util.random
+#define BOOST_TEST_DYN_LINK
+#include <array>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <Utils/Random.hpp>
+
+namespace rnd = fuzzuf::utils::random;
+
+// 同じシードからは同じ系列が得られる
+BOOST_AUTO_TEST_CASE(UtilRandomSameSeed) {
+  rnd::prng a( 1u );
+  rnd::prng b( 1u );
+  rnd::prng c( 2u );
+  bool differ = false;
+  for( int i = 0; i != 1000; ++i ) {
+    const auto va = a();
+    BOOST_CHECK_EQUAL( va, b() );
+    if( va != c() ) differ = true;
+  }
+  BOOST_CHECK( differ );
+}
+
+// fillはoperator()を繰り返し呼んだ場合と同じ値を返す
+// 補充の境界を跨ぐように半端な長さで取り出す
+BOOST_AUTO_TEST_CASE(UtilRandomFill) {
+  rnd::prng a( 3u );
+  rnd::prng b( 3u );
+  a();
+  b();
+  std::vector< rnd::prng::result_type > filled( rnd::prng::batch_size * 3u + 5u );
+  a.fill( filled.data(), filled.size() );
+  for( auto v: filled ) BOOST_CHECK_EQUAL( v, b() );
+  BOOST_CHECK_EQUAL( a(), b() );
+}
+
+// belowは[0, limit)の値のみを返し、各値の出現頻度に大きな偏りがない
+BOOST_AUTO_TEST_CASE(UtilRandomBelow) {
+  rnd::prng rng( 4u );
+  for( std::uint32_t limit: { 1u, 2u, 3u, 7u, 100u, 0x80000001u, 0xFFFFFFFFu } ) {
+    for( int i = 0; i != 10000; ++i ) BOOST_CHECK_LT( rng.below( limit ), limit );
+  }
+
+  constexpr std::uint32_t limit = 7u;
+  constexpr int draws = 70000;
+  std::array< int, limit > hist{};
+  for( int i = 0; i != draws; ++i ) ++hist[ rng.below( limit ) ];
+  for( auto count: hist ) {
+    BOOST_CHECK_GT( count, draws / limit * 9 / 10 );
+    BOOST_CHECK_LT( count, draws / limit * 11 / 10 );
+  }
+}
+
+// splitで作った乱数生成器は元の乱数生成器と異なる系列を持つ
+BOOST_AUTO_TEST_CASE(UtilRandomSplit) {
+  rnd::prng parent( 5u );
+  rnd::prng reference( 5u );
+  auto child = parent.split();
+  std::vector< rnd::prng::result_type > from_child;
+  std::vector< rnd::prng::result_type > from_parent;
+  for( int i = 0; i != 100; ++i ) {
+    from_child.push_back( child() );
+    from_parent.push_back( parent() );
+    // 子は分割前の系列をそのまま引き継ぐ
+    BOOST_CHECK_EQUAL( from_child.back(), reference() );
+  }
+  BOOST_CHECK( from_child != from_parent );
+}
+
+// 保存した状態を戻すと、保存した時点の続きから同じ系列が得られる
+BOOST_AUTO_TEST_CASE(UtilRandomState) {
+  rnd::prng a( 6u );
+  for( int i = 0; i != 5; ++i ) a();
+  const auto saved = a.get_state();
+  std::vector< rnd::prng::result_type > expected;
+  for( std::size_t i = 0; i != rnd::prng::batch_size * 2u; ++i ) expected.push_back( a() );
+
+  rnd::prng b( 7u );
+  b.set_state( saved );
+  for( auto v: expected ) BOOST_CHECK_EQUAL( v, b() );
+}
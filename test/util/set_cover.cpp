@@ -0,0 +1,68 @@
+#define BOOST_TEST_MODULE util.set_cover
+#define BOOST_TEST_DYN_LINK
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <Utils/SetCover.hpp>
+
+namespace {
+  fuzzuf::utils::set_cover_item make_item( std::uint64_t size, const std::vector< std::uint32_t > &elems ) {
+    fuzzuf::utils::set_cover_item item;
+    item.size = size;
+    for( auto e : elems ) {
+      if( item.word_pos.empty() || item.word_pos.back() != e / 64u ) {
+        item.word_pos.emplace_back( e / 64u );
+        item.words.emplace_back( 0u );
+      }
+      item.words.back() |= std::uint64_t( 1u ) << ( e % 64u );
+    }
+    return item;
+  }
+}
+
+// 他の集合で覆える集合は選ばれず、1つの集合しか持たない要素は必ず覆われる
+BOOST_AUTO_TEST_CASE(UtilSetCoverRedundant) {
+  std::vector< fuzzuf::utils::set_cover_item > items{
+    make_item( 10u, { 1u, 2u } ),
+    make_item( 10u, { 2u, 3u } ),
+    make_item( 5u, { 1u, 2u, 3u } ),
+    make_item( 1u, { 130u } )
+  };
+  const auto selected = fuzzuf::utils::set_cover( items, 4u );
+  BOOST_CHECK( selected == std::vector< std::size_t >( { 2u, 3u } ) );
+}
+
+// 同じ要素を持つ集合が複数あれば小さい方が、同じ大きさなら添字が小さい方が選ばれる
+BOOST_AUTO_TEST_CASE(UtilSetCoverTieBreak) {
+  std::vector< fuzzuf::utils::set_cover_item > items{
+    make_item( 8u, { 0u, 64u } ),
+    make_item( 4u, { 0u, 64u } ),
+    make_item( 4u, { 0u, 64u } ),
+    make_item( 4u, { 200u } ),
+    make_item( 4u, { 200u } )
+  };
+  const auto selected = fuzzuf::utils::set_cover( items, 4u );
+  BOOST_CHECK( selected == std::vector< std::size_t >( { 1u, 3u } ) );
+}
+
+// 持っている集合が少ない要素から決めるので、その要素を持つ大きな集合が他の要素もまとめて覆う
+BOOST_AUTO_TEST_CASE(UtilSetCoverRareFirst) {
+  std::vector< fuzzuf::utils::set_cover_item > items{
+    make_item( 1u, { 0u } ),
+    make_item( 1u, { 1u } ),
+    make_item( 100u, { 0u, 1u, 2u } )
+  };
+  const auto selected = fuzzuf::utils::set_cover( items, 1u );
+  BOOST_CHECK( selected == std::vector< std::size_t >( { 2u } ) );
+}
+
+// 要素を持たない集合は選ばれない
+BOOST_AUTO_TEST_CASE(UtilSetCoverEmpty) {
+  std::vector< fuzzuf::utils::set_cover_item > items{
+    make_item( 1u, {} ),
+    make_item( 2u, {} )
+  };
+  BOOST_CHECK( fuzzuf::utils::set_cover( items, 1u ).empty() );
+  BOOST_CHECK( fuzzuf::utils::set_cover( {}, 1u ).empty() );
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <random>
+#include <functional>
+#include <boost/program_options.hpp>
+#include <x86intrin.h>
+#include <Options.hpp>
+#include <Utils/Common.hpp>
+#include <Utils/BitmapKernel.hpp>
+
+// Utils/BitmapKernel.cppの各カーネルを実装毎に実行し、1サイクルあたりに処理したバイト数を表示する
+
+namespace bk = fuzzuf::utils::bitmap_kernel;
+
+// funcをiterations回呼び出し、1サイクルあたりに処理したバイト数を返す
+static double measure( const std::function< void() > &func, u32 len, u32 iterations ) {
+  func(); // warm up
+  const auto begin = __rdtsc();
+  for( u32 i = 0u; i != iterations; ++i ) func();
+  const auto end = __rdtsc();
+  return double( len ) * iterations / double( end - begin );
+}
+
+int main( int argc, char *argv[] ) {
+
+  namespace po = boost::program_options;
+
+  po::options_description desc( "Options" );
+  u32 len = AFLOption::MAP_SIZE;
+  u32 iterations = 10000u;
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "length,l", po::value< u32 >( &len ), "bitmap size in bytes (multiple of 8)" )
+    ( "iterations,n", po::value< u32 >( &iterations ), "number of calls per kernel" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    exit( 0 );
+  }
+  len &= ~u32( 7u );
+
+  // virgin_bitsに近い、大部分が255で所々が欠けたビットマップ
+  std::mt19937 rng( 1u );
+  std::vector< u8 > virgin( len, 255u );
+  for( u32 i = 0u; i < len / 16u; ++i ) virgin[ rng() % len ] = rng();
+  // trace_bitsに近い、大部分が0のビットマップ
+  std::vector< u8 > trace( len, 0u );
+  for( u32 i = 0u; i < len / 16u; ++i ) trace[ rng() % len ] = rng();
+  // LocateDiffsが前後から全体を走査するように中央だけが異なるバッファ
+  std::vector< u8 > other = trace;
+  other[ len / 2u ] ^= 1u;
+  std::vector< u8 > mini( len / 8u );
+
+  volatile u64 sink = 0u;
+  std::cout << std::left << std::setw( 20 ) << "kernel";
+  for( auto isa: { bk::isa_t::SCALAR, bk::isa_t::SSE2, bk::isa_t::AVX2 } )
+    if( bk::is_available( isa ) ) std::cout << std::setw( 12 ) << bk::to_string( isa );
+  std::cout << "(bytes/cycle)" << std::endl;
+
+  const std::vector< std::pair< std::string, std::function< void( bk::isa_t ) > > > kernels{
+    { "CountBits", [&]( bk::isa_t isa ) { sink = sink + bk::count_bits( isa, virgin.data(), len ); } },
+    { "CountBytes", [&]( bk::isa_t isa ) { sink = sink + bk::count_bytes( isa, trace.data(), len ); } },
+    { "CountNon255Bytes", [&]( bk::isa_t isa ) { sink = sink + bk::count_non_255_bytes( isa, virgin.data(), len ); } },
+    { "MinimizeBits", [&]( bk::isa_t isa ) { bk::minimize_bits( isa, mini.data(), trace.data(), len ); sink = sink + mini[ 0 ]; } },
+    { "LocateDiffs", [&]( bk::isa_t isa ) { sink = sink + std::get< 1 >( bk::locate_diffs( isa, trace.data(), other.data(), len ) ); } }
+  };
+  for( const auto &[name,kernel]: kernels ) {
+    std::cout << std::setw( 20 ) << name;
+    for( auto isa: { bk::isa_t::SCALAR, bk::isa_t::SSE2, bk::isa_t::AVX2 } ) {
+      if( !bk::is_available( isa ) ) continue;
+      const auto bpc = measure( [&]() { kernel( isa ); }, len, iterations );
+      std::cout << std::setw( 12 ) << std::fixed << std::setprecision( 3 ) << bpc;
+    }
+    std::cout << std::endl;
+  }
+}
+
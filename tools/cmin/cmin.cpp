@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <boost/program_options.hpp>
+#include <Options.hpp>
+#include <Utils/Common.hpp>
+#include <Utils/Filesystem.hpp>
+#include <Utils/ListDirectory.hpp>
+#include <Utils/SetCover.hpp>
+#include <Executor/NativeLinuxExecutor.hpp>
+#include <Algorithms/AFL/AFLFuzzer.hpp>
+
+// コーパスを、AFLのカバレッジを全て保ったまま小さくする（afl-cminに相当）
+//
+// 各入力を複数のNativeLinuxExecutorで並列に実行し、ヒット数を区分に分類したトレースを得る
+// 分類済みのトレースの各バイトは区分ごとに1ビットだけが立つので、トレースをそのまま
+// 「辺と区分の組」のビット集合とみなし、u64の語単位で扱う。入力ごとには0でない語だけを持つ
+//
+// 組ごとに最も小さい入力（同じ大きさなら名前順で先の方）を選んでおき、持っている入力が少ない組から順に、
+// まだ覆われていなければその入力を採用し、その入力の組を全て覆われたことにする（fuzzuf::utils::set_cover）
+// 実行時間は選択に使わないので、同じコーパスからは毎回同じ入力が選ばれる
+// クラッシュやタイムアウトになった入力は採用しない
+
+namespace {
+
+  constexpr u32 map_words = AFLOption::MAP_SIZE / sizeof( u64 );
+
+  struct sample_t {
+    std::string name;
+    PUTExitReasonType exit_reason = PUTExitReasonType::FAULT_NONE;
+    // 入力の大きさと、トレースの0でない語の位置と値
+    fuzzuf::utils::set_cover_item trace;
+  };
+
+  std::vector< u8 > read_all( const std::string &path, u64 size ) {
+    std::vector< u8 > buf( size );
+    int fd = Util::OpenFile( path, O_RDONLY );
+    try {
+      Util::ReadFile( fd, buf.data(), buf.size() );
+    }
+    catch( ... ) {
+      Util::CloseFile( fd );
+      throw;
+    }
+    Util::CloseFile( fd );
+    return buf;
+  }
+
+  void run_sample( NativeLinuxExecutor &executor, const std::string &in_dir, sample_t &sample ) {
+    auto buf = read_all( in_dir + "/" + sample.name, sample.trace.size );
+
+    executor.Run( buf.data(), buf.size() );
+
+    sample.exit_reason = executor.GetExitStatusFeedback().exit_reason;
+    if( sample.exit_reason != PUTExitReasonType::FAULT_NONE ) return;
+
+    auto inp_feed = executor.GetAFLFeedback();
+    inp_feed.ModifyMemoryWithFunc(
+      []( u8 *trace_bits, u32 map_size ) {
+        AFLFuzzer::ClassifyCounts< u64 >( reinterpret_cast< u64* >( trace_bits ), map_size );
+      }
+    );
+    inp_feed.ShowMemoryToFunc(
+      [&trace = sample.trace]( const u8 *trace_bits, u32 ) {
+        const auto *words = reinterpret_cast< const u64* >( trace_bits );
+        for( u32 i = 0u; i != map_words; ++i ) {
+          if( words[ i ] ) {
+            trace.word_pos.emplace_back( i );
+            trace.words.emplace_back( words[ i ] );
+          }
+        }
+      }
+    );
+  }
+
+}
+
+int main( int argc, char *argv[] ) {
+
+  namespace po = boost::program_options;
+
+  po::options_description desc( "Options" );
+  std::string in_dir;
+  std::string out_dir;
+  u32 timeout_ms = 1000u;
+  u64 memlimit_mb = AFLOption::MEM_LIMIT;
+  u32 jobs = std::max( 1u, std::thread::hardware_concurrency() );
+  std::vector< std::string > target;
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "input,i", po::value< std::string >( &in_dir )->required(), "directory containing the corpus" )
+    ( "output,o", po::value< std::string >( &out_dir )->required(), "directory to write the minimized corpus to (must not exist)" )
+    ( "timeout,t", po::value< u32 >( &timeout_ms ), "timeout for each run (ms)" )
+    ( "memory,m", po::value< u64 >( &memlimit_mb ), "memory limit for the target (MB, 0 for none)" )
+    ( "jobs,j", po::value< u32 >( &jobs ), "number of targets to run in parallel" )
+    ( "target", po::value< std::vector< std::string > >( &target ), "target command line; @@ is replaced with the input file" );
+  po::positional_options_description pos;
+  pos.add( "target", -1 );
+  po::variables_map vm;
+  try {
+    po::store( po::command_line_parser( argc, argv ).options( desc ).positional( pos ).run(), vm );
+    if( vm.count( "help" ) ) {
+      std::cout << "usage: cmin -i in_dir -o out_dir [options] -- /path/to/target [args] @@" << std::endl;
+      std::cout << desc << std::endl;
+      exit( 0 );
+    }
+    po::notify( vm );
+  }
+  catch( const po::error &e ) {
+    std::cerr << e.what() << std::endl;
+    exit( 1 );
+  }
+  if( target.empty() ) {
+    std::cerr << "no target command" << std::endl;
+    exit( 1 );
+  }
+  if( jobs == 0u ) jobs = 1u;
+
+  std::vector< std::string > names;
+  if( !fuzzuf::utils::list_directory( in_dir, names ) ) {
+    std::cerr << "unable to open " << in_dir << std::endl;
+    exit( 1 );
+  }
+  std::sort( names.begin(), names.end() );
+
+  std::vector< sample_t > samples;
+  for( auto &name : names ) {
+    struct stat st;
+    auto path = in_dir + "/" + name;
+    if( lstat( path.c_str(), &st ) != 0 || !S_ISREG( st.st_mode ) || !st.st_size ) continue;
+    if( st.st_size > AFLOption::MAX_FILE ) {
+      std::cerr << "skipping " << path << ": too big" << std::endl;
+      continue;
+    }
+    samples.emplace_back();
+    samples.back().name = std::move( name );
+    samples.back().trace.size = st.st_size;
+  }
+  if( samples.empty() ) {
+    std::cerr << "no inputs in " << in_dir << std::endl;
+    exit( 1 );
+  }
+
+  try {
+    if( !fs::create_directory( out_dir ) ) {
+      std::cerr << out_dir << " already exists" << std::endl;
+      exit( 1 );
+    }
+  }
+  catch( const std::exception &e ) {
+    std::cerr << e.what() << std::endl;
+    exit( 1 );
+  }
+
+  try {
+    jobs = u32( std::min< std::size_t >( jobs, samples.size() ) );
+    std::vector< std::unique_ptr< NativeLinuxExecutor > > executors;
+    for( u32 i = 0u; i != jobs; ++i ) {
+      executors.emplace_back(
+        new NativeLinuxExecutor(
+          target,
+          timeout_ms,
+          memlimit_mb,
+          true,                 // forksrv
+          fs::path( out_dir ) / ( ".cur_input." + std::to_string( i ) ),
+          true,                 // need_afl_cov
+          false,                // need_bb_cov
+          NativeLinuxExecutor::CPUID_DO_NOT_BIND
+        )
+      );
+    }
+    // Each executor overwrites these on construction
+    NativeLinuxExecutor::active_instance = executors.front().get();
+    executors.front()->SetupEnvironmentVariablesForTarget();
+
+    std::cout << "running " << samples.size() << " inputs on " << jobs << " targets..." << std::endl;
+
+    std::atomic< std::size_t > next_sample( 0u );
+    std::vector< std::exception_ptr > errors( jobs );
+    auto work = [&]( u32 worker_id ) {
+      try {
+        while( true ) {
+          std::size_t s = next_sample++;
+          if( s >= samples.size() ) break;
+          run_sample( *executors[ worker_id ], in_dir, samples[ s ] );
+        }
+      }
+      catch( ... ) {
+        errors[ worker_id ] = std::current_exception();
+      }
+    };
+    std::vector< std::thread > threads;
+    for( u32 i = 1u; i < jobs; ++i ) threads.emplace_back( work, i );
+    work( 0u );
+    for( auto &thread : threads ) thread.join();
+    for( auto &error : errors ) {
+      if( error ) std::rethrow_exception( error );
+    }
+
+    for( u32 i = 0u; i != jobs; ++i ) {
+      fs::remove( fs::path( out_dir ) / ( ".cur_input." + std::to_string( i ) ) );
+    }
+  }
+  catch( const std::exception &e ) {
+    std::cerr << e.what() << std::endl;
+    exit( 1 );
+  }
+
+  u32 crashes = 0u;
+  u32 timeouts = 0u;
+  for( const auto &sample : samples ) {
+    if( sample.exit_reason == PUTExitReasonType::FAULT_CRASH ) ++crashes;
+    else if( sample.exit_reason == PUTExitReasonType::FAULT_TMOUT ) ++timeouts;
+  }
+
+  std::vector< fuzzuf::utils::set_cover_item > traces;
+  for( auto &sample : samples ) traces.emplace_back( std::move( sample.trace ) );
+  auto selected = fuzzuf::utils::set_cover( traces, map_words );
+
+  u64 total_size = 0u;
+  u64 selected_size = 0u;
+  for( const auto &trace : traces ) total_size += trace.size;
+  for( std::size_t s : selected ) {
+    const auto &sample = samples[ s ];
+    selected_size += traces[ s ].size;
+    auto from = in_dir + "/" + sample.name;
+    auto to = out_dir + "/" + sample.name;
+    if( link( from.c_str(), to.c_str() ) != 0 ) {
+      try {
+        Util::CopyFile( from, to );
+      }
+      catch( const std::exception &e ) {
+        std::cerr << e.what() << std::endl;
+        exit( 1 );
+      }
+    }
+  }
+
+  if( crashes || timeouts ) {
+    std::cout << "skipped " << crashes << " crashing and " << timeouts << " timing out inputs" << std::endl;
+  }
+  std::cout << selected.size() << " of " << samples.size() << " inputs ("
+            << selected_size << " of " << total_size << " bytes) written to " << out_dir << std::endl;
+}
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <boost/program_options.hpp>
+#include <Utils/Common.hpp>
+#include <ExecInput/PackedCorpusStore.hpp>
+
+// AFL_PACKED_CORPUSで保存したキューを、AFLのキューディレクトリの形式に書き出す
+// 形式の詳細はExecInput/PackedCorpusStore.hppを参照
+
+int main( int argc, char *argv[] ) {
+
+  namespace po = boost::program_options;
+
+  po::options_description desc( "Options" );
+  std::string in_dir( "queue" );
+  std::string out_dir( "queue_exported" );
+  desc.add_options()
+    ( "help,h", "show this message" )
+    ( "input,i", po::value< std::string >( &in_dir ), "directory containing corpus.idx and corpus.seg" )
+    ( "output,o", po::value< std::string >( &out_dir ), "output queue directory" );
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc, argv, desc ), vm );
+  po::notify( vm );
+  if( vm.count( "help" ) ) {
+    std::cout << desc << std::endl;
+    exit( 0 );
+  }
+  if( !PackedCorpusStore::Exists( in_dir ) ) {
+    std::cerr << "no packed corpus in " << in_dir << std::endl;
+    exit( 1 );
+  }
+
+  try {
+    PackedCorpusStore store( in_dir, true );
+    store.Export( out_dir );
+    std::cout << store.size() << " entries exported to " << out_dir << std::endl;
+  }
+  catch( const FileError &e ) {
+    std::cerr << e.what() << std::endl;
+    exit( 1 );
+  }
+}